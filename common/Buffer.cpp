@@ -65,6 +65,17 @@ bool Buffer::Write(std::string &string) {
 	return Write((uint8_t*) string.data(), string.size());
 }
 
+bool Buffer::Adopt(std::vector<uint8_t> &&vec) {
+	if(ReadAvailable() > 0 || (limit && vec.size() > *limit)) {
+		return Write(vec.data(), vec.size());
+	}
+	size_t size = vec.size();
+	data.swap(vec);
+	read_head = 0;
+	write_head = size;
+	return true;
+}
+
 std::tuple<uint8_t*, size_t> Buffer::Reserve(size_t size) {
 	TryEnsureSpace(size);
 	return std::make_tuple(data.data() + write_head, data.size() - write_head);
@@ -121,7 +132,7 @@ bool Buffer::EnsureSpace(size_t size) {
 		if(limit && write_head + size > *limit) {
 			return false;
 		}
-		data.resize(write_head + size);
+		Grow(write_head + size);
 	}
 	return true;
 }
@@ -134,13 +145,24 @@ void Buffer::TryEnsureSpace(size_t size) {
 		if(limit && write_head + size > *limit) {
 			data.resize(*limit);
 		} else {
-			data.resize(write_head + size);
+			Grow(write_head + size);
 		}
 	}
 }
 
+void Buffer::Grow(size_t size) {
+	// grow geometrically so that repeated appends don't reallocate and
+	// zero-fill the whole vector every time
+	size_t new_size = std::max(size, data.size() * 2);
+	if(limit) {
+		new_size = std::min(new_size, std::max(size, *limit));
+	}
+	data.resize(new_size);
+}
+
 void Buffer::Compact() {
-	std::copy(data.begin() + read_head, data.end(), data.begin());
+	// only the unread data needs to move
+	std::copy(data.begin() + read_head, data.begin() + write_head, data.begin());
 	write_head-= read_head;
 	read_head = 0;
 }
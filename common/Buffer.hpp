@@ -61,6 +61,10 @@ class Buffer {
 	}
 
 	bool Write(std::string &str);
+
+	// Like Write, but takes over vec's storage instead of copying it if
+	// nothing is waiting to be read. vec is left with the old storage.
+	bool Adopt(std::vector<uint8_t> &&vec);
 	
 	template<typename T>
 	bool Write(T t) {
@@ -120,6 +124,8 @@ class Buffer {
 	bool EnsureSpace(size_t size);
 	// tries to expand vector, up to limit if necessary.
 	void TryEnsureSpace(size_t size);
+	// resizes vector to hold at least `size` bytes.
+	void Grow(size_t size);
 };
 
 } // namespace util
@@ -0,0 +1,107 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "MemorySnapshot.hpp"
+
+#include<algorithm>
+#include<cstring>
+
+namespace twili {
+namespace util {
+
+uint64_t MemorySnapshot::HashPage(const uint8_t *page) {
+	// Four independent lanes so the multiplies pipeline. Each step is a
+	// bijection of the lane state for a given input word, which is what
+	// makes single-word changes always visible.
+	const uint64_t k = 0x9e3779b97f4a7c15ull;
+	uint64_t lanes[4] = {k, k + 1, k + 2, k + 3};
+	for(size_t i = 0; i < PAGE_SIZE; i+= sizeof(lanes)) {
+		for(size_t j = 0; j < 4; j++) {
+			uint64_t word;
+			std::memcpy(&word, page + i + j * sizeof(uint64_t), sizeof(word));
+			uint64_t x = (lanes[j] ^ word) * k;
+			lanes[j] = (x << 31) | (x >> 33);
+		}
+	}
+
+	uint64_t h = 0;
+	for(size_t j = 0; j < 4; j++) {
+		h = (h ^ lanes[j]) * k;
+		h^= h >> 32;
+	}
+	return h;
+}
+
+void MemorySnapshot::Clear() {
+	runs.clear();
+}
+
+void MemorySnapshot::Record(uint64_t addr, const uint8_t *data, size_t size) {
+	if(runs.empty() || runs.back().base + runs.back().hashes.size() * PAGE_SIZE != addr) {
+		runs.push_back(Run {addr, {}});
+	}
+	std::vector<uint64_t> &hashes = runs.back().hashes;
+	hashes.reserve(hashes.size() + size / PAGE_SIZE);
+	for(size_t offset = 0; offset < size; offset+= PAGE_SIZE) {
+		hashes.push_back(HashPage(data + offset));
+	}
+}
+
+size_t MemorySnapshot::Diff(uint64_t addr, const uint8_t *data, size_t size, std::vector<uint64_t> &changed, size_t max_changed) const {
+	if(changed.size() >= max_changed) {
+		return 0;
+	}
+	for(size_t offset = 0; offset < size; offset+= PAGE_SIZE) {
+		const uint64_t *hash = Find(addr + offset);
+		if(!hash || *hash != HashPage(data + offset)) {
+			changed.push_back(addr + offset);
+			if(changed.size() >= max_changed) {
+				return offset + PAGE_SIZE;
+			}
+		}
+	}
+	return size;
+}
+
+size_t MemorySnapshot::GetPageCount() const {
+	size_t count = 0;
+	for(const Run &run : runs) {
+		count+= run.hashes.size();
+	}
+	return count;
+}
+
+const uint64_t *MemorySnapshot::Find(uint64_t page) const {
+	auto i = std::upper_bound(
+		runs.begin(), runs.end(), page,
+		[](uint64_t page, const Run &run) { return page < run.base; });
+	if(i == runs.begin()) {
+		return nullptr;
+	}
+	i--;
+	uint64_t index = (page - i->base) / PAGE_SIZE;
+	if(index >= i->hashes.size()) {
+		return nullptr;
+	}
+	return &i->hashes[index];
+}
+
+} // namespace util
+} // namespace twili
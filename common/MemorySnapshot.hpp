@@ -0,0 +1,66 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<vector>
+
+#include<stddef.h>
+#include<stdint.h>
+
+namespace twili {
+namespace util {
+
+// Per-page hashes of a range of process memory, used by twili to find which
+// pages changed between two points in time without sending any of them
+// over the bridge. Only 8 bytes are kept per page.
+class MemorySnapshot {
+ public:
+	static const size_t PAGE_SIZE = 0x1000;
+
+	// Non-cryptographic. Any single changed 8-byte word is guaranteed to
+	// change the hash; beyond that, collisions are down to chance.
+	static uint64_t HashPage(const uint8_t *page);
+	
+	void Clear();
+	// Records hashes for the pages in [addr, addr + size). addr and size
+	// must be page-aligned, and calls must go in increasing address order.
+	void Record(uint64_t addr, const uint8_t *data, size_t size);
+	// Hashes the pages in [addr, addr + size) and appends the address of
+	// each one that doesn't match its recorded hash (or was never recorded)
+	// to changed, until it holds max_changed entries. Returns how many bytes
+	// it got through, which is less than size only if it stopped early.
+	size_t Diff(uint64_t addr, const uint8_t *data, size_t size, std::vector<uint64_t> &changed, size_t max_changed) const;
+	
+	size_t GetPageCount() const;
+	
+ private:
+	// contiguous pages
+	struct Run {
+		uint64_t base;
+		std::vector<uint64_t> hashes;
+	};
+	std::vector<Run> runs; // sorted by base, non-overlapping
+
+	const uint64_t *Find(uint64_t page) const;
+};
+
+} // namespace util
+} // namespace twili
@@ -0,0 +1,176 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "PatternScan.hpp"
+
+#include<algorithm>
+#include<cstring>
+
+#include<ctype.h>
+
+namespace twili {
+namespace util {
+
+// Number of candidate positions the anchor prefilter looks at per pass.
+static const size_t SCAN_BLOCK_SIZE = 64;
+
+bool PatternScanner::IsValid(const std::vector<uint8_t> &pattern, const std::vector<uint8_t> &mask, size_t alignment) {
+	return !pattern.empty() &&
+		(mask.empty() || mask.size() == pattern.size()) &&
+		alignment != 0 && (alignment & (alignment - 1)) == 0;
+}
+
+PatternScanner::PatternScanner(const std::vector<uint8_t> &pattern, const std::vector<uint8_t> &mask, size_t alignment) :
+	pattern(pattern),
+	mask(mask.empty() ? std::vector<uint8_t>(pattern.size(), 0xff) : mask),
+	alignment_mask(alignment - 1) {
+	for(size_t i = 0; i < this->pattern.size(); i++) {
+		this->pattern[i]&= this->mask[i];
+		if(this->mask[i] != 0) {
+			if(!has_anchor) {
+				anchor0 = i;
+				has_anchor = true;
+			}
+			anchor1 = i;
+		}
+	}
+}
+
+bool PatternScanner::Matches(const uint8_t *data) const {
+	uint8_t diff = 0;
+	for(size_t i = 0; i < pattern.size(); i++) {
+		diff|= (data[i] & mask[i]) ^ pattern[i];
+	}
+	return diff == 0;
+}
+
+size_t PatternScanner::Scan(const uint8_t *data, size_t size, size_t limit, uint64_t base, std::vector<uint64_t> &matches, size_t max_matches) const {
+	if(matches.size() >= max_matches) {
+		return 0;
+	}
+	if(!has_anchor) {
+		// all wildcards; every aligned position matches and there is
+		// nothing to filter on
+		return ScanScalar(data, size, limit, base, matches, max_matches);
+	}
+	
+	size_t end = size < pattern.size() ? 0 : std::min(limit, size - pattern.size() + 1);
+	const uint8_t *d0 = data + anchor0;
+	const uint8_t *d1 = data + anchor1;
+	const uint8_t m0 = mask[anchor0], p0 = pattern[anchor0];
+	const uint8_t m1 = mask[anchor1], p1 = pattern[anchor1];
+	
+	for(size_t block = 0; block < end; block+= SCAN_BLOCK_SIZE) {
+		uint8_t hits[SCAN_BLOCK_SIZE];
+		size_t count = std::min(SCAN_BLOCK_SIZE, end - block);
+		if(count == SCAN_BLOCK_SIZE) {
+			// fixed trip count so that this vectorizes
+			for(size_t i = 0; i < SCAN_BLOCK_SIZE; i++) {
+				hits[i] = ((d0[block + i] & m0) == p0) & ((d1[block + i] & m1) == p1);
+			}
+		} else {
+			for(size_t i = 0; i < count; i++) {
+				hits[i] = ((d0[block + i] & m0) == p0) & ((d1[block + i] & m1) == p1);
+			}
+			std::fill(hits + count, hits + SCAN_BLOCK_SIZE, 0);
+		}
+
+		for(size_t w = 0; w < SCAN_BLOCK_SIZE; w+= sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, hits + w, sizeof(word));
+			if(word == 0) {
+				continue;
+			}
+			for(size_t i = w; i < w + sizeof(uint64_t); i++) {
+				size_t offset = block + i;
+				if(hits[i] && ((base + offset) & alignment_mask) == 0 && Matches(data + offset)) {
+					matches.push_back(base + offset);
+					if(matches.size() >= max_matches) {
+						return offset + 1;
+					}
+				}
+			}
+		}
+	}
+	
+	return limit;
+}
+
+size_t PatternScanner::ScanScalar(const uint8_t *data, size_t size, size_t limit, uint64_t base, std::vector<uint64_t> &matches, size_t max_matches) const {
+	if(matches.size() >= max_matches) {
+		return 0;
+	}
+	
+	size_t end = size < pattern.size() ? 0 : std::min(limit, size - pattern.size() + 1);
+	for(size_t offset = 0; offset < end; offset++) {
+		if(((base + offset) & alignment_mask) == 0 && Matches(data + offset)) {
+			matches.push_back(base + offset);
+			if(matches.size() >= max_matches) {
+				return offset + 1;
+			}
+		}
+	}
+	
+	return limit;
+}
+
+bool ParsePattern(const std::string &str, std::vector<uint8_t> &pattern, std::vector<uint8_t> &mask) {
+	pattern.clear();
+	mask.clear();
+	
+	size_t i = 0;
+	while(i < str.size()) {
+		if(isspace((unsigned char) str[i])) {
+			i++;
+			continue;
+		}
+		if(i + 1 >= str.size()) {
+			return false;
+		}
+
+		uint8_t value = 0;
+		uint8_t value_mask = 0;
+		for(size_t j = i; j < i + 2; j++) {
+			char c = str[j];
+			value<<= 4;
+			value_mask<<= 4;
+			if(c == '?') {
+				continue;
+			} else if(c >= '0' && c <= '9') {
+				value|= c - '0';
+			} else if(c >= 'a' && c <= 'f') {
+				value|= c - 'a' + 10;
+			} else if(c >= 'A' && c <= 'F') {
+				value|= c - 'A' + 10;
+			} else {
+				return false;
+			}
+			value_mask|= 0xf;
+		}
+		pattern.push_back(value);
+		mask.push_back(value_mask);
+		i+= 2;
+	}
+	
+	return !pattern.empty();
+}
+
+} // namespace util
+} // namespace twili
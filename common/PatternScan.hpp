@@ -0,0 +1,76 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include<stddef.h>
+#include<stdint.h>
+
+namespace twili {
+namespace util {
+
+// Masked byte pattern search, used by twili to scan debuggee memory on the
+// device so that only matching addresses have to cross the bridge. A byte
+// at pattern position i matches when (byte & mask[i]) == (pattern[i] &
+// mask[i]).
+//
+// Scan prefilters candidate positions on two anchor bytes (the first and
+// last positions with a non-zero mask) a fixed-size block at a time, in a
+// form compilers turn into vector compares, and only does the full masked
+// compare on positions that pass. ScanScalar is the straightforward
+// version, kept around to check Scan against.
+class PatternScanner {
+ public:
+	// Patterns must be non-empty, masks must be empty (exact match) or the
+	// same length as the pattern, and alignment must be a power of two.
+	static bool IsValid(const std::vector<uint8_t> &pattern, const std::vector<uint8_t> &mask, size_t alignment);
+	
+	PatternScanner(const std::vector<uint8_t> &pattern, const std::vector<uint8_t> &mask, size_t alignment = 1);
+
+	inline size_t GetSize() const { return pattern.size(); }
+	
+	// Looks for matches that start at offsets [0, limit) of data and end
+	// within its first size bytes, and whose address (base + offset) is
+	// aligned. Appends their addresses to matches until it holds
+	// max_matches entries. Returns the offset to resume scanning from: limit
+	// if it got that far, or one past the last match if it stopped early.
+	size_t Scan(const uint8_t *data, size_t size, size_t limit, uint64_t base, std::vector<uint64_t> &matches, size_t max_matches) const;
+	size_t ScanScalar(const uint8_t *data, size_t size, size_t limit, uint64_t base, std::vector<uint64_t> &matches, size_t max_matches) const;
+	
+ private:
+	bool Matches(const uint8_t *data) const;
+	
+	std::vector<uint8_t> pattern; // pre-masked
+	std::vector<uint8_t> mask;
+	uint64_t alignment_mask;
+	bool has_anchor = false;
+	size_t anchor0 = 0;
+	size_t anchor1 = 0;
+};
+
+// Parses a pattern like "de ad ?? e?", where ? is a wildcard nybble.
+// Whitespace between bytes is optional. Returns false on malformed input.
+bool ParsePattern(const std::string &str, std::vector<uint8_t> &pattern, std::vector<uint8_t> &mask);
+
+} // namespace util
+} // namespace twili
@@ -40,13 +40,22 @@ struct MessageHeader {
 	uint32_t object_count;
 };
 
-const int VERSION = 2;
+const int VERSION = 3;
+
+// Command IDs handled by the bridge itself rather than by any object.
+// CLOSE_OBJECT releases the object it is sent to (or, sent to object 0,
+// every object except object 0). CLOSE_OBJECTS is sent to object 0 and its
+// payload is a plain array of u32 object IDs to release in one go; bridges
+// only understand it starting with protocol version 3.
+const uint32_t CLOSE_OBJECT = 0xffffffff;
+const uint32_t CLOSE_OBJECTS = 0xfffffffe;
 
 class ITwibMetaInterface {
  public:
 	enum class Command : uint32_t {
 		LIST_DEVICES = 10,
 		CONNECT_TCP = 11,
+		DUMP_TRACE = 12,
 	};
 };
 
@@ -77,6 +86,7 @@ class ITwibPipeReader {
  public:
 	enum class Command : uint32_t {
 		READ = 10,
+		SPLICE = 11,
 	};
 };
 
@@ -105,7 +115,28 @@ class ITwibDebugger {
 		GET_TARGET_ENTRY = 21,
 		LAUNCH_DEBUG_PROCESS = 22,
 		GET_NRO_INFOS = 24,
+		SCAN_MEMORY = 25,
+		SNAPSHOT_MEMORY = 26,
+		DIFF_MEMORY = 27,
+		GET_MEMORY_MAP = 28,
+		// Response is a flat array of u64 words. Each sample is
+		//   tick, pause_ticks, thread_count, thread...
+		// and each thread is
+		//   thread_id, lr, frame_count, pc, return addresses...
+		// where frame_count includes pc.
+		SAMPLE = 29,
+		// Responds with the context of each thread that could be read, and a
+		// flat array of u64 words with, for each of those threads in order,
+		//   thread_id, record_count, (address, fp, lr) * record_count
+		// where each triple is a frame record and the address it was read from.
+		BACKTRACE = 30,
+		// Takes TLS addresses from AttachThread events and responds with a
+		// THREAD_NAME_SIZE-byte, NUL-padded slot per thread, empty if the
+		// name couldn't be found.
+		GET_THREAD_NAMES = 31,
 	};
+
+	static const uint32_t THREAD_NAME_SIZE = 0x40;
 };
 
 class ITwibProcessMonitor {
@@ -135,6 +166,26 @@ class ITwibFilesystemAccessor {
 		GET_ENTRY_TYPE = 17,
 		OPEN_FILE = 18,
 		OPEN_DIRECTORY = 19,
+		// Takes a destination filesystem accessor, source and destination
+		// paths, and COPY_FLAG_* flags. Copies recursively on the device and
+		// responds right away with a pipe that streams CopyRecords.
+		COPY = 20,
+	};
+
+	static const uint32_t COPY_FLAG_MOVE = 1; // delete sources once copied
+
+	// Each record is followed by path_size bytes of path, without a NUL.
+	struct CopyRecord {
+		enum class Type : uint32_t {
+			PROGRESS = 0, // copied bytes of a size-byte file so far
+			ENTRY = 1, // finished a file or directory of this size
+			DONE = 2, // last record; bytes is the total copied
+		} type;
+		uint32_t result;
+		uint64_t bytes;
+		uint64_t size;
+		uint32_t entry_type; // as in GET_ENTRY_TYPE: 0 = directory, 1 = file
+		uint32_t path_size;
 	};
 };
 
@@ -0,0 +1,174 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "SegmentedBuffer.hpp"
+
+#include<algorithm>
+#include<cstring>
+
+namespace twili {
+namespace util {
+
+SegmentedBuffer::SegmentedBuffer(size_t max_spare_blocks) : max_spare_blocks(max_spare_blocks) {
+}
+
+SegmentedBuffer::SegmentedBuffer(SegmentedBuffer &&other) :
+	segments(std::move(other.segments)),
+	spare_blocks(std::move(other.spare_blocks)),
+	max_spare_blocks(other.max_spare_blocks),
+	read_available(other.read_available) {
+	other.segments.clear();
+	other.spare_blocks.clear();
+	other.read_available = 0;
+}
+
+SegmentedBuffer::~SegmentedBuffer() {
+	for(Segment &s : segments) {
+		delete[] s.block;
+	}
+	for(uint8_t *block : spare_blocks) {
+		delete[] block;
+	}
+}
+
+std::tuple<uint8_t*, size_t> SegmentedBuffer::Reserve(size_t hint) {
+	size_t wanted = std::min(std::max(hint, (size_t) 1), BLOCK_SIZE);
+	if(segments.empty() || BLOCK_SIZE - segments.back().end < wanted) {
+		segments.push_back(Segment {AllocateBlock(), 0, 0});
+	}
+	Segment &tail = segments.back();
+	return std::make_tuple(tail.block + tail.end, BLOCK_SIZE - tail.end);
+}
+
+void SegmentedBuffer::MarkWritten(size_t size) {
+	segments.back().end+= size;
+	read_available+= size;
+}
+
+void SegmentedBuffer::Write(const uint8_t *data, size_t size) {
+	while(size > 0) {
+		auto [ptr, avail] = Reserve(size);
+		size_t chunk = std::min(avail, size);
+		std::memcpy(ptr, data, chunk);
+		MarkWritten(chunk);
+		data+= chunk;
+		size-= chunk;
+	}
+}
+
+bool SegmentedBuffer::Read(uint8_t *data, size_t size) {
+	if(!Peek(data, size)) {
+		return false;
+	}
+	MarkRead(size);
+	return true;
+}
+
+bool SegmentedBuffer::Read(Buffer &other, size_t size) {
+	if(read_available < size) {
+		return false;
+	}
+	uint8_t *dest = std::get<0>(other.Reserve(size));
+	if(!Peek(dest, size)) {
+		return false;
+	}
+	other.MarkWritten(size);
+	MarkRead(size);
+	return true;
+}
+
+bool SegmentedBuffer::Peek(uint8_t *data, size_t size) const {
+	if(read_available < size) {
+		return false;
+	}
+	for(auto i = segments.begin(); size > 0; i++) {
+		size_t chunk = std::min(i->end - i->begin, size);
+		std::memcpy(data, i->block + i->begin, chunk);
+		data+= chunk;
+		size-= chunk;
+	}
+	return true;
+}
+
+size_t SegmentedBuffer::GetReadSpans(Span *spans, size_t max) const {
+	size_t count = 0;
+	for(auto i = segments.begin(); i != segments.end() && count < max; i++) {
+		if(i->end > i->begin) {
+			spans[count++] = Span {i->block + i->begin, i->end - i->begin};
+		}
+	}
+	return count;
+}
+
+Span SegmentedBuffer::GetFrontSpan() const {
+	Span span = {nullptr, 0};
+	GetReadSpans(&span, 1);
+	return span;
+}
+
+void SegmentedBuffer::MarkRead(size_t size) {
+	read_available-= size;
+	while(!segments.empty()) {
+		Segment &head = segments.front();
+		size_t chunk = std::min(head.end - head.begin, size);
+		head.begin+= chunk;
+		size-= chunk;
+		if(head.begin < head.end) {
+			break;
+		}
+		if(segments.size() > 1) {
+			ReleaseBlock(head.block);
+			segments.pop_front();
+		} else {
+			// keep the last block around for the next write
+			head.begin = 0;
+			head.end = 0;
+			break;
+		}
+	}
+}
+
+size_t SegmentedBuffer::ReadAvailable() const {
+	return read_available;
+}
+
+void SegmentedBuffer::Clear() {
+	MarkRead(read_available);
+}
+
+uint8_t *SegmentedBuffer::AllocateBlock() {
+	if(!spare_blocks.empty()) {
+		uint8_t *block = spare_blocks.back();
+		spare_blocks.pop_back();
+		return block;
+	}
+	return new uint8_t[BLOCK_SIZE];
+}
+
+void SegmentedBuffer::ReleaseBlock(uint8_t *block) {
+	if(spare_blocks.size() < max_spare_blocks) {
+		spare_blocks.push_back(block);
+	} else {
+		delete[] block;
+	}
+}
+
+} // namespace util
+} // namespace twili
@@ -0,0 +1,127 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<deque>
+#include<tuple>
+#include<type_traits>
+#include<vector>
+
+#include<stdint.h>
+
+#include "Buffer.hpp"
+
+namespace twili {
+namespace util {
+
+// Contiguous view into a SegmentedBuffer, like a struct iovec.
+struct Span {
+	uint8_t *data;
+	size_t size;
+};
+
+// Byte queue made of a chain of fixed-size blocks. Unlike Buffer, writing
+// never moves data that is already queued and consuming data never compacts,
+// so the cost of each operation is independent of how much is buffered.
+// Readable data is not guaranteed to be contiguous; use GetReadSpans to walk
+// it without copying.
+// Consumed blocks are kept for reuse (up to `max_spare_blocks` of them) so
+// that steady-state traffic doesn't touch the allocator. Blocks are never
+// zero-filled.
+class SegmentedBuffer {
+ public:
+	static constexpr size_t BLOCK_SIZE = 0x10000;
+	
+	SegmentedBuffer(size_t max_spare_blocks = 4);
+	SegmentedBuffer(const SegmentedBuffer &other) = delete;
+	SegmentedBuffer(SegmentedBuffer &&other);
+	~SegmentedBuffer();
+
+	SegmentedBuffer &operator=(const SegmentedBuffer &other) = delete;
+	
+	// Returns a pointer to contiguous writable space in the last block and
+	// how much of it there is. This is at least min(hint, BLOCK_SIZE) bytes,
+	// but may be less than `hint`. Call MarkWritten to commit it.
+	std::tuple<uint8_t*, size_t> Reserve(size_t hint);
+	void MarkWritten(size_t size);
+
+	void Write(const uint8_t *data, size_t size);
+	
+	template<typename T>
+	void Write(const std::vector<T> &data) {
+		static_assert(std::is_standard_layout<T>::value, "T must be standard layout");
+		Write((const uint8_t*) data.data(), sizeof(T) * data.size());
+	}
+
+	template<typename T>
+	void Write(const T &t) {
+		static_assert(std::is_standard_layout<T>::value, "T must be standard layout");
+		Write((const uint8_t*) &t, sizeof(T));
+	}
+
+	// Like Buffer, reads either succeed completely or leave the buffer
+	// untouched and return false.
+	bool Read(uint8_t *data, size_t size);
+	bool Read(Buffer &other, size_t size);
+
+	template<typename T>
+	bool Read(T &out) {
+		static_assert(std::is_standard_layout<T>::value, "T must be standard layout");
+		return Read((uint8_t*) &out, sizeof(T));
+	}
+
+	template<typename T>
+	bool Read(std::vector<T> &vec) {
+		static_assert(std::is_standard_layout<T>::value, "T must be standard layout");
+		return Read((uint8_t*) vec.data(), sizeof(T) * vec.size());
+	}
+
+	// Copies without consuming.
+	bool Peek(uint8_t *data, size_t size) const;
+	
+	// Fills `spans` with up to `max` views of readable data, in order.
+	// Returns how many were filled.
+	size_t GetReadSpans(Span *spans, size_t max) const;
+	// First contiguous run of readable data. Empty if nothing is readable.
+	Span GetFrontSpan() const;
+	void MarkRead(size_t size);
+
+	size_t ReadAvailable() const;
+	void Clear();
+	
+ private:
+	struct Segment {
+		uint8_t *block;
+		size_t begin;
+		size_t end;
+	};
+	
+	uint8_t *AllocateBlock();
+	void ReleaseBlock(uint8_t *block);
+	
+	std::deque<Segment> segments;
+	std::vector<uint8_t*> spare_blocks;
+	size_t max_spare_blocks;
+	size_t read_available = 0;
+};
+
+} // namespace util
+} // namespace twili
@@ -0,0 +1,99 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<algorithm>
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+const std::vector<uint64_t> MESSAGE_SIZES = {16, 64 * 1024, 16 * 1024 * 1024};
+
+State::State(size_t iterations, uint64_t param) :
+	iterations(iterations),
+	param(param),
+	elapsed(0) {
+}
+
+void State::PauseTiming() {
+	Stop();
+}
+
+void State::ResumeTiming() {
+	Start();
+}
+
+void State::Start() {
+	if(!running) {
+		running = true;
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+void State::Stop() {
+	if(running) {
+		elapsed+= std::chrono::steady_clock::now() - start;
+		running = false;
+	}
+}
+
+std::chrono::nanoseconds State::GetElapsed() const {
+	return elapsed;
+}
+
+void Registry::Add(std::string name, std::vector<uint64_t> params, std::function<void(State&)> func) {
+	benchmarks.push_back(Benchmark {name, params, func});
+}
+
+Result Run(const Benchmark &benchmark, uint64_t param, std::chrono::nanoseconds min_time) {
+	const size_t max_iterations = 1000000000;
+	size_t iterations = 1;
+	while(true) {
+		State state(iterations, param);
+		state.Start();
+		benchmark.func(state);
+		state.Stop();
+
+		std::chrono::nanoseconds elapsed = state.GetElapsed();
+		if(elapsed >= min_time || iterations >= max_iterations) {
+			Result r;
+			r.name = benchmark.name;
+			r.param = param;
+			r.iterations = iterations;
+			double seconds = std::chrono::duration<double>(elapsed).count();
+			r.ns_per_iteration = seconds * 1e9 / iterations;
+			r.bytes_per_second = seconds > 0 ? state.bytes_processed / seconds : 0;
+			r.items_per_second = seconds > 0 ? state.items_processed / seconds : 0;
+			return r;
+		}
+
+		// aim 20% past the minimum time based on this run, but don't grow
+		// by more than 10x at a time in case this run was unrepresentative
+		double scale = elapsed.count() > 0 ? (double) min_time.count() / elapsed.count() * 1.2 : 10.0;
+		scale = std::clamp(scale, 2.0, 10.0);
+		iterations = std::min((size_t) (iterations * scale), max_iterations);
+	}
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
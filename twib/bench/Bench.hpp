@@ -0,0 +1,137 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<atomic>
+#include<chrono>
+#include<functional>
+#include<string>
+#include<vector>
+
+#include<stdint.h>
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// Passed to each benchmark function. The function should run its operation
+// `iterations` times; the harness picks `iterations` so that the run lasts
+// at least the minimum benchmark time.
+class State {
+ public:
+	State(size_t iterations, uint64_t param);
+
+	const size_t iterations;
+	// size or other parameter the benchmark was registered with
+	const uint64_t param;
+
+	// Totals across all iterations, used to report throughput.
+	uint64_t bytes_processed = 0;
+	uint64_t items_processed = 0;
+
+	// Excludes per-iteration setup from the measurement. Both are
+	// comparatively expensive, so avoid calling them on every iteration
+	// of a benchmark that only takes a few nanoseconds.
+	void PauseTiming();
+	void ResumeTiming();
+
+	void Start();
+	void Stop();
+	std::chrono::nanoseconds GetElapsed() const;
+ private:
+	std::chrono::steady_clock::time_point start;
+	std::chrono::nanoseconds elapsed;
+	bool running = false;
+};
+
+struct Benchmark {
+	std::string name;
+	std::vector<uint64_t> params;
+	std::function<void(State&)> func;
+};
+
+class Registry {
+ public:
+	void Add(std::string name, std::vector<uint64_t> params, std::function<void(State&)> func);
+
+	std::vector<Benchmark> benchmarks;
+};
+
+struct Result {
+	std::string name;
+	uint64_t param;
+	size_t iterations;
+	double ns_per_iteration;
+	double bytes_per_second; // 0 if the benchmark doesn't report bytes
+	double items_per_second; // 0 if the benchmark doesn't report items
+};
+
+// Runs the benchmark with increasing iteration counts until a run lasts
+// at least `min_time`.
+Result Run(const Benchmark &benchmark, uint64_t param, std::chrono::nanoseconds min_time);
+
+#if defined(__GNUC__)
+// Keeps the compiler from optimizing away a value that is otherwise unused.
+template<typename T>
+inline void DoNotOptimize(const T &value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Forces any pending writes to memory to be considered observable.
+inline void ClobberMemory() {
+	asm volatile("" : : : "memory");
+}
+#else
+// No inline asm here (MSVC), so publish the value's address through a
+// volatile and fence the compiler instead. This is a little heavier, but
+// only a store.
+template<typename T>
+inline void DoNotOptimize(const T &value) {
+	static const void *volatile sink;
+	sink = &value;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+inline void ClobberMemory() {
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+#endif
+
+// sizes shared between benchmarks so results can be compared
+extern const std::vector<uint64_t> MESSAGE_SIZES; // 16 B, 64 KiB, 16 MiB
+
+// Each benchmark source file registers its benchmarks with one of these.
+void RegisterBufferBenchmarks(Registry &registry);
+void RegisterPackingBenchmarks(Registry &registry);
+void RegisterMessageConnectionBenchmarks(Registry &registry);
+void RegisterMsgpackBenchmarks(Registry &registry);
+void RegisterDispatchBenchmarks(Registry &registry);
+void RegisterLogBenchmarks(Registry &registry);
+void RegisterClientBenchmarks(Registry &registry);
+void RegisterDaemonBenchmarks(Registry &registry);
+void RegisterScanBenchmarks(Registry &registry);
+void RegisterSnapshotBenchmarks(Registry &registry);
+void RegisterProfileBenchmarks(Registry &registry);
+void RegisterGdbBenchmarks(Registry &registry); // only built with TWIB_GDB_ENABLED
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,102 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<algorithm>
+#include<vector>
+
+#include "Buffer.hpp"
+#include "SegmentedBuffer.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// amount of data left sitting in the buffer for the backlog benchmarks,
+// like a connection that is a little behind its peer
+static const size_t BACKLOG_SIZE = 1024 * 1024;
+
+template<typename T>
+static void RoundTrip(State &state) {
+	T buffer;
+	std::vector<uint8_t> src(state.param, 0xaa);
+	std::vector<uint8_t> dst(state.param);
+	for(size_t i = 0; i < state.iterations; i++) {
+		buffer.Write(src.data(), src.size());
+		buffer.Read(dst.data(), dst.size());
+		DoNotOptimize(dst.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+template<typename T>
+static void Backlog(State &state) {
+	T buffer;
+	std::vector<uint8_t> src(state.param, 0xaa);
+	std::vector<uint8_t> dst(state.param);
+	std::vector<uint8_t> backlog(BACKLOG_SIZE, 0x55);
+	buffer.Write(backlog.data(), backlog.size());
+	for(size_t i = 0; i < state.iterations; i++) {
+		buffer.Write(src.data(), src.size());
+		buffer.Read(dst.data(), dst.size());
+		DoNotOptimize(dst.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+// receive path: data arrives in socket-sized chunks via Reserve/MarkWritten
+// and is consumed as whole messages
+template<typename T>
+static void Chunked(State &state) {
+	const size_t chunk_size = 8192;
+	T buffer;
+	std::vector<uint8_t> chunk(chunk_size, 0xaa);
+	std::vector<uint8_t> dst(state.param);
+	for(size_t i = 0; i < state.iterations; i++) {
+		size_t remaining = state.param;
+		while(remaining > 0) {
+			auto [ptr, size] = buffer.Reserve(chunk_size);
+			size_t n = std::min(std::min(size, chunk_size), remaining);
+			std::copy_n(chunk.data(), n, ptr);
+			buffer.MarkWritten(n);
+			remaining-= n;
+		}
+		buffer.Read(dst.data(), dst.size());
+		DoNotOptimize(dst.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+void RegisterBufferBenchmarks(Registry &registry) {
+	registry.Add("buffer/util/roundtrip", MESSAGE_SIZES, RoundTrip<util::Buffer>);
+	registry.Add("buffer/segmented/roundtrip", MESSAGE_SIZES, RoundTrip<util::SegmentedBuffer>);
+	registry.Add("buffer/util/backlog", MESSAGE_SIZES, Backlog<util::Buffer>);
+	registry.Add("buffer/segmented/backlog", MESSAGE_SIZES, Backlog<util::SegmentedBuffer>);
+	registry.Add("buffer/util/chunked", MESSAGE_SIZES, Chunked<util::Buffer>);
+	registry.Add("buffer/segmented/chunked", MESSAGE_SIZES, Chunked<util::SegmentedBuffer>);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,121 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<deque>
+#include<future>
+#include<optional>
+#include<thread>
+
+#include "common/blockingconcurrentqueue.h"
+#include "tool/Client.hpp"
+#include "tool/RemoteObject.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// Answers every request from a separate thread, standing in for the socket
+// to twibd, so that the benchmarks measure the client library's own
+// bookkeeping: tag allocation, the response table, and waking the caller.
+class LoopbackClient : public tool::client::Client {
+ public:
+	LoopbackClient(size_t response_size) :
+		response_payload(response_size, 0xaa),
+		thread(&LoopbackClient::ThreadFunc, this) {
+	}
+
+	virtual ~LoopbackClient() override {
+		queue.enqueue(std::nullopt);
+		thread.join();
+	}
+	
+ protected:
+	virtual void SendRequestImpl(const tool::Request &rq) override {
+		queue.enqueue(rq);
+	}
+	
+ private:
+	void ThreadFunc() {
+		std::optional<tool::Request> rq;
+		while(true) {
+			queue.wait_dequeue(rq);
+			if(!rq) {
+				return;
+			}
+			protocol::MessageHeader mh;
+			mh.device_id = rq->device_id;
+			mh.object_id = rq->object_id;
+			mh.result_code = 0;
+			mh.tag = rq->tag;
+			mh.payload_size = response_payload.size();
+			mh.object_count = 0;
+			util::Buffer payload(response_payload);
+			util::Buffer object_ids;
+			PostResponse(mh, payload, object_ids);
+		}
+	}
+	
+	std::vector<uint8_t> response_payload;
+	moodycamel::BlockingConcurrentQueue<std::optional<tool::Request>> queue;
+	std::thread thread;
+};
+
+// one request at a time, like most of twib's commands
+static void Sync(State &state) {
+	LoopbackClient client(state.param);
+	tool::RemoteObject obj(client, 1, 0);
+	for(size_t i = 0; i < state.iterations; i++) {
+		tool::Response rs = obj.SendSyncRequest(0);
+		DoNotOptimize(rs.payload.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+// keeps `param` requests in flight, like `twib pull` does
+static void Async(State &state) {
+	LoopbackClient client(16);
+	tool::RemoteObject obj(client, 1, 0);
+	std::deque<std::future<tool::Response>> in_flight;
+	size_t sent = 0;
+	for(size_t i = 0; i < state.iterations; i++) {
+		while(in_flight.size() < state.param && sent < state.iterations) {
+			in_flight.push_back(obj.SendAsyncRequest(0));
+			sent++;
+		}
+		tool::Response rs = in_flight.front().get();
+		in_flight.pop_front();
+		DoNotOptimize(rs.payload.data());
+	}
+	state.items_processed = state.iterations;
+}
+
+void RegisterClientBenchmarks(Registry &registry) {
+	// parameter is the response size
+	registry.Add("client/sync", {16, 64 * 1024}, Sync);
+	// parameter is the number of requests kept in flight
+	registry.Add("client/async", {1, 8, 64}, Async);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
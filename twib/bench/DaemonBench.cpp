@@ -0,0 +1,170 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<algorithm>
+#include<atomic>
+#include<optional>
+#include<thread>
+
+#include "common/blockingconcurrentqueue.h"
+#include "common/Semaphore.hpp"
+#include "daemon/Daemon.hpp"
+#include "daemon/PendingRequests.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// Answers every request with an OK response from its own thread, the way
+// the USB and TCP backends do from their event threads.
+class StandInDevice : public daemon::Device {
+ public:
+	StandInDevice(daemon::Daemon &daemon, size_t response_size) :
+		daemon(daemon),
+		response_payload(response_size, 0xaa),
+		thread(&StandInDevice::ThreadFunc, this) {
+		device_id = 0x5bec0000;
+		device_nickname = "stand-in";
+		serial_number = "stand-in";
+	}
+
+	virtual ~StandInDevice() {
+		queue.enqueue(std::nullopt);
+		thread.join();
+	}
+	
+	virtual void SendRequest(const daemon::Request &&r) override {
+		queue.enqueue(daemon::WeakRequest(r.client ? r.client->client_id : 0xffffffff, r.device_id, r.object_id, r.command_id, r.tag));
+	}
+	
+	virtual int GetPriority() override {
+		return 0;
+	}
+	
+	virtual std::string GetBridgeType() override {
+		return "stand-in";
+	}
+	
+ private:
+	void ThreadFunc() {
+		std::optional<daemon::WeakRequest> rq;
+		while(true) {
+			queue.wait_dequeue(rq);
+			if(!rq) {
+				return;
+			}
+			daemon::Response rs = rq->RespondOk();
+			rs.payload = response_payload;
+			daemon.PostResponse(std::move(rs));
+		}
+	}
+	
+	daemon::Daemon &daemon;
+	std::vector<uint8_t> response_payload;
+	moodycamel::BlockingConcurrentQueue<std::optional<daemon::WeakRequest>> queue;
+	std::thread thread;
+};
+
+// Counts responses instead of writing them to a socket.
+class CountingClient : public daemon::Client {
+ public:
+	virtual void PostResponse(daemon::Response &r) override {
+		DoNotOptimize(r.payload.data());
+		responses.notify();
+	}
+
+	common::Semaphore responses;
+};
+
+// Full trip through twibd's dispatch thread: frontend posts a request, the
+// dispatch thread routes it to the device, the device thread posts the
+// response, and the dispatch thread routes it back to the client. Eight
+// requests are kept in flight; the parameter is both the request and the
+// response payload size.
+static void RoundTrip(State &state) {
+	const size_t depth = 8;
+	
+	state.PauseTiming();
+	daemon::Daemon daemon(false);
+	std::shared_ptr<StandInDevice> device = std::make_shared<StandInDevice>(daemon, state.param);
+	std::shared_ptr<CountingClient> client = std::make_shared<CountingClient>();
+	daemon.AddDevice(device);
+	daemon.AddClient(client);
+	std::vector<uint8_t> payload(state.param, 0x55);
+
+	std::atomic<bool> running(true);
+	std::thread dispatch_thread(
+		[&daemon, &running]() {
+			while(running) {
+				daemon.Process();
+			}
+		});
+	state.ResumeTiming();
+
+	size_t sent = 0;
+	for(; sent < std::min(depth, state.iterations); sent++) {
+		daemon.PostRequest(daemon::Request(client, device->device_id, 0, 0, sent, payload));
+	}
+	for(size_t i = 0; i < state.iterations; i++) {
+		client->responses.wait();
+		if(sent < state.iterations) {
+			daemon.PostRequest(daemon::Request(client, device->device_id, 0, 0, sent++, payload));
+		}
+	}
+
+	state.PauseTiming();
+	running = false;
+	daemon.Awaken();
+	dispatch_thread.join();
+	daemon.RemoveClient(client);
+	daemon.RemoveDevice(device);
+	state.ResumeTiming();
+	
+	state.bytes_processed = state.iterations * state.param * 2;
+	state.items_processed = state.iterations;
+}
+
+// Steady-state pipeline at the given depth: every iteration answers the
+// oldest outstanding request and sends a new one, as a backend would.
+static void PendingRequestsPipeline(State &state) {
+	std::shared_ptr<CountingClient> client = std::make_shared<CountingClient>();
+	client->client_id = 1;
+	daemon::PendingRequests pending;
+	uint32_t tag = 0;
+	for(; tag < state.param; tag++) {
+		pending.Add(daemon::Request(client, 1, 0, 0, tag));
+	}
+	for(size_t i = 0; i < state.iterations; i++) {
+		DoNotOptimize(pending.Remove(client->client_id, tag - state.param));
+		pending.Add(daemon::Request(client, 1, 0, 0, tag++));
+	}
+	state.items_processed = state.iterations;
+}
+
+void RegisterDaemonBenchmarks(Registry &registry) {
+	registry.Add("daemon/roundtrip", MESSAGE_SIZES, RoundTrip);
+	registry.Add("daemon/pending_requests", {16, 1024, 16384}, PendingRequestsPipeline);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
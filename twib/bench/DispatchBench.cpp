@@ -0,0 +1,79 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<thread>
+#include<variant>
+#include<vector>
+
+#include "common/blockingconcurrentqueue.h"
+#include "daemon/Messages.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// same element type as Daemon::dispatch_queue
+using DispatchQueue = moodycamel::BlockingConcurrentQueue<std::variant<std::monostate, daemon::Request, daemon::Response>>;
+
+static void SingleThread(State &state) {
+	DispatchQueue queue;
+	std::vector<uint8_t> payload(state.param, 0xaa);
+	std::variant<std::monostate, daemon::Request, daemon::Response> v;
+	for(size_t i = 0; i < state.iterations; i++) {
+		queue.enqueue(daemon::Request(nullptr, 1, 0, 0, i, payload));
+		queue.wait_dequeue(v);
+		DoNotOptimize(v);
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+// one producer (a frontend or backend thread) feeding the dispatch thread
+static void CrossThread(State &state) {
+	DispatchQueue queue;
+	std::vector<uint8_t> payload(state.param, 0xaa);
+	size_t iterations = state.iterations;
+	std::thread producer(
+		[&queue, &payload, iterations]() {
+			for(size_t i = 0; i < iterations; i++) {
+				queue.enqueue(daemon::Request(nullptr, 1, 0, 0, i, payload));
+			}
+		});
+	
+	std::variant<std::monostate, daemon::Request, daemon::Response> v;
+	for(size_t i = 0; i < state.iterations; i++) {
+		queue.wait_dequeue(v);
+		DoNotOptimize(v);
+	}
+	producer.join();
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+void RegisterDispatchBenchmarks(Registry &registry) {
+	registry.Add("dispatch/single_thread", MESSAGE_SIZES, SingleThread);
+	registry.Add("dispatch/cross_thread", MESSAGE_SIZES, CrossThread);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
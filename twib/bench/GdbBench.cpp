@@ -0,0 +1,111 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include "Buffer.hpp"
+#include "tool/GdbConnection.hpp"
+#include "tool/HexCodec.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+using tool::gdb::GdbConnection;
+namespace hex = tool::gdb::hex;
+
+static const std::vector<uint64_t> HEX_SIZES = {16, 4096, 1024 * 1024};
+
+static std::vector<uint8_t> MakeData(size_t size) {
+	std::vector<uint8_t> data(size);
+	for(size_t i = 0; i < data.size(); i++) {
+		data[i] = i * 37;
+	}
+	return data;
+}
+
+static std::vector<char> MakeHex(size_t size) {
+	std::vector<uint8_t> data = MakeData(size);
+	std::vector<char> hex_data(size * 2);
+	hex::EncodeScalar(data.data(), data.size(), hex_data.data());
+	return hex_data;
+}
+
+// memory reads ('m' responses) and writes ('M' packets) are hex-encoded
+// byte for byte, so these dominate the cost of moving memory through the stub
+static void HexEncode(State &state) {
+	std::vector<uint8_t> data = MakeData(state.param);
+	util::Buffer dest;
+	for(size_t i = 0; i < state.iterations; i++) {
+		dest.Clear();
+		GdbConnection::Encode(data.data(), data.size(), dest);
+		DoNotOptimize(dest.Read());
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+static void HexDecode(State &state) {
+	std::vector<char> hex_data = MakeHex(state.param);
+
+	// Decode consumes its input, so the packet is refilled each iteration.
+	// The copy is a memcpy and small next to the decode itself.
+	util::Buffer packet;
+	util::Buffer dest;
+	for(size_t i = 0; i < state.iterations; i++) {
+		packet.Clear();
+		packet.Write(hex_data);
+		dest.Clear();
+		GdbConnection::Decode(dest, packet);
+		DoNotOptimize(dest.Read());
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+// the scalar codecs on their own, for comparison
+static void HexEncodeScalar(State &state) {
+	std::vector<uint8_t> data = MakeData(state.param);
+	std::vector<char> dest(state.param * 2);
+	for(size_t i = 0; i < state.iterations; i++) {
+		hex::EncodeScalar(data.data(), data.size(), dest.data());
+		ClobberMemory();
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+static void HexDecodeScalar(State &state) {
+	std::vector<char> hex_data = MakeHex(state.param);
+	std::vector<uint8_t> dest(state.param);
+	for(size_t i = 0; i < state.iterations; i++) {
+		DoNotOptimize(hex::DecodeScalar(hex_data.data(), dest.size(), dest.data()));
+		ClobberMemory();
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+void RegisterGdbBenchmarks(Registry &registry) {
+	registry.Add("gdb/hex_encode", HEX_SIZES, HexEncode);
+	registry.Add("gdb/hex_decode", HEX_SIZES, HexDecode);
+	registry.Add("gdb/hex_encode_scalar", HEX_SIZES, HexEncodeScalar);
+	registry.Add("gdb/hex_decode_scalar", HEX_SIZES, HexDecodeScalar);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
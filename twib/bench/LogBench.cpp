@@ -0,0 +1,121 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<memory>
+#include<string>
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#include "common/Logger.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// Overrides the global minimum level for the duration of a benchmark, since
+// the only registered logger (errors to stderr) would otherwise let every
+// message below Error short-circuit.
+class MinLevelOverride {
+ public:
+	MinLevelOverride(log::Level lvl) : saved(log::min_level.load()) {
+		log::min_level = lvl;
+	}
+	~MinLevelOverride() {
+		log::min_level = saved;
+	}
+ private:
+	log::Level saved;
+};
+
+// message below the minimum level; only the level check should run
+static void Filtered(State &state) {
+	std::string msg(state.param, 'a');
+	for(size_t i = 0; i < state.iterations; i++) {
+		LogMessage(Debug, "%s %zu", msg.c_str(), i);
+	}
+	state.items_processed = state.iterations;
+}
+
+// message at Info that reaches _log, gets formatted, and is handed to every
+// registered logger (which then drop it)
+static void Dispatch(State &state) {
+	MinLevelOverride override(log::Level::Info);
+	std::string msg(state.param, 'a');
+	for(size_t i = 0; i < state.iterations; i++) {
+		LogMessage(Info, "%s %zu", msg.c_str(), i);
+	}
+	state.items_processed = state.iterations;
+}
+
+static FILE *OpenNull() {
+	FILE *f = fopen("/dev/null", "w");
+	if(f == nullptr) {
+		perror("/dev/null");
+		abort();
+	}
+	return f;
+}
+
+// a plain FileLogger writing on the logging thread
+static void FileSync(State &state) {
+	FILE *null = OpenNull();
+	{
+		log::FileLogger logger(null, log::Level::Info);
+		std::string msg(state.param, 'a');
+		for(size_t i = 0; i < state.iterations; i++) {
+			logger.do_log(log::Level::Info, __FILE__, __LINE__, msg.c_str());
+		}
+	}
+	fclose(null);
+	state.items_processed = state.iterations;
+}
+
+// cost paid by the logging thread with --async-log; messages that overflow
+// the queue are dropped, which is also what would happen in twibd
+static void AsyncEnqueue(State &state) {
+	FILE *null = OpenNull();
+	{
+		log::AsyncLogger logger(std::make_shared<log::FileLogger>(null, log::Level::Info));
+		std::string msg(state.param, 'a');
+		for(size_t i = 0; i < state.iterations; i++) {
+			logger.do_log(log::Level::Info, __FILE__, __LINE__, msg.c_str());
+		}
+		// don't count draining the queue on destruction
+		state.PauseTiming();
+	}
+	fclose(null);
+	state.ResumeTiming();
+	state.items_processed = state.iterations;
+}
+
+void RegisterLogBenchmarks(Registry &registry) {
+	// parameter is the length of the message text
+	registry.Add("log/filtered", {16, 256}, Filtered);
+	registry.Add("log/dispatch", {16, 256}, Dispatch);
+	registry.Add("log/file_sync", {16, 256}, FileSync);
+	registry.Add("log/async_enqueue", {16, 256}, AsyncEnqueue);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,124 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<algorithm>
+#include<vector>
+
+#include "common/MessageConnection.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// Feeds a prerecorded byte stream into MessageConnection in socket-sized
+// reads, so Process() sees the same framing work it does on a real socket.
+class StreamConnection : public common::MessageConnection {
+ public:
+	StreamConnection(std::vector<uint8_t> stream) : stream(std::move(stream)) {
+	}
+
+	void Rewind() {
+		position = 0;
+	}
+
+	void DiscardOutput() {
+		std::lock_guard<common::Semaphore> lock(out_buffer_sema);
+		out_buffer.Clear();
+	}
+	
+ protected:
+	virtual bool RequestInput() override {
+		if(position >= stream.size()) {
+			return false;
+		}
+		auto [ptr, size] = in_buffer.Reserve(8192);
+		size_t n = std::min(std::min(size, (size_t) 8192), stream.size() - position);
+		std::copy_n(stream.data() + position, n, ptr);
+		in_buffer.MarkWritten(n);
+		position+= n;
+		return true;
+	}
+	
+	virtual bool RequestOutput() override {
+		return false;
+	}
+
+ private:
+	std::vector<uint8_t> stream;
+	size_t position = 0;
+};
+
+static protocol::MessageHeader MakeHeader(size_t payload_size, uint32_t tag) {
+	protocol::MessageHeader mh;
+	mh.device_id = 1;
+	mh.object_id = 0;
+	mh.command_id = 0;
+	mh.tag = tag;
+	mh.payload_size = payload_size;
+	mh.object_count = 0;
+	return mh;
+}
+
+static void Process(State &state) {
+	// enough messages that refilling the stream doesn't dominate small sizes
+	size_t messages = std::max((size_t) 2, (size_t) (1024 * 1024 / (state.param + sizeof(protocol::MessageHeader))));
+	std::vector<uint8_t> stream;
+	std::vector<uint8_t> payload(state.param, 0xaa);
+	for(size_t i = 0; i < messages; i++) {
+		protocol::MessageHeader mh = MakeHeader(payload.size(), i);
+		stream.insert(stream.end(), (uint8_t*) &mh, (uint8_t*) (&mh + 1));
+		stream.insert(stream.end(), payload.begin(), payload.end());
+	}
+	
+	StreamConnection connection(std::move(stream));
+	for(size_t i = 0; i < state.iterations; i++) {
+		common::MessageConnection::Request *rq = connection.Process();
+		if(rq == nullptr) {
+			connection.Rewind();
+			rq = connection.Process();
+		}
+		DoNotOptimize(rq);
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+static void Send(State &state) {
+	StreamConnection connection(std::vector<uint8_t> {});
+	std::vector<uint8_t> payload(state.param, 0xaa);
+	std::vector<uint32_t> object_ids;
+	for(size_t i = 0; i < state.iterations; i++) {
+		connection.SendMessage(MakeHeader(payload.size(), i), payload, object_ids);
+		connection.DiscardOutput();
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+void RegisterMessageConnectionBenchmarks(Registry &registry) {
+	registry.Add("message_connection/process", MESSAGE_SIZES, Process);
+	registry.Add("message_connection/send", MESSAGE_SIZES, Send);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
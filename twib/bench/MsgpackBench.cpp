@@ -0,0 +1,127 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<string>
+#include<vector>
+
+#include<msgpack11.hpp>
+
+#include "Protocol.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+// same shape as what ITwibDeviceInterface::Identify sends
+static msgpack11::MsgPack MakeIdentification(int index) {
+	return msgpack11::MsgPack::object {
+		{"service", "twili"},
+		{"protocol", protocol::VERSION},
+		{"firmware_version", std::vector<uint8_t>(0x100, 0x11)},
+		{"serial_number", "XAW10000000" + std::to_string(index)},
+		{"bluetooth_bd_address", std::vector<uint8_t>(6, 0x22)},
+		{"wireless_lan_mac_address", std::vector<uint8_t>(6, 0x33)},
+		{"device_nickname", "bench device " + std::to_string(index)},
+		{"mii_author_id", std::vector<uint8_t>(16, 0x44)}
+	};
+}
+
+// TCPBackend and USBBackend parse this once per device they identify
+static void ParseIdentification(State &state) {
+	std::vector<std::string> serialized;
+	for(uint64_t i = 0; i < state.param; i++) {
+		serialized.push_back(MakeIdentification(i).dump());
+	}
+	
+	for(size_t i = 0; i < state.iterations; i++) {
+		for(const std::string &ser : serialized) {
+			std::string err;
+			msgpack11::MsgPack obj = msgpack11::MsgPack::parse(ser, err);
+			std::string nickname = obj["device_nickname"].string_value();
+			std::string serial_number = obj["serial_number"].string_value();
+			DoNotOptimize(nickname.data());
+			DoNotOptimize(serial_number.data());
+		}
+	}
+	state.items_processed = state.iterations * state.param;
+}
+
+// what twibd does to answer LIST_DEVICES when its cache is cold
+static void SerializeDeviceList(State &state) {
+	std::vector<msgpack11::MsgPack> identifications;
+	for(uint64_t i = 0; i < state.param; i++) {
+		identifications.push_back(MakeIdentification(i));
+	}
+
+	size_t bytes = 0;
+	for(size_t i = 0; i < state.iterations; i++) {
+		std::vector<msgpack11::MsgPack> device_packs;
+		for(uint64_t j = 0; j < identifications.size(); j++) {
+			device_packs.push_back(
+				msgpack11::MsgPack::object {
+					{"device_id", (uint32_t) j},
+					{"bridge_type", "usb"},
+					{"identification", identifications[j]}
+				});
+		}
+		std::string ser = msgpack11::MsgPack(device_packs).dump();
+		bytes+= ser.size();
+		DoNotOptimize(ser.data());
+	}
+	state.bytes_processed = bytes;
+	state.items_processed = state.iterations * state.param;
+}
+
+// what `twib list-devices` does with the response
+static void ParseDeviceList(State &state) {
+	std::vector<msgpack11::MsgPack> device_packs;
+	for(uint64_t i = 0; i < state.param; i++) {
+		device_packs.push_back(
+			msgpack11::MsgPack::object {
+				{"device_id", (uint32_t) i},
+				{"bridge_type", "usb"},
+				{"identification", MakeIdentification(i)}
+			});
+	}
+	std::string ser = msgpack11::MsgPack(device_packs).dump();
+
+	for(size_t i = 0; i < state.iterations; i++) {
+		std::string err;
+		msgpack11::MsgPack obj = msgpack11::MsgPack::parse(ser, err);
+		for(const msgpack11::MsgPack &device : obj.array_items()) {
+			DoNotOptimize(device["identification"]["device_nickname"].string_value().data());
+		}
+	}
+	state.bytes_processed = state.iterations * ser.size();
+	state.items_processed = state.iterations * state.param;
+}
+
+void RegisterMsgpackBenchmarks(Registry &registry) {
+	// parameter is the number of devices
+	registry.Add("msgpack/identification/parse", {1, 16}, ParseIdentification);
+	registry.Add("msgpack/device_list/serialize", {1, 16, 256}, SerializeDeviceList);
+	registry.Add("msgpack/device_list/parse", {1, 16, 256}, ParseDeviceList);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,138 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<string>
+#include<vector>
+
+#include "tool/RemoteObject.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+using tool::in;
+using tool::out;
+using tool::detail::PackingHelper;
+using tool::detail::WrappingHelper;
+
+static void PackVector(State &state) {
+	std::vector<uint8_t> vec(state.param, 0xaa);
+	util::Buffer buffer;
+	for(size_t i = 0; i < state.iterations; i++) {
+		buffer.Clear();
+		PackingHelper<std::vector<uint8_t>>::Pack(std::move(vec), buffer);
+		DoNotOptimize(buffer.Read());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+static void UnpackVector(State &state) {
+	std::vector<uint8_t> vec(state.param, 0xaa);
+	util::Buffer packed;
+	PackingHelper<std::vector<uint8_t>>::Pack(std::move(vec), packed);
+	std::vector<uint8_t> data = packed.GetData();
+	
+	std::vector<uint8_t> result;
+	for(size_t i = 0; i < state.iterations; i++) {
+		util::Buffer buffer(data);
+		PackingHelper<std::vector<uint8_t>>::Unpack(std::move(result), buffer);
+		DoNotOptimize(result.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+static void PackString(State &state) {
+	std::string str(state.param, 'a');
+	util::Buffer buffer;
+	for(size_t i = 0; i < state.iterations; i++) {
+		buffer.Clear();
+		PackingHelper<std::string>::Pack(std::move(str), buffer);
+		DoNotOptimize(buffer.Read());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+static void UnpackString(State &state) {
+	std::string str(state.param, 'a');
+	util::Buffer packed;
+	PackingHelper<std::string>::Pack(std::move(str), packed);
+	std::vector<uint8_t> data = packed.GetData();
+
+	std::string result;
+	for(size_t i = 0; i < state.iterations; i++) {
+		util::Buffer buffer(data);
+		PackingHelper<std::string>::Unpack(std::move(result), buffer);
+		DoNotOptimize(result.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+// what SendSmartSyncRequest does for ITwibFileAccessor::Write
+static void PackWriteRequest(State &state) {
+	std::vector<uint8_t> vec(state.param, 0xaa);
+	for(size_t i = 0; i < state.iterations; i++) {
+		util::Buffer buffer;
+		std::vector<std::shared_ptr<tool::RemoteObject>> objects;
+		uint64_t offset = i;
+		WrappingHelper<in<uint64_t>>::Pack(in<uint64_t>(offset), buffer, objects);
+		WrappingHelper<in<std::vector<uint8_t>>>::Pack(in<std::vector<uint8_t>>(vec), buffer, objects);
+		std::vector<uint8_t> payload = buffer.GetData();
+		DoNotOptimize(payload.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+// what SendSmartSyncRequest does with a ITwibFileAccessor::Read response
+static void UnpackReadResponse(State &state) {
+	std::vector<uint8_t> vec(state.param, 0xaa);
+	util::Buffer packed;
+	PackingHelper<std::vector<uint8_t>>::Pack(std::move(vec), packed);
+	std::vector<uint8_t> payload = packed.GetData();
+	std::vector<std::shared_ptr<tool::RemoteObject>> objects;
+
+	for(size_t i = 0; i < state.iterations; i++) {
+		std::vector<uint8_t> result;
+		util::Buffer buffer(payload);
+		WrappingHelper<out<std::vector<uint8_t>>>::Unpack(out<std::vector<uint8_t>>(result), buffer, objects);
+		DoNotOptimize(result.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+	state.items_processed = state.iterations;
+}
+
+void RegisterPackingBenchmarks(Registry &registry) {
+	registry.Add("packing/vector/pack", MESSAGE_SIZES, PackVector);
+	registry.Add("packing/vector/unpack", MESSAGE_SIZES, UnpackVector);
+	registry.Add("packing/string/pack", MESSAGE_SIZES, PackString);
+	registry.Add("packing/string/unpack", MESSAGE_SIZES, UnpackString);
+	registry.Add("packing/write_request/pack", MESSAGE_SIZES, PackWriteRequest);
+	registry.Add("packing/read_response/unpack", MESSAGE_SIZES, UnpackReadResponse);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
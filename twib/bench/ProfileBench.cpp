@@ -0,0 +1,74 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<random>
+
+#include "tool/Profile.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+using tool::Profile;
+
+static const std::vector<Profile::Module> MODULES = {
+	{"lib", 0x2000000, 0x8000},
+	{"main", 0x1000000, 0x10000},
+};
+
+// Builds a batch of `samples` samples of 8 threads with 16 frames each,
+// drawn from a small set of call sites, like a busy game's main loop.
+static std::vector<uint64_t> MakeBatch(size_t samples) {
+	std::mt19937 rng(0x7072);
+	std::vector<uint64_t> words;
+	for(size_t s = 0; s < samples; s++) {
+		words.insert(words.end(), {s * 19200, 200, 8});
+		for(uint64_t t = 0; t < 8; t++) {
+			words.insert(words.end(), {t, 0, 16});
+			for(int f = 0; f < 16; f++) {
+				words.push_back(0x1000000 + (rng() % 64) * 0x40);
+			}
+		}
+	}
+	return words;
+}
+
+static void AggregateSamples(State &state) {
+	state.PauseTiming();
+	std::vector<uint64_t> batch = MakeBatch(state.param);
+	state.ResumeTiming();
+
+	for(size_t i = 0; i < state.iterations; i++) {
+		Profile profile(MODULES);
+		profile.AddBatch(batch);
+		DoNotOptimize(profile.thread_samples);
+	}
+	state.items_processed = state.iterations * state.param * 8;
+}
+
+void RegisterProfileBenchmarks(Registry &registry) {
+	registry.Add("profile/aggregate", {100, 1000}, AggregateSamples);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,95 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<random>
+
+#include<stdint.h>
+
+#include "PatternScan.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+using util::PatternScanner;
+
+static const std::vector<uint64_t> SCAN_SIZES = {4096, 1024 * 1024, 16 * 1024 * 1024};
+
+// Mostly zeroes with some small integers and pointer-ish values mixed in,
+// which is closer to game heap than uniformly random bytes and keeps the
+// anchor prefilter honest.
+static std::vector<uint8_t> MakeMemory(size_t size, std::mt19937 &rng) {
+	std::vector<uint8_t> data(size, 0);
+	for(size_t i = 0; i + 8 <= size; i+= 8) {
+		switch(rng() % 4) {
+		case 0:
+			data[i] = rng() % 100;
+			break;
+		case 1:
+			for(size_t j = 0; j < 5; j++) {
+				data[i + j] = rng();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return data;
+}
+
+static void ScanBenchmark(State &state, bool scalar) {
+	state.PauseTiming();
+	std::mt19937 rng(1);
+	std::vector<uint8_t> data = MakeMemory(state.param, rng);
+	// a 32-bit value search, the most common kind
+	PatternScanner scanner({0x39, 0x05, 0x00, 0x00}, {}, 4);
+	std::vector<uint64_t> matches;
+	state.ResumeTiming();
+	
+	for(size_t i = 0; i < state.iterations; i++) {
+		matches.clear();
+		if(scalar) {
+			scanner.ScanScalar(data.data(), data.size(), data.size(), 0, matches, SIZE_MAX);
+		} else {
+			scanner.Scan(data.data(), data.size(), data.size(), 0, matches, SIZE_MAX);
+		}
+		DoNotOptimize(matches.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+static void Scan(State &state) {
+	ScanBenchmark(state, false);
+}
+
+static void ScanScalar(State &state) {
+	ScanBenchmark(state, true);
+}
+
+void RegisterScanBenchmarks(Registry &registry) {
+	registry.Add("scan/value", SCAN_SIZES, Scan);
+	registry.Add("scan/value_scalar", SCAN_SIZES, ScanScalar);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,86 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Bench.hpp"
+
+#include<random>
+
+#include<stdint.h>
+
+#include "MemorySnapshot.hpp"
+
+namespace twili {
+namespace twib {
+namespace bench {
+
+using util::MemorySnapshot;
+
+static const std::vector<uint64_t> SNAPSHOT_SIZES = {64 * 1024, 16 * 1024 * 1024};
+
+static std::vector<uint8_t> MakePages(size_t size, std::mt19937 &rng) {
+	std::vector<uint8_t> data(size);
+	for(uint8_t &b : data) {
+		b = rng() % 4 ? 0 : rng();
+	}
+	return data;
+}
+
+static void HashPages(State &state) {
+	state.PauseTiming();
+	std::mt19937 rng(1);
+	std::vector<uint8_t> data = MakePages(state.param, rng);
+	MemorySnapshot snapshot;
+	state.ResumeTiming();
+	
+	for(size_t i = 0; i < state.iterations; i++) {
+		snapshot.Clear();
+		snapshot.Record(0, data.data(), data.size());
+		ClobberMemory();
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+// the common case: most pages unchanged
+static void DiffPages(State &state) {
+	state.PauseTiming();
+	std::mt19937 rng(1);
+	std::vector<uint8_t> data = MakePages(state.param, rng);
+	MemorySnapshot snapshot;
+	snapshot.Record(0, data.data(), data.size());
+	data[data.size() / 2]++;
+	std::vector<uint64_t> changed;
+	state.ResumeTiming();
+	
+	for(size_t i = 0; i < state.iterations; i++) {
+		changed.clear();
+		snapshot.Diff(0, data.data(), data.size(), changed, SIZE_MAX);
+		DoNotOptimize(changed.data());
+	}
+	state.bytes_processed = state.iterations * state.param;
+}
+
+void RegisterSnapshotBenchmarks(Registry &registry) {
+	registry.Add("snapshot/record", SNAPSHOT_SIZES, HashPages);
+	registry.Add("snapshot/diff", SNAPSHOT_SIZES, DiffPages);
+}
+
+} // namespace bench
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,183 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<chrono>
+#include<string>
+#include<vector>
+
+#include<stdio.h>
+#include<time.h>
+
+#include<CLI/CLI.hpp>
+
+#include "common/config.hpp"
+#include "common/Logger.hpp"
+
+#include "Bench.hpp"
+
+using namespace twili;
+using namespace twili::twib;
+
+static std::string EscapeJSON(const std::string &str) {
+	std::string out;
+	for(char c : str) {
+		if(c == '"' || c == '\\') {
+			out.push_back('\\');
+		}
+		out.push_back(c);
+	}
+	return out;
+}
+
+static void WriteText(FILE *f, const std::vector<bench::Result> &results) {
+	fprintf(f, "%-48s %12s %14s %14s %14s\n", "benchmark", "iterations", "ns/iter", "MiB/s", "items/s");
+	for(const bench::Result &r : results) {
+		std::string name = r.name + "/" + std::to_string(r.param);
+		fprintf(f, "%-48s %12zu %14.1f", name.c_str(), r.iterations, r.ns_per_iteration);
+		if(r.bytes_per_second > 0) {
+			fprintf(f, " %14.1f", r.bytes_per_second / (1024.0 * 1024.0));
+		} else {
+			fprintf(f, " %14s", "-");
+		}
+		if(r.items_per_second > 0) {
+			fprintf(f, " %14.0f\n", r.items_per_second);
+		} else {
+			fprintf(f, " %14s\n", "-");
+		}
+	}
+}
+
+// One object per run, with enough context to line results up across
+// releases and machines.
+static void WriteJSON(FILE *f, const std::vector<bench::Result> &results, double min_time_ms) {
+	char date[64];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	
+	fprintf(f, "{\n");
+	fprintf(f, "  \"context\": {\n");
+	fprintf(f, "    \"date\": \"%s\",\n", date);
+#if defined(__VERSION__)
+	fprintf(f, "    \"compiler\": \"%s\",\n", EscapeJSON(__VERSION__).c_str());
+#endif
+#if defined(NDEBUG)
+	fprintf(f, "    \"build_type\": \"release\",\n");
+#else
+	fprintf(f, "    \"build_type\": \"debug\",\n");
+#endif
+	fprintf(f, "    \"min_time_ms\": %g\n", min_time_ms);
+	fprintf(f, "  },\n");
+	fprintf(f, "  \"benchmarks\": [");
+	for(size_t i = 0; i < results.size(); i++) {
+		const bench::Result &r = results[i];
+		fprintf(f, "%s\n    {\"name\": \"%s\", \"param\": %llu, \"iterations\": %zu, \"ns_per_iteration\": %.3f, \"bytes_per_second\": %.1f, \"items_per_second\": %.1f}",
+						i == 0 ? "" : ",",
+						EscapeJSON(r.name).c_str(),
+						(unsigned long long) r.param,
+						r.iterations,
+						r.ns_per_iteration,
+						r.bytes_per_second,
+						r.items_per_second);
+	}
+	fprintf(f, "\n  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+	CLI::App app {"Benchmarks for twib and twibd internals"};
+
+	std::string filter;
+	app.add_option("-f,--filter", filter, "Only run benchmarks whose name contains this string");
+
+	double min_time_ms = 200;
+	app.add_option("-t,--min-time", min_time_ms, "Minimum time to run each benchmark for, in milliseconds");
+
+	std::string format = "text";
+	app.add_set("--format", format, {"text", "json"}, "Output format");
+
+	std::string output;
+	app.add_option("-o,--output", output, "Write results to this file instead of stdout");
+
+	bool list = false;
+	app.add_flag("-l,--list", list, "List benchmarks instead of running them");
+
+	try {
+		app.parse(argc, argv);
+	} catch(const CLI::ParseError &e) {
+		return app.exit(e);
+	}
+
+	// errors still get printed, but everything else is kept out of the
+	// measurements
+	log::add_log(std::make_shared<log::PrettyFileLogger>(stderr, log::Level::Error));
+	
+	bench::Registry registry;
+	bench::RegisterBufferBenchmarks(registry);
+	bench::RegisterPackingBenchmarks(registry);
+	bench::RegisterMessageConnectionBenchmarks(registry);
+	bench::RegisterMsgpackBenchmarks(registry);
+	bench::RegisterDispatchBenchmarks(registry);
+	bench::RegisterLogBenchmarks(registry);
+	bench::RegisterClientBenchmarks(registry);
+	bench::RegisterDaemonBenchmarks(registry);
+	bench::RegisterScanBenchmarks(registry);
+	bench::RegisterSnapshotBenchmarks(registry);
+	bench::RegisterProfileBenchmarks(registry);
+#if TWIB_GDB_ENABLED == 1
+	bench::RegisterGdbBenchmarks(registry);
+#endif
+
+	FILE *out = stdout;
+	if(!output.empty()) {
+		out = fopen(output.c_str(), "w");
+		if(!out) {
+			fprintf(stderr, "failed to open %s\n", output.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<bench::Result> results;
+	std::chrono::nanoseconds min_time((int64_t) (min_time_ms * 1000000.0));
+	for(const bench::Benchmark &b : registry.benchmarks) {
+		if(b.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		for(uint64_t param : b.params) {
+			if(list) {
+				fprintf(out, "%s/%llu\n", b.name.c_str(), (unsigned long long) param);
+				continue;
+			}
+			fprintf(stderr, "running %s/%llu...\n", b.name.c_str(), (unsigned long long) param);
+			results.push_back(bench::Run(b, param, min_time));
+		}
+	}
+
+	if(!list) {
+		if(format == "json") {
+			WriteJSON(out, results, min_time_ms);
+		} else {
+			WriteText(out, results);
+		}
+	}
+
+	if(out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
@@ -0,0 +1,168 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<optional>
+#include<utility>
+#include<vector>
+
+#include<stdint.h>
+
+namespace twili {
+namespace twib {
+namespace common {
+
+// Open-addressing hash map keyed by request tag. Tags are handed out
+// sequentially, so Fibonacci hashing spreads them evenly and linear probing
+// keeps lookups within a cache line or two. Erasure uses backward-shift
+// deletion, so there are no tombstones to clean up after long sessions.
+// Key can be any unsigned integer up to 64 bits, e.g. a client id and tag
+// packed together. Not thread-safe; callers provide their own locking.
+template<typename T, typename Key = uint32_t>
+class FlatTagMap {
+ public:
+	FlatTagMap(size_t initial_capacity = 16) {
+		size_t capacity = 16;
+		while(capacity < initial_capacity) {
+			capacity<<= 1;
+		}
+		Rehash(capacity);
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	T *Find(Key key) {
+		for(size_t i = Index(key); slots[i].value; i = (i + 1) & mask) {
+			if(slots[i].key == key) {
+				return &*slots[i].value;
+			}
+		}
+		return nullptr;
+	}
+
+	bool Contains(Key key) {
+		return Find(key) != nullptr;
+	}
+
+	// returns false if the key was already present
+	bool Insert(Key key, T &&value) {
+		if((count + 1) * 4 > slots.size() * 3) {
+			Rehash(slots.size() * 2);
+		}
+		size_t i = Index(key);
+		for(; slots[i].value; i = (i + 1) & mask) {
+			if(slots[i].key == key) {
+				return false;
+			}
+		}
+		slots[i].key = key;
+		slots[i].value.emplace(std::move(value));
+		count++;
+		return true;
+	}
+
+	// removes the entry and hands its value back to the caller
+	std::optional<T> Take(Key key) {
+		size_t i = Index(key);
+		for(; slots[i].value; i = (i + 1) & mask) {
+			if(slots[i].key == key) {
+				std::optional<T> value = std::move(slots[i].value);
+				slots[i].value.reset();
+				count--;
+				ShiftBack(i);
+				return value;
+			}
+		}
+		return std::nullopt;
+	}
+
+	bool Erase(Key key) {
+		return Take(key).has_value();
+	}
+
+	// calls func(key, value) for every entry, removing all of them
+	template<typename F>
+	void Drain(F &&func) {
+		std::vector<Slot> old(slots.size());
+		std::swap(old, slots);
+		count = 0;
+		for(Slot &s : old) {
+			if(s.value) {
+				func(s.key, std::move(*s.value));
+			}
+		}
+	}
+	
+ private:
+	struct Slot {
+		Key key;
+		std::optional<T> value;
+	};
+	
+	std::vector<Slot> slots;
+	size_t mask;
+	int shift;
+	size_t count = 0;
+
+	size_t Index(Key key) const {
+		return (size_t) (((uint64_t) key * 0x9e3779b97f4a7c15ull) >> shift) & mask;
+	}
+
+	void ShiftBack(size_t hole) {
+		for(size_t j = (hole + 1) & mask; slots[j].value; j = (j + 1) & mask) {
+			size_t home = Index(slots[j].key);
+			// move the entry into the hole if the hole lies between its
+			// home slot and where it currently sits
+			if(((j - home) & mask) >= ((j - hole) & mask)) {
+				slots[hole].key = slots[j].key;
+				slots[hole].value = std::move(slots[j].value);
+				slots[j].value.reset();
+				hole = j;
+			}
+		}
+	}
+
+	void Rehash(size_t capacity) {
+		std::vector<Slot> old(capacity);
+		std::swap(old, slots);
+		mask = capacity - 1;
+		shift = 64;
+		for(size_t c = capacity; c > 1; c>>= 1) {
+			shift--;
+		}
+		count = 0;
+		for(Slot &s : old) {
+			if(s.value) {
+				Insert(s.key, std::move(*s.value));
+			}
+		}
+	}
+};
+
+} // namespace common
+} // namespace twib
+} // namespace twili
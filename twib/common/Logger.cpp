@@ -48,6 +48,7 @@ namespace log {
 const size_t BUFFER_SIZE = 2048;
 
 std::forward_list<std::shared_ptr<Logger>> logs;
+std::atomic<Level> min_level(Level::Max);
 
 void init_color() {
 #ifdef _WIN32
@@ -138,6 +139,10 @@ char *Logger::format(char *buf, int size, bool color, Level lvl, const char *fna
 Logger::~Logger() {
 }
 
+Level Logger::get_min_level() {
+  return Level::Debug;
+}
+
 FileLogger::FileLogger(FILE *fp, Level minlvl, Level maxlvl) {
   this->file = fp;
   this->minlevel = minlvl;
@@ -148,6 +153,10 @@ FileLogger::~FileLogger() {
   fclose(this->file);
 }
 
+Level FileLogger::get_min_level() {
+  return this->minlevel;
+}
+
 void FileLogger::do_log(Level lvl, const char *fname, int line, const char *msg) {
   if(lvl >= this->minlevel && lvl < this->maxlevel) {
     char buf[BUFFER_SIZE + 256];
@@ -181,8 +190,142 @@ void SystemdLogger::do_log(Level lvl, const char *fname, int line, const char *m
 }
 #endif // WITH_SYSTEMD == 1
 
+// Each slot's sequence number says whose turn it is: a slot at ring position
+// pos is free for the producer that claims pos when sequence == pos, and holds
+// a message for the logging thread when sequence == pos + 1. Once the message
+// is written out, the slot is handed to the producer one lap later.
+struct AsyncLogger::Slot {
+  std::atomic<size_t> sequence;
+  Level lvl;
+  const char *fname; // always __FILE__, so doesn't need to be copied
+  int line;
+  char msg[BUFFER_SIZE];
+};
+
+static size_t round_up_pow2(size_t n) {
+  size_t p = 1;
+  while(p < n) {
+    p<<= 1;
+  }
+  return p;
+}
+
+AsyncLogger::AsyncLogger(std::shared_ptr<Logger> backend, size_t capacity) :
+  backend(backend),
+  slots(new Slot[round_up_pow2(capacity)]),
+  mask(round_up_pow2(capacity) - 1),
+  enqueue_pos(0),
+  dequeue_pos(0),
+  running(true),
+  sleeping(false),
+  dropped(0) {
+  for(size_t i = 0; i <= mask; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread = std::thread(&AsyncLogger::ThreadFunc, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    running = false;
+  }
+  wake_condvar.notify_one();
+  thread.join();
+}
+
+void AsyncLogger::do_log(Level lvl, const char *fname, int line, const char *msg) {
+  size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+  Slot *slot;
+  while(true) {
+    slot = &slots[pos & mask];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    if(seq == pos) {
+      if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if(seq < pos) {
+      // slot hasn't been written out since the last lap; ring is full
+      dropped++;
+      return;
+    } else {
+      // another producer claimed pos first
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->lvl = lvl;
+  slot->fname = fname;
+  slot->line = line;
+  strncpy(slot->msg, msg, BUFFER_SIZE - 1);
+  slot->msg[BUFFER_SIZE - 1] = 0;
+  slot->sequence.store(pos + 1); // seq_cst, pairs with the check in ThreadFunc
+
+  // only take the mutex if the logging thread is (about to be) asleep
+  if(sleeping) {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    wake_condvar.notify_one();
+  }
+}
+
+Level AsyncLogger::get_min_level() {
+  return backend->get_min_level();
+}
+
+AsyncLogger::Slot *AsyncLogger::Peek() {
+  Slot *slot = &slots[dequeue_pos & mask];
+  if(slot->sequence.load() == dequeue_pos + 1) {
+    return slot;
+  } else {
+    return nullptr;
+  }
+}
+
+void AsyncLogger::Release(Slot *slot) {
+  slot->sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+  dequeue_pos++;
+}
+
+void AsyncLogger::ThreadFunc() {
+  while(true) {
+    Slot *slot = Peek();
+    bool stopping = false;
+    if(slot == nullptr) {
+      std::unique_lock<std::mutex> lock(wake_mutex);
+      sleeping = true;
+      // check again now that producers can see we're asleep
+      slot = Peek();
+      if(slot == nullptr) {
+        if(running) {
+          wake_condvar.wait_for(lock, std::chrono::milliseconds(100));
+        } else {
+          stopping = true;
+        }
+      }
+      sleeping = false;
+    }
+    
+    size_t drop_count = dropped.exchange(0);
+    if(drop_count > 0) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "dropped %zu log messages", drop_count);
+      backend->do_log(Level::Warning, __FILE__, __LINE__, buf);
+    }
+    
+    if(slot != nullptr) {
+      backend->do_log(slot->lvl, slot->fname, slot->line, slot->msg);
+      Release(slot);
+    } else if(stopping) {
+      break; // queue is drained and we've been asked to stop
+    }
+  }
+}
+
 void add_log(std::shared_ptr<Logger> l) {
   logs.push_front(l);
+  if(l->get_min_level() < min_level) {
+    min_level = l->get_min_level();
+  }
 }
 
 } // namespace log
@@ -20,8 +20,13 @@
 
 #pragma once
 
+#include<atomic>
+#include<condition_variable>
 #include<memory>
+#include<mutex>
 #include<ostream>
+#include<string>
+#include<thread>
 
 #include "common/config.hpp"
 
@@ -82,14 +87,23 @@ enum class Level {
 	Max
 };
 
+// lowest level that any registered logger will accept, so that messages
+// nobody will see can be skipped without formatting them.
+extern std::atomic<Level> min_level;
+
 #define LogMessage(lvl, format, ...) \
-	_log(::twili::log::Level::lvl, __FILE__, __LINE__,	\
-			 format, ##__VA_ARGS__);
+	do { \
+		if(::twili::log::Level::lvl >= ::twili::log::min_level.load(std::memory_order_relaxed)) { \
+			_log(::twili::log::Level::lvl, __FILE__, __LINE__,	\
+					 format, ##__VA_ARGS__); \
+		} \
+	} while(0)
 
 class Logger {
  public:
 	virtual ~Logger();
 	virtual void do_log(Level lvl, const char *fname, int line, const char *msg) = 0;
+	virtual Level get_min_level();
  protected:
 	char *format(char *buf, int size, bool use_color, Level lvl, const char *fname, int line, const char *msg);
 };
@@ -100,6 +114,7 @@ class FileLogger : public Logger {
 	virtual ~FileLogger();
 
 	virtual void do_log(Level lvl, const char *fname, int line, const char *msg);
+	virtual Level get_min_level();
  protected:
 	FILE *file;
 	Level minlevel;
@@ -123,6 +138,40 @@ class SystemdLogger : public FileLogger {
 };
 #endif // WITH_SYSTEMD == 1
 
+// Hands messages off to a background thread that passes them on to another
+// logger, so that the thread logging a message doesn't wait on the output.
+// Messages are copied into a ring of fixed-size slots that is allocated up
+// front, so logging never allocates; a message that finds every slot full is
+// dropped (and counted). Anything still queued is written out when the logger
+// is destroyed.
+class AsyncLogger : public Logger {
+ public:
+	// capacity is rounded up to a power of two
+	AsyncLogger(std::shared_ptr<Logger> backend, size_t capacity = 1024);
+	virtual ~AsyncLogger();
+
+	virtual void do_log(Level lvl, const char *fname, int line, const char *msg);
+	virtual Level get_min_level();
+ private:
+	struct Slot;
+	
+	Slot *Peek();
+	void Release(Slot *slot);
+	void ThreadFunc();
+	
+	std::shared_ptr<Logger> backend;
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	std::atomic<size_t> enqueue_pos;
+	size_t dequeue_pos; // only touched by the logging thread
+	std::atomic<bool> running;
+	std::atomic<bool> sleeping;
+	std::atomic<size_t> dropped;
+	std::mutex wake_mutex;
+	std::condition_variable wake_condvar;
+	std::thread thread;
+};
+
 void _log(Level lvl, const char *fname, int line, const char *format, ...);
 void add_log(std::shared_ptr<Logger> l);
 void init_color();
@@ -38,7 +38,6 @@ MessageConnection::Request *MessageConnection::Process() {
 				current_rq.payload.Clear();
 				has_current_payload = false;
 			} else {
-				in_buffer.Reserve(sizeof(protocol::MessageHeader));
 				if(RequestInput()) { continue; }
 				return nullptr;
 			}
@@ -49,7 +48,6 @@ MessageConnection::Request *MessageConnection::Process() {
 				has_current_payload = true;
 				current_rq.object_ids.Clear();
 			} else {
-				in_buffer.Reserve(current_rq.mh.payload_size);
 				if(RequestInput()) { continue; }
 				return nullptr;
 			}
@@ -60,7 +58,6 @@ MessageConnection::Request *MessageConnection::Process() {
 			has_current_payload = false;
 			return &current_rq;
 		} else {
-			in_buffer.Reserve(current_rq.mh.object_count * sizeof(uint32_t));
 			if(RequestInput()) { continue; }
 			return nullptr;
 		}
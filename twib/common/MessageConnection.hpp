@@ -27,6 +27,7 @@
 #include "Semaphore.hpp"
 #include "Protocol.hpp"
 #include "Buffer.hpp"
+#include "SegmentedBuffer.hpp"
 #include "Logger.hpp"
 
 namespace twili {
@@ -52,10 +53,10 @@ class MessageConnection {
 
 	bool error_flag = false;
  protected:
-	util::Buffer in_buffer;
+	util::SegmentedBuffer in_buffer;
 
 	Semaphore out_buffer_sema;
-	util::Buffer out_buffer;
+	util::SegmentedBuffer out_buffer;
 
 	// these turn true if more data was obtained
 	virtual bool RequestInput() = 0;
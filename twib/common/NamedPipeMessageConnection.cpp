@@ -155,7 +155,8 @@ bool NamedPipeMessageConnection::RequestOutput() {
 		LogMessage(Debug, "locked out_buffer_lock");
 		if(out_buffer.ReadAvailable() > 0) {
 			DWORD bytes_written;
-			if(WriteFile(pipe.handle, (void*)out_buffer.Read(), out_buffer.ReadAvailable(), &bytes_written, &output_member.overlap)) {
+			util::Span span = out_buffer.GetFrontSpan();
+			if(WriteFile(pipe.handle, (void*)span.data, span.size, &bytes_written, &output_member.overlap)) {
 				out_buffer.MarkRead(bytes_written);
 				out_buffer_sema.notify();
 				LogMessage(Debug, "completed synchronously");
@@ -55,14 +55,17 @@ void SocketMessageConnection::ConnectionMember::SignalRead() {
 void SocketMessageConnection::ConnectionMember::SignalWrite() {
 	LogMessage(Debug, "pumping out 0x%lx bytes", connection.out_buffer.ReadAvailable());
 	std::lock_guard<Semaphore> lock(connection.out_buffer_sema);
-	if(connection.out_buffer.ReadAvailable() > 0) {
-		ssize_t r = socket.Send(connection.out_buffer.Read(), connection.out_buffer.ReadAvailable(), 0);
+	while(connection.out_buffer.ReadAvailable() > 0) {
+		util::Span span = connection.out_buffer.GetFrontSpan();
+		ssize_t r = socket.Send(span.data, span.size, 0);
 		if(r < 0) {
 			connection.error_flag = true;
 			return;
 		}
-		if(r > 0) {
-			connection.out_buffer.MarkRead(r);
+		connection.out_buffer.MarkRead(r);
+		if((size_t) r < span.size) {
+			// socket is full; wait to be signalled again
+			return;
 		}
 	}
 }
@@ -37,17 +37,18 @@ BridgeObject::~BridgeObject() {
 	// try to close object if valid
 	if(valid) {
 		LogMessage(Debug, "cleaning up lost object 0x%x", object_id);
-		daemon.local_client->SendRequest(
-			Request(
-				nullptr, // local client overwrites this
-				device_id,
-				object_id,
-				0xffffffff,
-				0 // local client generates this
-				)); // we don't care about the response
+		daemon.CloseObject(device_id, object_id);
 	}
 }
 
+uint64_t BridgeObject::GetKey() const {
+	return MakeKey(device_id, object_id);
+}
+
+uint64_t BridgeObject::MakeKey(uint32_t device_id, uint32_t object_id) {
+	return ((uint64_t) device_id << 32) | object_id;
+}
+
 } // namespace daemon
 } // namespace twib
 } // namespace twili
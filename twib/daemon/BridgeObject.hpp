@@ -33,7 +33,10 @@ class BridgeObject {
 	BridgeObject(Daemon &daemon, uint32_t device_id, uint32_t object_id);
 	~BridgeObject();
 
-	const Daemon &daemon;
+	uint64_t GetKey() const;
+	static uint64_t MakeKey(uint32_t device_id, uint32_t object_id);
+
+	Daemon &daemon;
 	const uint32_t device_id;
 	const uint32_t object_id;
 	bool valid = true;
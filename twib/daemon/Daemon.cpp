@@ -27,53 +27,32 @@
 #include<stdlib.h>
 #include<string.h>
 
-#if WITH_SYSTEMD == 1
-#include<systemd/sd-daemon.h>
-#endif
-
-#if WITH_LAUNCHD == 1
-#include<launch.h>
-#endif
-
 #include<msgpack11.hpp>
-#include<CLI/CLI.hpp>
 
-#if TWIB_NAMED_PIPE_FRONTEND_ENABLED == 1
-#include "NamedPipeFrontend.hpp"
-#endif
-
-#include "SocketFrontend.hpp"
+#include "Buffer.hpp"
 #include "Protocol.hpp"
 #include "err.hpp"
 
-#include <iostream>
-#include <ostream>
-#include <string>
-#include <csignal>
-
 namespace twili {
 namespace twib {
 namespace daemon {
 
-Daemon::Daemon() :
-	local_client(std::make_shared<LocalClient>(*this))
-// this comma placement is really gross, but for some reason C++ doesn't seem to allow commas at the end of member initializer lists
+Daemon::Daemon(bool backends_enabled) :
+	local_client(std::make_shared<LocalClient>(*this)) {
+	AddClient(local_client);
+	if(!backends_enabled) {
+		return;
+	}
 #if TWIBD_TCP_BACKEND_ENABLED
-	, tcp(*this)
-#endif
-#if TWIBD_LIBUSB_BACKEND_ENABLED
-	, usb(*this)
-#endif
-#if TWIBD_LIBUSBK_BACKEND_ENABLED
-	, usbk(*this)
+	tcp.emplace(*this);
 #endif
-	{
-	AddClient(local_client);
 #if TWIBD_LIBUSB_BACKEND_ENABLED
-	usb.Probe();
+	usb.emplace(*this);
+	usb->Probe();
 #endif
 #if TWIBD_LIBUSBK_BACKEND_ENABLED
-	usbk.Probe();
+	usbk.emplace(*this);
+	usbk->Probe();
 #endif
 }
 
@@ -89,10 +68,17 @@ void Daemon::AddDevice(std::shared_ptr<Device> device) {
 
 	if(!entry_lock || entry_lock->GetPriority() <= device->GetPriority()) { // don't let tcp devices clobber usb devices
 		entry = device;
+		device_list_cache.reset();
 
 		LogMessage(Debug, "resetting objects on new device");
+		{
+			// the reset covers anything we were still waiting to close, and
+			// the new bridge may hand the same object ids out again.
+			std::lock_guard<std::mutex> close_lock(close_mutex);
+			pending_closes.erase(device->device_id);
+		}
 		local_client->SendRequest(
-			Request(nullptr, device->device_id, 0, 0xffffffff, 0)); // we don't care about the response
+			Request(nullptr, device->device_id, 0, protocol::CLOSE_OBJECT, 0)); // we don't care about the response
 	}
 }
 
@@ -121,6 +107,61 @@ void Daemon::PostResponse(Response &&response) {
 	dispatch_queue.enqueue(response);
 }
 
+void Daemon::CloseObject(uint32_t device_id, uint32_t object_id) {
+	bool awaken = false;
+	{
+		std::lock_guard<std::mutex> lock(close_mutex);
+		pending_closes[device_id].push_back(object_id);
+		if(!close_deadline) {
+			close_deadline = std::chrono::steady_clock::now() + CLOSE_BATCH_DELAY;
+			awaken = true; // make sure the dispatch thread picks up the deadline
+		}
+	}
+	if(awaken) {
+		Awaken();
+	}
+}
+
+void Daemon::FlushObjectCloses() {
+	std::map<uint32_t, std::vector<uint32_t>> closes;
+	{
+		std::lock_guard<std::mutex> lock(close_mutex);
+		closes.swap(pending_closes);
+		close_deadline.reset();
+	}
+
+	for(auto &[device_id, object_ids] : closes) {
+		std::shared_ptr<Device> device;
+		{
+			std::lock_guard<std::mutex> lock(device_map_mutex);
+			auto i = devices.find(device_id);
+			if(i != devices.end()) {
+				device = i->second.lock();
+			}
+		}
+		if(!device || device->deletion_flag) {
+			LogMessage(Debug, "dropping %zu closes for missing device %08x", object_ids.size(), device_id);
+			continue;
+		}
+
+		// we don't care about the responses to any of these
+		if(object_ids.size() > 1 && device->identification["protocol"].uint32_value() >= 3) {
+			LogMessage(Debug, "closing %zu objects on device %08x", object_ids.size(), device_id);
+			util::Buffer payload;
+			for(uint32_t object_id : object_ids) {
+				payload.Write(object_id);
+			}
+			local_client->SendRequest(
+				Request(nullptr, device_id, 0, protocol::CLOSE_OBJECTS, 0, payload.GetData()));
+		} else {
+			for(uint32_t object_id : object_ids) {
+				local_client->SendRequest(
+					Request(nullptr, device_id, object_id, protocol::CLOSE_OBJECT, 0));
+			}
+		}
+	}
+}
+
 void Daemon::RemoveClient(std::shared_ptr<Client> client) {
 	std::lock_guard<std::mutex> lock(client_map_mutex);
 	clients.erase(clients.find(client->client_id));
@@ -134,6 +175,7 @@ void Daemon::RemoveDevice(std::shared_ptr<Device> device) {
 	if(i != devices.end()) {
 		devices.erase(i);
 	}
+	device_list_cache.reset();
 }
 
 // voodoo
@@ -142,8 +184,21 @@ template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
 
 void Daemon::Process() {
 	std::variant<std::monostate, Request, Response> v;
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+	{
+		std::lock_guard<std::mutex> lock(close_mutex);
+		deadline = close_deadline;
+	}
 	LogMessage(Debug, "Process: dequeueing job...");
-	dispatch_queue.wait_dequeue(v);
+	if(deadline) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now >= *deadline || !dispatch_queue.wait_dequeue_timed(v, *deadline - now)) {
+			FlushObjectCloses();
+			return;
+		}
+	} else {
+		dispatch_queue.wait_dequeue(v);
+	}
 	LogMessage(Debug, "Process: dequeued job: %d", v.index());
 
 	std::visit(overloaded {
@@ -151,6 +206,7 @@ void Daemon::Process() {
 				// just a wake-up signal
 			},
 			[&](Request &rq) {
+				tracer.Record(Tracer::Event::Dispatch, rq.client ? rq.client->client_id : 0xffffffff, rq.tag);
 				LogMessage(Debug, "dispatching request");
 				LogMessage(Debug, "  client id: %08x", rq.client->client_id);
 				LogMessage(Debug, "  device id: %08x", rq.device_id);
@@ -159,7 +215,11 @@ void Daemon::Process() {
 				LogMessage(Debug, "  tag: %08x", rq.tag);
 
 				if(rq.device_id == 0) {
-					PostResponse(HandleRequest(rq));
+					std::optional<Response> r = HandleRequest(rq);
+					if(r) {
+						tracer.Record(Tracer::Event::Finalize, r->client_id, r->tag, r->object_id);
+						PostResponse(std::move(*r));
+					}
 				} else {
 					std::shared_ptr<Device> device;
 					{
@@ -175,26 +235,43 @@ void Daemon::Process() {
 							return;
 						}
 					}
-					if(rq.command_id == 0xffffffff) {
+					if(!rq.object_ids.empty()) {
+						// clients may only pass along objects they own on this device
+						std::shared_ptr<Client> client = rq.client;
+						for(uint32_t object_id : rq.object_ids) {
+							if(!client || client->owned_objects.find(BridgeObject::MakeKey(rq.device_id, object_id)) == client->owned_objects.end()) {
+								LogMessage(Debug, "request passes unowned object 0x%x", object_id);
+								PostResponse(rq.RespondError(TWILI_ERR_PROTOCOL_UNRECOGNIZED_OBJECT));
+								return;
+							}
+						}
+					}
+					if(rq.command_id == protocol::CLOSE_OBJECT && rq.object_id != 0) {
 						LogMessage(Debug, "detected close request for 0x%x", rq.object_id);
 						std::shared_ptr<Client> client = rq.client;
 						if(client) {
 							// disown the object that's being closed
-							for(auto i = client->owned_objects.begin(); i != client->owned_objects.end(); ){
-								if((*i)->object_id == rq.object_id) {
-									// need to mark this so that it doesn't send another close request
-									(*i)->valid = false;
-									i = client->owned_objects.erase(i);
-									LogMessage(Debug, "  disowned from client");
-								} else {
-									i++;
-								}
+							auto i = client->owned_objects.find(BridgeObject::MakeKey(rq.device_id, rq.object_id));
+							if(i != client->owned_objects.end()) {
+								// need to mark this so that it doesn't send another close request
+								i->second->valid = false;
+								client->owned_objects.erase(i);
+								LogMessage(Debug, "  disowned from client");
+
+								// object ids aren't reused, so nobody can observe the
+								// object going away late. batch it with other closes
+								// and answer now instead of waiting on the device.
+								CloseObject(rq.device_id, rq.object_id);
+								tracer.Record(Tracer::Event::Finalize, client->client_id, rq.tag, rq.object_id);
+								PostResponse(rq.RespondOk());
+								return;
 							}
 						} else {
 							LogMessage(Warning, "failed to locate client for disownership");
 						}
 					}
 					LogMessage(Debug, "sending request via device");
+					tracer.Record(Tracer::Event::BackendSend, rq.client ? rq.client->client_id : 0xffffffff, rq.tag);
 					device->SendRequest(std::move(rq));
 					LogMessage(Debug, "sent request via device");
 				}
@@ -217,10 +294,10 @@ void Daemon::Process() {
 				}
 				// add any objects this response included to the client's
 				// owned object list, to keep the BridgeObject object alive
-				client->owned_objects.insert(
-					client->owned_objects.end(),
-					rs.objects.begin(),
-					rs.objects.end());
+				for(auto &o : rs.objects) {
+					client->owned_objects.emplace(o->GetKey(), o);
+				}
+				tracer.Record(Tracer::Event::FrontendSend, rs.client_id, rs.tag, rs.object_id);
 				client->PostResponse(rs);
 			}
 		}, v);
@@ -228,22 +305,28 @@ void Daemon::Process() {
 	LogMessage(Debug, "finished process loop");
 }
 
-Response Daemon::HandleRequest(Request &rq) {
+std::optional<Response> Daemon::HandleRequest(Request &rq) {
 	switch(rq.object_id) {
 	case 0:
 		switch((protocol::ITwibMetaInterface::Command) rq.command_id) {
 		case protocol::ITwibMetaInterface::Command::LIST_DEVICES: {
 			LogMessage(Debug, "command 0 issued to twibd meta object: LIST_DEVICES");
-			LogMessage(Debug, "waiting for ISL...");
-			initial_scan_lock.wait();
-			LogMessage(Debug, "got ISL");
+			if(!initial_scan_complete) {
+				LogMessage(Debug, "waiting for ISL...");
+				initial_scan_lock.wait();
+				LogMessage(Debug, "got ISL");
+				initial_scan_complete = true;
+			}
 
 			Response r = rq.RespondOk();
-			std::vector<msgpack11::MsgPack> device_packs;
-			{
-				std::lock_guard<std::mutex> lock(device_map_mutex);
+			std::lock_guard<std::mutex> lock(device_map_mutex);
+			if(!device_list_cache) {
+				std::vector<msgpack11::MsgPack> device_packs;
 				for(auto i = devices.begin(); i != devices.end(); i++) {
 					auto device = i->second.lock();
+					if(!device) {
+						continue;
+					}
 					device_packs.push_back(
 						msgpack11::MsgPack::object {
 							{"device_id", device->device_id},
@@ -251,16 +334,17 @@ Response Daemon::HandleRequest(Request &rq) {
 									{"identification", device->identification}
 						});
 				}
-			}
 
-			util::Buffer response_payload;
+				util::Buffer response_payload;
 
-			msgpack11::MsgPack array_pack(device_packs);
-			std::string ser = array_pack.dump();
-			response_payload.Write<uint64_t>(ser.size());
-			response_payload.Write(ser);
+				msgpack11::MsgPack array_pack(device_packs);
+				std::string ser = array_pack.dump();
+				response_payload.Write<uint64_t>(ser.size());
+				response_payload.Write(ser);
 
-			r.payload = response_payload.GetData();
+				device_list_cache = response_payload.GetData();
+			}
+			r.payload = *device_list_cache;
 
 			return r; }
 		case protocol::ITwibMetaInterface::Command::CONNECT_TCP: {
@@ -277,11 +361,36 @@ Response Daemon::HandleRequest(Request &rq) {
 			}
 			LogMessage(Info, "requested to connect to %s:%s", hostname.c_str(), port.c_str());
 
+#if TWIBD_TCP_BACKEND_ENABLED
+			if(!tcp) {
+				return rq.RespondError(TWILI_ERR_PROTOCOL_UNRECOGNIZED_FUNCTION);
+			}
+			// respond once the connection goes through or fails, so that
+			// the dispatch thread isn't stuck waiting on it
+			tcp->Connect(
+				hostname, port,
+				[this, wrq = rq.Weak()](std::string msg) mutable {
+					Response r = wrq.RespondOk();
+					util::Buffer response_payload;
+					response_payload.Write<uint64_t>(msg.size());
+					response_payload.Write(msg);
+					r.payload = response_payload.GetData();
+					tracer.Record(Tracer::Event::Finalize, r.client_id, r.tag, r.object_id);
+					PostResponse(std::move(r));
+				});
+			return std::nullopt;
+#else
+			return rq.RespondError(TWILI_ERR_PROTOCOL_UNRECOGNIZED_FUNCTION);
+#endif
+			}
+		case protocol::ITwibMetaInterface::Command::DUMP_TRACE: {
+			LogMessage(Debug, "command 12 issued to twibd meta object: DUMP_TRACE");
+
 			Response r = rq.RespondOk();
 			util::Buffer response_payload;
-			std::string msg = tcp.Connect(hostname, port);
-			response_payload.Write<uint64_t>(msg.size());
-			response_payload.Write(msg);
+			std::string trace = tracer.DumpChromeTrace();
+			response_payload.Write<uint64_t>(trace.size());
+			response_payload.Write(trace);
 			r.payload = response_payload.GetData();
 			return r; }
 		default:
@@ -314,216 +423,6 @@ std::shared_ptr<Client> Daemon::GetClient(uint32_t client_id) {
 	return client;
 }
 
-#if TWIB_TCP_FRONTEND_ENABLED == 1
-static std::shared_ptr<frontend::SocketFrontend> CreateTCPFrontend(Daemon &daemon, uint16_t port) {
-	struct sockaddr_in6 addr;
-	memset(&addr, 0, sizeof(addr));
-	addr.sin6_family = AF_INET6;
-	addr.sin6_port = htons(port);
-	addr.sin6_addr = in6addr_any;
-	return std::make_shared<frontend::SocketFrontend>(daemon, AF_INET6, SOCK_STREAM, (struct sockaddr*) &addr, sizeof(addr));
-}
-#endif
-
-#if TWIB_UNIX_FRONTEND_ENABLED == 1
-static std::shared_ptr<frontend::SocketFrontend> CreateUNIXFrontend(Daemon &daemon, std::string path) {
-	struct sockaddr_un addr;
-	memset(&addr, 0, sizeof(addr));
-	addr.sun_family = AF_UNIX;
-	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
-	return std::make_shared<frontend::SocketFrontend>(daemon, AF_UNIX, SOCK_STREAM, (struct sockaddr*) &addr, sizeof(addr));
-}
-#endif
-
-#if TWIB_NAMED_PIPE_FRONTEND_ENABLED == 1
-static std::shared_ptr<frontend::NamedPipeFrontend> CreateNamedPipeFrontend(Daemon &daemon) {
-	return std::make_shared<frontend::NamedPipeFrontend>(daemon, "foo");
-}
-#endif
-
 } // namespace daemon
 } // namespace twib
 } // namespace twili
-
-using namespace twili;
-using namespace twili::twib;
-
-daemon::Daemon *g_Daemon;
-std::sig_atomic_t g_Running;
-
-extern "C" void sigint_handler(int) {
-	g_Running = 0;
-	g_Daemon->Awaken();
-}
-
-int main(int argc, char *argv[]) {
-#ifdef _WIN32
-	WSADATA wsaData;
-	int err;
-	err = WSAStartup(MAKEWORD(2, 2), &wsaData);
-	if (err != 0) {
-		printf("WSASStartup failed with error: %d\n", err);
-		return 1;
-	}
-#endif
-
-	CLI::App app {"Twili debug monitor daemon"};
-
-	int verbosity = 3;
-	app.add_flag("-v,--verbose", verbosity, "Enable verbose messages. Use twice to enable debug messages");
-
-	bool systemd_mode = false;
-#if WITH_SYSTEMD == 1
-	app.add_flag("--systemd", systemd_mode, "Log in systemd format and obtain sockets from systemd (disables unix and tcp frontends)");
-#endif
-
-	bool launchd_mode = false;
-#if WITH_LAUNCHD == 1
-	app.add_flag("--launchd", launchd_mode, "Obtain sockets from launchd (disables unix and tcp frontends)");
-#endif
-
-#if TWIB_UNIX_FRONTEND_ENABLED == 1
-	bool unix_frontend_enabled = true;
-	app.add_flag_function(
-		"--unix",
-		[&unix_frontend_enabled](int count) {
-			unix_frontend_enabled = true;
-		}, "Enable UNIX socket frontend");
-	app.add_flag_function(
-		"--no-unix",
-		[&unix_frontend_enabled](int count) {
-			unix_frontend_enabled = false;
-		}, "Disable UNIX socket frontend");
-	std::string unix_frontend_path = TWIB_UNIX_FRONTEND_DEFAULT_PATH;
-	app.add_option(
-		"-P,--unix-path", unix_frontend_path,
-		"Path for the twibd UNIX socket frontend")
-		->envname("TWIB_UNIX_FRONTEND_PATH");
-#endif
-
-#if TWIB_TCP_FRONTEND_ENABLED == 1
-	bool tcp_frontend_enabled = true;
-	app.add_flag_function(
-		"--tcp",
-		[&tcp_frontend_enabled](int count) {
-			tcp_frontend_enabled = true;
-		}, "Enable TCP socket frontend");
-	app.add_flag_function(
-		"--no-tcp",
-		[&tcp_frontend_enabled](int count) {
-			tcp_frontend_enabled = false;
-		}, "Disable TCP socket frontend");
-	uint16_t tcp_frontend_port;
-	app.add_option(
-		"-p,--tcp-port", tcp_frontend_port,
-		"Port for the twibd TCP socket frontend")
-		->envname("TWIB_TCP_FRONTEND_PORT");
-#endif
-
-#if TWIB_NAMED_PIPE_FRONTEND_ENABLED == 1
-	bool named_pipe_frontend_enabled = true;
-	app.add_flag_function(
-		"--named-pipe",
-		[&named_pipe_frontend_enabled](int count) {
-			named_pipe_frontend_enabled = true;
-		}, "Enable named pipe frontend");
-	app.add_flag_function(
-		"--no-named-pipe",
-		[&named_pipe_frontend_enabled](int count) {
-			named_pipe_frontend_enabled = false;
-		}, "Disable named pipe frontend");
-#endif
-
-	try {
-		app.parse(argc, argv);
-	} catch(const CLI::ParseError &e) {
-		return app.exit(e);
-	}
-
-	log::Level min_log_level = log::Level::Message;
-	if(verbosity >= 1) {
-		min_log_level = log::Level::Info;
-	}
-	if(verbosity >= 2) {
-		min_log_level = log::Level::Debug;
-	}
-#if WITH_SYSTEMD == 1
-	if(systemd_mode) {
-		add_log(std::make_shared<log::SystemdLogger>(stderr, min_log_level));
-	}
-#endif
-	if(!systemd_mode) {
-		log::init_color();
-		log::add_log(std::make_shared<log::PrettyFileLogger>(stdout, min_log_level, log::Level::Error));
-		log::add_log(std::make_shared<log::PrettyFileLogger>(stderr, log::Level::Error));
-	}
-
-	LogMessage(Message, "starting twibd");
-	daemon::Daemon daemon;
-	g_Daemon = &daemon;
-	g_Running = true;
-
-	std::vector<std::shared_ptr<daemon::frontend::Frontend>> frontends;
-	if(!systemd_mode && !launchd_mode) {
-#if TWIB_TCP_FRONTEND_ENABLED == 1
-		if(tcp_frontend_enabled) {
-			frontends.push_back(daemon::CreateTCPFrontend(daemon, tcp_frontend_port));
-		}
-#endif
-#if TWIB_UNIX_FRONTEND_ENABLED == 1
-		if(unix_frontend_enabled) {
-			frontends.push_back(daemon::CreateUNIXFrontend(daemon, unix_frontend_path));
-		}
-#endif
-#if TWIB_NAMED_PIPE_FRONTEND_ENABLED == 1
-		if(named_pipe_frontend_enabled) {
-			frontends.push_back(daemon::CreateNamedPipeFrontend(daemon));
-		}
-#endif
-	}
-
-#if WITH_SYSTEMD == 1
-	if(systemd_mode) {
-		int num_fds = sd_listen_fds(false);
-		if(num_fds < 0) {
-			LogMessage(Warning, "failed to get FDs from systemd");
-		} else {
-			LogMessage(Info, "got %d sockets from systemd", num_fds);
-			for(int fd = SD_LISTEN_FDS_START; fd < SD_LISTEN_FDS_START + num_fds; fd++) {
-				if(sd_is_socket(fd, 0, SOCK_STREAM, 1) == 1) {
-					frontends.push_back(std::make_shared<daemon::frontend::SocketFrontend>(daemon, platform::Socket(fd)));
-				} else {
-					LogMessage(Warning, "got an FD from systemd that wasn't a SOCK_STREAM: %d", fd);
-				}
-			}
-		}
-		sd_notify(false, "READY=1");
-	}
-#endif
-
-#if WITH_LAUNCHD == 1
-	if(launchd_mode) {
-		int *fds = nullptr;
-		size_t num_fds = 0;
-		int err = launch_activate_socket("twibd-listener", &fds, &num_fds);
-		if(err != 0 || fds == nullptr || num_fds == 0) {
-			LogMessage(Warning, "failed to get FDs from launchd");
-		} else {
-			LogMessage(Info, "got %zu sockets from launchd", num_fds);
-			for(size_t i = 0; i < num_fds; i++) {
-				frontends.push_back(std::make_shared<daemon::frontend::SocketFrontend>(daemon, platform::Socket(fds[i])));
-			}
-		}
-		if(fds != nullptr) {
-			free(fds);
-		}
-	}
-#endif
-
-	std::signal(SIGINT, &sigint_handler);
-
-	while(g_Running) {
-		daemon.Process();
-	}
-	return 0;
-}
@@ -23,10 +23,12 @@
 #include "platform/platform.hpp"
 
 #include<list>
+#include<chrono>
 #include<thread>
 #include<mutex>
 #include<variant>
 #include<map>
+#include<optional>
 #include<random>
 #include<condition_variable>
 
@@ -48,6 +50,7 @@
 #include "Device.hpp"
 #include "LocalClient.hpp"
 #include "InitialScanLock.hpp"
+#include "Tracer.hpp"
 
 namespace twili {
 namespace twib {
@@ -55,7 +58,8 @@ namespace daemon {
 
 class Daemon {
  public:
-	Daemon();
+	// backends can be left out to drive the daemon with stand-in devices
+	Daemon(bool backends_enabled = true);
 	~Daemon();
 
 	void AddDevice(std::shared_ptr<Device> device);
@@ -65,19 +69,39 @@ class Daemon {
 	void PostResponse(Response &&response);
 	void RemoveDevice(std::shared_ptr<Device> device);
 	void RemoveClient(std::shared_ptr<Client> client);
+
+	// Queues an object close. Closes are held for a few milliseconds so that
+	// objects dropped together (e.g. when a client disconnects) can be
+	// released with a single CLOSE_OBJECTS request per device.
+	void CloseObject(uint32_t device_id, uint32_t object_id);
 	
 	void Process();
-	Response HandleRequest(Request &request);
+	std::optional<Response> HandleRequest(Request &request); // nullopt if the response will be posted later
 	std::shared_ptr<Client> GetClient(uint32_t client_id);
 
 	std::shared_ptr<LocalClient> local_client;
 
 	InitialScanLock initial_scan_lock;
+	Tracer tracer;
  private:
+	void FlushObjectCloses();
+
+	// declared before the dispatch queue so that any BridgeObjects still
+	// sitting in queued responses can reach them while being destroyed.
+	static constexpr std::chrono::milliseconds CLOSE_BATCH_DELAY = std::chrono::milliseconds(5);
+	std::mutex close_mutex;
+	std::map<uint32_t, std::vector<uint32_t>> pending_closes; // guarded by close_mutex
+	std::optional<std::chrono::steady_clock::time_point> close_deadline; // guarded by close_mutex
+
 	moodycamel::BlockingConcurrentQueue<std::variant<std::monostate, Request, Response>> dispatch_queue;
 	
 	std::mutex device_map_mutex;
 	std::map<uint32_t, std::weak_ptr<Device>> devices;
+	// serialized LIST_DEVICES response, reset whenever the device map changes
+	std::optional<std::vector<uint8_t>> device_list_cache; // guarded by device_map_mutex
+	// once the initial scan is done, LIST_DEVICES reports whatever devices
+	// have been identified so far instead of waiting for stragglers.
+	bool initial_scan_complete = false; // only accessed on dispatch thread
 	
 	std::mutex client_map_mutex;
 	std::map<uint32_t, std::weak_ptr<Client>> clients;
@@ -85,13 +109,13 @@ class Daemon {
 	std::random_device rng;
 
 #if TWIBD_TCP_BACKEND_ENABLED
-	backend::TCPBackend tcp;
+	std::optional<backend::TCPBackend> tcp;
 #endif
 #if TWIBD_LIBUSB_BACKEND_ENABLED
-	backend::USBBackend usb;
+	std::optional<backend::USBBackend> usb;
 #endif
 #if TWIBD_LIBUSBK_BACKEND_ENABLED
-	backend::USBKBackend usbk;
+	std::optional<backend::USBKBackend> usbk;
 #endif
 };
 
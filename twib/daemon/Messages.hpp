@@ -22,6 +22,7 @@
 
 #include<vector>
 #include<memory>
+#include<unordered_map>
 
 #include<stdint.h>
 
@@ -51,7 +52,8 @@ class Client : public std::enable_shared_from_this<Client> {
 	uint32_t client_id;
 	bool deletion_flag = false;
 	virtual void PostResponse(Response &r) = 0;
-	std::vector<std::shared_ptr<BridgeObject>> owned_objects;
+	// keyed by (device_id << 32) | object_id, see BridgeObject::GetKey
+	std::unordered_map<uint64_t, std::shared_ptr<BridgeObject>> owned_objects;
 };
 
 class WeakRequest {
@@ -86,6 +88,7 @@ class Request {
 	uint32_t command_id;
 	uint32_t tag;
 	std::vector<uint8_t> payload;
+	std::vector<uint32_t> object_ids; // objects passed by reference, must be owned by client
  private:
 };
 
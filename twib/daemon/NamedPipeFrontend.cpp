@@ -82,14 +82,17 @@ void NamedPipeFrontend::Logic::Prepare(platform::EventLoop &loop) {
 		common::MessageConnection::Request *rq;
 		while((rq = (*i)->connection.Process()) != nullptr) {
 			LogMessage(Debug, "posting request");
-			frontend.daemon.PostRequest(
-				Request(
-					*i,
-					rq->mh.device_id,
-					rq->mh.object_id,
-					rq->mh.command_id,
-					rq->mh.tag,
-					std::vector<uint8_t>(rq->payload.Read(), rq->payload.Read() + rq->payload.ReadAvailable())));
+			frontend.daemon.tracer.Record(Tracer::Event::FrontendReceive, (*i)->client_id, rq->mh.tag, rq->mh.object_id, rq->mh.command_id);
+			Request request(
+				*i,
+				rq->mh.device_id,
+				rq->mh.object_id,
+				rq->mh.command_id,
+				rq->mh.tag,
+				std::vector<uint8_t>(rq->payload.Read(), rq->payload.Read() + rq->payload.ReadAvailable()));
+			request.object_ids.resize(rq->mh.object_count);
+			rq->object_ids.Read(request.object_ids);
+			frontend.daemon.PostRequest(std::move(request));
 			LogMessage(Debug, "posted request");
 		}
 
@@ -0,0 +1,66 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "PendingRequests.hpp"
+
+#include "common/Logger.hpp"
+
+namespace twili {
+namespace twib {
+namespace daemon {
+
+void PendingRequests::Add(const Request &r) {
+	uint32_t client_id = r.client ? r.client->client_id : 0xffffffff;
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!map.Insert(Key(client_id, r.tag), WeakRequest(client_id, r.device_id, r.object_id, r.command_id, r.tag))) {
+		LogMessage(Warning, "client 0x%x reused pending tag 0x%x", client_id, r.tag);
+	}
+}
+
+bool PendingRequests::Remove(uint32_t client_id, uint32_t tag) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return map.Erase(Key(client_id, tag));
+}
+
+std::vector<Response> PendingRequests::FailAll(uint32_t result_code) {
+	std::vector<Response> responses;
+	std::lock_guard<std::mutex> lock(mutex);
+	responses.reserve(map.size());
+	map.Drain(
+		[&](uint64_t, WeakRequest &&r) {
+			if(r.client_id != 0xffffffff) {
+				responses.push_back(r.RespondError(result_code));
+			}
+		});
+	return responses;
+}
+
+size_t PendingRequests::Size() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return map.size();
+}
+
+uint64_t PendingRequests::Key(uint32_t client_id, uint32_t tag) {
+	return ((uint64_t) client_id << 32) | tag;
+}
+
+} // namespace daemon
+} // namespace twib
+} // namespace twili
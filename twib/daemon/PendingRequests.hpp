@@ -0,0 +1,58 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<mutex>
+#include<vector>
+
+#include<stdint.h>
+
+#include "common/FlatTagMap.hpp"
+
+#include "Messages.hpp"
+
+namespace twili {
+namespace twib {
+namespace daemon {
+
+// Requests that have been sent to a device but not yet responded to, kept
+// so that they can be failed if the device goes away. Indexed by client id
+// and tag, since tags are only unique per client. Payloads aren't kept.
+// Thread-safe, since backends send and receive on different threads.
+class PendingRequests {
+ public:
+	void Add(const Request &r);
+	// returns false if no such request was pending
+	bool Remove(uint32_t client_id, uint32_t tag);
+	// Removes every pending request and returns error responses for them,
+	// leaving out requests from the identification meta-client.
+	std::vector<Response> FailAll(uint32_t result_code);
+	size_t Size();
+ private:
+	static uint64_t Key(uint32_t client_id, uint32_t tag);
+	
+	std::mutex mutex;
+	common::FlatTagMap<WeakRequest, uint64_t> map;
+};
+
+} // namespace daemon
+} // namespace twib
+} // namespace twili
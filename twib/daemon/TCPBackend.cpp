@@ -23,6 +23,7 @@
 #include "platform/platform.hpp"
 
 #include "Daemon.hpp"
+#include "err.hpp"
 
 namespace twili {
 namespace twib {
@@ -33,7 +34,8 @@ TCPBackend::TCPBackend(Daemon &daemon) :
 	daemon(daemon),
 	server_logic(*this),
 	event_loop(server_logic),
-	listen_member(*this, platform::Socket(AF_INET, SOCK_DGRAM, 0)) {
+	listen_member(*this, platform::Socket(AF_INET, SOCK_DGRAM, 0)),
+	resolver_thread(&TCPBackend::ResolverThreadFunc, this) {
 	sockaddr_in addr;
 	memset(&addr, 0, sizeof(addr));
 	addr.sin_family = AF_INET;
@@ -52,63 +54,209 @@ TCPBackend::TCPBackend(Daemon &daemon) :
 }
 
 TCPBackend::~TCPBackend() {
+	resolve_queue.enqueue(std::nullopt);
+	resolver_thread.join();
 	event_loop.Destroy();
 	listen_member.socket.Close();
 }
 
-std::string TCPBackend::Connect(std::string hostname, std::string port) {
-	struct addrinfo hints;
-	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = 0;
-	struct addrinfo *res_raw = 0;
-	int err = getaddrinfo(hostname.c_str(), port.c_str(), &hints, &res_raw);
-	if(err != 0) {
-		return gai_strerror(err);
-	}
+void TCPBackend::Connect(std::string hostname, std::string port, std::function<void(std::string)> callback) {
+	resolve_queue.enqueue(ResolveJob {hostname, port, callback});
+}
 
-	auto deleter =
-		[](struct addrinfo *r) {
-			freeaddrinfo(r);
-		};
-	std::unique_ptr<addrinfo, decltype(deleter)> res(res_raw, deleter);
+void TCPBackend::Connect(sockaddr *addr, socklen_t addr_len) {
+	if(addr->sa_family == AF_INET) {
+		((sockaddr_in*) addr)->sin_port = htons(15152); // force port number
+	} else if(addr->sa_family == AF_INET6) {
+		((sockaddr_in6*) addr)->sin6_port = htons(15152); // force port number
+	} else {
+		LogMessage(Info, "not an IP address");
+		return;
+	}
 	
-	try {
-		platform::Socket socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-		socket.Connect(res->ai_addr, res->ai_addrlen);
+	ResolvedAddress address;
+	address.family = addr->sa_family;
+	address.socktype = SOCK_STREAM;
+	address.protocol = IPPROTO_TCP;
+	memcpy(&address.addr, addr, addr_len);
+	address.addr_len = addr_len;
+
+	std::shared_ptr<ConnectionAttempt> attempt = std::make_shared<ConnectionAttempt>();
+	attempt->name = AddressToString(addr, addr_len);
+	if(IsKnownAddress(attempt->name)) {
+		// devices keep announcing themselves after we connect
+		return;
+	}
+	LogMessage(Info, "received twili device announcement from %s", attempt->name.c_str());
 
-		devices.emplace_back(std::make_shared<Device>(std::move(socket), *this))->Begin();
-		event_loop.GetNotifier().Notify();
-		return "Ok"; 
-	} catch(platform::NetworkError &e) {
-		return e.what();
+	std::vector<ResolvedAddress> addresses = {address};
+	StartAttempt(attempt, addresses);
+}
+
+std::string TCPBackend::AddressToString(const sockaddr *addr, socklen_t addr_len) {
+	char host[NI_MAXHOST];
+	if(getnameinfo(addr, addr_len, host, sizeof(host), nullptr, 0, NI_NUMERICHOST) != 0) {
+		return "<unknown>";
 	}
+	return host;
 }
 
-void TCPBackend::Connect(sockaddr *addr, socklen_t addr_len) {
-	if(addr->sa_family == AF_INET) {
-		sockaddr_in *addr_in = (sockaddr_in*) addr;
-		LogMessage(Info, "  from %s", inet_ntoa(addr_in->sin_addr));
-		addr_in->sin_port = htons(15152); // force port number
+void TCPBackend::TuneSocket(platform::Socket &socket) {
+	// requests are small and latency-bound, so don't let Nagle hold them back
+	int nodelay = 1;
+	if(socket.SetSockOpt(IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+		LogMessage(Warning, "failed to set TCP_NODELAY: %s", platform::NetErrStr());
+	}
+
+	// large enough for file transfers to keep the link busy. these need to
+	// be set before connecting so the window scale is negotiated to match.
+	int buffer_size = 1024 * 1024;
+	if(socket.SetSockOpt(SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)) != 0 ||
+		 socket.SetSockOpt(SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) != 0) {
+		LogMessage(Warning, "failed to set socket buffer sizes: %s", platform::NetErrStr());
+	}
+}
+
+// Whether we're already connected or connecting to a device at `address`.
+bool TCPBackend::IsKnownAddress(const std::string &address) {
+	for(std::shared_ptr<Device> &device : devices) {
+		if(!device->deletion_flag && device->address == address) {
+			return true;
+		}
+	}
+	for(std::unique_ptr<PendingConnection> &pc : pending_connections) {
+		if(pc->address == address && (!pc->done_flag || !pc->error)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void TCPBackend::StartAttempt(std::shared_ptr<ConnectionAttempt> attempt, std::vector<ResolvedAddress> &addresses) {
+	bool known = false;
+	for(ResolvedAddress &resolved : addresses) {
+		std::string address = AddressToString((sockaddr*) &resolved.addr, resolved.addr_len);
+		if(IsKnownAddress(address)) {
+			LogMessage(Debug, "already connected to %s", address.c_str());
+			known = true;
+			continue;
+		}
 		
-		platform::Socket socket(addr->sa_family, SOCK_STREAM, IPPROTO_TCP);
-		socket.Connect(addr, addr_len);
+		try {
+			platform::Socket socket(resolved.family, resolved.socktype, resolved.protocol);
+			TuneSocket(socket);
+			bool connected = socket.StartConnect((sockaddr*) &resolved.addr, resolved.addr_len);
+			
+			std::unique_ptr<PendingConnection> pc = std::make_unique<PendingConnection>(attempt, std::move(socket), address);
+			pc->done_flag = connected;
+			pending_connections.push_back(std::move(pc));
+			attempt->remaining++;
+		} catch(platform::NetworkError &e) {
+			LogMessage(Info, "failed to connect to %s: %s", address.c_str(), e.what());
+			attempt->last_error = e.what();
+		}
+	}
+	
+	if(attempt->remaining == 0) {
+		attempt->Finish(known ? "Already connected" : attempt->last_error);
+	}
+}
 
-		devices.emplace_back(std::make_shared<Device>(std::move(socket), *this))->Begin();
-		LogMessage(Info, "connected to %s", inet_ntoa(addr_in->sin_addr));
+void TCPBackend::ResolverThreadFunc() {
+	std::optional<ResolveJob> job;
+	while(true) {
+		resolve_queue.wait_dequeue(job);
+		if(!job) {
+			return;
+		}
+		
+		std::shared_ptr<ConnectionAttempt> attempt = std::make_shared<ConnectionAttempt>();
+		attempt->name = job->hostname + ":" + job->port;
+		attempt->callback = std::move(job->callback);
+		
+		struct addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = 0;
+		struct addrinfo *res = nullptr;
+		std::vector<ResolvedAddress> addresses;
+		int err = getaddrinfo(job->hostname.c_str(), job->port.c_str(), &hints, &res);
+		if(err != 0) {
+			attempt->last_error = gai_strerror(err);
+		} else {
+			for(struct addrinfo *i = res; i != nullptr; i = i->ai_next) {
+				ResolvedAddress address;
+				address.family = i->ai_family;
+				address.socktype = i->ai_socktype;
+				address.protocol = i->ai_protocol;
+				memcpy(&address.addr, i->ai_addr, i->ai_addrlen);
+				address.addr_len = i->ai_addrlen;
+				addresses.push_back(address);
+			}
+			freeaddrinfo(res);
+		}
+		
+		{
+			std::lock_guard<std::mutex> lock(resolved_mutex);
+			resolved.emplace_back(attempt, std::move(addresses));
+		}
 		event_loop.GetNotifier().Notify();
-	} else {
-		LogMessage(Info, "not an IPv4 address");
 	}
 }
 
-TCPBackend::Device::Device(platform::Socket &&socket, TCPBackend &backend) :
+void TCPBackend::ConnectionAttempt::Finish(std::string message) {
+	if(callback) {
+		callback(message);
+		callback = nullptr;
+	}
+}
+
+TCPBackend::PendingConnection::PendingConnection(std::shared_ptr<ConnectionAttempt> attempt, platform::Socket &&socket, std::string address) :
+	platform::EventLoop::SocketMember(std::move(socket)),
+	attempt(attempt),
+	address(address) {
+}
+
+bool TCPBackend::PendingConnection::WantsWrite() {
+	return !done_flag;
+}
+
+void TCPBackend::PendingConnection::SignalWrite() {
+	if(done_flag) {
+		return;
+	}
+	done_flag = true;
+	try {
+		socket.FinishConnect();
+	} catch(platform::NetworkError &e) {
+		error = e.what();
+	}
+}
+
+void TCPBackend::PendingConnection::SignalError() {
+	if(done_flag) {
+		return;
+	}
+	done_flag = true;
+	try {
+		socket.FinishConnect();
+		error = "connection failed";
+	} catch(platform::NetworkError &e) {
+		error = e.what();
+	}
+}
+
+TCPBackend::Device::Device(platform::Socket &&socket, TCPBackend &backend, std::string address) :
 	backend(backend),
+	address(address),
 	connection(std::move(socket), backend.event_loop.GetNotifier()) {
 }
 
 TCPBackend::Device::~Device() {
+	for(Response &r : pending_requests.FailAll(TWILI_ERR_PROTOCOL_TRANSFER_ERROR)) {
+		backend.daemon.PostResponse(std::move(r));
+	}
 }
 
 void TCPBackend::Device::Begin() {
@@ -135,13 +283,12 @@ void TCPBackend::Device::IncomingMessage(protocol::MessageHeader &mh, util::Buff
 	}
 
 	// remove from pending requests
-	pending_requests.remove_if([this](WeakRequest &r) {
-			return r.tag == response_in.tag;
-		});
+	pending_requests.Remove(response_in.client_id, response_in.tag);
 	
 	if(response_in.client_id == 0xFFFFFFFF) { // identification meta-client
 		Identified(response_in);
 	} else {
+		backend.daemon.tracer.Record(Tracer::Event::Finalize, response_in.client_id, response_in.tag, response_in.object_id);
 		backend.daemon.PostResponse(std::move(response_in));
 	}
 }
@@ -175,19 +322,11 @@ void TCPBackend::Device::SendRequest(const Request &&r) {
 	mhdr.command_id = r.command_id;
 	mhdr.tag = r.tag;
 	mhdr.payload_size = r.payload.size();
-	mhdr.object_count = 0;
-
-	pending_requests.push_back(r.Weak());
-
-	/* TODO: request objects
-	std::vector<uint32_t> object_ids(r.objects.size(), 0);
-	std::transform(
-		r.objects.begin(), r.objects.end(), object_ids.begin(),
-		[](auto const &object) {
-			return object->object_id;
-		});
-	connection.out_buffer.Write(object_ids); */
-	connection.SendMessage(mhdr, r.payload, std::vector<uint32_t>());
+	mhdr.object_count = r.object_ids.size();
+
+	pending_requests.Add(r);
+
+	connection.SendMessage(mhdr, r.payload, r.object_ids);
 }
 
 int TCPBackend::Device::GetPriority() {
@@ -218,7 +357,6 @@ void TCPBackend::ListenMember::SignalRead() {
 	} else {
 		buffer[r] = 0;
 		if(!strcmp(buffer, "twili-announce")) {
-			LogMessage(Info, "received twili device announcement");
 			backend.Connect(addr, addr_len);
 		}
 	}
@@ -235,6 +373,44 @@ TCPBackend::ServerLogic::ServerLogic(TCPBackend &backend) : backend(backend) {
 void TCPBackend::ServerLogic::Prepare(platform::EventLoop &loop) {
 	loop.Clear();
 	loop.AddMember(backend.listen_member);
+
+	{
+		std::lock_guard<std::mutex> lock(backend.resolved_mutex);
+		for(auto &r : backend.resolved) {
+			backend.StartAttempt(r.first, r.second);
+		}
+		backend.resolved.clear();
+	}
+	
+	for(auto i = backend.pending_connections.begin(); i != backend.pending_connections.end(); ) {
+		PendingConnection &pc = **i;
+		std::shared_ptr<ConnectionAttempt> attempt = pc.attempt;
+		if(!pc.done_flag) {
+			if(attempt->connected) {
+				// another address for the same host won the race
+				i = backend.pending_connections.erase(i);
+			} else {
+				loop.AddMember(pc);
+				i++;
+			}
+			continue;
+		}
+
+		if(pc.error) {
+			LogMessage(Info, "failed to connect to %s: %s", pc.address.c_str(), pc.error->c_str());
+			attempt->last_error = *pc.error;
+		} else if(!attempt->connected) {
+			attempt->connected = true;
+			LogMessage(Info, "connected to %s", pc.address.c_str());
+			backend.devices.emplace_back(std::make_shared<Device>(std::move(pc.socket), backend, pc.address))->Begin();
+			attempt->Finish("Ok");
+		}
+		if(--attempt->remaining == 0 && !attempt->connected) {
+			attempt->Finish(attempt->last_error);
+		}
+		i = backend.pending_connections.erase(i);
+	}
+	
 	for(auto i = backend.devices.begin(); i != backend.devices.end(); ) {
 		common::MessageConnection::Request *rq;
 		while((rq = (*i)->connection.Process()) != nullptr) {
@@ -27,12 +27,16 @@
 #include<queue>
 #include<mutex>
 #include<condition_variable>
+#include<functional>
+#include<optional>
 
+#include "common/blockingconcurrentqueue.h"
 #include "common/SocketMessageConnection.hpp"
 
 #include "Buffer.hpp"
 #include "Device.hpp"
 #include "Messages.hpp"
+#include "PendingRequests.hpp"
 #include "Protocol.hpp"
 
 namespace twili {
@@ -48,12 +52,15 @@ class TCPBackend {
 	TCPBackend(Daemon &daemon);
 	~TCPBackend();
 
-	std::string Connect(std::string hostname, std::string port);
+	// Resolves and connects without blocking the caller. The callback is
+	// invoked on the event thread with "Ok" or an error message.
+	void Connect(std::string hostname, std::string port, std::function<void(std::string)> callback);
+	// Must be called on the event thread.
 	void Connect(sockaddr *sockaddr, socklen_t addr_len);
 	
 	class Device : public daemon::Device, public std::enable_shared_from_this<Device> {
 	 public:
-		Device(platform::Socket &&socket, TCPBackend &backend);
+		Device(platform::Socket &&socket, TCPBackend &backend, std::string address);
 		~Device();
 
 		void Begin();
@@ -64,16 +71,70 @@ class TCPBackend {
 		virtual std::string GetBridgeType() override;
 		
 		TCPBackend &backend;
+		std::string address; // numeric host, used to ignore repeated announcements
 		common::SocketMessageConnection connection;
-		std::list<WeakRequest> pending_requests;
+		PendingRequests pending_requests;
 		Response response_in;
 		bool ready_flag = false;
 		bool added_flag = false;
 	};
 
  private:
+	// One Connect call. Every address a hostname resolves to is tried in
+	// parallel, and the first one to connect wins.
+	struct ConnectionAttempt {
+		std::string name;
+		std::function<void(std::string)> callback;
+		size_t remaining = 0;
+		bool connected = false;
+		std::string last_error;
+
+		void Finish(std::string message);
+	};
+
+	class PendingConnection : public platform::EventLoop::SocketMember {
+	 public:
+		PendingConnection(std::shared_ptr<ConnectionAttempt> attempt, platform::Socket &&socket, std::string address);
+
+		virtual bool WantsWrite() override;
+		virtual void SignalWrite() override;
+		virtual void SignalError() override;
+
+		std::shared_ptr<ConnectionAttempt> attempt;
+		std::string address;
+		bool done_flag = false;
+		std::optional<std::string> error;
+	};
+
+	struct ResolveJob {
+		std::string hostname;
+		std::string port;
+		std::function<void(std::string)> callback;
+	};
+
+	struct ResolvedAddress {
+		int family;
+		int socktype;
+		int protocol;
+		sockaddr_storage addr;
+		socklen_t addr_len;
+	};
+
+	static std::string AddressToString(const sockaddr *addr, socklen_t addr_len);
+	static void TuneSocket(platform::Socket &socket);
+	bool IsKnownAddress(const std::string &address);
+	void StartAttempt(std::shared_ptr<ConnectionAttempt> attempt, std::vector<ResolvedAddress> &addresses);
+	void ResolverThreadFunc();
+	
 	Daemon &daemon;
 	std::list<std::shared_ptr<Device>> devices;
+	std::list<std::unique_ptr<PendingConnection>> pending_connections;
+
+	// getaddrinfo has no portable asynchronous version, so hostnames are
+	// resolved on their own thread and handed back to the event thread.
+	moodycamel::BlockingConcurrentQueue<std::optional<ResolveJob>> resolve_queue;
+	std::mutex resolved_mutex;
+	std::list<std::pair<std::shared_ptr<ConnectionAttempt>, std::vector<ResolvedAddress>>> resolved; // guarded by resolved_mutex
 
 	class ListenMember : public platform::EventLoop::SocketMember {
 	 public:
@@ -95,6 +156,7 @@ class TCPBackend {
 	} server_logic;
 	
 	platform::EventLoop event_loop;
+	std::thread resolver_thread;
 };
 
 } // namespace backend
@@ -0,0 +1,184 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Tracer.hpp"
+
+#include<algorithm>
+#include<chrono>
+
+#include<stdio.h>
+#include<inttypes.h>
+
+namespace twili {
+namespace twib {
+namespace daemon {
+
+namespace {
+
+struct TraceRecord {
+	uint64_t timestamp;
+	Tracer::Event event;
+	uint32_t client_id;
+	uint32_t tag;
+	uint32_t object_id;
+	uint32_t command_id;
+};
+
+// name of the stage that starts with each event
+const char *StageName(Tracer::Event event) {
+	switch(event) {
+	case Tracer::Event::FrontendReceive:
+		return "dispatch queue";
+	case Tracer::Event::Dispatch:
+		return "dispatch";
+	case Tracer::Event::BackendSend:
+		return "device";
+	case Tracer::Event::HeaderReceive:
+		return "response transfer";
+	case Tracer::Event::Finalize:
+		return "response queue";
+	default:
+		return "unknown";
+	}
+}
+
+void AppendEvent(std::string &out, const char *name, char phase, const TraceRecord &r, uint64_t base) {
+	char buffer[256];
+	double ts = (r.timestamp - base) / 1000.0;
+	snprintf(
+		buffer, sizeof(buffer),
+		"%s{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%" PRIu32 ",\"id\":\"0x%08" PRIx32 "%08" PRIx32 "\"}",
+		out.empty() ? "" : ",\n", name, phase, ts, r.client_id, r.client_id, r.tag);
+	out+= buffer;
+}
+
+} // anonymous namespace
+
+Tracer::Tracer(size_t capacity) : enabled(false), head(0), ring(capacity), mask(capacity - 1) {
+	for(Entry &e : ring) {
+		e.sequence.store(0, std::memory_order_relaxed);
+	}
+}
+
+void Tracer::SetEnabled(bool enabled) {
+	this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::RecordImpl(Event event, uint32_t client_id, uint32_t tag, uint32_t object_id, uint32_t command_id) {
+	uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	
+	uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+	Entry &e = ring[index & mask];
+
+	// mark the entry as being written, so that readers don't see a torn record
+	e.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.timestamp.store(timestamp, std::memory_order_relaxed);
+	e.event.store((uint32_t) event, std::memory_order_relaxed);
+	e.client_id.store(client_id, std::memory_order_relaxed);
+	e.tag.store(tag, std::memory_order_relaxed);
+	e.object_id.store(object_id, std::memory_order_relaxed);
+	e.command_id.store(command_id, std::memory_order_relaxed);
+	e.sequence.store(index + 1, std::memory_order_release);
+}
+
+std::string Tracer::DumpChromeTrace() {
+	std::vector<TraceRecord> records;
+	
+	uint64_t end = head.load(std::memory_order_acquire);
+	uint64_t begin = end > ring.size() ? end - ring.size() : 0;
+	records.reserve(end - begin);
+	for(uint64_t i = begin; i < end; i++) {
+		Entry &e = ring[i & mask];
+		if(e.sequence.load(std::memory_order_acquire) != i + 1) {
+			continue; // overwritten or still being written
+		}
+		TraceRecord r;
+		r.timestamp = e.timestamp.load(std::memory_order_relaxed);
+		r.event = (Event) e.event.load(std::memory_order_relaxed);
+		r.client_id = e.client_id.load(std::memory_order_relaxed);
+		r.tag = e.tag.load(std::memory_order_relaxed);
+		r.object_id = e.object_id.load(std::memory_order_relaxed);
+		r.command_id = e.command_id.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(e.sequence.load(std::memory_order_relaxed) != i + 1) {
+			continue;
+		}
+		records.push_back(r);
+	}
+
+	uint64_t base = records.empty() ? 0 : std::min_element(
+		records.begin(), records.end(),
+		[](const TraceRecord &a, const TraceRecord &b) {
+			return a.timestamp < b.timestamp;
+		})->timestamp;
+	
+	// group records for the same request together, in the order they happened
+	std::stable_sort(
+		records.begin(), records.end(),
+		[](const TraceRecord &a, const TraceRecord &b) {
+			if(a.client_id != b.client_id) { return a.client_id < b.client_id; }
+			if(a.tag != b.tag) { return a.tag < b.tag; }
+			return a.timestamp < b.timestamp;
+		});
+
+	std::string events;
+	for(auto i = records.begin(); i != records.end(); ) {
+		// a request runs until its events stop advancing through the
+		// lifecycle; tags may be reused by later requests.
+		auto j = i + 1;
+		while(j != records.end() &&
+					j->client_id == i->client_id &&
+					j->tag == i->tag &&
+					(uint32_t) j->event > (uint32_t) (j-1)->event) {
+			j++;
+		}
+
+		AppendEvent(events, "request", 'b', *i, base);
+		for(auto k = i; k + 1 != j; k++) {
+			AppendEvent(events, StageName(k->event), 'b', *k, base);
+			AppendEvent(events, StageName(k->event), 'e', *(k + 1), base);
+		}
+		AppendEvent(events, "request", 'e', *(j - 1), base);
+
+		// request metadata, only known from the request side
+		if(i->event == Event::FrontendReceive) {
+			char buffer[192];
+			snprintf(
+				buffer, sizeof(buffer),
+				",\n{\"name\":\"request\",\"cat\":\"request\",\"ph\":\"n\",\"ts\":%.3f,\"pid\":1,\"tid\":%" PRIu32 ",\"id\":\"0x%08" PRIx32 "%08" PRIx32 "\",\"args\":{\"object_id\":%" PRIu32 ",\"command_id\":%" PRIu32 "}}",
+				(i->timestamp - base) / 1000.0, i->client_id, i->client_id, i->tag, i->object_id, i->command_id);
+			events+= buffer;
+		}
+		
+		i = j;
+	}
+
+	return "{\"traceEvents\":[\n" + events + "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+} // namespace daemon
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,85 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<atomic>
+#include<string>
+#include<vector>
+
+#include<stdint.h>
+
+namespace twili {
+namespace twib {
+namespace daemon {
+
+// Records timestamps as requests move through twibd, so that we can see where
+// time goes between a client sending a request and getting its response.
+// Records go into a fixed-size ring that is overwritten once full. Recording
+// takes no locks, so this is cheap enough to leave enabled.
+class Tracer {
+ public:
+	enum class Event : uint32_t {
+		FrontendReceive, // request parsed from a frontend client
+		Dispatch, // request dequeued by Daemon::Process
+		BackendSend, // request handed to a device backend
+		HeaderReceive, // response header received from the device
+		Finalize, // response fully received from the device
+		FrontendSend, // response queued to the frontend client
+	};
+
+	Tracer(size_t capacity = 32768); // capacity must be a power of two
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled();
+
+	inline void Record(Event event, uint32_t client_id, uint32_t tag, uint32_t object_id = 0, uint32_t command_id = 0) {
+		if(!enabled.load(std::memory_order_relaxed)) {
+			return;
+		}
+		RecordImpl(event, client_id, tag, object_id, command_id);
+	}
+
+	// Renders the records currently in the ring in Chrome's trace event
+	// format, which can be loaded by chrome://tracing or Perfetto.
+	std::string DumpChromeTrace();
+ private:
+	struct Entry {
+		// index of the record + 1, or 0 while it's being written
+		std::atomic<uint64_t> sequence;
+		std::atomic<uint64_t> timestamp;
+		std::atomic<uint32_t> event;
+		std::atomic<uint32_t> client_id;
+		std::atomic<uint32_t> tag;
+		std::atomic<uint32_t> object_id;
+		std::atomic<uint32_t> command_id;
+	};
+
+	void RecordImpl(Event event, uint32_t client_id, uint32_t tag, uint32_t object_id, uint32_t command_id);
+	
+	std::atomic<bool> enabled;
+	std::atomic<uint64_t> head;
+	std::vector<Entry> ring;
+	uint64_t mask;
+};
+
+} // namespace daemon
+} // namespace twib
+} // namespace twili
@@ -91,10 +91,8 @@ USBBackend::Device::Device(USBBackend *backend, libusb_device_handle *handle, ui
 }
 
 USBBackend::Device::~Device() {
-	for(auto r : pending_requests) {
-		if(r.client_id != 0xffffffff) {
-			backend->daemon.PostResponse(r.RespondError(TWILI_ERR_PROTOCOL_TRANSFER_ERROR));
-		}
+	for(Response &r : pending_requests.FailAll(TWILI_ERR_PROTOCOL_TRANSFER_ERROR)) {
+		backend->daemon.PostResponse(std::move(r));
 	}
 	Destroy();
 	libusb_free_transfer(tfer_meta_out);
@@ -149,10 +147,11 @@ void USBBackend::Device::SendRequest(const Request &&request) {
 	mhdr.command_id = request.command_id;
 	mhdr.tag = request.tag;
 	mhdr.payload_size = request.payload.size();
-	mhdr.object_count = 0;
+	mhdr.object_count = request.object_ids.size();
 
 	request_out = request.Weak();
-	pending_requests.push_back(request_out);
+	object_ids_out = request.object_ids;
+	pending_requests.Add(request);
 
 	libusb_fill_bulk_transfer(tfer_meta_out, handle, endp_meta_out, (uint8_t*) &mhdr, sizeof(mhdr), &Device::MetaOutTransferShim, SharedPtrForTransfer(), 5000);
 	transferring_meta = true;
@@ -196,6 +195,9 @@ void USBBackend::Device::MetaOutTransferCompleted() {
 			Kill();
 			return;
 		}
+	} else if(object_ids_out.size() > 0) {
+		transferring_data = true;
+		SubmitObjectOutTransfer();
 	}
 
 	transferring_meta = false;
@@ -225,6 +227,9 @@ void USBBackend::Device::DataOutTransferCompleted() {
 			return;
 		}
 		return;
+	} else if(object_ids_out.size() > 0) {
+		// object IDs follow the payload on the same endpoint
+		SubmitObjectOutTransfer();
 	} else {
 		LogMessage(Debug, "finished transferring data");
 		std::unique_lock<std::mutex> lock(state_mutex);
@@ -238,6 +243,35 @@ void USBBackend::Device::DataOutTransferCompleted() {
 	}
 }
 
+void USBBackend::Device::SubmitObjectOutTransfer() {
+	LogMessage(Debug, "transferring object IDs");
+	libusb_fill_bulk_transfer(tfer_data_out, handle, endp_data_out, (uint8_t*) object_ids_out.data(), object_ids_out.size() * sizeof(uint32_t), &Device::ObjectOutTransferShim, SharedPtrForTransfer(), 5000);
+	int r = libusb_submit_transfer(tfer_data_out);
+	if(r != 0) {
+		LogMessage(Debug, "transfer failed: %s", libusb_error_name(r));
+		Kill();
+		return;
+	}
+}
+
+void USBBackend::Device::ObjectOutTransferCompleted() {
+	if((size_t) tfer_data_out->actual_length != object_ids_out.size() * sizeof(uint32_t)) {
+		LogMessage(Debug, "short object ID transfer");
+		Kill();
+		return;
+	}
+	
+	LogMessage(Debug, "finished transferring object IDs");
+	std::unique_lock<std::mutex> lock(state_mutex);
+	
+	transferring_data = false;
+	if(!transferring_meta && !transferring_data) {
+		LogMessage(Debug, "entering AVAILABLE state");
+		state = State::AVAILABLE;
+		state_cv.notify_one();
+	}
+}
+
 void USBBackend::Device::MetaInTransferCompleted() {
 	/*
   LogMessage(Debug, "got response header");
@@ -248,6 +282,7 @@ void USBBackend::Device::MetaInTransferCompleted() {
 	LogMessage(Debug, "  payload_size: 0x%lx", mhdr_in.payload_size);
 	LogMessage(Debug, "  object_count: %d", mhdr_in.object_count);
   */
+	backend->daemon.tracer.Record(Tracer::Event::HeaderReceive, mhdr_in.client_id, mhdr_in.tag, mhdr_in.object_id);
 
 	response_in.device_id = device_id;
 	response_in.client_id = mhdr_in.client_id;
@@ -331,13 +366,12 @@ void USBBackend::Device::DispatchResponse() {
 		});
 
 	// remove from pending requests
-	pending_requests.remove_if([this](WeakRequest &r) {
-			return r.tag == response_in.tag;
-		});
+	pending_requests.Remove(response_in.client_id, response_in.tag);
 	
 	if(response_in.client_id == 0xFFFFFFFF) { // identification meta-client
 		Identified(response_in);
 	} else {
+		backend->daemon.tracer.Record(Tracer::Event::Finalize, response_in.client_id, response_in.tag, response_in.object_id);
 		backend->daemon.PostResponse(std::move(response_in));
 	}
 	ResubmitMetaInTransfer();
@@ -411,6 +445,14 @@ void USBBackend::Device::DataOutTransferShim(libusb_transfer *tfer) {
 	delete d;
 }
 
+void USBBackend::Device::ObjectOutTransferShim(libusb_transfer *tfer) {
+	std::shared_ptr<Device> *d = (std::shared_ptr<Device> *) tfer->user_data;
+	if(!(*d)->CheckTransfer(tfer)) {
+		(*d)->ObjectOutTransferCompleted();
+	}
+	delete d;
+}
+
 void USBBackend::Device::MetaInTransferShim(libusb_transfer *tfer) {
 	std::shared_ptr<Device> *d = (std::shared_ptr<Device> *) tfer->user_data;
 	if(tfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
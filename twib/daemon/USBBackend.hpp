@@ -33,6 +33,7 @@
 #include "Buffer.hpp"
 #include "Device.hpp"
 #include "Messages.hpp"
+#include "PendingRequests.hpp"
 #include "Protocol.hpp"
 #include "InitialScanLock.hpp"
 
@@ -99,9 +100,10 @@ class USBBackend {
 		protocol::MessageHeader mhdr;
 		protocol::MessageHeader mhdr_in;
 		WeakRequest request_out;
+		std::vector<uint32_t> object_ids_out;
 		Response response_in;
 		std::vector<uint32_t> object_ids_in;
-		std::list<WeakRequest> pending_requests;
+		PendingRequests pending_requests;
 
 		std::unique_lock<InitialScanLock> isl_lock;
 
@@ -109,6 +111,8 @@ class USBBackend {
 		std::shared_ptr<Device> *SharedPtrForTransfer();
 		void MetaOutTransferCompleted();
 		void DataOutTransferCompleted();
+		void SubmitObjectOutTransfer();
+		void ObjectOutTransferCompleted();
 		void MetaInTransferCompleted();
 		void DataInTransferCompleted();
 		void ObjectInTransferCompleted();
@@ -119,6 +123,7 @@ class USBBackend {
 		static size_t LimitTransferSize(size_t size);
 		static void MetaOutTransferShim(libusb_transfer *tfer);
 		static void DataOutTransferShim(libusb_transfer *tfer);
+		static void ObjectOutTransferShim(libusb_transfer *tfer);
 		static void MetaInTransferShim(libusb_transfer *tfer);
 		static void DataInTransferShim(libusb_transfer *tfer);
 		static void ObjectInTransferShim(libusb_transfer *tfer);
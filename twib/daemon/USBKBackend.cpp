@@ -177,10 +177,8 @@ USBKBackend::Device::Device(USBKBackend &backend, KUSB_DRIVER_API Usb, UsbHandle
 }
 
 USBKBackend::Device::~Device() {
-	for(auto r : pending_requests) {
-		if(r.client_id != 0xffffffff) {
-			backend.daemon.PostResponse(r.RespondError(TWILI_ERR_PROTOCOL_TRANSFER_ERROR));
-		}
+	for(Response &r : pending_requests.FailAll(TWILI_ERR_PROTOCOL_TRANSFER_ERROR)) {
+		backend.daemon.PostResponse(std::move(r));
 	}
 	if(isl_lock) { isl_lock.unlock(); }
 }
@@ -219,10 +217,13 @@ void USBKBackend::Device::SendRequest(const Request &&request) {
 	mhdr.command_id = request.command_id;
 	mhdr.tag = request.tag;
 	mhdr.payload_size = request.payload.size();
-	mhdr.object_count = 0;
+	mhdr.object_count = request.object_ids.size();
 
 	request_out = request.Weak();
-	pending_requests.push_back(request_out);
+	object_ids_out = request.object_ids;
+	wrote_out_objects = false;
+	data_out_transferred = 0;
+	pending_requests.Add(request);
 
 	member_meta_out.Submit((uint8_t*)&mhdr, sizeof(mhdr));
 	transferring_data = false;
@@ -244,6 +245,10 @@ void USBKBackend::Device::MetaOutTransferCompleted(size_t size) {
 		data_out_transferred = 0;
 		member_data_out.Submit((uint8_t*)request_out.payload.data(), LimitTransferSize(request_out.payload.size()));
 		transferring_data = true;
+	} else if(object_ids_out.size() > 0) {
+		wrote_out_objects = true;
+		member_data_out.Submit((uint8_t*)object_ids_out.data(), object_ids_out.size() * sizeof(uint32_t));
+		transferring_data = true;
 	}
 
 	transferring_meta = false;
@@ -255,12 +260,25 @@ void USBKBackend::Device::MetaOutTransferCompleted(size_t size) {
 }
 
 void USBKBackend::Device::DataOutTransferCompleted(size_t size) {
-	data_out_transferred += size;
+	if(wrote_out_objects) {
+		if(size != object_ids_out.size() * sizeof(uint32_t)) {
+			LogMessage(Debug, "short object ID transfer");
+			Kill();
+			return;
+		}
+	} else {
+		data_out_transferred += size;
+	}
 	size_t remaining = mhdr.payload_size - data_out_transferred;
 
 	if(remaining > 0) {
 		member_data_out.Submit((uint8_t*)request_out.payload.data() + data_out_transferred, LimitTransferSize(remaining));
 		return;
+	} else if(!wrote_out_objects && object_ids_out.size() > 0) {
+		// object IDs follow the payload on the same endpoint
+		wrote_out_objects = true;
+		member_data_out.Submit((uint8_t*)object_ids_out.data(), object_ids_out.size() * sizeof(uint32_t));
+		return;
 	} else {
 		std::unique_lock<std::mutex> lock(state_mutex);
 		
@@ -274,6 +292,8 @@ void USBKBackend::Device::DataOutTransferCompleted(size_t size) {
 }
 
 void USBKBackend::Device::MetaInTransferCompleted(size_t size) {
+	backend.daemon.tracer.Record(Tracer::Event::HeaderReceive, mhdr_in.client_id, mhdr_in.tag, mhdr_in.object_id);
+	
 	response_in.device_id = device_id;
 	response_in.client_id = mhdr_in.client_id;
 	response_in.object_id = mhdr_in.object_id;
@@ -330,13 +350,12 @@ void USBKBackend::Device::DispatchResponse() {
 		});
 
 	// remove from pending requests
-	pending_requests.remove_if([this](WeakRequest &r) {
-			return r.tag == response_in.tag;
-		});
+	pending_requests.Remove(response_in.client_id, response_in.tag);
 	
 	if(response_in.client_id == 0xFFFFFFFF) { // identification meta-client
 		Identified(response_in);
 	} else {
+		backend.daemon.tracer.Record(Tracer::Event::Finalize, response_in.client_id, response_in.tag, response_in.object_id);
 		backend.daemon.PostResponse(std::move(response_in));
 	}
 	ResubmitMetaInTransfer();
@@ -34,6 +34,7 @@
 #include "Buffer.hpp"
 #include "Device.hpp"
 #include "Messages.hpp"
+#include "PendingRequests.hpp"
 #include "Protocol.hpp"
 #include "InitialScanLock.hpp"
 
@@ -150,8 +151,9 @@ class USBKBackend {
 		protocol::MessageHeader mhdr_in;
 		protocol::MessageHeader mhdr;
 		WeakRequest request_out;
+		std::vector<uint32_t> object_ids_out;
 		Response response_in;
-		std::list<WeakRequest> pending_requests;
+		PendingRequests pending_requests;
 		std::vector<uint32_t> object_ids_in;
 
 		std::unique_lock<InitialScanLock> isl_lock;
@@ -161,6 +163,7 @@ class USBKBackend {
 		size_t data_out_transferred;
 		size_t data_in_transferred;
 		bool read_in_objects;
+		bool wrote_out_objects;
 
 		void Kill();
 		
@@ -24,6 +24,7 @@
 
 #include<libgen.h>
 #include<fcntl.h>
+#include<dirent.h>
 #include<sys/stat.h>
 
 namespace twili {
@@ -40,6 +41,8 @@ std::optional<Stat> StatFile(const char *path) {
 	} else {
 		Stat out;
 		out.is_directory = S_ISDIR(stat_buf.st_mode);
+		out.size = stat_buf.st_size;
+		out.mtime = stat_buf.st_mtime;
 		return out;
 	}
 }
@@ -49,6 +52,23 @@ std::string BaseName(const char *path) {
 	return basename(copy.data()); // haha don't do this
 }
 
+std::vector<std::string> ListDirectory(const char *path) {
+	DIR *dir = opendir(path);
+	if(dir == nullptr) {
+		throw NetworkError(errno);
+	}
+	std::vector<std::string> names;
+	struct dirent *entry;
+	while((entry = readdir(dir)) != nullptr) {
+		std::string name = entry->d_name;
+		if(name != "." && name != "..") {
+			names.push_back(name);
+		}
+	}
+	closedir(dir);
+	return names;
+}
+
 } // namespace fs
 } // namespace platform
 } // namespace twili
\ No newline at end of file
@@ -198,6 +198,37 @@ void Socket::Connect(const struct sockaddr *address, socklen_t address_len) {
 	}
 }
 
+bool Socket::StartConnect(const struct sockaddr *address, socklen_t address_len) {
+	int flags = fcntl(fd, F_GETFL);
+	if(flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		throw NetworkError(errno);
+	}
+	if(connect(fd, address, address_len) != 0) {
+		if(errno == EINPROGRESS) {
+			return false;
+		}
+		throw NetworkError(errno);
+	}
+	FinishConnect();
+	return true;
+}
+
+void Socket::FinishConnect() {
+	int error = 0;
+	socklen_t error_len = sizeof(error);
+	if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0) {
+		throw NetworkError(errno);
+	}
+	if(error != 0) {
+		throw NetworkError(error);
+	}
+	// the rest of twib expects blocking sockets
+	int flags = fcntl(fd, F_GETFL);
+	if(flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+		throw NetworkError(errno);
+	}
+}
+
 } // namespace unix
 } // namespace platform
 } // namespace twili
@@ -27,6 +27,7 @@
 #include<sys/un.h>
 #include<netinet/in.h>
 #include<netinet/ip.h>
+#include<netinet/tcp.h>
 #include<arpa/inet.h>
 #include<netdb.h>
 #include<unistd.h>
@@ -99,6 +100,12 @@ class Socket : public File {
 	Socket Accept(struct sockaddr *address, socklen_t *address_len);
 	void Connect(const struct sockaddr *address, socklen_t address_len);
 
+	// Non-blocking connect. StartConnect returns true if the connection was
+	// established immediately; otherwise wait for the socket to become
+	// writable and call FinishConnect, which throws if the connection failed.
+	bool StartConnect(const struct sockaddr *address, socklen_t address_len);
+	void FinishConnect();
+
  private:
 	bool should_unlink_unix_socket = false;
 	struct sockaddr_un unix_addr;
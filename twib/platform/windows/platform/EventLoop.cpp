@@ -157,6 +157,10 @@ void EventLoopSocketMember::Signal() {
 			SignalWrite();
 		}
 	}
+	if(netevents.lNetworkEvents & FD_CONNECT) {
+		// non-blocking connect finished, one way or another
+		SignalWrite();
+	}
 }
 
 Event &EventLoopSocketMember::GetEvent() {
@@ -167,6 +171,7 @@ Event &EventLoopSocketMember::GetEvent() {
 	}
 	if(WantsWrite()) {
 		events|= FD_WRITE;
+		events|= FD_CONNECT;
 	}
 	if(WSAEventSelect(socket.fd, event.handle, events)) {
 		LogMessage(Fatal, "failed to WSAEventSelect");
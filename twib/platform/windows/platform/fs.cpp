@@ -25,8 +25,8 @@ namespace platform {
 namespace fs {
 
 std::optional<Stat> StatFile(const char *path) {
-	DWORD attributes = GetFileAttributes(path);
-	if(attributes == INVALID_FILE_ATTRIBUTES) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if(!GetFileAttributesEx(path, GetFileExInfoStandard, &data)) {
 		DWORD err = GetLastError();
 		if(err != ERROR_PATH_NOT_FOUND && err != ERROR_FILE_NOT_FOUND) {
 			throw NetworkError(err);
@@ -34,7 +34,10 @@ std::optional<Stat> StatFile(const char *path) {
 		return std::nullopt;
 	} else {
 		Stat out;
-		out.is_directory = attributes & FILE_ATTRIBUTE_DIRECTORY;
+		out.is_directory = data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+		out.size = ((uint64_t) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		out.mtime = ((int64_t) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+		return out;
 	}
 }
 
@@ -53,6 +56,23 @@ std::string BaseName(const char *path) {
 	return out;
 }
 
+std::vector<std::string> ListDirectory(const char *path) {
+	WIN32_FIND_DATA data;
+	HANDLE find = FindFirstFile((std::string(path) + "\\*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE) {
+		throw NetworkError(GetLastError());
+	}
+	std::vector<std::string> names;
+	do {
+		std::string name = data.cFileName;
+		if(name != "." && name != "..") {
+			names.push_back(name);
+		}
+	} while(FindNextFile(find, &data));
+	FindClose(find);
+	return names;
+}
+
 } // namespace fs
 } // namespace platform
 } // namespace twili
\ No newline at end of file
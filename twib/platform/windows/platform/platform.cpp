@@ -211,6 +211,34 @@ void Socket::Connect(const struct sockaddr *address, socklen_t address_len) {
 	}
 }
 
+bool Socket::StartConnect(const struct sockaddr *address, socklen_t address_len) {
+	// sockets stay non-blocking once the event loop has WSAEventSelect'd them,
+	// so there is no need to switch back in FinishConnect
+	u_long nonblocking = 1;
+	if(ioctlsocket(fd, FIONBIO, &nonblocking) == SOCKET_ERROR) {
+		throw NetworkError(WSAGetLastError());
+	}
+	if(WSAConnect(fd, address, address_len, nullptr, nullptr, nullptr, nullptr) == SOCKET_ERROR) {
+		int error = WSAGetLastError();
+		if(error == WSAEWOULDBLOCK) {
+			return false;
+		}
+		throw NetworkError(error);
+	}
+	return true;
+}
+
+void Socket::FinishConnect() {
+	int error = 0;
+	int error_len = sizeof(error);
+	if(getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*) &error, &error_len) == SOCKET_ERROR) {
+		throw NetworkError(WSAGetLastError());
+	}
+	if(error != 0) {
+		throw NetworkError(error);
+	}
+}
+
 void Socket::Close() {
 	closesocket(fd);
 	fd = INVALID_SOCKET;
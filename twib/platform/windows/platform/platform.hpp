@@ -130,6 +130,12 @@ class Socket {
 	Socket Accept(struct sockaddr *address, socklen_t *address_len);
 	void Connect(const struct sockaddr *address, socklen_t address_len);
 
+	// Non-blocking connect. StartConnect returns true if the connection was
+	// established immediately; otherwise wait for the socket to become
+	// writable and call FinishConnect, which throws if the connection failed.
+	bool StartConnect(const struct sockaddr *address, socklen_t address_len);
+	void FinishConnect();
+
 	void Close();
 
 	SOCKET fd;
@@ -0,0 +1,276 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<optional>
+#include<random>
+#include<thread>
+
+#include "common/blockingconcurrentqueue.h"
+#include "common/Semaphore.hpp"
+#include "Protocol.hpp"
+#include "err.hpp"
+#include "daemon/Daemon.hpp"
+#include "daemon/PendingRequests.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+// Answers every request with an empty OK response from its own thread, the
+// way the USB and TCP backends do from their event threads, and counts the
+// objects it is asked to close.
+class StandInDevice : public daemon::Device {
+ public:
+	StandInDevice(daemon::Daemon &daemon) :
+		daemon(daemon),
+		thread(&StandInDevice::ThreadFunc, this) {
+		device_id = 0x7e570000;
+		device_nickname = "stand-in";
+		serial_number = "stand-in";
+	}
+
+	virtual ~StandInDevice() {
+		queue.enqueue(std::nullopt);
+		thread.join();
+	}
+	
+	virtual void SendRequest(const daemon::Request &&r) override {
+		if(r.command_id == protocol::CLOSE_OBJECTS) {
+			close_requests++;
+			closed_objects+= r.payload.size() / sizeof(uint32_t);
+		} else if(r.command_id == protocol::CLOSE_OBJECT && r.object_id != 0) {
+			close_requests++;
+			closed_objects++;
+		}
+		queue.enqueue(daemon::WeakRequest(r.client ? r.client->client_id : 0xffffffff, r.device_id, r.object_id, r.command_id, r.tag));
+	}
+	
+	virtual int GetPriority() override {
+		return 0;
+	}
+	
+	virtual std::string GetBridgeType() override {
+		return "stand-in";
+	}
+
+	std::atomic<size_t> close_requests = 0;
+	std::atomic<size_t> closed_objects = 0;
+	
+ private:
+	void ThreadFunc() {
+		std::optional<daemon::WeakRequest> rq;
+		while(true) {
+			queue.wait_dequeue(rq);
+			if(!rq) {
+				return;
+			}
+			daemon.PostResponse(rq->RespondOk());
+		}
+	}
+	
+	daemon::Daemon &daemon;
+	moodycamel::BlockingConcurrentQueue<std::optional<daemon::WeakRequest>> queue;
+	std::thread thread;
+};
+
+// Runs the daemon's dispatch loop on its own thread for as long as it's
+// alive.
+class DispatchThread {
+ public:
+	DispatchThread(daemon::Daemon &daemon) :
+		daemon(daemon),
+		thread(
+			[this]() {
+				while(running) {
+					this->daemon.Process();
+				}
+			}) {
+	}
+
+	~DispatchThread() {
+		running = false;
+		daemon.Awaken();
+		thread.join();
+	}
+ private:
+	daemon::Daemon &daemon;
+	std::atomic<bool> running = true;
+	std::thread thread;
+};
+
+// Counts responses instead of writing them to a socket.
+class CountingClient : public daemon::Client {
+ public:
+	virtual void PostResponse(daemon::Response &r) override {
+		last_result_code = r.result_code;
+		responses.notify();
+	}
+
+	common::Semaphore responses;
+	std::atomic<uint32_t> last_result_code = 0;
+};
+
+// Drives thousands of outstanding requests from several clients with
+// overlapping tags through the table, answers them out of order, and fails
+// the rest in bulk.
+static void PendingRequestsTracksEveryRequest() {
+	const uint32_t clients = 4;
+	const uint32_t per_client = 5000;
+	std::vector<std::shared_ptr<CountingClient>> client_objects;
+	for(uint32_t c = 0; c < clients; c++) {
+		client_objects.push_back(std::make_shared<CountingClient>());
+		client_objects.back()->client_id = c;
+	}
+
+	daemon::PendingRequests pending;
+	std::vector<std::pair<uint32_t, uint32_t>> sent;
+	for(uint32_t tag = 0; tag < per_client; tag++) {
+		for(uint32_t c = 0; c < clients; c++) {
+			pending.Add(daemon::Request(client_objects[c], 1, 0, 0, tag));
+			sent.emplace_back(c, tag);
+		}
+	}
+	// identification requests come from the meta-client and are never failed
+	pending.Add(daemon::Request(std::shared_ptr<daemon::Client>(), 1, 0, 0, 0xffffffff));
+	Check(pending.Size() == sent.size() + 1, "size after adding");
+
+	std::shuffle(sent.begin(), sent.end(), std::mt19937(0x7769));
+	size_t answered = sent.size() / 2;
+	for(size_t i = 0; i < answered; i++) {
+		Check(pending.Remove(sent[i].first, sent[i].second), "removing pending request %u/%u", sent[i].first, sent[i].second);
+		Check(!pending.Remove(sent[i].first, sent[i].second), "removing request %u/%u twice", sent[i].first, sent[i].second);
+	}
+	Check(pending.Size() == sent.size() - answered + 1, "size after responses");
+
+	std::vector<daemon::Response> failed = pending.FailAll(1);
+	if(!Check(failed.size() == sent.size() - answered, "failed %zu responses, expected %zu", failed.size(), sent.size() - answered)) {
+		return;
+	}
+	std::sort(failed.begin(), failed.end(),
+		[](const daemon::Response &a, const daemon::Response &b) {
+			return std::make_pair(a.client_id, a.tag) < std::make_pair(b.client_id, b.tag);
+		});
+	std::sort(sent.begin() + answered, sent.end());
+	for(size_t i = 0; i < failed.size(); i++) {
+		Check(failed[i].client_id == sent[answered + i].first && failed[i].tag == sent[answered + i].second, "failed response %zu doesn't match an outstanding request", i);
+		Check(failed[i].result_code == 1, "failed response %zu result code", i);
+	}
+	Check(pending.Size() == 0, "empty after failing");
+}
+
+// Hands a client a pile of objects, drops the client, and makes sure the
+// objects reach the device as a single CLOSE_OBJECTS request (or one close
+// each, for bridges that predate it).
+static void CheckObjectCloses(bool batched) {
+	const uint32_t count = 1000;
+	
+	daemon::Daemon daemon(false);
+	std::shared_ptr<StandInDevice> device = std::make_shared<StandInDevice>(daemon);
+	if(batched) {
+		device->identification = msgpack11::MsgPack::object {
+			{"protocol", protocol::VERSION},
+		};
+	}
+	std::shared_ptr<CountingClient> client = std::make_shared<CountingClient>();
+	daemon.AddDevice(device);
+	daemon.AddClient(client);
+	
+	{
+		DispatchThread dispatch(daemon);
+		{
+			daemon::Response rs(client->client_id, device->device_id, 0, 0, 0);
+			for(uint32_t i = 1; i <= count; i++) {
+				rs.objects.push_back(std::make_shared<daemon::BridgeObject>(daemon, device->device_id, i));
+			}
+			daemon.PostResponse(std::move(rs));
+		}
+		client->responses.wait();
+		daemon.RemoveClient(client);
+		client.reset();
+
+		for(int i = 0; i < 1000 && device->closed_objects < count; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		Check(device->closed_objects == count, "closed %zu objects, expected %u", (size_t) device->closed_objects, count);
+		Check(device->close_requests == (batched ? 1 : count), "sent %zu close requests", (size_t) device->close_requests);
+	}
+	daemon.RemoveDevice(device);
+}
+
+static void ObjectClosesBatched() {
+	CheckObjectCloses(true);
+}
+
+static void ObjectClosesUnbatched() {
+	CheckObjectCloses(false);
+}
+
+// Makes sure requests can only pass along objects that the sending client
+// owns on the target device.
+static void ObjectArgumentsMustBeOwned() {
+	daemon::Daemon daemon(false);
+	std::shared_ptr<StandInDevice> device = std::make_shared<StandInDevice>(daemon);
+	std::shared_ptr<CountingClient> client = std::make_shared<CountingClient>();
+	std::shared_ptr<CountingClient> other_client = std::make_shared<CountingClient>();
+	daemon.AddDevice(device);
+	daemon.AddClient(client);
+	daemon.AddClient(other_client);
+	
+	{
+		DispatchThread dispatch(daemon);
+		{
+			daemon::Response rs(client->client_id, device->device_id, 0, 0, 0);
+			rs.objects.push_back(std::make_shared<daemon::BridgeObject>(daemon, device->device_id, 1));
+			daemon.PostResponse(std::move(rs));
+		}
+		client->responses.wait();
+
+		daemon::Request owned(client, device->device_id, 0, 0, 1);
+		owned.object_ids.push_back(1);
+		daemon.PostRequest(std::move(owned));
+		client->responses.wait();
+		Check(client->last_result_code == 0, "passing an owned object failed with 0x%x", (uint32_t) client->last_result_code);
+	
+		daemon::Request unowned(other_client, device->device_id, 0, 0, 2);
+		unowned.object_ids.push_back(1);
+		daemon.PostRequest(std::move(unowned));
+		other_client->responses.wait();
+		Check(other_client->last_result_code == TWILI_ERR_PROTOCOL_UNRECOGNIZED_OBJECT, "passing another client's object gave 0x%x", (uint32_t) other_client->last_result_code);
+	}
+	daemon.RemoveClient(client);
+	daemon.RemoveClient(other_client);
+	daemon.RemoveDevice(device);
+}
+
+void RegisterDaemonTests(Registry &registry) {
+	registry.Add("daemon/object_closes_batched", ObjectClosesBatched);
+	registry.Add("daemon/object_closes_unbatched", ObjectClosesUnbatched);
+	registry.Add("daemon/object_arguments", ObjectArgumentsMustBeOwned);
+	registry.Add("daemon/pending_requests", PendingRequestsTracksEveryRequest);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,113 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<random>
+
+#include<ctype.h>
+#include<string.h>
+
+#include "tool/HexCodec.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+namespace hex = tool::gdb::hex;
+
+// Checks the vector codecs against the scalar ones over every length that
+// exercises a partial vector, with mixed case and stray invalid characters
+// in the input.
+static void HexCodecMatchesScalar() {
+	std::mt19937 rng(0x7769);
+	for(size_t size = 0; size < 256; size++) {
+		for(int round = 0; round < 16; round++) {
+			std::vector<uint8_t> data(size);
+			for(uint8_t &b : data) {
+				b = rng();
+			}
+			std::vector<char> encoded(size * 2), expected(size * 2);
+			hex::Encode(data.data(), size, encoded.data());
+			hex::EncodeScalar(data.data(), size, expected.data());
+			if(!Check(encoded == expected, "hex::Encode (%s) disagrees with scalar for %zu bytes", hex::GetImplementationName(), size)) {
+				return;
+			}
+
+			for(char &c : encoded) {
+				if(rng() % 8 == 0) {
+					c = toupper(c);
+				} else if(round % 2 && rng() % 256 == 0) {
+					c = rng();
+				}
+			}
+			std::vector<uint8_t> decoded(size), decoded_expected(size);
+			bool valid = hex::Decode(encoded.data(), size, decoded.data());
+			bool valid_expected = hex::DecodeScalar(encoded.data(), size, decoded_expected.data());
+			if(!Check(valid == valid_expected && decoded == decoded_expected, "hex::Decode (%s) disagrees with scalar for %zu bytes", hex::GetImplementationName(), size)) {
+				return;
+			}
+		}
+	}
+}
+
+// Non-hex characters decode as zero nybbles, the way GdbConnection always
+// decoded them, so a malformed packet doesn't write 0xff anywhere.
+static void HexCodecInvalidNybblesAreZero() {
+	struct Case {
+		const char *hex;
+		std::vector<uint8_t> expected;
+	};
+	std::vector<Case> cases = {
+		{"zz", {0x00}},
+		{"z1", {0x01}},
+		{"1z", {0x10}},
+		{"G0aF", {0x00, 0xaf}},
+	};
+
+	// long enough to go through every vector path, with an invalid
+	// character in the middle of a block
+	std::string long_hex;
+	std::vector<uint8_t> long_expected;
+	for(size_t i = 0; i < 96; i++) {
+		long_hex+= i == 40 ? "x7" : "5a";
+		long_expected.push_back(i == 40 ? 0x07 : 0x5a);
+	}
+	cases.push_back({long_hex.c_str(), long_expected});
+
+	for(Case &c : cases) {
+		size_t size = strlen(c.hex) / 2;
+		std::vector<uint8_t> decoded(size, 0xcc), decoded_scalar(size, 0xcc);
+		bool valid = hex::Decode(c.hex, size, decoded.data());
+		bool valid_scalar = hex::DecodeScalar(c.hex, size, decoded_scalar.data());
+		Check(!valid && !valid_scalar, "'%.16s' reported as valid", c.hex);
+		Check(decoded == c.expected, "hex::Decode (%s) decoded '%.16s' wrong", hex::GetImplementationName(), c.hex);
+		Check(decoded_scalar == c.expected, "hex::DecodeScalar decoded '%.16s' wrong", c.hex);
+	}
+}
+
+void RegisterHexCodecTests(Registry &registry) {
+	registry.Add("hex/matches_scalar", HexCodecMatchesScalar);
+	registry.Add("hex/invalid_nybbles_are_zero", HexCodecInvalidNybblesAreZero);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,140 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<string>
+#include<thread>
+#include<vector>
+
+#include<stdlib.h>
+
+#include "common/Logger.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+// Remembers every message that reaches it. Only ever called from the
+// AsyncLogger's thread, so it doesn't need any locking.
+class CapturingLogger : public log::Logger {
+ public:
+	virtual void do_log(log::Level lvl, const char *fname, int line, const char *msg) {
+		if(lvl == log::Level::Warning) { // "dropped N log messages"
+			drop_reports++;
+		} else {
+			messages.push_back(msg);
+		}
+	}
+	virtual log::Level get_min_level() {
+		return log::Level::Debug;
+	}
+
+	std::vector<std::string> messages;
+	size_t drop_reports = 0;
+};
+
+// Messages from several threads at once all come out, each thread's in the
+// order it logged them, when there's room for all of them.
+static void AsyncPreservesOrder() {
+	const size_t threads = 4, per_thread = 512;
+	auto backend = std::make_shared<CapturingLogger>();
+	{
+		log::AsyncLogger logger(backend, threads * per_thread);
+		std::vector<std::thread> producers;
+		for(size_t t = 0; t < threads; t++) {
+			producers.emplace_back([&logger, t]() {
+				for(size_t i = 0; i < per_thread; i++) {
+					logger.do_log(log::Level::Info, __FILE__, __LINE__, (std::to_string(t) + " " + std::to_string(i)).c_str());
+				}
+			});
+		}
+		for(std::thread &p : producers) {
+			p.join();
+		}
+	}
+
+	Check(backend->drop_reports == 0, "%zu drop reports with room for every message", backend->drop_reports);
+	if(!Check(backend->messages.size() == threads * per_thread, "got %zu of %zu messages", backend->messages.size(), threads * per_thread)) {
+		return;
+	}
+	std::vector<size_t> next(threads, 0);
+	for(const std::string &msg : backend->messages) {
+		size_t t = strtoul(msg.c_str(), nullptr, 10);
+		size_t i = strtoul(msg.c_str() + msg.find(' ') + 1, nullptr, 10);
+		if(!Check(t < threads && i == next[t], "message '%s' out of order", msg.c_str())) {
+			return;
+		}
+		next[t]++;
+	}
+}
+
+// The ring wraps around many times over without losing or repeating
+// messages from a single producer.
+static void AsyncWrapsAround() {
+	const size_t count = 10000;
+	auto backend = std::make_shared<CapturingLogger>();
+	size_t delivered = 0, dropped = 0;
+	{
+		log::AsyncLogger logger(backend, 8);
+		for(size_t i = 0; i < count; i++) {
+			logger.do_log(log::Level::Info, __FILE__, __LINE__, std::to_string(i).c_str());
+		}
+	}
+	
+	size_t last = 0;
+	for(const std::string &msg : backend->messages) {
+		size_t i = strtoul(msg.c_str(), nullptr, 10);
+		if(!Check(delivered == 0 || i > last, "message %zu came after %zu", i, last)) {
+			return;
+		}
+		last = i;
+		delivered++;
+	}
+	dropped = count - delivered;
+	Check(backend->messages.size() >= 8, "only %zu messages delivered", backend->messages.size());
+	Check(dropped == 0 || backend->drop_reports > 0, "%zu messages dropped without a report", dropped);
+}
+
+// Messages are copied into fixed-size slots, so anything longer than a
+// formatted message can be is cut short instead of overflowing.
+static void AsyncTruncatesLongMessages() {
+	auto backend = std::make_shared<CapturingLogger>();
+	std::string msg(8192, 'a');
+	{
+		log::AsyncLogger logger(backend, 1);
+		logger.do_log(log::Level::Info, __FILE__, __LINE__, msg.c_str());
+	}
+	if(!Check(backend->messages.size() == 1, "got %zu messages", backend->messages.size())) {
+		return;
+	}
+	Check(backend->messages[0].size() > 0 && backend->messages[0].size() < msg.size(), "long message came out as %zu bytes", backend->messages[0].size());
+	Check(backend->messages[0] == msg.substr(0, backend->messages[0].size()), "long message was mangled");
+}
+
+void RegisterLoggerTests(Registry &registry) {
+	registry.Add("log/async_preserves_order", AsyncPreservesOrder);
+	registry.Add("log/async_wraps_around", AsyncWrapsAround);
+	registry.Add("log/async_truncates_long_messages", AsyncTruncatesLongMessages);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,127 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<algorithm>
+#include<random>
+
+#include<stdint.h>
+
+#include "MemorySnapshot.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using util::MemorySnapshot;
+
+static std::vector<uint8_t> MakePages(size_t size, std::mt19937 &rng) {
+	std::vector<uint8_t> data(size);
+	for(uint8_t &b : data) {
+		b = rng() % 4 ? 0 : rng();
+	}
+	return data;
+}
+
+// every byte position, since the hash works a word at a time
+static void HashSeesEveryByte() {
+	const size_t page = MemorySnapshot::PAGE_SIZE;
+	std::mt19937 rng(0x736e);
+	
+	std::vector<uint8_t> one = MakePages(page, rng);
+	uint64_t hash = MemorySnapshot::HashPage(one.data());
+	for(size_t i = 0; i < page; i++) {
+		one[i]^= 1 << (i % 8);
+		if(!Check(MemorySnapshot::HashPage(one.data()) != hash, "missed a change at byte %zu", i)) {
+			return;
+		}
+		one[i]^= 1 << (i % 8);
+	}
+}
+
+// Checks that Diff reports exactly the pages that were touched, across
+// several runs and unrecorded gaps, and that stopping early and resuming
+// loses nothing.
+static void DiffFindsChangedPages() {
+	const size_t page = MemorySnapshot::PAGE_SIZE;
+	std::mt19937 rng(0x736e);
+	
+	for(int round = 0; round < 200; round++) {
+		MemorySnapshot snapshot;
+		
+		// three runs of pages with gaps between them, recorded in chunks
+		std::vector<std::pair<uint64_t, std::vector<uint8_t>>> runs;
+		uint64_t addr = 0x8000000;
+		for(int r = 0; r < 3; r++) {
+			addr+= page * (rng() % 3);
+			runs.emplace_back(addr, MakePages(page * (1 + rng() % 16), rng));
+			addr+= runs.back().second.size();
+		}
+		for(auto &run : runs) {
+			size_t chunk = page * (1 + rng() % 4);
+			for(size_t offset = 0; offset < run.second.size(); offset+= chunk) {
+				snapshot.Record(run.first + offset, run.second.data() + offset, std::min(chunk, run.second.size() - offset));
+			}
+		}
+		
+		std::vector<uint64_t> expected;
+		for(auto &run : runs) {
+			for(size_t offset = 0; offset < run.second.size(); offset+= page) {
+				if(rng() % 4 == 0) {
+					run.second[offset + rng() % page]+= 1 + rng() % 255;
+					expected.push_back(run.first + offset);
+				}
+			}
+		}
+		// a page that wasn't there before counts as changed
+		std::vector<uint8_t> extra = MakePages(page, rng);
+		uint64_t extra_addr = runs.back().first + runs.back().second.size();
+		expected.push_back(extra_addr);
+
+		size_t max_changed = 1 + rng() % 8;
+		std::vector<uint64_t> changed;
+		auto diff = [&](uint64_t base, const std::vector<uint8_t> &data) {
+			size_t offset = 0;
+			while(offset < data.size()) {
+				std::vector<uint64_t> batch;
+				offset+= snapshot.Diff(base + offset, data.data() + offset, data.size() - offset, batch, max_changed);
+				changed.insert(changed.end(), batch.begin(), batch.end());
+			}
+		};
+		for(auto &run : runs) {
+			diff(run.first, run.second);
+		}
+		diff(extra_addr, extra);
+		
+		if(!Check(changed == expected, "Diff reported the wrong pages (round %d)", round)) {
+			return;
+		}
+	}
+}
+
+void RegisterMemorySnapshotTests(Registry &registry) {
+	registry.Add("snapshot/hash_sees_every_byte", HashSeesEveryByte);
+	registry.Add("snapshot/diff_finds_changed_pages", DiffFindsChangedPages);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,138 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<algorithm>
+#include<random>
+
+#include<stdint.h>
+
+#include "PatternScan.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using util::PatternScanner;
+
+// Mostly zeroes with some small integers and pointer-ish values mixed in,
+// like game heap.
+static std::vector<uint8_t> MakeMemory(size_t size, std::mt19937 &rng) {
+	std::vector<uint8_t> data(size, 0);
+	for(size_t i = 0; i + 8 <= size; i+= 8) {
+		switch(rng() % 4) {
+		case 0:
+			data[i] = rng() % 100;
+			break;
+		case 1:
+			for(size_t j = 0; j < 5; j++) {
+				data[i + j] = rng();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return data;
+}
+
+// Scans data the way the device does, in chunks that overlap by one byte
+// less than the pattern, and resuming after max_matches each time.
+static std::vector<uint64_t> ScanChunked(const PatternScanner &scanner, const std::vector<uint8_t> &data, uint64_t base, size_t chunk_size, size_t max_matches) {
+	std::vector<uint64_t> all;
+	size_t offset = 0;
+	while(offset < data.size()) {
+		size_t limit = std::min(chunk_size, data.size() - offset);
+		size_t size = std::min(data.size() - offset, limit + scanner.GetSize() - 1);
+		std::vector<uint64_t> matches;
+		offset+= scanner.Scan(data.data() + offset, size, limit, base + offset, matches, max_matches);
+		all.insert(all.end(), matches.begin(), matches.end());
+	}
+	return all;
+}
+
+// Checks Scan against ScanScalar on random patterns, masks, alignments, and
+// lengths, including scanning in chunks and stopping early.
+static void ScanMatchesScalar() {
+	std::mt19937 rng(0x7363);
+	for(int round = 0; round < 2000; round++) {
+		std::vector<uint8_t> data = MakeMemory(rng() % 1024, rng);
+		uint64_t base = 0x8000000 + rng() % 16;
+		
+		std::vector<uint8_t> pattern(1 + rng() % 9);
+		std::vector<uint8_t> mask;
+		if(data.size() >= pattern.size() && rng() % 2) {
+			// pick the pattern out of the data so there is something to find
+			size_t at = rng() % (data.size() - pattern.size() + 1);
+			std::copy(data.begin() + at, data.begin() + at + pattern.size(), pattern.begin());
+		} else {
+			for(uint8_t &b : pattern) {
+				b = rng() % 3 ? 0 : rng();
+			}
+		}
+		if(rng() % 2) {
+			mask.resize(pattern.size());
+			for(uint8_t &b : mask) {
+				uint32_t r = rng() % 4;
+				b = r == 0 ? 0 : r == 1 ? 0xf0 : 0xff;
+			}
+		}
+		size_t alignment = 1 << (rng() % 4);
+		
+		PatternScanner scanner(pattern, mask, alignment);
+		std::vector<uint64_t> matches, expected;
+		size_t limit = data.size() - std::min<size_t>(data.size(), rng() % 8);
+		size_t r = scanner.Scan(data.data(), data.size(), limit, base, matches, SIZE_MAX);
+		size_t r_expected = scanner.ScanScalar(data.data(), data.size(), limit, base, expected, SIZE_MAX);
+		if(!Check(matches == expected && r == r_expected, "Scan disagrees with scalar (round %d)", round)) {
+			return;
+		}
+
+		if(data.size() > 0) {
+			size_t chunk_size = 1 + rng() % 100;
+			size_t max_matches = 1 + rng() % 4;
+			std::vector<uint64_t> all_expected;
+			scanner.ScanScalar(data.data(), data.size(), data.size(), base, all_expected, SIZE_MAX);
+			if(!Check(ScanChunked(scanner, data, base, chunk_size, max_matches) == all_expected, "chunked Scan missed matches (round %d)", round)) {
+				return;
+			}
+		}
+	}
+}
+
+static void ParsePattern() {
+	std::vector<uint8_t> pattern, mask;
+	Check(util::ParsePattern("de ad?? e?", pattern, mask), "rejected a good pattern");
+	Check(pattern == std::vector<uint8_t>({0xde, 0xad, 0x00, 0xe0}), "wrong pattern bytes");
+	Check(mask == std::vector<uint8_t>({0xff, 0xff, 0x00, 0xf0}), "wrong mask bytes");
+	Check(!util::ParsePattern("de a", pattern, mask), "accepted a half byte");
+	Check(!util::ParsePattern("xx", pattern, mask), "accepted a bad digit");
+	Check(!util::ParsePattern("  ", pattern, mask), "accepted an empty pattern");
+}
+
+void RegisterPatternScanTests(Registry &registry) {
+	registry.Add("scan/matches_scalar", ScanMatchesScalar);
+	registry.Add("scan/parse_pattern", ParsePattern);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,119 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<map>
+#include<set>
+
+#include<stdint.h>
+#include<stdio.h>
+
+#include "tool/Profile.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using tool::Profile;
+
+static const std::vector<Profile::Module> MODULES = {
+	{"lib", 0x2000000, 0x8000},
+	{"main", 0x1000000, 0x10000},
+};
+
+static const std::vector<uint64_t> BATCH = {
+	// tick, pause, threads
+	100, 10, 2,
+	// thread 1: no lr, pc in main, returns into lib and main
+	1, 0, 3, 0x1000100, 0x2000014, 0x1000208,
+	// thread 2: pc outside any module, lr in main
+	2, 0x1000300, 1, 0x3000000,
+	300, 30, 1,
+	1, 0, 3, 0x1000100, 0x2000014, 0x1000208,
+};
+
+// folded stack output for a hand-built batch with and without the link
+// register
+static void FoldsStacks() {
+	Profile plain(MODULES);
+	Profile with_lr(MODULES, true);
+	if(!Check(plain.AddBatch(BATCH) && with_lr.AddBatch(BATCH), "rejected a good batch")) {
+		return;
+	}
+	std::map<std::string, uint64_t> expected_plain = {
+		{"main+0x204;lib+0x10;main+0x100", 2},
+		{"0x3000000", 1},
+	};
+	std::map<std::string, uint64_t> expected_lr = {
+		{"main+0x204;lib+0x10;main+0x100", 2},
+		{"main+0x2fc;0x3000000", 1},
+	};
+	Check(plain.GetStacks() == expected_plain, "folded stacks wrong");
+	Check(with_lr.GetStacks() == expected_lr, "folded stacks wrong with link register");
+	Check(plain.samples == 2 && plain.thread_samples == 3, "sample counts wrong");
+	Check(plain.total_pause_ticks == 40 && plain.max_pause_ticks == 30, "pause statistics wrong");
+	Check(plain.first_tick == 100 && plain.last_tick == 300, "tick range wrong");
+}
+
+// every truncation of a batch that doesn't fall on a sample boundary is
+// rejected without touching the profile
+static void RejectsTruncatedBatches() {
+	std::set<size_t> boundaries = {0, 13, BATCH.size()};
+	for(size_t length = 0; length <= BATCH.size(); length++) {
+		Profile profile(MODULES);
+		bool ok = profile.AddBatch(std::vector<uint64_t>(BATCH.begin(), BATCH.begin() + length));
+		Check(ok == (boundaries.count(length) > 0), "%s a batch truncated to %zu words", ok ? "accepted" : "rejected", length);
+		Check(ok || (profile.samples == 0 && profile.GetStacks().empty()), "kept part of a batch truncated to %zu words", length);
+	}
+}
+
+// recordings read back the same as they were written
+static void RecordingRoundTrips() {
+	FILE *f = tmpfile();
+	if(!Check(f != nullptr, "could not create a temporary file")) {
+		return;
+	}
+	std::vector<std::vector<uint64_t>> batches = {BATCH, {}, BATCH};
+	bool written = tool::WriteProfileHeader(f, MODULES);
+	for(auto &b : batches) {
+		written = written && tool::WriteProfileBatch(f, b);
+	}
+	rewind(f);
+	std::vector<Profile::Module> read_modules;
+	std::vector<std::vector<uint64_t>> read_batches;
+	if(Check(written, "failed to write recording") &&
+		 Check(tool::ReadProfileRecording(f, read_modules, read_batches), "failed to read recording")) {
+		Check(read_batches == batches, "batches didn't round trip");
+		Check(read_modules.size() == MODULES.size() && read_modules[1].name == "main" &&
+					read_modules[1].base == 0x1000000 && read_modules[1].size == 0x10000, "modules didn't round trip");
+	}
+	fclose(f);
+}
+
+void RegisterProfileTests(Registry &registry) {
+	registry.Add("profile/folds_stacks", FoldsStacks);
+	registry.Add("profile/rejects_truncated_batches", RejectsTruncatedBatches);
+	registry.Add("profile/recording_round_trips", RecordingRoundTrips);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
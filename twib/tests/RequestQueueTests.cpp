@@ -0,0 +1,346 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<algorithm>
+#include<deque>
+#include<random>
+
+#include<stdint.h>
+#include<string.h>
+
+#include "Buffer.hpp"
+#include "SegmentedBuffer.hpp"
+#include "../../twili/bridge/tcp/RequestQueue.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using bridge::tcp::RequestQueue;
+using Job = RequestQueue::Job;
+
+struct Message {
+	protocol::MessageHeader mh;
+	std::vector<uint8_t> payload;
+	std::vector<uint32_t> object_ids;
+
+	void Write(util::SegmentedBuffer &buffer) const {
+		buffer.Write(mh);
+		buffer.Write(payload);
+		buffer.Write(object_ids);
+	}
+};
+
+static Message MakeMessage(uint32_t tag, size_t payload_size, size_t object_count, std::mt19937 &rng) {
+	Message m;
+	memset(&m.mh, 0, sizeof(m.mh));
+	m.mh.device_id = 0;
+	m.mh.object_id = rng() % 16;
+	m.mh.command_id = rng() % 32;
+	m.mh.tag = tag;
+	m.mh.payload_size = payload_size;
+	m.mh.object_count = object_count;
+	m.payload.resize(payload_size);
+	for(uint8_t &b : m.payload) {
+		b = rng();
+	}
+	for(size_t i = 0; i < object_count; i++) {
+		m.object_ids.push_back(rng());
+	}
+	return m;
+}
+
+// Folds jobs back into messages the way the main thread runs them, checking
+// that they come in Begin, Flush..., Finalize order.
+class Reassembler {
+ public:
+	void Run(std::deque<Job> &jobs) {
+		for(Job &job : jobs) {
+			switch(job.type) {
+			case Job::Type::BeginProcessingCommand:
+				Check(!in_message, "began a command inside another");
+				in_message = true;
+				current = Message();
+				current.mh = job.mh;
+				break;
+			case Job::Type::FlushReceiveBuffer:
+				Check(in_message, "payload outside of a command");
+				Check(!job.data.empty(), "empty payload job");
+				current.payload.insert(current.payload.end(), job.data.begin(), job.data.end());
+				break;
+			case Job::Type::FinalizeCommand:
+				Check(in_message, "finalized a command that didn't begin");
+				in_message = false;
+				current.object_ids = job.object_ids;
+				messages.push_back(std::move(current));
+				break;
+			}
+		}
+		jobs.clear();
+	}
+
+	bool in_message = false;
+	Message current;
+	std::vector<Message> messages;
+};
+
+static bool SameMessage(const Message &a, const Message &b) {
+	return memcmp(&a.mh, &b.mh, sizeof(a.mh)) == 0 && a.payload == b.payload && a.object_ids == b.object_ids;
+}
+
+// A header that trickles in a byte at a time is only turned into a job once
+// it's complete.
+static void SplitHeader() {
+	std::mt19937 rng(0x7271);
+	Message m = MakeMessage(1, 0, 0, rng);
+	const uint8_t *bytes = (const uint8_t*) &m.mh;
+	
+	RequestQueue queue;
+	util::SegmentedBuffer input;
+	for(size_t i = 0; i + 1 < sizeof(m.mh); i++) {
+		input.Write(bytes + i, 1);
+		Check(!queue.Ingest(input), "queued a job from %zu header bytes", i + 1);
+		Check(queue.IsEmpty(), "not empty after %zu header bytes", i + 1);
+	}
+	input.Write(bytes + sizeof(m.mh) - 1, 1);
+	Check(queue.Ingest(input), "didn't queue a job for a complete header");
+	Check(input.ReadAvailable() == 0, "left input behind");
+
+	std::deque<Job> jobs;
+	queue.Take(jobs);
+	Reassembler r;
+	r.Run(jobs);
+	if(Check(r.messages.size() == 1, "got %zu messages", r.messages.size())) {
+		Check(SameMessage(r.messages[0], m), "message didn't survive");
+	}
+}
+
+// Payloads bigger than a block straddle segment boundaries, and ingesting
+// without taking coalesces them into a single job.
+static void PayloadAcrossSegments() {
+	std::mt19937 rng(0x7272);
+	Message m = MakeMessage(2, util::SegmentedBuffer::BLOCK_SIZE * 2 + 123, 0, rng);
+	util::SegmentedBuffer input;
+	m.Write(input);
+	
+	RequestQueue queue;
+	Check(queue.Ingest(input), "didn't queue anything");
+	Check(input.ReadAvailable() == 0, "left input behind");
+	Check(queue.GetQueuedSize() == m.payload.size(), "queued size %zu, expected %zu", queue.GetQueuedSize(), m.payload.size());
+
+	std::deque<Job> jobs;
+	queue.Take(jobs);
+	Check(queue.GetQueuedSize() == 0, "queued size not reset by Take");
+	if(Check(jobs.size() == 3, "payload split into %zu jobs", jobs.size() - 2)) {
+		Check(jobs[1].type == Job::Type::FlushReceiveBuffer && jobs[1].data == m.payload, "coalesced payload wrong");
+	}
+	Reassembler r;
+	r.Run(jobs);
+	if(Check(r.messages.size() == 1, "got %zu messages", r.messages.size())) {
+		Check(SameMessage(r.messages[0], m), "message didn't survive");
+	}
+}
+
+// The main thread hands a queued payload to the handler's buffer without
+// copying it a second time, unless the handler left something unread.
+static void PayloadHandoff() {
+	std::mt19937 rng(0x7276);
+	Message m = MakeMessage(6, 300, 0, rng);
+	util::SegmentedBuffer input;
+	m.Write(input);
+
+	RequestQueue queue;
+	queue.Ingest(input);
+	std::deque<Job> jobs;
+	queue.Take(jobs);
+	if(!Check(jobs.size() == 3 && jobs[1].type == Job::Type::FlushReceiveBuffer, "unexpected jobs")) {
+		return;
+	}
+
+	util::Buffer payload_buffer;
+	const uint8_t *storage = jobs[1].data.data();
+	Check(payload_buffer.Adopt(std::move(jobs[1].data)), "adopt failed");
+	Check(payload_buffer.Read() == storage, "payload was copied");
+	Check(payload_buffer.ReadAvailable() == m.payload.size(), "adopted %zu bytes", payload_buffer.ReadAvailable());
+
+	std::vector<uint8_t> head(10);
+	payload_buffer.Read(head);
+	std::vector<uint8_t> more = {1, 2, 3};
+	Check(payload_buffer.Adopt(std::move(more)), "append failed");
+	std::vector<uint8_t> expected(m.payload.begin() + 10, m.payload.end());
+	expected.insert(expected.end(), {1, 2, 3});
+	std::vector<uint8_t> rest(payload_buffer.ReadAvailable());
+	payload_buffer.Read(rest);
+	Check(rest == expected, "unread bytes lost on append");
+}
+
+// Object IDs follow the payload and the command isn't finalized until all
+// of them are in, even when the payload is empty.
+static void ObjectIdTail() {
+	std::mt19937 rng(0x7273);
+	for(size_t payload_size : {0, 17}) {
+		Message m = MakeMessage(3, payload_size, 3, rng);
+		util::SegmentedBuffer full;
+		m.Write(full);
+		std::vector<uint8_t> bytes(full.ReadAvailable());
+		full.Read(bytes.data(), bytes.size());
+
+		size_t tail = bytes.size() - m.object_ids.size() * sizeof(uint32_t);
+		RequestQueue queue;
+		util::SegmentedBuffer input;
+		input.Write(bytes.data(), tail);
+		queue.Ingest(input);
+		std::deque<Job> jobs;
+		Reassembler r;
+		for(size_t i = tail; i < bytes.size(); i++) {
+			queue.Take(jobs);
+			r.Run(jobs);
+			Check(r.messages.empty(), "finalized with %zu of %zu object id bytes", i - tail, bytes.size() - tail);
+			input.Write(bytes.data() + i, 1);
+			queue.Ingest(input);
+		}
+		queue.Take(jobs);
+		r.Run(jobs);
+		if(Check(r.messages.size() == 1, "got %zu messages", r.messages.size())) {
+			Check(SameMessage(r.messages[0], m), "message with %zu byte payload didn't survive", payload_size);
+		}
+	}
+}
+
+// A budget smaller than a coalesced payload still moves the whole job, and
+// the queued size drops by exactly what was taken.
+static void TakeBudget() {
+	std::mt19937 rng(0x7274);
+	std::vector<Message> messages = {
+		MakeMessage(4, 1000, 0, rng),
+		MakeMessage(5, 0, 1, rng),
+		MakeMessage(6, 500, 2, rng),
+	};
+	util::SegmentedBuffer input;
+	for(const Message &m : messages) {
+		m.Write(input);
+	}
+	RequestQueue queue;
+	queue.Ingest(input);
+	Check(queue.GetQueuedSize() == 1500, "queued size %zu after ingest", queue.GetQueuedSize());
+
+	std::deque<Job> jobs;
+	queue.Take(jobs, 1);
+	Check(jobs.size() == 1 && jobs[0].type == Job::Type::BeginProcessingCommand, "budget of 1 took %zu jobs", jobs.size());
+	Check(queue.GetQueuedSize() == 1500, "queued size %zu after taking a header", queue.GetQueuedSize());
+	
+	queue.Take(jobs, 10);
+	Check(jobs.size() == 2 && jobs[1].data.size() == 1000, "small budget didn't take the whole payload");
+	Check(queue.GetQueuedSize() == 500, "queued size %zu after taking a payload", queue.GetQueuedSize());
+
+	// headers and finalizers count as a byte each
+	queue.Take(jobs, 3);
+	Check(jobs.size() == 5, "budget of 3 took %zu jobs", jobs.size() - 2);
+	Check(queue.GetQueuedSize() == 500, "queued size %zu before the last payload", queue.GetQueuedSize());
+
+	// a budget of 0 still makes progress
+	queue.Take(jobs, 0);
+	Check(jobs.size() == 6, "budget of 0 took %zu jobs", jobs.size() - 5);
+	queue.Take(jobs, 0);
+	Check(jobs.size() == 7 && jobs[6].data.size() == 500, "budget of 0 didn't take the last payload");
+	Check(queue.GetQueuedSize() == 0, "queued size %zu after taking every payload", queue.GetQueuedSize());
+	queue.Take(jobs, SIZE_MAX);
+	Check(queue.IsEmpty(), "not empty after taking everything");
+
+	Reassembler r;
+	r.Run(jobs);
+	if(Check(r.messages.size() == messages.size(), "got %zu messages", r.messages.size())) {
+		for(size_t i = 0; i < messages.size(); i++) {
+			Check(SameMessage(r.messages[i], messages[i]), "message %zu didn't survive", i);
+		}
+	}
+}
+
+// Random messages fed in random chunks and taken with random budgets, as
+// the socket and main threads would, with the queued size checked against
+// the jobs left in the queue all along.
+static void RandomStream() {
+	std::mt19937 rng(0x7275);
+	std::vector<Message> messages;
+	util::SegmentedBuffer stream;
+	for(uint32_t tag = 0; tag < 200; tag++) {
+		size_t payload_size = rng() % 4 ? rng() % 300 : rng() % (util::SegmentedBuffer::BLOCK_SIZE * 2);
+		messages.push_back(MakeMessage(tag, payload_size, rng() % 4, rng));
+		messages.back().Write(stream);
+	}
+	std::vector<uint8_t> bytes(stream.ReadAvailable());
+	stream.Read(bytes.data(), bytes.size());
+
+	RequestQueue queue;
+	util::SegmentedBuffer input;
+	std::deque<Job> jobs;
+	Reassembler r;
+	size_t taken_payload = 0;
+	size_t offset = 0;
+	while(offset < bytes.size() || !queue.IsEmpty()) {
+		if(offset < bytes.size()) {
+			size_t chunk = std::min(bytes.size() - offset, (size_t) (1 + rng() % 70000));
+			input.Write(bytes.data() + offset, chunk);
+			offset+= chunk;
+			queue.Ingest(input);
+		}
+		size_t before = queue.GetQueuedSize();
+		queue.Take(jobs, rng() % 4096);
+		size_t moved = 0;
+		for(Job &job : jobs) {
+			moved+= job.data.size();
+		}
+		if(!Check(before - queue.GetQueuedSize() == moved, "queued size dropped by %zu, but %zu payload bytes were taken", before - queue.GetQueuedSize(), moved)) {
+			return;
+		}
+		taken_payload+= moved;
+		r.Run(jobs);
+	}
+	Check(input.ReadAvailable() == 0, "left %zu bytes of input behind", input.ReadAvailable());
+	Check(queue.GetQueuedSize() == 0, "queued size %zu when empty", queue.GetQueuedSize());
+	
+	size_t total_payload = 0;
+	for(const Message &m : messages) {
+		total_payload+= m.payload.size();
+	}
+	Check(taken_payload == total_payload, "took %zu payload bytes, expected %zu", taken_payload, total_payload);
+	if(Check(r.messages.size() == messages.size(), "got %zu messages, expected %zu", r.messages.size(), messages.size())) {
+		for(size_t i = 0; i < messages.size(); i++) {
+			if(!Check(SameMessage(r.messages[i], messages[i]), "message %zu didn't survive", i)) {
+				return;
+			}
+		}
+	}
+}
+
+void RegisterRequestQueueTests(Registry &registry) {
+	registry.Add("tcp_bridge/split_header", SplitHeader);
+	registry.Add("tcp_bridge/payload_across_segments", PayloadAcrossSegments);
+	registry.Add("tcp_bridge/payload_handoff", PayloadHandoff);
+	registry.Add("tcp_bridge/object_id_tail", ObjectIdTail);
+	registry.Add("tcp_bridge/take_budget", TakeBudget);
+	registry.Add("tcp_bridge/random_stream", RandomStream);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,249 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<algorithm>
+#include<deque>
+#include<random>
+
+#include<stdint.h>
+#include<string.h>
+
+#include "../../twili/bridge/usb/RequestSequencer.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using bridge::usb::RequestSequencer;
+using Step = RequestSequencer::Step;
+using ResponseStart = RequestSequencer::ResponseStart;
+
+static const size_t DATA_BUFFER_SIZE = 0x1000;
+
+static protocol::MessageHeader MakeHeader(uint32_t tag, uint64_t payload_size, uint32_t object_count) {
+	protocol::MessageHeader mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.tag = tag;
+	mh.payload_size = payload_size;
+	mh.object_count = object_count;
+	return mh;
+}
+
+// Receives payload the way USBBridge::RequestReader does, one data buffer at
+// a time, until the sequencer asks for something else.
+static size_t ReceivePayload(RequestSequencer &sequencer) {
+	size_t received = 0;
+	while(sequencer.GetNextStep() == Step::ReceivePayload) {
+		size_t size = sequencer.GetPayloadTransferSize(DATA_BUFFER_SIZE);
+		if(!Check(size > 0 && size <= DATA_BUFFER_SIZE, "asked for a %zu byte transfer", size) ||
+			 !Check(sequencer.PayloadReceived(size), "rejected a transfer it asked for")) {
+			break;
+		}
+		received+= size;
+	}
+	return received;
+}
+
+// A handler that responds as soon as it has the header (an error, or a
+// command that doesn't need its input) discards the rest of its request,
+// but the reader still has to consume all of it before the next header.
+static void EarlyResponse() {
+	RequestSequencer sequencer;
+	int response;
+	
+	sequencer.BeginRequest(MakeHeader(1, DATA_BUFFER_SIZE * 2 + 5, 2), &response);
+	Check(sequencer.IsHandlingInput(), "not handling input for a new request");
+	Check(sequencer.GetNextStep() == Step::ReceivePayload, "didn't ask for payload");
+	Check(sequencer.BeginResponse(&response) == ResponseStart::Early, "response wasn't recognized as early");
+	Check(!sequencer.IsHandlingInput(), "still handling input after responding");
+	Check(sequencer.GetTransmittingResponse() == &response, "early response isn't transmitting");
+	sequencer.EndResponse(&response);
+	
+	Check(ReceivePayload(sequencer) == DATA_BUFFER_SIZE * 2 + 5, "didn't consume the discarded payload");
+	Check(sequencer.GetNextStep() == Step::ReceiveObjects, "didn't ask for object IDs");
+	sequencer.ObjectsReceived();
+	Check(sequencer.GetNextStep() == Step::Finalize, "didn't finalize");
+	sequencer.EndRequest();
+	Check(sequencer.GetNextStep() == Step::ReceiveHeader, "didn't ask for the next header");
+}
+
+// A response to an earlier request that begins in the middle of another
+// request's payload leaves that request alone.
+static void AsyncResponseMidPayload() {
+	RequestSequencer sequencer;
+	int earlier, current;
+	
+	sequencer.BeginRequest(MakeHeader(1, 0, 0), &earlier);
+	Check(sequencer.GetNextStep() == Step::Finalize, "didn't finalize a request without payload");
+	sequencer.EndRequest();
+
+	sequencer.BeginRequest(MakeHeader(2, DATA_BUFFER_SIZE * 3, 0), &current);
+	Check(sequencer.PayloadReceived(DATA_BUFFER_SIZE), "rejected the first chunk");
+	Check(sequencer.BeginResponse(&earlier) == ResponseStart::Ok, "earlier response was mistaken for an early one");
+	Check(sequencer.IsHandlingInput(), "stopped handling input for another request's response");
+	Check(sequencer.GetNextStep() == Step::ReceivePayload, "stopped receiving payload");
+	Check(sequencer.PayloadReceived(DATA_BUFFER_SIZE), "rejected a chunk while another response transmits");
+	sequencer.EndResponse(&earlier);
+	Check(sequencer.GetTransmittingResponse() == nullptr, "finished response still transmitting");
+	
+	Check(ReceivePayload(sequencer) == DATA_BUFFER_SIZE, "lost track of the payload");
+	Check(!sequencer.PayloadReceived(1), "accepted a transfer past the payload");
+	Check(sequencer.IsHandlingInput(), "stopped handling input at the end of the payload");
+	Check(sequencer.GetNextStep() == Step::Finalize, "didn't finalize");
+	sequencer.EndRequest();
+	Check(!sequencer.IsHandlingInput(), "still handling input after the request ended");
+
+	// the current request's response, now that it's been received
+	Check(sequencer.BeginResponse(&current) == ResponseStart::Ok, "response after receipt was mistaken for an early one");
+	sequencer.EndResponse(&current);
+}
+
+// Only one response can hold the response buffers. A second one trying to
+// begin is what makes USBBridge::ResponseState::SendHeader abort with
+// TWILI_ERR_FATAL_BRIDGE_STATE. The buffers are handed back when the
+// response is finalized, or when it's destroyed partway through.
+static void TransmittingHandoff() {
+	RequestSequencer sequencer;
+	int a, b, c;
+
+	Check(sequencer.BeginResponse(&a) == ResponseStart::Ok, "first response didn't begin");
+	Check(sequencer.BeginResponse(&b) == ResponseStart::Busy, "second response began while the first was transmitting");
+	Check(sequencer.GetTransmittingResponse() == &a, "busy response took over the buffers");
+	sequencer.EndResponse(&b); // b is destroyed without having sent anything
+	Check(sequencer.GetTransmittingResponse() == &a, "ending another response released the buffers");
+	sequencer.EndResponse(&a);
+	
+	Check(sequencer.BeginResponse(&b) == ResponseStart::Ok, "response didn't begin after the buffers were handed back");
+	sequencer.EndResponse(&b); // destroyed partway through
+	Check(sequencer.BeginResponse(&c) == ResponseStart::Ok, "response didn't begin after the last one was destroyed");
+	sequencer.EndResponse(&c);
+	Check(sequencer.GetTransmittingResponse() == nullptr, "buffers still held");
+}
+
+// Many requests with random payloads, each answered at a random later point
+// (sometimes before it has been fully received), with responses transmitted
+// one at a time and sometimes interleaved with incoming payload.
+static void RandomInterleaving() {
+	struct Request {
+		protocol::MessageHeader mh;
+		size_t received = 0;
+		bool responded = false;
+		bool responded_early = false;
+	};
+	
+	std::mt19937 rng(0x7573);
+	std::deque<Request> requests;
+	for(uint32_t tag = 0; tag < 500; tag++) {
+		Request r;
+		r.mh = MakeHeader(tag, rng() % 3 ? rng() % (DATA_BUFFER_SIZE * 4) : 0, rng() % 3);
+		requests.push_back(r);
+	}
+	
+	RequestSequencer sequencer;
+	std::vector<Request*> pending; // received or being received, not yet responded to
+	Request *transmitting = nullptr;
+	Request *receiving = nullptr;
+	size_t next = 0;
+	size_t early_responses = 0;
+
+	// Starts or finishes a response, the way handlers completing on the
+	// event loop would.
+	auto poke_responses = [&]() {
+		if(transmitting) {
+			if(rng() % 2) {
+				sequencer.EndResponse(transmitting);
+				transmitting = nullptr;
+			}
+		} else if(!pending.empty() && rng() % 3 == 0) {
+			size_t i = rng() % pending.size();
+			Request *r = pending[i];
+			ResponseStart start = sequencer.BeginResponse(r);
+			bool early = r == receiving;
+			Check(start == (early ? ResponseStart::Early : ResponseStart::Ok), "response %u started wrong", r->mh.tag);
+			r->responded = true;
+			r->responded_early = early;
+			if(early) {
+				early_responses++;
+			}
+			pending.erase(pending.begin() + i);
+			transmitting = r;
+		}
+		if(transmitting && !pending.empty()) {
+			Check(sequencer.BeginResponse(pending[rng() % pending.size()]) == ResponseStart::Busy, "second response began");
+		}
+	};
+	
+	while(next < requests.size() || !pending.empty() || transmitting) {
+		poke_responses();
+		switch(sequencer.GetNextStep()) {
+		case Step::ReceiveHeader:
+			if(next < requests.size()) {
+				receiving = &requests[next++];
+				sequencer.BeginRequest(receiving->mh, receiving);
+				pending.push_back(receiving);
+			}
+			break;
+		case Step::ReceivePayload: {
+			size_t remaining = receiving->mh.payload_size - receiving->received;
+			size_t size = sequencer.GetPayloadTransferSize(DATA_BUFFER_SIZE);
+			Check(size == std::min(remaining, DATA_BUFFER_SIZE), "asked for %zu bytes with %zu remaining", size, remaining);
+			// the host may send short transfers
+			size = 1 + rng() % size;
+			Check(sequencer.PayloadReceived(size), "rejected a transfer");
+			receiving->received+= size;
+			// input only goes to the handler until its response begins
+			if(sequencer.IsHandlingInput()) {
+				Check(!receiving->responded, "handling input for request %u after its response began", receiving->mh.tag);
+			} else {
+				Check(receiving->responded_early, "discarded input for request %u", receiving->mh.tag);
+			}
+			break; }
+		case Step::ReceiveObjects:
+			Check(receiving->received == receiving->mh.payload_size, "asked for object IDs before the end of the payload");
+			sequencer.ObjectsReceived();
+			break;
+		case Step::Finalize:
+			Check(receiving->received == receiving->mh.payload_size, "finalized request %u before the end of its payload", receiving->mh.tag);
+			sequencer.EndRequest();
+			receiving = nullptr;
+			break;
+		}
+	}
+	Check(sequencer.GetTransmittingResponse() == nullptr, "buffers still held at the end");
+	Check(early_responses > 0, "never responded early");
+	for(const Request &r : requests) {
+		if(!Check(r.responded, "request %u never responded to", r.mh.tag)) {
+			break;
+		}
+	}
+}
+
+void RegisterRequestSequencerTests(Registry &registry) {
+	registry.Add("usb_bridge/early_response", EarlyResponse);
+	registry.Add("usb_bridge/async_response_mid_payload", AsyncResponseMidPayload);
+	registry.Add("usb_bridge/transmitting_handoff", TransmittingHandoff);
+	registry.Add("usb_bridge/random_interleaving", RandomInterleaving);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
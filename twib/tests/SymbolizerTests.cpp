@@ -0,0 +1,136 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<string>
+#include<vector>
+
+#include<stdint.h>
+#include<stdio.h>
+#include<string.h>
+
+#include "tool/Symbolizer.hpp"
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+using tool::Symbolizer;
+
+static const char *ELF_PATH = "twib_tests_symbols.elf";
+
+template<typename T>
+static void Append(std::vector<uint8_t> &out, const T &value) {
+	out.insert(out.end(), (const uint8_t*) &value, (const uint8_t*) &value + sizeof(value));
+}
+
+// Writes a minimal ELF with just a symbol table: a function with a size, a
+// function without one, a data object, and an undefined function.
+static bool WriteTestElf() {
+	const char strings[] = "\0_Z3foov\0bar\0data\0ext";
+	struct Sym { uint32_t name; uint8_t info, other; uint16_t shndx; uint64_t value, size; };
+	const Sym syms[] = {
+		{0, 0, 0, 0, 0, 0},
+		{1, 0x12, 0, 1, 0x100, 0x20}, // _Z3foov, global func
+		{9, 0x12, 0, 1, 0x200, 0}, // bar
+		{13, 0x11, 0, 1, 0x180, 0x10}, // data, global object
+		{18, 0x12, 0, 0, 0, 0}, // ext, undefined
+	};
+	struct Shdr { uint32_t name, type; uint64_t flags, addr, offset, size; uint32_t link, info; uint64_t addralign, entsize; };
+	
+	uint64_t strtab_offset = 0x40;
+	uint64_t symtab_offset = strtab_offset + sizeof(strings);
+	symtab_offset = (symtab_offset + 7) & ~7ull;
+	uint64_t shdr_offset = symtab_offset + sizeof(syms);
+
+	std::vector<uint8_t> elf;
+	const uint8_t ident[16] = {0x7f, 'E', 'L', 'F', 2, 1, 1};
+	elf.insert(elf.end(), ident, ident + sizeof(ident));
+	Append<uint16_t>(elf, 3); // ET_DYN
+	Append<uint16_t>(elf, 183); // EM_AARCH64
+	Append<uint32_t>(elf, 1);
+	Append<uint64_t>(elf, 0); // entry
+	Append<uint64_t>(elf, 0); // phoff
+	Append<uint64_t>(elf, shdr_offset);
+	Append<uint32_t>(elf, 0); // flags
+	for(uint16_t half : {0x40, 0x38, 0, 0x40, 3, 0}) { // ehsize, phentsize, phnum, shentsize, shnum, shstrndx
+		Append<uint16_t>(elf, half);
+	}
+	elf.insert(elf.end(), strings, strings + sizeof(strings));
+	elf.resize(symtab_offset);
+	for(const Sym &sym : syms) {
+		Append(elf, sym);
+	}
+	Append(elf, Shdr {});
+	Append(elf, Shdr {0, 2, 0, 0, symtab_offset, sizeof(syms), 2, 1, 8, sizeof(Sym)}); // SHT_SYMTAB
+	Append(elf, Shdr {0, 3, 0, 0, strtab_offset, sizeof(strings), 0, 0, 1, 0}); // SHT_STRTAB
+
+	FILE *f = fopen(ELF_PATH, "wb");
+	if(!f) {
+		return false;
+	}
+	bool ok = fwrite(elf.data(), 1, elf.size(), f) == elf.size();
+	return fclose(f) == 0 && ok;
+}
+
+// Addresses are named by function where the module has symbols, falling
+// back to module+offset and then the bare address.
+static void NamesFunctions() {
+	if(!Check(WriteTestElf(), "could not write '%s'", ELF_PATH)) {
+		return;
+	}
+	Symbolizer symbolizer({
+		{"main", 0x8000000, 0x1000, ELF_PATH},
+		{"lib", 0x9000000, 0x1000},
+	});
+	remove(ELF_PATH);
+
+#if defined(__GNUC__)
+	const std::string foo = "foo()";
+#else
+	const std::string foo = "_Z3foov";
+#endif
+	struct {
+		uint64_t addr;
+		std::string expected;
+	} cases[] = {
+		{0x8000100, foo + "+0x0"},
+		{0x800011c, foo + "+0x1c"},
+		{0x8000130, "main+0x130"}, // past the end of foo
+		{0x8000184, "main+0x184"}, // data isn't a function
+		{0x8000250, "bar+0x50"}, // no size, so anything up to the next symbol
+		{0x8000010, "main+0x10"}, // before the first symbol
+		{0x9000010, "lib+0x10"}, // no symbols for this module
+		{0xa000000, "0xa000000"},
+	};
+	for(auto &c : cases) {
+		std::string name = symbolizer.Symbolize(c.addr);
+		Check(name == c.expected, "0x%llx named '%s', expected '%s'", (unsigned long long) c.addr, name.c_str(), c.expected.c_str());
+	}
+}
+
+void RegisterSymbolizerTests(Registry &registry) {
+	registry.Add("symbolizer/names_functions", NamesFunctions);
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
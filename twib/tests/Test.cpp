@@ -0,0 +1,66 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Test.hpp"
+
+#include<exception>
+
+#include<stdarg.h>
+#include<stdio.h>
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+static const Test *current_test = nullptr;
+static size_t failures = 0;
+
+void Registry::Add(std::string name, std::function<void()> func) {
+	tests.push_back(Test {name, func});
+}
+
+bool Check(bool condition, const char *format, ...) {
+	if(!condition) {
+		va_list args;
+		va_start(args, format);
+		fprintf(stderr, "%s: ", current_test ? current_test->name.c_str() : "?");
+		vfprintf(stderr, format, args);
+		fprintf(stderr, "\n");
+		va_end(args);
+		failures++;
+	}
+	return condition;
+}
+
+size_t Run(const Test &test) {
+	current_test = &test;
+	failures = 0;
+	try {
+		test.func();
+	} catch(std::exception &e) {
+		Check(false, "uncaught exception: %s", e.what());
+	}
+	current_test = nullptr;
+	return failures;
+}
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,72 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<functional>
+#include<string>
+#include<vector>
+
+#if defined(__GNUC__)
+#define TWIB_PRINTF_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define TWIB_PRINTF_FORMAT(fmt, args)
+#endif
+
+namespace twili {
+namespace twib {
+namespace tests {
+
+struct Test {
+	std::string name;
+	std::function<void()> func;
+};
+
+class Registry {
+ public:
+	void Add(std::string name, std::function<void()> func);
+
+	std::vector<Test> tests;
+};
+
+// Reports a failure against the running test if `condition` is false, then
+// carries on, so that one run shows every check that fails instead of just
+// the first. Returns `condition` so that callers can bail out of checks that
+// depend on it.
+bool Check(bool condition, const char *format, ...) TWIB_PRINTF_FORMAT(2, 3);
+
+// Runs one test and returns the number of checks that failed. An exception
+// escaping the test counts as a failure.
+size_t Run(const Test &test);
+
+// Each test source file registers its tests with one of these.
+void RegisterDaemonTests(Registry &registry);
+void RegisterPatternScanTests(Registry &registry);
+void RegisterMemorySnapshotTests(Registry &registry);
+void RegisterProfileTests(Registry &registry);
+void RegisterSymbolizerTests(Registry &registry);
+void RegisterRequestQueueTests(Registry &registry);
+void RegisterRequestSequencerTests(Registry &registry);
+void RegisterLoggerTests(Registry &registry);
+void RegisterHexCodecTests(Registry &registry); // only built with TWIB_GDB_ENABLED
+
+} // namespace tests
+} // namespace twib
+} // namespace twili
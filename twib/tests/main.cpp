@@ -0,0 +1,88 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include<string>
+#include<vector>
+
+#include<stdio.h>
+
+#include<CLI/CLI.hpp>
+
+#include "common/config.hpp"
+#include "common/Logger.hpp"
+
+#include "Test.hpp"
+
+using namespace twili;
+using namespace twili::twib;
+
+int main(int argc, char *argv[]) {
+	CLI::App app {"Unit tests for twib and twibd internals"};
+
+	std::string filter;
+	app.add_option("-f,--filter", filter, "Only run tests whose name contains this string");
+
+	bool list = false;
+	app.add_flag("-l,--list", list, "List tests instead of running them");
+
+	try {
+		app.parse(argc, argv);
+	} catch(const CLI::ParseError &e) {
+		return app.exit(e);
+	}
+
+	log::add_log(std::make_shared<log::PrettyFileLogger>(stderr, log::Level::Error));
+	
+	tests::Registry registry;
+	tests::RegisterDaemonTests(registry);
+	tests::RegisterPatternScanTests(registry);
+	tests::RegisterMemorySnapshotTests(registry);
+	tests::RegisterProfileTests(registry);
+	tests::RegisterSymbolizerTests(registry);
+	tests::RegisterRequestQueueTests(registry);
+	tests::RegisterRequestSequencerTests(registry);
+	tests::RegisterLoggerTests(registry);
+#if TWIB_GDB_ENABLED == 1
+	tests::RegisterHexCodecTests(registry);
+#endif
+
+	size_t ran = 0;
+	size_t failed = 0;
+	for(const tests::Test &t : registry.tests) {
+		if(t.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		if(list) {
+			printf("%s\n", t.name.c_str());
+			continue;
+		}
+		size_t failures = tests::Run(t);
+		printf("%-48s %s\n", t.name.c_str(), failures ? "FAILED" : "ok");
+		ran++;
+		if(failures) {
+			failed++;
+		}
+	}
+
+	if(!list) {
+		printf("%zu of %zu tests passed\n", ran - failed, ran);
+	}
+	return failed ? 1 : 0;
+}
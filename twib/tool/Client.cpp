@@ -30,6 +30,14 @@ namespace twib {
 namespace tool {
 namespace client {
 
+Client::Client() {
+	// Tags only need to be unique among this client's outstanding requests,
+	// but twibd matches device responses by tag alone, so start each client
+	// somewhere random to keep them from colliding with each other.
+	std::random_device rng;
+	next_tag = rng();
+}
+
 void Client::PostResponse(protocol::MessageHeader &mh, util::Buffer &payload, util::Buffer &object_ids) {
 	// create RAII objects for remote objects
 	std::vector<std::shared_ptr<RemoteObject>> objects(mh.object_count);
@@ -45,15 +53,14 @@ void Client::PostResponse(protocol::MessageHeader &mh, util::Buffer &payload, ut
 	std::function<void(Response)> func;
 	{
 		std::lock_guard<std::mutex> lock(response_map_mutex);
-		auto it = response_map.find(mh.tag);
-		if(it == response_map.end()) {
+		std::optional<std::function<void(Response)>> entry = response_map.Take(mh.tag);
+		if(!entry) {
 			LogMessage(Warning, "dropping response for unknown tag 0x%x", mh.tag);
 			return;
 		}
-		func = std::move(it->second);
-		response_map.erase(it);
+		func = std::move(*entry);
 	}
-		
+	
 	std::invoke(
 		func,
 		Response(
@@ -66,34 +73,50 @@ void Client::PostResponse(protocol::MessageHeader &mh, util::Buffer &payload, ut
 }
 
 void Client::SendRequest(Request &&rq, std::function<void(Response)> &&function) {
-	if(failed) {
-		std::invoke(function, Response(0, 0, fail_code, 0, std::vector<uint8_t>(), std::vector<std::shared_ptr<RemoteObject>>()));
-	} else {
-		{
-			std::lock_guard<std::mutex> lock(response_map_mutex);
-			static std::random_device rng;
-
-			uint32_t tag = rng();
+	bool send;
+	{
+		std::lock_guard<std::mutex> lock(response_map_mutex);
+		send = !failed;
+		if(send) {
+			// skip any tag that is still outstanding after wrapping around
+			uint32_t tag;
+			do {
+				tag = next_tag++;
+			} while(response_map.Contains(tag));
 			rq.tag = tag;
-
-			response_map[tag] = std::move(function);
+			
+			response_map.Insert(tag, std::move(function));
 		}
-
+	}
+	
+	if(send) {
 		SendRequestImpl(rq);
+	} else {
+		std::invoke(function, Response(0, 0, fail_code, 0, std::vector<uint8_t>(), std::vector<std::shared_ptr<RemoteObject>>()));
 	}
 }
 
 void Client::FailAllRequests(uint32_t code) {
-	fail_code = code;
-	failed = true;
-	for(auto i = response_map.begin(); i != response_map.end();) {
+	std::vector<std::function<void(Response)>> funcs;
+	{
+		std::lock_guard<std::mutex> lock(response_map_mutex);
+		fail_code = code;
+		failed = true;
+		funcs.reserve(response_map.size());
+		response_map.Drain(
+			[&](uint32_t tag, std::function<void(Response)> &&func) {
+				funcs.push_back(std::move(func));
+			});
+	}
+	
+	// callbacks may send more requests, so don't hold the lock for them
+	for(auto &func : funcs) {
 		std::invoke(
-			i->second,
+			func,
 			Response(
 				0, 0, code, 0,
 				std::vector<uint8_t>(),
 				std::vector<std::shared_ptr<RemoteObject>>()));
-		i = response_map.erase(i);
 	}
 }
 
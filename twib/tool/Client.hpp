@@ -20,13 +20,14 @@
 
 #pragma once
 
+#include<atomic>
 #include<functional>
 #include<mutex>
-#include<map>
 
 #include "Messages.hpp"
 #include "Protocol.hpp"
 #include "Buffer.hpp"
+#include "common/FlatTagMap.hpp"
 
 namespace twili {
 namespace twib {
@@ -35,6 +36,7 @@ namespace client {
 
 class Client {
  public:
+	Client();
 	virtual ~Client() = default;
 	void SendRequest(Request &&rq, std::function<void(Response)> &&function);
 	
@@ -45,8 +47,9 @@ class Client {
 	void PostResponse(protocol::MessageHeader &mh, util::Buffer &payload, util::Buffer &object_ids);
 	void FailAllRequests(uint32_t code);
  private:
-	std::map<uint32_t, std::function<void(Response r)>> response_map;
+	common::FlatTagMap<std::function<void(Response r)>> response_map;
 	std::mutex response_map_mutex;
+	std::atomic<uint32_t> next_tag;
 	bool failed = false;
 	uint32_t fail_code;
 };
@@ -19,6 +19,10 @@
 //
 
 #include "GdbConnection.hpp"
+
+#include<algorithm>
+
+#include "HexCodec.hpp"
 #include "common/Logger.hpp"
 
 namespace twili {
@@ -35,9 +39,23 @@ GdbConnection::GdbConnection(
 
 util::Buffer *GdbConnection::Process(bool &interrupted) {
 	std::unique_lock<std::mutex> lock(mutex);
-	char ch;
 	interrupted = false;
-	while(in_buffer.Read(ch)) {
+	for(util::Span span; (span = in_buffer.GetFrontSpan()).size > 0;) {
+		size_t i = 0;
+		util::Buffer *packet = ProcessSpan(span, i, interrupted);
+		in_buffer.MarkRead(i);
+		if(packet || interrupted || error_flag) {
+			return packet;
+		}
+	}
+	return nullptr;
+}
+
+// Runs the packet state machine over `span`, leaving `i` just past the last
+// character consumed.
+util::Buffer *GdbConnection::ProcessSpan(util::Span span, size_t &i, bool &interrupted) {
+	while(i < span.size) {
+		char ch = span.data[i++];
 		switch(state) {
 		case State::WAITING_PACKET_OPEN:
 			if(ch == '+') {
@@ -106,31 +124,48 @@ util::Buffer *GdbConnection::Process(bool &interrupted) {
 }
 
 void GdbConnection::Respond(util::Buffer &buffer) {
+	Send('$', buffer);
+}
+
+void GdbConnection::Notify(util::Buffer &buffer) {
+	Send('%', buffer);
+}
+
+void GdbConnection::Send(char open, util::Buffer &buffer) {
 	std::unique_lock<std::mutex> lock(mutex);
-	out_buffer.Write('$');
+	out_buffer.Write(open);
 	uint8_t checksum = 0;
-	char ch;
-	while(buffer.Read(ch)) {
+	
+	// copy runs of characters that don't need escaping in one go
+	uint8_t *data = buffer.Read();
+	size_t size = buffer.ReadAvailable();
+	size_t run_start = 0;
+	for(size_t i = 0; i < size; i++) {
+		char ch = data[i];
 		if(ch == '#' || ch == '$' || ch == '}' || ch == '*') {
+			out_buffer.Write(data + run_start, i - run_start);
 			out_buffer.Write('}');
 			checksum+= '}';
 			ch^= 0x20;
+			out_buffer.Write(ch);
+			run_start = i + 1;
 		}
-		out_buffer.Write(ch);
 		checksum+= ch;
 	}
-	out_buffer.Write('#');
-	Encode(checksum, 1, out_buffer);
+	out_buffer.Write(data + run_start, size - run_start);
+	buffer.MarkRead(size);
+	
+	char trailer[3] = {'#', EncodeHexNybble(checksum >> 4), EncodeHexNybble(checksum & 0xf)};
+	out_buffer.Write((uint8_t*) trailer, sizeof(trailer));
 
 	while(out_buffer.ReadAvailable()) {
-		ssize_t r = write(out_file.fd, (char*) out_buffer.Read(), out_buffer.ReadAvailable());
+		util::Span span = out_buffer.GetFrontSpan();
+		ssize_t r = write(out_file.fd, (char*) span.data, span.size);
 		if(r < 0) {
 			SignalError();
 			return;
 		}
-		if(r > 0) {
-			out_buffer.MarkRead(r);
-		}
+		out_buffer.MarkRead(r);
 	}
 }
 
@@ -233,36 +268,31 @@ void GdbConnection::Decode(uint64_t &out, util::Buffer &packet) {
 }
 
 void GdbConnection::Decode(std::vector<uint8_t> &out, util::Buffer &packet) {
-	out.reserve(packet.ReadAvailable()/2);
-	while(packet.ReadAvailable()) {
-		uint8_t b = DecodeHexNybble(packet.Read()[0]) << 4;
-		packet.MarkRead(1); // consume
-		if(!packet.ReadAvailable()) {
-			LogMessage(Error, "unexpectedly odd number of nybbles");
-			return;
-		}
-		b|= DecodeHexNybble(packet.Read()[0]);
-		packet.MarkRead(1); // consume
-
-		out.push_back(b);
+	size_t size = packet.ReadAvailable() / 2;
+	size_t offset = out.size();
+	out.resize(offset + size);
+	if(!hex::Decode((char*) packet.Read(), size, out.data() + offset)) {
+		LogMessage(Error, "invalid hex data");
+	}
+	packet.MarkRead(size * 2);
+	if(packet.ReadAvailable()) {
+		LogMessage(Error, "unexpectedly odd number of nybbles");
+		packet.MarkRead(packet.ReadAvailable());
 	}
 }
 
 void GdbConnection::Decode(util::Buffer &out, util::Buffer &packet) {
-	std::tuple<uint8_t*, size_t> r = out.Reserve(packet.ReadAvailable()/2);
-	uint8_t *dest = std::get<0>(r);
-	while(packet.ReadAvailable()) {
-		uint8_t b = DecodeHexNybble(packet.Read()[0]) << 4;
-		packet.MarkRead(1); // consume
-		if(!packet.ReadAvailable()) {
-			LogMessage(Error, "unexpectedly odd number of nybbles");
-			return;
-		}
-		b|= DecodeHexNybble(packet.Read()[0]);
-		packet.MarkRead(1); // consume
-
-		*(dest++) = b;
-		out.MarkWritten(1);
+	size_t size = packet.ReadAvailable() / 2;
+	std::tuple<uint8_t*, size_t> r = out.Reserve(size);
+	size = std::min(size, std::get<1>(r));
+	if(!hex::Decode((char*) packet.Read(), size, std::get<0>(r))) {
+		LogMessage(Error, "invalid hex data");
+	}
+	out.MarkWritten(size);
+	packet.MarkRead(size * 2);
+	if(packet.ReadAvailable()) {
+		LogMessage(Error, "unexpectedly odd number of nybbles");
+		packet.MarkRead(packet.ReadAvailable());
 	}
 }
 
@@ -293,11 +323,10 @@ void GdbConnection::Encode(uint64_t n, size_t size, util::Buffer &out_buffer) {
 }
 
 void GdbConnection::Encode(uint8_t *p, size_t size, util::Buffer &out_buffer) {
-	for(size_t i = 0; i < size; i++) {
-		uint8_t n = p[i];
-		out_buffer.Write(EncodeHexNybble((n >> 4) & 0xf));
-		out_buffer.Write(EncodeHexNybble((n >> 0) & 0xf));
-	}
+	std::tuple<uint8_t*, size_t> r = out_buffer.Reserve(size * 2);
+	size = std::min(size, std::get<1>(r) / 2);
+	hex::Encode(p, size, (char*) std::get<0>(r));
+	out_buffer.MarkWritten(size * 2);
 }
 
 void GdbConnection::Encode(std::string &string, util::Buffer &out_buffer) {
@@ -26,6 +26,7 @@
 #include "platform/platform.hpp"
 #include "platform/EventLoop.hpp"
 #include "Buffer.hpp"
+#include "SegmentedBuffer.hpp"
 
 namespace twili {
 namespace twib {
@@ -75,15 +76,21 @@ class GdbConnection {
 	void RespondEmpty();
 	void RespondError(int no);
 	void RespondOk();
+	// Sends an asynchronous notification, which GDB doesn't acknowledge.
+	// Used for %Stop in non-stop mode.
+	void Notify(util::Buffer &buffer);
 	void SignalError();
 	void StartNoAckMode();
 	
  private:
 	platform::File out_file;
 
-	util::Buffer in_buffer;
+	void Send(char open, util::Buffer &buffer);
+	util::Buffer *ProcessSpan(util::Span span, size_t &i, bool &interrupted);
+	
+	util::SegmentedBuffer in_buffer;
 	util::Buffer message_buffer;
-	util::Buffer out_buffer;
+	util::SegmentedBuffer out_buffer;
 	enum class State {
 		WAITING_PACKET_OPEN,
 		READING_PACKET_DATA,
@@ -21,6 +21,7 @@
 #include "GdbStub.hpp"
 
 #include<functional>
+#include<cstddef>
 
 #include "common/Logger.hpp"
 #include "common/ResultError.hpp"
@@ -37,7 +38,10 @@ GdbStub::GdbStub(ITwibDeviceInterface &itdi) :
 		platform::File(STDOUT_FILENO, false)),
 	logic(*this),
 	loop(logic),
-	xfer_libraries(*this, &GdbStub::XferReadLibraries) {
+	xfer_libraries(*this, &GdbStub::XferReadLibraries),
+	xfer_memory_map(*this, &GdbStub::XferReadMemoryMap),
+	xfer_features(*this, &GdbStub::XferReadTargetDescription),
+	xfer_threads(*this, &GdbStub::XferReadThreads) {
 	AddGettableQuery(Query(*this, "Supported", &GdbStub::QueryGetSupported, false));
 	AddGettableQuery(Query(*this, "C", &GdbStub::QueryGetCurrentThread, false));
 	AddGettableQuery(Query(*this, "fThreadInfo", &GdbStub::QueryGetFThreadInfo, false));
@@ -48,10 +52,46 @@ GdbStub::GdbStub(ITwibDeviceInterface &itdi) :
 	AddGettableQuery(Query(*this, "Xfer", &GdbStub::QueryXfer, false));
 	AddSettableQuery(Query(*this, "StartNoAckMode", &GdbStub::QuerySetStartNoAckMode));
 	AddSettableQuery(Query(*this, "ThreadEvents", &GdbStub::QuerySetThreadEvents));
+	AddSettableQuery(Query(*this, "NonStop", &GdbStub::QuerySetNonStop));
 	AddMultiletterHandler("Attach", &GdbStub::HandleVAttach);
 	AddMultiletterHandler("Cont?", &GdbStub::HandleVContQuery);
 	AddMultiletterHandler("Cont", &GdbStub::HandleVCont);
+	AddMultiletterHandler("Stopped", &GdbStub::HandleVStopped);
 	AddXferObject("libraries", xfer_libraries);
+	AddXferObject("memory-map", xfer_memory_map);
+	AddXferObject("features", xfer_features);
+	AddXferObject("threads", xfer_threads);
+}
+
+// Where each register in our target description lives in ThreadContext.
+// The numbering follows ThreadContext's layout, so 'g' and 'G' packets are
+// just the two blocks of it without padding.
+static bool GetRegisterLayout(uint64_t regnum, size_t &offset, size_t &size) {
+	if(regnum < 31) {
+		offset = offsetof(ThreadContext, x) + regnum * 8;
+		size = 8;
+	} else if(regnum == 31) {
+		offset = offsetof(ThreadContext, sp);
+		size = 8;
+	} else if(regnum == 32) {
+		offset = offsetof(ThreadContext, pc);
+		size = 8;
+	} else if(regnum == 33) {
+		offset = offsetof(ThreadContext, psr);
+		size = 4;
+	} else if(regnum < 66) {
+		offset = offsetof(ThreadContext, fpr) + (regnum - 34) * 16;
+		size = 16;
+	} else if(regnum == 66) {
+		offset = offsetof(ThreadContext, fpcr);
+		size = 4;
+	} else if(regnum == 67) {
+		offset = offsetof(ThreadContext, fpsr);
+		size = 4;
+	} else {
+		return false;
+	}
+	return true;
 }
 
 GdbStub::~GdbStub() {
@@ -113,6 +153,17 @@ void GdbStub::Stop() {
 	HandleGetStopReason(); // send reason
 }
 
+void GdbStub::QueueStop(std::string reason) {
+	LogMessage(Debug, "queueing stop reason: \"%s\"", reason.c_str());
+	pending_stops.push_back(reason);
+	if(pending_stops.size() == 1) {
+		util::Buffer buf;
+		buf.Write("Stop:");
+		buf.Write(reason);
+		connection.Notify(buf);
+	}
+}
+
 void GdbStub::ReadThreadId(util::Buffer &packet, int64_t &pid, int64_t &thread_id) {
 	pid = current_thread ? current_thread->process.pid : 0;
 	
@@ -203,8 +254,25 @@ void GdbStub::HandleMultiletterPacket(util::Buffer &packet) {
 }
 
 void GdbStub::HandleGetStopReason() {
+	if(non_stop) {
+		// report every stopped thread, and let GDB collect the rest with
+		// vStopped
+		pending_stops.clear();
+		for(auto &p : attached_processes) {
+			for(auto &t : p.second.threads) {
+				if(t.second.stopped) {
+					pending_stops.push_back(p.second.BuildStopReason('T', t.second.stop_signal, t.first));
+				}
+			}
+		}
+		if(pending_stops.empty()) {
+			connection.RespondOk();
+			return;
+		}
+	}
+	
 	util::Buffer buf;
-	buf.Write(stop_reason);
+	buf.Write(non_stop ? pending_stops.front() : stop_reason);
 	connection.Respond(buf);
 }
 
@@ -289,6 +357,62 @@ void GdbStub::HandleWriteGeneralRegisters(util::Buffer &packet) {
 	}
 }
 
+void GdbStub::HandleReadRegister(util::Buffer &packet) {
+	uint64_t regnum;
+	size_t offset, size;
+	GdbConnection::Decode(regnum, packet);
+	
+	if(current_thread == nullptr) {
+		LogMessage(Warning, "attempt to read register with no selected thread");
+		connection.RespondError(1);
+		return;
+	}
+	if(!GetRegisterLayout(regnum, offset, size)) {
+		LogMessage(Warning, "attempt to read unknown register %lu", regnum);
+		connection.RespondError(1);
+		return;
+	}
+
+	try {
+		util::Buffer response;
+		ThreadContext tc = current_thread->GetRegisters();
+		GdbConnection::Encode((uint8_t*) &tc + offset, size, response);
+		connection.Respond(response);
+	} catch(ResultError &e) {
+		LogMessage(Debug, "failed to read register: 0x%x", e.code);
+		connection.RespondError(e.code);
+	}
+}
+
+void GdbStub::HandleWriteRegister(util::Buffer &packet) {
+	uint64_t regnum;
+	size_t offset, size;
+	std::vector<uint8_t> value;
+	GdbConnection::DecodeWithSeparator(regnum, '=', packet);
+	GdbConnection::Decode(value, packet);
+	
+	if(current_thread == nullptr) {
+		LogMessage(Warning, "attempt to write register with no selected thread");
+		connection.RespondError(1);
+		return;
+	}
+	if(!GetRegisterLayout(regnum, offset, size) || value.size() != size) {
+		LogMessage(Warning, "bad write to register %lu (0x%zx bytes)", regnum, value.size());
+		connection.RespondError(1);
+		return;
+	}
+
+	try {
+		ThreadContext tc = current_thread->GetRegisters();
+		memcpy((uint8_t*) &tc + offset, value.data(), size);
+		current_thread->SetRegisters(tc);
+		connection.RespondOk();
+	} catch(ResultError &e) {
+		LogMessage(Debug, "failed to write register: 0x%x", e.code);
+		connection.RespondError(e.code);
+	}
+}
+
 void GdbStub::HandleSetCurrentThread(util::Buffer &packet) {
 	if(packet.ReadAvailable() < 2) {
 		LogMessage(Warning, "invalid thread id");
@@ -358,7 +482,7 @@ void GdbStub::HandleReadMemory(util::Buffer &packet) {
 
 	try {
 		util::Buffer response;
-		std::vector<uint8_t> mem = current_thread->process.debugger.ReadMemory(address, size);
+		std::vector<uint8_t> mem = current_thread->process.ReadMemory(address, size);
 		GdbConnection::Encode(mem.data(), mem.size(), response);
 		connection.Respond(response);
 	} catch(ResultError &e) {
@@ -391,7 +515,7 @@ void GdbStub::HandleWriteMemory(util::Buffer &packet) {
 	
 	try {
 		util::Buffer response;
-		current_thread->process.debugger.WriteMemory(address, bytes);
+		current_thread->process.WriteMemory(address, bytes);
 		connection.RespondOk();
 	} catch(ResultError &e) {
 		connection.RespondError(e.code);
@@ -433,12 +557,17 @@ void GdbStub::HandleVAttach(util::Buffer &packet) {
 	}
 	
 	// ok
-	HandleGetStopReason();
+	if(non_stop) {
+		// every thread is stopped, but GDB finds out about them with vCont;t
+		connection.RespondOk();
+	} else {
+		HandleGetStopReason();
+	}
 }
 
 void GdbStub::HandleVContQuery(util::Buffer &packet) {
 	util::Buffer response;
-	response.Write(std::string("vCont;c;C"));
+	response.Write(std::string(non_stop ? "vCont;c;C;t" : "vCont;c;C"));
 	connection.Respond(response);
 }
 
@@ -452,7 +581,8 @@ void GdbStub::HandleVCont(util::Buffer &packet) {
 	struct Action {
 		enum class Type {
 			Invalid,
-			Continue
+			Continue,
+			Stop
 		} type = Type::Invalid;
 	};
 
@@ -475,6 +605,12 @@ void GdbStub::HandleVCont(util::Buffer &packet) {
 			case 'c':
 				action.type = Action::Type::Continue;
 				break;
+			case 't':
+				if(non_stop) {
+					action.type = Action::Type::Stop;
+					break;
+				}
+				// fall-through
 			default:
 				LogMessage(Warning, "unsupported vCont action: %c", ch);
 			}
@@ -534,6 +670,50 @@ void GdbStub::HandleVCont(util::Buffer &packet) {
 			continue;
 		}
 		Process &proc = p_i->second;
+		if(non_stop) {
+			bool needs_break = false;
+			bool resumed = false;
+			for(auto &t : p.second) {
+				auto t_i = proc.threads.find(t.first);
+				if(t_i == proc.threads.end()) {
+					LogMessage(Warning, "no such thread: 0x%lx", t.first);
+					continue;
+				}
+				Thread &thread = t_i->second;
+				if(t.second.type == Action::Type::Stop) {
+					if(thread.stopped || !proc.running) {
+						// GDB thinks it's running, like right after vAttach,
+						// or the process is broken in anyway, so there's no
+						// break to wait for
+						if(!thread.stopped) {
+							thread.stopped = true;
+							thread.cached_context.reset();
+							proc.caches_filled = false;
+						}
+						thread.stop_signal = 0;
+						QueueStop(proc.BuildStopReason('T', 0, thread.thread_id));
+					} else {
+						proc.stop_requests.push_back(thread.thread_id);
+						needs_break = true;
+					}
+				} else if(thread.stopped) {
+					thread.stopped = false;
+					resumed = true;
+				}
+			}
+			
+			if(proc.running && (needs_break || resumed)) {
+				// Horizon only breaks whole processes, and we can only
+				// continue threads while it's broken in. IngestEvents
+				// stops the requested threads and continues the rest.
+				proc.debugger.BreakProcess();
+				proc.IngestEvents(*this);
+			} else if(resumed) {
+				proc.ContinueThreads();
+			}
+			continue;
+		}
+		
 		LogMessage(Debug, "ingesting process events before continue...");
 		if(proc.IngestEvents(*this)) {
 			LogMessage(Debug, "  stopped");
@@ -554,13 +734,29 @@ void GdbStub::HandleVCont(util::Buffer &packet) {
 		for(auto &t : proc.running_thread_ids) {
 			LogMessage(Debug, "  tid 0x%lx", t);
 		}
-		proc.debugger.ContinueDebugEvent(7, proc.running_thread_ids);
-		proc.running = true;
+		proc.Continue();
+	}
+	if(non_stop) {
+		connection.RespondOk();
+		return;
 	}
 	waiting_for_stop = true;
 	LogMessage(Debug, "reached end of vCont");
 }
 
+void GdbStub::HandleVStopped(util::Buffer &packet) {
+	if(!pending_stops.empty()) { // acknowledge the last one we sent
+		pending_stops.pop_front();
+	}
+	if(pending_stops.empty()) {
+		connection.RespondOk();
+	} else {
+		util::Buffer buf;
+		buf.Write(pending_stops.front());
+		connection.Respond(buf);
+	}
+}
+
 void GdbStub::QueryGetSupported(util::Buffer &packet) {
 	util::Buffer response;
 
@@ -672,32 +868,10 @@ void GdbStub::QueryGetThreadExtraInfo(util::Buffer &packet) {
 
 	Thread &t = j->second;
 
-	std::string extra_info;
-
-	try {
-		std::vector<uint8_t> tls_ctx_ptr_u8 = p.debugger.ReadMemory(t.tls_addr + 0x1f8, 8);
-		uint64_t tls_ctx_addr = *(uint64_t*) tls_ctx_ptr_u8.data();
-		std::vector<uint8_t> name_ptr_u8 = p.debugger.ReadMemory(tls_ctx_addr + 0x1a8, 8);
-		uint64_t name_addr = *(uint64_t*) name_ptr_u8.data();
-	
-		if(name_addr != 0) {
-			std::vector<uint8_t> name = p.debugger.ReadMemory(name_addr, 0x40);
-			for(size_t i = 0; i < name.size(); i++) {
-				if(name[i] == 0) {
-					break;
-				}
-				extra_info.push_back(name[i]);
-				if(i == name.size()-1) {
-					name_addr+= name.size();
-					name = p.debugger.ReadMemory(name_addr, 0x40);
-					i = 0;
-				}
-			}
-			extra_info = (char*) name.data();
-		}
-	} catch(ResultError &e) {
-		LogMessage(Warning, "caught 0x%x reading thread name", e.code);
+	if(!t.name) {
+		p.FetchThreadNames();
 	}
+	std::string extra_info = t.name.value_or("");
 
 	if(extra_info.empty()) {
 		extra_info = "?";
@@ -863,23 +1037,51 @@ void GdbStub::QuerySetThreadEvents(util::Buffer &packet) {
 	connection.RespondOk();
 }
 
+void GdbStub::QuerySetNonStop(util::Buffer &packet) {
+	char c;
+	if(!packet.Read(c)) {
+		connection.RespondError(1);
+		return;
+	}
+	if(c == '0') {
+		non_stop = false;
+	} else if(c == '1') {
+		non_stop = true;
+	} else {
+		connection.RespondError(1);
+		return;
+	}
+	pending_stops.clear();
+	connection.RespondOk();
+}
+
 bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 	std::optional<nx::DebugEvent> event;
 
 	bool was_running = running;
-	
-	char style = 'T';
-	int signal = 0;
-	uint64_t thread_id = 0;
-	util::Buffer stop_info;
+	bool got_events = false;
+	bool exited = false;
 	bool stopped = false;
-	
-	while(!stopped && (event = debugger.GetDebugEvent())) {
+
+	struct StopEvent {
+		char style;
+		int signal;
+		uint64_t thread_id;
+	};
+	std::vector<StopEvent> stops;
+
+	// in all-stop mode, we only take events up to the first stop. in
+	// non-stop mode, every stop gets its own notification.
+	while((stub.non_stop || !stopped) && (event = debugger.GetDebugEvent())) {
 		LogMessage(Debug, "got event: %d", event->event_type);
 
 		running = false;
+		got_events = true;
 		
-		thread_id = event->thread_id;
+		char style = 'T';
+		int signal = 0;
+		uint64_t thread_id = event->thread_id;
+		bool event_stops = false;
 		
 		switch(event->event_type) {
 		case nx::DebugEvent::EventType::AttachProcess: {
@@ -889,20 +1091,25 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 			LogMessage(Debug, "  attaching new thread: 0x%x", thread_id);
 			running_thread_ids.push_back(thread_id); // autocontinue
 			auto r = threads.emplace(thread_id, Thread(*this, thread_id, event->attach_thread.tls_pointer));
+			if(stub.non_stop) {
+				// threads that start while we're attaching are stopped
+				// with the rest of the process
+				r.first->second.stopped = !was_running;
+			}
 
 			stub.get_thread_info.valid = false;
 			
 			if(stub.thread_events_enabled) {
 				signal = 5;
-				stop_info.Write("create");
-				stopped = true;
+				event_stops = true;
 			}
 			break; }
 		case nx::DebugEvent::EventType::ExitProcess: {
 			LogMessage(Warning, "process exited");
 			style = 'W';
 			signal = 0;
-			stopped = true;
+			exited = true;
+			event_stops = true;
 			break; }
 		case nx::DebugEvent::EventType::ExitThread: {
 			LogMessage(Warning, "thread exited");
@@ -926,12 +1133,12 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 			if(stub.thread_events_enabled) {
 				style = 'w';
 				signal = 0;
-				stopped = true;
+				event_stops = true;
 			}
 			break; }
 		case nx::DebugEvent::EventType::Exception: {
 			LogMessage(Warning, "hit exception");
-			stopped = true;
+			event_stops = true;
 			switch(event->exception.exception_type) {
 			case nx::DebugEvent::ExceptionType::Trap:
 				LogMessage(Warning, "trap");
@@ -952,6 +1159,10 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 			case nx::DebugEvent::ExceptionType::DebuggerAttached:
 				LogMessage(Warning, "debugger attached");
 				signal = 0; // no signal
+				if(stub.non_stop) {
+					// GDB stops each thread with vCont;t after attaching
+					event_stops = false;
+				}
 				break;
 			case nx::DebugEvent::ExceptionType::BreakPoint:
 				LogMessage(Warning, "breakpoint");
@@ -964,6 +1175,18 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 			case nx::DebugEvent::ExceptionType::DebuggerBreak:
 				LogMessage(Warning, "debugger break");
 				signal = 2; // SIGINT
+				if(stub.non_stop) {
+					// we broke in to stop some threads for vCont;t
+					event_stops = false;
+					for(uint64_t request : stop_requests) {
+						auto i = threads.find(request);
+						if(i != threads.end() && !i->second.stopped) {
+							i->second.stopped = true;
+							stops.push_back({'T', 0, request});
+						}
+					}
+					stop_requests.clear();
+				}
 				break;
 			case nx::DebugEvent::ExceptionType::BadSvcId:
 				LogMessage(Warning, "bad svc id");
@@ -976,36 +1199,32 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 			}
 			break; }
 		}
-	}
 
-	if(stopped) {
-		util::Buffer stop_reason;
-		if(style == 'T') { // signal
-			stop_reason.Write('T');
-			GdbConnection::Encode(signal, 1, stop_reason);
+		if(event_stops) {
+			stopped = true;
+			auto i = threads.find(thread_id);
+			if(i != threads.end()) {
+				i->second.stopped = true;
+			}
+			stops.push_back({style, signal, thread_id});
+		}
+	}
 
-			if(thread_id) {
-				stop_reason.Write("thread:p");
-				GdbConnection::Encode(pid, 0, stop_reason);
-				stop_reason.Write('.');
-				GdbConnection::Encode(thread_id, 0, stop_reason);
-				stop_reason.Write(';');
+	if(stub.non_stop) {
+		for(StopEvent &stop : stops) {
+			auto i = threads.find(stop.thread_id);
+			if(i != threads.end()) {
+				i->second.stop_signal = stop.signal;
+				i->second.cached_context.reset();
 			}
-		} else if(style == 'W') { // process exit
-			stop_reason.Write('W');
-			GdbConnection::Encode(signal, 1, stop_reason);
-		} else if(style == 'w') { // thread exit
-			stop_reason.Write('w');
-			GdbConnection::Encode(signal, 1, stop_reason);
-			stop_reason.Write(";p");
-			GdbConnection::Encode(pid, 0, stop_reason);
-			stop_reason.Write('.');
-			GdbConnection::Encode(thread_id, 0, stop_reason);
-		} else {
-			LogMessage(Warning, "invalid stop reason style: '%c'", style);
-			stop_reason.Write("T05");
 		}
-		stub.stop_reason = stop_reason.GetString();
+		// the threads we just stopped aren't in the caches yet
+		caches_filled = false;
+		for(StopEvent &stop : stops) {
+			stub.QueueStop(BuildStopReason(stop.style, stop.signal, stop.thread_id));
+		}
+	} else if(stopped) {
+		stub.stop_reason = BuildStopReason(stops.back().style, stops.back().signal, stops.back().thread_id);
 		LogMessage(Debug, "set stop reason: \"%s\"", stub.stop_reason.c_str());
 	}
 
@@ -1025,65 +1244,176 @@ bool GdbStub::Process::IngestEvents(GdbStub &stub) {
 		stub.has_async_wait = true;
 	}
 
-	if(was_running && !running && !stopped) { // if we're not running but we should be...
+	if(stub.non_stop) {
+		if(got_events && !exited) { // the process is broken in, so keep the rest of it going
+			ContinueThreads();
+		}
+	} else if(was_running && !running && !stopped) { // if we're not running but we should be...
 		LogMessage(Debug, "got debug events but didn't stop, so continuing...");
-		debugger.ContinueDebugEvent(7, running_thread_ids);
-		running = true;
+		Continue();
 	}
 	
 	return stopped;
 }
 
-std::string GdbStub::Process::BuildLibraryList() {
-	std::stringstream ss;
-	ss << "<library-list>" << std::endl;
-	util::Buffer build_id_buffer;
+std::string GdbStub::Process::BuildStopReason(char style, int signal, uint64_t thread_id) {
+	util::Buffer stop_reason;
+	if(style == 'T') { // signal
+		stop_reason.Write('T');
+		GdbConnection::Encode(signal, 1, stop_reason);
 
-	try {
-		std::vector<nx::LoadedModuleInfo> nsos = debugger.GetNsoInfos();
-		for(size_t i = 0; i < nsos.size(); i++) {
-			// skip main
-			if(nsos.size() == 1) { continue; } // standalone main
-			if(nsos.size() >= 2 && i == 1) { continue; } // rtld, main, subsdks, etc.
-			
-			nx::LoadedModuleInfo &info = nsos[i];
-		
-			build_id_buffer.Clear();
-			GdbConnection::Encode(info.build_id, sizeof(info.build_id), build_id_buffer);
-			std::string build_id = build_id_buffer.GetString();
-
-			ss << "  <library";
-			ss << " name=\"" << build_id << "\"";
-			ss << " build_id=\"" << build_id << "\"";
-			ss << " type=\"nso\"";
-			ss << ">" << std::endl;
-			ss << "    <segment address=\"0x" << std::hex << info.base_addr << "\" />" << std::endl;
-			ss << "  </library>" << std::endl;
+		if(thread_id) {
+			stop_reason.Write("thread:p");
+			GdbConnection::Encode(pid, 0, stop_reason);
+			stop_reason.Write('.');
+			GdbConnection::Encode(thread_id, 0, stop_reason);
+			stop_reason.Write(';');
+
+			// GDB wants registers of the stopped thread right away, so
+			// fetch all of them now and send the ones it needs to unwind
+			// along with the stop reply
+			if(!caches_filled) {
+				Prefetch();
+				FillCaches();
 			}
-	} catch(ResultError &e) {
-		LogMessage(Warning, "caught 0x%x reading NSO list", e.code);
+			auto t = threads.find(thread_id);
+			if(t != threads.end() && t->second.cached_context) {
+				ThreadContext &tc = *t->second.cached_context;
+				for(uint64_t regnum : {29, 30, 31, 32}) {
+					size_t offset, size;
+					GetRegisterLayout(regnum, offset, size);
+					GdbConnection::Encode(regnum, 1, stop_reason);
+					stop_reason.Write(':');
+					GdbConnection::Encode((uint8_t*) &tc + offset, size, stop_reason);
+					stop_reason.Write(';');
+				}
+			}
+		}
+	} else if(style == 'W') { // process exit
+		stop_reason.Write('W');
+		GdbConnection::Encode(signal, 1, stop_reason);
+	} else if(style == 'w') { // thread exit
+		stop_reason.Write('w');
+		GdbConnection::Encode(signal, 1, stop_reason);
+		stop_reason.Write(";p");
+		GdbConnection::Encode(pid, 0, stop_reason);
+		stop_reason.Write('.');
+		GdbConnection::Encode(thread_id, 0, stop_reason);
+	} else {
+		LogMessage(Warning, "invalid stop reason style: '%c'", style);
+		stop_reason.Write("T05");
+	}
+	return stop_reason.GetString();
+}
+
+static std::string EscapeXml(const std::string &str) {
+	std::string out;
+	for(char c : str) {
+		switch(c) {
+		case '<': out+= "&lt;"; break;
+		case '>': out+= "&gt;"; break;
+		case '&': out+= "&amp;"; break;
+		case '"': out+= "&quot;"; break;
+		default: out.push_back(c);
+		}
+	}
+	return out;
+}
+
+static bool SameModules(const std::vector<nx::LoadedModuleInfo> &a, const std::vector<nx::LoadedModuleInfo> &b) {
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+}
+
+std::string GdbStub::Process::BuildLibraryList(const SymbolCache *symbol_cache) {
+	if(!library_list_stale) {
+		return library_list;
 	}
 	
+	// both lists go out before waiting on either
+	RequestLibraryList();
+	bool changed = library_list.empty();
+	if(pending_nsos.valid()) {
+		try {
+			nsos = pending_nsos.get();
+			changed = true;
+		} catch(ResultError &e) {
+			LogMessage(Warning, "caught 0x%x reading NSO list", e.code);
+		}
+	}
 	try {
-		for(nx::LoadedModuleInfo &info : debugger.GetNroInfos()) {
-			build_id_buffer.Clear();
-			GdbConnection::Encode(info.build_id, sizeof(info.build_id), build_id_buffer);
-			std::string build_id = build_id_buffer.GetString();
-
-			ss << "  <library";
-			ss << " name=\"" << build_id << "\"";
-			ss << " build_id=\"" << build_id << "\"";
-			ss << " type=\"nro\"";
-			ss << ">" << std::endl;
-			ss << "    <segment address=\"0x" << std::hex << info.base_addr << "\" />" << std::endl;
-			ss << "  </library>" << std::endl;
+		std::vector<nx::LoadedModuleInfo> current_nros = pending_nros.get();
+		if(!SameModules(current_nros, nros)) {
+			nros = std::move(current_nros);
+			changed = true;
 		}
 	} catch(ResultError &e) {
 		LogMessage(Warning, "caught 0x%x reading NRO list", e.code);
 	}
+	library_list_stale = false;
+	if(!changed) {
+		return library_list;
+	}
+	
+	std::stringstream ss;
+	ss << "<library-list>" << std::endl;
+	util::Buffer build_id_buffer;
+
+	auto write_library = [&](nx::LoadedModuleInfo &info, const char *type) {
+		build_id_buffer.Clear();
+		GdbConnection::Encode(info.build_id, sizeof(info.build_id), build_id_buffer);
+		std::string build_id = build_id_buffer.GetString();
+
+		// GDB loads symbols from the library name, so point it at a local
+		// copy if we know of one
+		std::string name = build_id;
+		if(symbol_cache) {
+			name = symbol_cache->Find(info.build_id, sizeof(info.build_id)).value_or(build_id);
+		}
+
+		ss << "  <library";
+		ss << " name=\"" << EscapeXml(name) << "\"";
+		ss << " build_id=\"" << build_id << "\"";
+		ss << " type=\"" << type << "\"";
+		ss << ">" << std::endl;
+		ss << "    <segment address=\"0x" << std::hex << info.base_addr << "\" />" << std::endl;
+		ss << "  </library>" << std::endl;
+	};
+	
+	if(nsos) {
+		for(size_t i = 0; i < nsos->size(); i++) {
+			// skip main
+			if(nsos->size() == 1) { continue; } // standalone main
+			if(nsos->size() >= 2 && i == 1) { continue; } // rtld, main, subsdks, etc.
+			write_library((*nsos)[i], "nso");
+		}
+	}
+	for(nx::LoadedModuleInfo &info : nros) {
+		write_library(info, "nro");
+	}
 	
 	ss << "</library-list>" << std::endl;
 
+	library_list = ss.str();
+	return library_list;
+}
+
+std::string GdbStub::Process::BuildMemoryMap() {
+	std::stringstream ss;
+	ss << "<memory-map>" << std::endl;
+	for(nx::MemoryInfo &info : debugger.GetMemoryMap()) {
+		// GDB refuses to touch anything outside the map, so leave out what
+		// can't be accessed anyway. Everything is "ram" even if it isn't
+		// writable, since "rom" makes GDB want hardware breakpoints.
+		if((info.memory_type & 0xff) == 0 || info.permission == 0) {
+			continue;
+		}
+		ss << "  <memory type=\"ram\"";
+		ss << " start=\"0x" << std::hex << info.base_addr << "\"";
+		ss << " length=\"0x" << std::hex << info.size << "\"";
+		ss << "/>" << std::endl;
+	}
+	ss << "</memory-map>" << std::endl;
+	
 	return ss.str();
 }
 
@@ -1091,13 +1421,156 @@ GdbStub::Thread::Thread(Process &process, uint64_t thread_id, uint64_t tls_addr)
 }
 
 ThreadContext GdbStub::Thread::GetRegisters() {
-	return process.debugger.GetThreadContext(thread_id);
+	if(!cached_context && !process.caches_filled) {
+		process.FillCaches();
+	}
+	if(!cached_context) { // new thread, or the batch couldn't read it
+		cached_context = process.debugger.GetThreadContext(thread_id);
+	}
+	return *cached_context;
 }
 
 void GdbStub::Thread::SetRegisters(const ThreadContext &registers) {
+	cached_context.reset();
 	return process.debugger.SetThreadContext(thread_id, registers);
 }
 
+void GdbStub::Process::FillCaches() {
+	caches_filled = true;
+	std::vector<uint64_t> thread_ids; // empty means every thread
+	if(running) { // non-stop mode, so only ask for the stopped threads
+		for(auto &t : threads) {
+			if(t.second.stopped) {
+				thread_ids.push_back(t.first);
+			}
+		}
+		if(thread_ids.empty()) {
+			return;
+		}
+	}
+	try {
+		for(ThreadBacktrace &backtrace : debugger.Backtrace(thread_ids, 32)) {
+			auto i = threads.find(backtrace.thread_id);
+			if(i != threads.end()) {
+				i->second.cached_context = backtrace.context;
+			}
+			for(FrameRecord &record : backtrace.records) {
+				frame_records[record.address] = record;
+			}
+		}
+	} catch(ResultError &e) {
+		// everything still works without the caches, just slower
+		LogMessage(Warning, "failed to fetch backtraces: 0x%x", e.code);
+	}
+}
+
+void GdbStub::Process::Prefetch() {
+	if(library_list_stale) {
+		RequestLibraryList();
+	}
+	RequestThreadNames();
+}
+
+void GdbStub::Process::RequestLibraryList() {
+	if(!nsos && !pending_nsos.valid()) {
+		pending_nsos = debugger.GetNsoInfosAsync();
+	}
+	if(!pending_nros.valid()) {
+		pending_nros = debugger.GetNroInfosAsync();
+	}
+}
+
+void GdbStub::Process::RequestThreadNames() {
+	if(pending_names.valid()) {
+		return;
+	}
+	
+	std::vector<uint64_t> tls_addrs;
+	pending_name_threads.clear();
+	for(auto &t : threads) {
+		if(!t.second.name) {
+			pending_name_threads.push_back(t.first);
+			tls_addrs.push_back(t.second.tls_addr);
+		}
+	}
+	if(!tls_addrs.empty()) {
+		pending_names = debugger.GetThreadNamesAsync(tls_addrs);
+	}
+}
+
+void GdbStub::Process::FetchThreadNames() {
+	// a prefetched request doesn't cover threads that started since, but
+	// those get picked up next time like any other unnamed thread
+	RequestThreadNames();
+	if(!pending_names.valid()) {
+		return;
+	}
+	
+	try {
+		std::vector<std::string> names = ITwibDebugger::DecodeThreadNames(pending_names.get(), pending_name_threads.size());
+		for(size_t i = 0; i < pending_name_threads.size(); i++) {
+			auto t = threads.find(pending_name_threads[i]);
+			if(t != threads.end() && !names[i].empty()) {
+				t->second.name = names[i];
+			}
+		}
+	} catch(ResultError &e) {
+		LogMessage(Warning, "caught 0x%x reading thread names", e.code);
+	}
+}
+
+void GdbStub::Process::Continue() {
+	caches_filled = false;
+	library_list_stale = true;
+	pending_nros = {}; // NROs may be loaded or unloaded while running
+	frame_records.clear();
+	for(auto &t : threads) {
+		t.second.cached_context.reset();
+	}
+	debugger.ContinueDebugEvent(7, running_thread_ids);
+	running = true;
+}
+
+void GdbStub::Process::ContinueThreads() {
+	std::vector<uint64_t> thread_ids;
+	for(auto &t : threads) {
+		if(!t.second.stopped) {
+			t.second.cached_context.reset();
+			thread_ids.push_back(t.first);
+		}
+	}
+	running = !thread_ids.empty();
+	if(!running) {
+		return;
+	}
+	caches_filled = false;
+	library_list_stale = true;
+	pending_nros = {}; // NROs may be loaded or unloaded while running
+	frame_records.clear(); // some of these stacks are about to change
+	LogMessage(Debug, "continuing %ld threads", thread_ids.size());
+	// no ContinueAll flag, so only the listed threads run (3.0.0+)
+	debugger.ContinueDebugEvent(3, thread_ids);
+}
+
+std::vector<uint8_t> GdbStub::Process::ReadMemory(uint64_t addr, uint64_t size) {
+	// GDB reads frame records a word at a time while unwinding
+	auto i = frame_records.upper_bound(addr);
+	if(i != frame_records.begin()) {
+		i--;
+		if(addr - i->first <= 16 && size <= 16 - (addr - i->first)) {
+			uint64_t words[2] = {i->second.fp, i->second.lr};
+			uint8_t *bytes = (uint8_t*) words + (addr - i->first);
+			return std::vector<uint8_t>(bytes, bytes + size);
+		}
+	}
+	return debugger.ReadMemory(addr, size);
+}
+
+void GdbStub::Process::WriteMemory(uint64_t addr, std::vector<uint8_t> &bytes) {
+	frame_records.clear();
+	debugger.WriteMemory(addr, bytes);
+}
+
 GdbStub::Process::Process(uint64_t pid, ITwibDebugger debugger) : pid(pid), debugger(debugger) {
 	has_events = std::make_shared<bool>(false);
 }
@@ -1143,6 +1616,12 @@ void GdbStub::Logic::Prepare(platform::EventLoop &loop) {
 		case 'M': // write memory
 			stub.HandleWriteMemory(*buffer);
 			break;
+		case 'p': // read register
+			stub.HandleReadRegister(*buffer);
+			break;
+		case 'P': // write register
+			stub.HandleWriteRegister(*buffer);
+			break;
 		case 'q': // general get query
 			stub.HandleGeneralGetQuery(*buffer);
 			break;
@@ -1162,12 +1641,16 @@ void GdbStub::Logic::Prepare(platform::EventLoop &loop) {
 		}
 	}
 
-	if(interrupted || stub.waiting_for_stop) {
+	if(interrupted || stub.waiting_for_stop || stub.non_stop) {
 		for(auto &p : stub.attached_processes) {
 			if(interrupted && p.second.running) {
 				p.second.debugger.BreakProcess();
 			}
-			if(stub.waiting_for_stop && *p.second.has_events) {
+			if(stub.non_stop && *p.second.has_events) {
+				// stops are sent as notifications from IngestEvents
+				*p.second.has_events = false;
+				p.second.IngestEvents(stub);
+			} else if(stub.waiting_for_stop && *p.second.has_events) {
 				if(p.second.IngestEvents(stub)) {
 					LogMessage(Debug, "stopping due to received event");
 					stub.Stop();
@@ -1196,7 +1679,10 @@ void GdbStub::ReadOnlyStringXferObject::Read(std::string annex, size_t offset, s
 		return;
 	}
 
-	std::string string = std::invoke(generator, stub);
+	if(offset == 0) {
+		cached = std::invoke(generator, stub);
+	}
+	const std::string &string = cached;
 	
 	util::Buffer response;
 	if(offset + length >= string.size()) {
@@ -1205,7 +1691,9 @@ void GdbStub::ReadOnlyStringXferObject::Read(std::string annex, size_t offset, s
 		response.Write('m');
 	}
 
-	response.Write((uint8_t*) string.data() + offset, std::min(string.size() - offset, length));
+	if(offset < string.size()) {
+		response.Write((uint8_t*) string.data() + offset, std::min(string.size() - offset, length));
+	}
 	stub.connection.Respond(response);
 }
 
@@ -1221,7 +1709,79 @@ std::string GdbStub::XferReadLibraries() {
 	if(current_thread == nullptr) {
 		return "<library-list></library-list>";
 	} else {
-		return current_thread->process.BuildLibraryList();
+		return current_thread->process.BuildLibraryList(symbol_cache);
+	}
+}
+
+std::string GdbStub::XferReadThreads() {
+	std::stringstream ss;
+	ss << "<?xml version=\"1.0\"?>";
+	ss << "<threads>";
+	for(auto &p : attached_processes) {
+		p.second.FetchThreadNames();
+		for(auto &t : p.second.threads) {
+			ss << "<thread id=\"";
+			if(multiprocess_enabled) {
+				ss << "p" << std::hex << p.first << ".";
+			}
+			ss << std::hex << t.first << "\"";
+			if(t.second.name) {
+				std::string name = EscapeXml(*t.second.name);
+				ss << " name=\"" << name << "\">" << name << "</thread>";
+			} else {
+				ss << "/>";
+			}
+		}
+	}
+	ss << "</threads>";
+	return ss.str();
+}
+
+std::string GdbStub::XferReadTargetDescription() {
+	std::stringstream ss;
+	ss << "<?xml version=\"1.0\"?>";
+	ss << "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">";
+	ss << "<target version=\"1.0\">";
+	ss << "<architecture>aarch64</architecture>";
+	ss << "<feature name=\"org.gnu.gdb.aarch64.core\">";
+	for(int i = 0; i < 31; i++) {
+		ss << "<reg name=\"x" << i << "\" bitsize=\"64\" regnum=\"" << i << "\"/>";
+	}
+	ss << "<reg name=\"sp\" bitsize=\"64\" type=\"data_ptr\" regnum=\"31\"/>";
+	ss << "<reg name=\"pc\" bitsize=\"64\" type=\"code_ptr\" regnum=\"32\"/>";
+	ss << "<reg name=\"cpsr\" bitsize=\"32\" regnum=\"33\"/>";
+	ss << "</feature>";
+	ss << "<feature name=\"org.gnu.gdb.aarch64.fpu\">";
+	ss << "<vector id=\"v2d\" type=\"ieee_double\" count=\"2\"/>";
+	ss << "<vector id=\"v2u\" type=\"uint64\" count=\"2\"/>";
+	ss << "<vector id=\"v4f\" type=\"ieee_single\" count=\"4\"/>";
+	ss << "<vector id=\"v4u\" type=\"uint32\" count=\"4\"/>";
+	ss << "<vector id=\"v8u\" type=\"uint16\" count=\"8\"/>";
+	ss << "<vector id=\"v16u\" type=\"uint8\" count=\"16\"/>";
+	ss << "<union id=\"aarch64v\">";
+	ss << "<field name=\"d\" type=\"v2d\"/><field name=\"ud\" type=\"v2u\"/>";
+	ss << "<field name=\"s\" type=\"v4f\"/><field name=\"us\" type=\"v4u\"/>";
+	ss << "<field name=\"h\" type=\"v8u\"/><field name=\"b\" type=\"v16u\"/>";
+	ss << "<field name=\"q\" type=\"uint128\"/>";
+	ss << "</union>";
+	for(int i = 0; i < 32; i++) {
+		ss << "<reg name=\"v" << i << "\" bitsize=\"128\" type=\"aarch64v\" regnum=\"" << (34 + i) << "\"/>";
+	}
+	// ThreadContext has these the other way around from GDB's usual order,
+	// which is fine since GDB goes by name
+	ss << "<reg name=\"fpcr\" bitsize=\"32\" regnum=\"66\"/>";
+	ss << "<reg name=\"fpsr\" bitsize=\"32\" regnum=\"67\"/>";
+	ss << "</feature>";
+	ss << "</target>";
+	return ss.str();
+}
+
+std::string GdbStub::XferReadMemoryMap() {
+	if(current_thread == nullptr) {
+		// an empty map means no restrictions
+		return "<memory-map></memory-map>";
+	} else {
+		return current_thread->process.BuildMemoryMap();
 	}
 }
 
@@ -20,10 +20,13 @@
 
 #pragma once
 
+#include<deque>
+#include<future>
 #include<optional>
 #include<unordered_map>
 
 #include "GdbConnection.hpp"
+#include "SymbolCache.hpp"
 #include "interfaces/ITwibDeviceInterface.hpp"
 #include "interfaces/ITwibDebugger.hpp"
 
@@ -81,6 +84,9 @@ class GdbStub {
 	 private:
 		GdbStub &stub;
 		std::string (GdbStub::*const generator)();
+		// GDB reads objects in pieces, so the string is only generated for
+		// the first piece and the rest come from here
+		std::string cached;
 	};
 
 	class Process;
@@ -93,19 +99,69 @@ class GdbStub {
 		Process &process;
 		uint64_t thread_id = 0;
 		uint64_t tls_addr = 0;
+		// only valid while the process is stopped
+		std::optional<ThreadContext> cached_context;
+		std::optional<std::string> name; // see Process::FetchThreadNames
+		// In non-stop mode, whether GDB thinks this thread is stopped. In
+		// all-stop mode, threads are always marked stopped.
+		bool stopped = true;
+		int stop_signal = 0; // for '?' in non-stop mode
 	};
 
 	class Process {
 	 public:
 		Process(uint64_t pid, ITwibDebugger debugger);
 		bool IngestEvents(GdbStub &stub); // returns whether process is stopped
-		std::string BuildLibraryList();
+		std::string BuildStopReason(char style, int signal, uint64_t thread_id);
+		// Cached until the process runs again, and then only regenerated if
+		// the module list changed.
+		std::string BuildLibraryList(const SymbolCache *symbol_cache);
+		std::string BuildMemoryMap();
+		// Fetches every thread's registers and frame records in one request,
+		// since GDB asks for them one packet at a time after each stop.
+		void FillCaches();
+		void Continue(); // invalidates caches
+		// Non-stop mode: continues every thread that isn't marked stopped.
+		// The process must be broken in.
+		void ContinueThreads();
+		// Sends the requests that GDB's queries after a stop will need
+		// (module lists and thread names) without waiting for them, so that
+		// they're answered while FillCaches waits on its own request.
+		void Prefetch();
+		// Looks up names for every thread that doesn't have one yet in one
+		// request, or collects the one Prefetch sent. Threads are often named
+		// after they start, so threads without names are tried again next
+		// time.
+		void FetchThreadNames();
+		std::vector<uint8_t> ReadMemory(uint64_t addr, uint64_t size);
+		void WriteMemory(uint64_t addr, std::vector<uint8_t> &bytes);
 		uint64_t pid;
 		ITwibDebugger debugger;
 		std::map<uint64_t, Thread> threads;
 		std::vector<uint64_t> running_thread_ids;
+		// threads that GDB asked to stop with vCont;t, which stop once we
+		// see the DebuggerBreak event
+		std::vector<uint64_t> stop_requests;
 		std::shared_ptr<bool> has_events;
 		bool running = false;
+		bool caches_filled = false;
+		std::map<uint64_t, FrameRecord> frame_records; // by address
+		// NSOs are all loaded before the process starts, so only NROs can
+		// change once we have the NSO list
+		std::optional<std::vector<nx::LoadedModuleInfo>> nsos;
+		std::vector<nx::LoadedModuleInfo> nros;
+		std::string library_list;
+		bool library_list_stale = true;
+		// in flight, from Prefetch or BuildLibraryList; dropped when the
+		// process runs again
+		std::future<std::vector<nx::LoadedModuleInfo>> pending_nsos;
+		std::future<std::vector<nx::LoadedModuleInfo>> pending_nros;
+		// in flight, from Prefetch or FetchThreadNames
+		std::future<std::vector<uint8_t>> pending_names;
+		std::vector<uint64_t> pending_name_threads; // thread ids, in request order
+	 private:
+		void RequestLibraryList();
+		void RequestThreadNames();
 	};
 	
 	Thread *current_thread = nullptr;
@@ -121,8 +177,14 @@ class GdbStub {
 	bool waiting_for_stop = false;
 	bool has_async_wait = false;
 	bool multiprocess_enabled = false;
+	bool non_stop = false;
+	const SymbolCache *symbol_cache = nullptr; // optional
 
 	void Stop();
+	// In non-stop mode, stop replies wait here until GDB collects them
+	// with vStopped. The one at the front has been sent as a %Stop
+	// notification but not acknowledged yet.
+	void QueueStop(std::string reason);
 	
  private:
 	ITwibDeviceInterface &itdi;
@@ -163,11 +225,14 @@ class GdbStub {
 	void HandleSetCurrentThread(util::Buffer &packet);
 	void HandleReadMemory(util::Buffer &packet);
 	void HandleWriteMemory(util::Buffer &packet);
+	void HandleReadRegister(util::Buffer &packet);
+	void HandleWriteRegister(util::Buffer &packet);
 	
 	// multiletter packets
 	void HandleVAttach(util::Buffer &packet);
 	void HandleVContQuery(util::Buffer &packet);
 	void HandleVCont(util::Buffer &packet);
+	void HandleVStopped(util::Buffer &packet);
 	
 	// get queries
 	void QueryGetSupported(util::Buffer &packet);
@@ -182,12 +247,20 @@ class GdbStub {
 	// set queries
 	void QuerySetStartNoAckMode(util::Buffer &packet);
 	void QuerySetThreadEvents(util::Buffer &packet);
+	void QuerySetNonStop(util::Buffer &packet);
 
 	// xfer objects
 	std::string XferReadLibraries();
+	std::string XferReadMemoryMap();
+	std::string XferReadTargetDescription();
+	std::string XferReadThreads();
 	ReadOnlyStringXferObject xfer_libraries;
+	ReadOnlyStringXferObject xfer_memory_map;
+	ReadOnlyStringXferObject xfer_features;
+	ReadOnlyStringXferObject xfer_threads;
 	
 	bool thread_events_enabled = false;
+	std::deque<std::string> pending_stops;
 };
 
 } // namespace gdb
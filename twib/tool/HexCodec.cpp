@@ -0,0 +1,323 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "HexCodec.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TWIB_HEX_SSE2 1
+#include<emmintrin.h>
+#endif
+
+// AVX2 is picked at runtime, since release builds don't assume it
+#if TWIB_HEX_SSE2 == 1 && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TWIB_HEX_AVX2 1
+#include<immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TWIB_HEX_NEON 1
+#include<arm_neon.h>
+#endif
+
+namespace twili {
+namespace twib {
+namespace tool {
+namespace gdb {
+namespace hex {
+
+static const char ENCODE_TABLE[] = "0123456789abcdef";
+
+// 0x80 marks characters that aren't hex digits. Its low nybble is zero, so
+// they decode as 0 like they always have.
+static const uint8_t DECODE_TABLE[256] = {
+#define X 0x80
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+	X, 10, 11, 12, 13, 14, 15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, 10, 11, 12, 13, 14, 15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+#undef X
+};
+
+void EncodeScalar(const uint8_t *src, size_t size, char *dest) {
+	for(size_t i = 0; i < size; i++) {
+		dest[i * 2 + 0] = ENCODE_TABLE[src[i] >> 4];
+		dest[i * 2 + 1] = ENCODE_TABLE[src[i] & 0xf];
+	}
+}
+
+bool DecodeScalar(const char *src, size_t size, uint8_t *dest) {
+	uint8_t invalid = 0;
+	for(size_t i = 0; i < size; i++) {
+		uint8_t hi = DECODE_TABLE[(uint8_t) src[i * 2 + 0]];
+		uint8_t lo = DECODE_TABLE[(uint8_t) src[i * 2 + 1]];
+		invalid|= hi | lo;
+		dest[i] = ((hi & 0xf) << 4) | (lo & 0xf);
+	}
+	// only the invalid marker has the high bit set
+	return !(invalid & 0x80);
+}
+
+#if TWIB_HEX_SSE2 == 1
+
+// nybbles (0-15 in each byte) to lowercase hex characters
+static inline __m128i NybblesToHexSSE2(__m128i n) {
+	__m128i letters = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+	return _mm_add_epi8(
+		_mm_add_epi8(n, _mm_set1_epi8('0')),
+		_mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+// hex characters to nybbles, clearing `valid` bits for any that aren't hex
+// and leaving their nybbles zero
+static inline __m128i HexToNybblesSSE2(__m128i c, __m128i &valid) {
+	// signed compares are fine here; anything that wraps negative is out of range anyway
+	__m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i digit_mask = _mm_and_si128(
+		_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)),
+		_mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+	__m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i letter_mask = _mm_and_si128(
+		_mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)),
+		_mm_cmplt_epi8(letter, _mm_set1_epi8(6)));
+	valid = _mm_and_si128(valid, _mm_or_si128(digit_mask, letter_mask));
+	return _mm_or_si128(
+		_mm_and_si128(digit, digit_mask),
+		_mm_and_si128(_mm_add_epi8(letter, _mm_set1_epi8(10)), letter_mask));
+}
+
+static size_t EncodeSSE2(const uint8_t *src, size_t size, char *dest) {
+	const __m128i low_mask = _mm_set1_epi8(0xf);
+	size_t i = 0;
+	for(; i + 16 <= size; i+= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i hi = NybblesToHexSSE2(_mm_and_si128(_mm_srli_epi16(v, 4), low_mask));
+		__m128i lo = NybblesToHexSSE2(_mm_and_si128(v, low_mask));
+		_mm_storeu_si128((__m128i*) (dest + i * 2 + 0), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*) (dest + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	return i;
+}
+
+// Returns how many bytes were decoded. Stops early at a block with invalid
+// characters so that the scalar version can handle it.
+static size_t DecodeSSE2(const char *src, size_t size, uint8_t *dest) {
+	const __m128i byte_mask = _mm_set1_epi16(0x00ff);
+	size_t i = 0;
+	for(; i + 16 <= size; i+= 16) {
+		__m128i valid = _mm_set1_epi8(-1);
+		__m128i a = HexToNybblesSSE2(_mm_loadu_si128((const __m128i*) (src + i * 2 + 0)), valid);
+		__m128i b = HexToNybblesSSE2(_mm_loadu_si128((const __m128i*) (src + i * 2 + 16)), valid);
+		if(_mm_movemask_epi8(valid) != 0xffff) {
+			break;
+		}
+		// each 16-bit lane holds (low nybble << 8) | high nybble
+		a = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(a, 4), _mm_srli_epi16(a, 8)), byte_mask);
+		b = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(b, 4), _mm_srli_epi16(b, 8)), byte_mask);
+		_mm_storeu_si128((__m128i*) (dest + i), _mm_packus_epi16(a, b));
+	}
+	return i;
+}
+
+#endif
+
+#if TWIB_HEX_AVX2 == 1
+
+__attribute__((target("avx2")))
+static inline __m256i NybblesToHexAVX2(__m256i n) {
+	__m256i letters = _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9));
+	return _mm256_add_epi8(
+		_mm256_add_epi8(n, _mm256_set1_epi8('0')),
+		_mm256_and_si256(letters, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i HexToNybblesAVX2(__m256i c, __m256i &valid) {
+	__m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+	__m256i digit_mask = _mm256_andnot_si256(
+		_mm256_cmpgt_epi8(_mm256_setzero_si256(), digit),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(10), digit));
+	__m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	__m256i letter_mask = _mm256_andnot_si256(
+		_mm256_cmpgt_epi8(_mm256_setzero_si256(), letter),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(6), letter));
+	valid = _mm256_and_si256(valid, _mm256_or_si256(digit_mask, letter_mask));
+	return _mm256_or_si256(
+		_mm256_and_si256(digit, digit_mask),
+		_mm256_and_si256(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), letter_mask));
+}
+
+__attribute__((target("avx2")))
+static size_t EncodeAVX2(const uint8_t *src, size_t size, char *dest) {
+	const __m256i low_mask = _mm256_set1_epi8(0xf);
+	size_t i = 0;
+	for(; i + 32 <= size; i+= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i hi = NybblesToHexAVX2(_mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+		__m256i lo = NybblesToHexAVX2(_mm256_and_si256(v, low_mask));
+		// unpack works within 128-bit lanes, so put the halves back in order
+		__m256i first = _mm256_unpacklo_epi8(hi, lo);
+		__m256i second = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*) (dest + i * 2 + 0), _mm256_permute2x128_si256(first, second, 0x20));
+		_mm256_storeu_si256((__m256i*) (dest + i * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t DecodeAVX2(const char *src, size_t size, uint8_t *dest) {
+	const __m256i byte_mask = _mm256_set1_epi16(0x00ff);
+	size_t i = 0;
+	for(; i + 32 <= size; i+= 32) {
+		__m256i valid = _mm256_set1_epi8(-1);
+		__m256i a = HexToNybblesAVX2(_mm256_loadu_si256((const __m256i*) (src + i * 2 + 0)), valid);
+		__m256i b = HexToNybblesAVX2(_mm256_loadu_si256((const __m256i*) (src + i * 2 + 32)), valid);
+		if(_mm256_movemask_epi8(valid) != -1) {
+			break;
+		}
+		a = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(a, 4), _mm256_srli_epi16(a, 8)), byte_mask);
+		b = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(b, 4), _mm256_srli_epi16(b, 8)), byte_mask);
+		// pack also works within 128-bit lanes, giving a0 b0 a1 b1
+		__m256i packed = _mm256_packus_epi16(a, b);
+		_mm256_storeu_si256((__m256i*) (dest + i), _mm256_permute4x64_epi64(packed, 0xd8));
+	}
+	return i;
+}
+
+static bool HasAVX2() {
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+}
+
+#endif
+
+#if TWIB_HEX_NEON == 1
+
+static inline uint8x16_t NybblesToHexNEON(uint8x16_t n) {
+	uint8x16_t letters = vcgtq_u8(n, vdupq_n_u8(9));
+	return vaddq_u8(
+		vaddq_u8(n, vdupq_n_u8('0')),
+		vandq_u8(letters, vdupq_n_u8('a' - '0' - 10)));
+}
+
+static inline uint8x16_t HexToNybblesNEON(uint8x16_t c, uint8x16_t &valid) {
+	uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+	uint8x16_t digit_mask = vcltq_u8(digit, vdupq_n_u8(10));
+	uint8x16_t letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	uint8x16_t letter_mask = vcltq_u8(letter, vdupq_n_u8(6));
+	valid = vandq_u8(valid, vorrq_u8(digit_mask, letter_mask));
+	return vorrq_u8(
+		vandq_u8(digit, digit_mask),
+		vandq_u8(vaddq_u8(letter, vdupq_n_u8(10)), letter_mask));
+}
+
+static size_t EncodeNEON(const uint8_t *src, size_t size, char *dest) {
+	size_t i = 0;
+	for(; i + 16 <= size; i+= 16) {
+		uint8x16_t v = vld1q_u8(src + i);
+		uint8x16x2_t chars;
+		chars.val[0] = NybblesToHexNEON(vshrq_n_u8(v, 4));
+		chars.val[1] = NybblesToHexNEON(vandq_u8(v, vdupq_n_u8(0xf)));
+		vst2q_u8((uint8_t*) (dest + i * 2), chars); // interleaves hi, lo
+	}
+	return i;
+}
+
+static size_t DecodeNEON(const char *src, size_t size, uint8_t *dest) {
+	size_t i = 0;
+	for(; i + 16 <= size; i+= 16) {
+		uint8x16x2_t chars = vld2q_u8((const uint8_t*) (src + i * 2)); // deinterleaves hi, lo
+		uint8x16_t valid = vdupq_n_u8(0xff);
+		uint8x16_t hi = HexToNybblesNEON(chars.val[0], valid);
+		uint8x16_t lo = HexToNybblesNEON(chars.val[1], valid);
+		uint64x2_t valid64 = vreinterpretq_u64_u8(valid);
+		if((vgetq_lane_u64(valid64, 0) & vgetq_lane_u64(valid64, 1)) != ~(uint64_t) 0) {
+			break;
+		}
+		vst1q_u8(dest + i, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+	}
+	return i;
+}
+
+#endif
+
+void Encode(const uint8_t *src, size_t size, char *dest) {
+	size_t i = 0;
+#if TWIB_HEX_AVX2 == 1
+	if(HasAVX2()) {
+		i = EncodeAVX2(src, size, dest);
+	}
+#endif
+#if TWIB_HEX_SSE2 == 1
+	i+= EncodeSSE2(src + i, size - i, dest + i * 2);
+#elif TWIB_HEX_NEON == 1
+	i+= EncodeNEON(src + i, size - i, dest + i * 2);
+#endif
+	EncodeScalar(src + i, size - i, dest + i * 2);
+}
+
+bool Decode(const char *src, size_t size, uint8_t *dest) {
+	size_t i = 0;
+#if TWIB_HEX_AVX2 == 1
+	if(HasAVX2()) {
+		i = DecodeAVX2(src, size, dest);
+	}
+#endif
+#if TWIB_HEX_SSE2 == 1
+	i+= DecodeSSE2(src + i * 2, size - i, dest + i);
+#elif TWIB_HEX_NEON == 1
+	i+= DecodeNEON(src + i * 2, size - i, dest + i);
+#endif
+	// the vector versions stop at the first block with invalid characters,
+	// so anything invalid ends up here and gets reported
+	return DecodeScalar(src + i * 2, size - i, dest + i);
+}
+
+const char *GetImplementationName() {
+#if TWIB_HEX_AVX2 == 1
+	if(HasAVX2()) {
+		return "avx2";
+	}
+#endif
+#if TWIB_HEX_SSE2 == 1
+	return "sse2";
+#elif TWIB_HEX_NEON == 1
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+} // namespace hex
+} // namespace gdb
+} // namespace tool
+} // namespace twib
+} // namespace twili
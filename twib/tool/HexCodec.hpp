@@ -0,0 +1,53 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2019 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<stddef.h>
+#include<stdint.h>
+
+namespace twili {
+namespace twib {
+namespace tool {
+namespace gdb {
+namespace hex {
+
+// Bulk hex codecs for GDB remote protocol payloads. These pick the widest
+// vector implementation the host supports (AVX2, SSE2, NEON) and fall back
+// to the scalar versions for any tail that doesn't fill a vector.
+
+// Writes 2 * size lowercase hex characters to dest.
+void Encode(const uint8_t *src, size_t size, char *dest);
+// Reads 2 * size hex characters from src and writes size bytes to dest.
+// Invalid characters decode as zero nybbles and make this return false.
+bool Decode(const char *src, size_t size, uint8_t *dest);
+
+// Reference implementations, kept around to check the vector ones against.
+void EncodeScalar(const uint8_t *src, size_t size, char *dest);
+bool DecodeScalar(const char *src, size_t size, uint8_t *dest);
+
+// Name of the implementation Encode/Decode dispatch to.
+const char *GetImplementationName();
+
+} // namespace hex
+} // namespace gdb
+} // namespace tool
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,109 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "MemoryMap.hpp"
+
+#include "common/Logger.hpp"
+#include "common/ResultError.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+static const char *memory_type_names[] = {
+	"unmapped",
+	"io",
+	"normal",
+	"code",
+	"code-mutable",
+	"heap",
+	"shared",
+	"alias",
+	"module-code",
+	"module-code-mutable",
+	"ipc-buffer0",
+	"stack",
+	"tls",
+	"transfer-isolated",
+	"transfer",
+	"process",
+	"reserved",
+	"ipc-buffer1",
+	"ipc-buffer3",
+	"kernel-stack",
+	"code-readonly",
+	"code-writable",
+};
+
+static const size_t memory_type_count = sizeof(memory_type_names) / sizeof(memory_type_names[0]);
+
+static void TagRegions(std::vector<MemoryMap::Region> &regions, const std::vector<nx::LoadedModuleInfo> &modules, const char *type) {
+	for(MemoryMap::Region &region : regions) {
+		for(const nx::LoadedModuleInfo &module : modules) {
+			if(region.info.base_addr >= module.base_addr && region.info.base_addr - module.base_addr < module.size) {
+				region.module_type = type;
+				region.module = &module;
+				break;
+			}
+		}
+	}
+}
+
+MemoryMap::MemoryMap(ITwibDebugger &debugger) {
+	for(nx::MemoryInfo &info : debugger.GetMemoryMap()) {
+		regions.push_back(Region {info});
+	}
+	
+	try {
+		nsos = debugger.GetNsoInfos();
+	} catch(ResultError &e) {
+		LogMessage(Warning, "caught 0x%x reading NSO list", e.code);
+	}
+	try {
+		nros = debugger.GetNroInfos();
+	} catch(ResultError &e) {
+		LogMessage(Warning, "caught 0x%x reading NRO list", e.code);
+	}
+
+	TagRegions(regions, nsos, "nso");
+	TagRegions(regions, nros, "nro");
+}
+
+const char *GetMemoryTypeName(uint32_t type) {
+	type&= 0xff;
+	if(type < memory_type_count) {
+		return memory_type_names[type];
+	} else {
+		return "unknown";
+	}
+}
+
+std::optional<uint32_t> ParseMemoryTypeName(const std::string &name) {
+	for(uint32_t i = 0; i < memory_type_count; i++) {
+		if(name == memory_type_names[i]) {
+			return i;
+		}
+	}
+	return std::nullopt;
+}
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,60 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<optional>
+#include<string>
+#include<vector>
+
+#include "interfaces/ITwibDebugger.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+// A process's whole address space, with each region tagged with the NSO or
+// NRO it belongs to, if any. Takes three requests no matter how many
+// regions there are.
+class MemoryMap {
+ public:
+	struct Region {
+		nx::MemoryInfo info;
+		const char *module_type = nullptr; // "nso", "nro", or nullptr
+		const nx::LoadedModuleInfo *module = nullptr; // points into nsos or nros
+	};
+
+	MemoryMap(ITwibDebugger &debugger);
+	MemoryMap(const MemoryMap &other) = delete;
+	MemoryMap(MemoryMap &&other) = default;
+
+	std::vector<nx::LoadedModuleInfo> nsos;
+	std::vector<nx::LoadedModuleInfo> nros;
+	std::vector<Region> regions;
+};
+
+// Short names for memory types, as printed by `twib vmmap` and accepted by
+// `twib scan-memory --type`.
+const char *GetMemoryTypeName(uint32_t type);
+std::optional<uint32_t> ParseMemoryTypeName(const std::string &name);
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
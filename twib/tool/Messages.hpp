@@ -59,6 +59,7 @@ class Request {
 	uint32_t command_id;
 	uint32_t tag;
 	std::vector<uint8_t> payload;
+	std::vector<uint32_t> object_ids; // objects passed by reference, see in_object
  private:
 };
 
@@ -51,6 +51,17 @@ struct out {
 	T &&value;
 };
 
+// Passes an object that the device already knows about by reference. T is
+// one of the interface wrappers, which expose their RemoteObject through
+// GetObject().
+template<typename T>
+struct in_object {
+	in_object(T &value) : value(value) {
+	}
+
+	T &value;
+};
+
 template<typename T>
 struct out_object {
 	out_object(std::optional<T> &value) : value(value) {
@@ -150,7 +161,7 @@ struct WrappingHelper;
 
 template<typename T>
 struct WrappingHelper<in<T>> {
-	static void Pack(in<T> &&param, util::Buffer &input_buffer) {
+	static void Pack(in<T> &&param, util::Buffer &input_buffer, std::vector<std::shared_ptr<RemoteObject>> &objects) {
 		PackingHelper<T>::Pack(std::move(param.value), input_buffer);
 	}
 	static bool Unpack(in<T> &&param, util::Buffer &output_buffer, std::vector<std::shared_ptr<RemoteObject>> objects) {
@@ -161,7 +172,7 @@ struct WrappingHelper<in<T>> {
 
 template<typename T>
 struct WrappingHelper<out<T>> {
-	static void Pack(out<T> &&param, util::Buffer &input_buffer) {
+	static void Pack(out<T> &&param, util::Buffer &input_buffer, std::vector<std::shared_ptr<RemoteObject>> &objects) {
 		// no-op
 	}
 	static bool Unpack(out<T> &&param, util::Buffer &output_buffer, std::vector<std::shared_ptr<RemoteObject>> objects) {
@@ -169,9 +180,21 @@ struct WrappingHelper<out<T>> {
 	}
 };
 
+template<typename T>
+struct WrappingHelper<in_object<T>> {
+	static void Pack(in_object<T> &&param, util::Buffer &input_buffer, std::vector<std::shared_ptr<RemoteObject>> &objects) {
+		input_buffer.Write<uint32_t>(objects.size());
+		objects.push_back(param.value.GetObject());
+	}
+	static bool Unpack(in_object<T> &&param, util::Buffer &output_buffer, std::vector<std::shared_ptr<RemoteObject>> objects) {
+		// no-op
+		return true;
+	}
+};
+
 template<typename T>
 struct WrappingHelper<out_object<T>> {
-	static void Pack(out_object<T> &&param, util::Buffer &input_buffer) {
+	static void Pack(out_object<T> &&param, util::Buffer &input_buffer, std::vector<std::shared_ptr<RemoteObject>> &objects) {
 		// no-op
 	}
 	static bool Unpack(out_object<T> &&param, util::Buffer &output_buffer, std::vector<std::shared_ptr<RemoteObject>> objects) {
@@ -0,0 +1,185 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Profile.hpp"
+
+#include<algorithm>
+#include<cstring>
+
+#include<inttypes.h>
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+static const char PROFILE_MAGIC[8] = {'T', 'W', 'P', 'R', 'O', 'F', '0', '1'};
+
+Profile::Profile(std::vector<Module> modules, bool use_lr) : symbolizer(modules), use_lr(use_lr) {
+}
+
+bool Profile::AddBatch(const std::vector<uint64_t> &words) {
+	// parse everything before adding anything, so a bad batch leaves no trace
+	std::vector<std::string> new_stacks;
+	uint64_t new_samples = 0, pause_ticks = 0, max_pause = 0, first = 0, last = 0;
+	
+	size_t i = 0;
+	auto take = [&](uint64_t &out) {
+		if(i >= words.size()) {
+			return false;
+		}
+		out = words[i++];
+		return true;
+	};
+	
+	while(i < words.size()) {
+		uint64_t tick, pause, thread_count;
+		if(!take(tick) || !take(pause) || !take(thread_count)) {
+			return false;
+		}
+		if(new_samples == 0) {
+			first = tick;
+		}
+		last = tick;
+		new_samples++;
+		pause_ticks+= pause;
+		max_pause = std::max(max_pause, pause);
+		
+		for(uint64_t t = 0; t < thread_count; t++) {
+			uint64_t thread_id, lr, frame_count;
+			if(!take(thread_id) || !take(lr) || !take(frame_count) ||
+				 frame_count == 0 || frame_count > words.size() - i) {
+				return false;
+			}
+			const uint64_t *frames = words.data() + i;
+			i+= frame_count;
+
+			// outermost frame first
+			std::string stack;
+			for(uint64_t f = frame_count - 1; f > 0; f--) {
+				stack+= GetName(frames[f] - 4);
+				stack+= ";";
+			}
+			if(use_lr && lr != 0 && (frame_count < 2 || frames[1] != lr)) {
+				stack+= GetName(lr - 4);
+				stack+= ";";
+			}
+			stack+= GetName(frames[0]);
+			new_stacks.push_back(std::move(stack));
+		}
+	}
+
+	for(std::string &stack : new_stacks) {
+		stacks[stack]++;
+	}
+	if(new_samples > 0) {
+		if(samples == 0) {
+			first_tick = first;
+		}
+		last_tick = last;
+	}
+	samples+= new_samples;
+	thread_samples+= new_stacks.size();
+	total_pause_ticks+= pause_ticks;
+	max_pause_ticks = std::max(max_pause_ticks, max_pause);
+	return true;
+}
+
+const std::string &Profile::GetName(uint64_t addr) {
+	auto i = names.find(addr);
+	if(i == names.end()) {
+		i = names.emplace(addr, symbolizer.Symbolize(addr)).first;
+	}
+	return i->second;
+}
+
+void Profile::WriteFolded(FILE *f) const {
+	for(auto &stack : stacks) {
+		fprintf(f, "%s %" PRIu64 "\n", stack.first.c_str(), stack.second);
+	}
+}
+
+static bool WriteWord(FILE *f, uint64_t word) {
+	return fwrite(&word, sizeof(word), 1, f) == 1;
+}
+
+static bool ReadWord(FILE *f, uint64_t &word) {
+	return fread(&word, sizeof(word), 1, f) == 1;
+}
+
+bool WriteProfileHeader(FILE *f, const std::vector<Profile::Module> &modules) {
+	if(fwrite(PROFILE_MAGIC, sizeof(PROFILE_MAGIC), 1, f) != 1 || !WriteWord(f, modules.size())) {
+		return false;
+	}
+	for(const Profile::Module &module : modules) {
+		if(!WriteWord(f, module.base) || !WriteWord(f, module.size) || !WriteWord(f, module.name.size()) ||
+			 fwrite(module.name.data(), 1, module.name.size(), f) != module.name.size()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool WriteProfileBatch(FILE *f, const std::vector<uint64_t> &words) {
+	return WriteWord(f, words.size()) &&
+		(words.empty() || fwrite(words.data(), sizeof(uint64_t), words.size(), f) == words.size());
+}
+
+bool ReadProfileRecording(FILE *f, std::vector<Profile::Module> &modules, std::vector<std::vector<uint64_t>> &batches) {
+	char magic[sizeof(PROFILE_MAGIC)];
+	uint64_t module_count;
+	if(fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, PROFILE_MAGIC, sizeof(magic)) != 0 ||
+		 !ReadWord(f, module_count)) {
+		return false;
+	}
+
+	modules.clear();
+	for(uint64_t i = 0; i < module_count; i++) {
+		Profile::Module module;
+		uint64_t name_size;
+		if(!ReadWord(f, module.base) || !ReadWord(f, module.size) || !ReadWord(f, name_size) || name_size > 0x1000) {
+			return false;
+		}
+		module.name.resize(name_size);
+		if(fread(&module.name[0], 1, name_size, f) != name_size) {
+			return false;
+		}
+		modules.push_back(module);
+	}
+
+	batches.clear();
+	uint64_t word_count;
+	while(ReadWord(f, word_count)) {
+		std::vector<uint64_t> words;
+		// grow as we go rather than trusting the count with an allocation
+		uint64_t word;
+		for(uint64_t i = 0; i < word_count; i++) {
+			if(!ReadWord(f, word)) {
+				return false;
+			}
+			words.push_back(word);
+		}
+		batches.push_back(std::move(words));
+	}
+	return feof(f);
+}
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,85 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<map>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+#include<stdint.h>
+#include<stdio.h>
+
+#include "Symbolizer.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+// Aggregates ITwibDebugger::Sample records into folded stacks
+// ("outer;inner;leaf count" lines), which is what flamegraph.pl and most
+// flame graph viewers take. Frames are named by Symbolizer. Return
+// addresses are backed up to the call instruction.
+class Profile {
+ public:
+	static const uint64_t TICKS_PER_SECOND = 19200000;
+	
+	using Module = Symbolizer::Module;
+
+	// use_lr adds the link register as the caller of the leaf frame when
+	// the frame pointer walk didn't find it. This helps with leaf functions
+	// that don't set up a frame, but adds a bogus frame when the leaf
+	// function did, since lr then points back into the leaf function.
+	Profile(std::vector<Module> modules, bool use_lr = false);
+
+	// Adds nothing and returns false if the batch is malformed.
+	bool AddBatch(const std::vector<uint64_t> &words);
+	void WriteFolded(FILE *f) const;
+
+	inline const std::map<std::string, uint64_t> &GetStacks() const { return stacks; }
+
+	uint64_t samples = 0;
+	uint64_t thread_samples = 0;
+	uint64_t total_pause_ticks = 0;
+	uint64_t max_pause_ticks = 0;
+	uint64_t first_tick = 0;
+	uint64_t last_tick = 0;
+	
+ private:
+	Symbolizer symbolizer;
+	bool use_lr;
+	std::map<std::string, uint64_t> stacks;
+	// the same few thousand addresses come up over and over
+	std::unordered_map<uint64_t, std::string> names;
+
+	const std::string &GetName(uint64_t addr);
+};
+
+// Recordings made by `twib profile --record` hold the module list followed
+// by each Sample response as it arrived, so they can be aggregated again
+// later without the device.
+bool WriteProfileHeader(FILE *f, const std::vector<Profile::Module> &modules);
+bool WriteProfileBatch(FILE *f, const std::vector<uint64_t> &words);
+bool ReadProfileRecording(FILE *f, std::vector<Profile::Module> &modules, std::vector<std::vector<uint64_t>> &batches);
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
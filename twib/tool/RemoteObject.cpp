@@ -20,9 +20,6 @@
 
 #include "RemoteObject.hpp"
 
-#include<mutex>
-#include<condition_variable>
-
 #include "common/Logger.hpp"
 #include "common/ResultError.hpp"
 
@@ -36,33 +33,43 @@ RemoteObject::RemoteObject(client::Client &client, uint32_t device_id, uint32_t
 }
 
 RemoteObject::~RemoteObject() {
-	// send close request if we're not object 0
+	// send close request if we're not object 0. twibd answers these
+	// without waiting on the device, and there's nothing useful to do if it
+	// fails, so don't block on the response.
 	if(object_id != 0) {
-		SendSyncRequestWithoutAssert(0xffffffff);
+		SendRequest(protocol::CLOSE_OBJECT, std::vector<uint8_t>(), [](Response rs) {});
 	}
 }
 
 void RemoteObject::SendRequest(uint32_t command_id, std::vector<uint8_t> payload, std::function<void(Response)> &&func) {
-	return client.SendRequest(Request(device_id, object_id, command_id, 0, payload), std::move(func));
+	return client.SendRequest(Request(device_id, object_id, command_id, 0, std::move(payload)), std::move(func));
 }
 
-Response RemoteObject::SendSyncRequestWithoutAssert(uint32_t command_id, std::vector<uint8_t> payload) {
-	std::mutex mutex;
-	std::unique_lock<std::mutex> lock(mutex);
-	std::condition_variable condvar;
-	std::optional<Response> rs;
+void RemoteObject::SendRequest(uint32_t command_id, std::vector<uint8_t> payload, const std::vector<std::shared_ptr<RemoteObject>> &objects, std::function<void(Response)> &&func) {
+	Request rq(device_id, object_id, command_id, 0, std::move(payload));
+	rq.object_ids.reserve(objects.size());
+	for(auto &object : objects) {
+		if(object->device_id != device_id) {
+			throw ResultError(TWILI_ERR_PROTOCOL_BAD_REQUEST);
+		}
+		rq.object_ids.push_back(object->object_id);
+	}
+	return client.SendRequest(std::move(rq), std::move(func));
+}
 
+std::future<Response> RemoteObject::SendAsyncRequest(uint32_t command_id, std::vector<uint8_t> payload, const std::vector<std::shared_ptr<RemoteObject>> &objects) {
+	std::shared_ptr<std::promise<Response>> promise = std::make_shared<std::promise<Response>>();
+	std::future<Response> future = promise->get_future();
 	SendRequest(
-		command_id, payload,
-		[&](Response rs_actual) {
-			rs = rs_actual;
-			condvar.notify_all();
+		command_id, std::move(payload), objects,
+		[promise](Response rs) {
+			promise->set_value(std::move(rs));
 		});
-	
-	while(!rs) {
-		condvar.wait(lock);
-	}
-	return *rs;
+	return future;
+}
+
+Response RemoteObject::SendSyncRequestWithoutAssert(uint32_t command_id, std::vector<uint8_t> payload, const std::vector<std::shared_ptr<RemoteObject>> &objects) {
+	return SendAsyncRequest(command_id, std::move(payload), objects).get();
 }
 
 Response RemoteObject::SendSyncRequest(uint32_t command_id, std::vector<uint8_t> payload) {
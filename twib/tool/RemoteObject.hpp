@@ -21,6 +21,7 @@
 #pragma once
 
 #include<functional>
+#include<future>
 
 #include "common/ResultError.hpp"
 
@@ -38,14 +39,21 @@ class RemoteObject {
 	~RemoteObject();
 
 	void SendRequest(uint32_t command_id, std::vector<uint8_t> payload, std::function<void(Response)> &&func);
-	Response SendSyncRequestWithoutAssert(uint32_t command_id, std::vector<uint8_t> payload = std::vector<uint8_t>());
+	// Objects passed along with a request must live on the same device as
+	// this object.
+	void SendRequest(uint32_t command_id, std::vector<uint8_t> payload, const std::vector<std::shared_ptr<RemoteObject>> &objects, std::function<void(Response)> &&func);
+	// Sends a request without waiting for it. Any number of these may be in
+	// flight at once; the future is fulfilled by the client's receive thread.
+	std::future<Response> SendAsyncRequest(uint32_t command_id, std::vector<uint8_t> payload = std::vector<uint8_t>(), const std::vector<std::shared_ptr<RemoteObject>> &objects = {});
+	Response SendSyncRequestWithoutAssert(uint32_t command_id, std::vector<uint8_t> payload = std::vector<uint8_t>(), const std::vector<std::shared_ptr<RemoteObject>> &objects = {});
 	Response SendSyncRequest(uint32_t command_id, std::vector<uint8_t> payload = std::vector<uint8_t>());
 
 	template<typename T, typename... Args>
 	uint32_t SendSmartSyncRequestWithoutAssert(T command_id, Args&&... args) {
 		util::Buffer input_buffer;
-		(detail::WrappingHelper<Args>::Pack(std::move(args), input_buffer), ...);
-		Response r = SendSyncRequestWithoutAssert((uint32_t) command_id, input_buffer.GetData());
+		std::vector<std::shared_ptr<RemoteObject>> input_objects;
+		(detail::WrappingHelper<Args>::Pack(std::move(args), input_buffer, input_objects), ...);
+		Response r = SendSyncRequestWithoutAssert((uint32_t) command_id, input_buffer.GetData(), input_objects);
 		if(r.result_code) {
 			return r.result_code;
 		}
@@ -64,13 +72,49 @@ class RemoteObject {
 		}
 	}
 
+	// Packs the (input-only) arguments, sends the request, and returns a
+	// future for the single value of type R that the response carries. A
+	// failing result code is reported as a ResultError from get().
+	template<typename R, typename T, typename... Args>
+	std::future<R> SendSmartAsyncRequest(T command_id, Args&&... args) {
+		util::Buffer input_buffer;
+		std::vector<std::shared_ptr<RemoteObject>> input_objects;
+		(detail::WrappingHelper<Args>::Pack(std::move(args), input_buffer, input_objects), ...);
+		std::shared_ptr<std::promise<R>> promise = std::make_shared<std::promise<R>>();
+		std::future<R> future = promise->get_future();
+		SendRequest(
+			(uint32_t) command_id,
+			input_buffer.GetData(),
+			input_objects,
+			[promise](Response r) {
+				if(r.result_code) {
+					promise->set_exception(std::make_exception_ptr(ResultError(r.result_code)));
+					return;
+				}
+				if constexpr(std::is_void<R>::value) {
+					promise->set_value();
+				} else {
+					util::Buffer output_buffer(r.payload);
+					R value;
+					if(!detail::PackingHelper<R>::Unpack(std::move(value), output_buffer)) {
+						promise->set_exception(std::make_exception_ptr(ResultError(TWILI_ERR_PROTOCOL_BAD_RESPONSE)));
+					} else {
+						promise->set_value(std::move(value));
+					}
+				}
+			});
+		return future;
+	}
+
 	template<typename T, typename... Args>
 	void SendSmartRequest(T command_id, std::function<void(uint32_t)> &&func, Args&&... args) {
 		util::Buffer input_buffer;
-		(detail::WrappingHelper<Args>::Pack(std::move(args), input_buffer), ...);
+		std::vector<std::shared_ptr<RemoteObject>> input_objects;
+		(detail::WrappingHelper<Args>::Pack(std::move(args), input_buffer, input_objects), ...);
 		SendRequest(
 			(uint32_t) command_id,
 			input_buffer.GetData(),
+			input_objects,
 			[&, func{std::move(func)}](Response r) {
 				if(r.result_code) {
 					func(r.result_code);
@@ -84,6 +128,14 @@ class RemoteObject {
 			});
 	}
 	
+	uint32_t GetDeviceId() const {
+		return device_id;
+	}
+
+	uint32_t GetObjectId() const {
+		return object_id;
+	}
+	
  private:
 	client::Client &client;
 	const uint32_t device_id;
@@ -43,9 +43,9 @@ void SocketClient::SendRequestImpl(const Request &rq) {
 	mh.command_id = rq.command_id;
 	mh.tag = rq.tag;
 	mh.payload_size = rq.payload.size();
-	mh.object_count = 0;
+	mh.object_count = rq.object_ids.size();
 
-	connection.SendMessage(mh, rq.payload, std::vector<uint32_t>());
+	connection.SendMessage(mh, rq.payload, rq.object_ids);
 	LogMessage(Debug, "sent request");
 }
 
@@ -0,0 +1,271 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "SymbolCache.hpp"
+
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+#include<vector>
+
+#include<string.h>
+
+#include "platform/platform.hpp"
+#include "common/Logger.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+static std::string BuildIdToString(const uint8_t *build_id, size_t size) {
+	static const char digits[] = "0123456789abcdef";
+	while(size > 0 && build_id[size - 1] == 0) {
+		size--;
+	}
+	std::string out;
+	for(size_t i = 0; i < size; i++) {
+		out.push_back(digits[build_id[i] >> 4]);
+		out.push_back(digits[build_id[i] & 15]);
+	}
+	return out;
+}
+
+SymbolCache::SymbolCache(std::string index_path) : index_path(index_path) {
+	// each line is "<build id or -> <size> <mtime> <path>"
+	std::ifstream index(index_path);
+	std::string line;
+	while(std::getline(index, line)) {
+		std::istringstream fields(line);
+		Entry entry;
+		std::string path;
+		if(!(fields >> entry.build_id >> entry.size >> entry.mtime) || !std::getline(fields >> std::ws, path)) {
+			LogMessage(Warning, "bad line in symbol index '%s'", index_path.c_str());
+			continue;
+		}
+		if(entry.build_id == "-") {
+			entry.build_id.clear();
+		}
+		files[path] = entry;
+	}
+}
+
+void SymbolCache::AddDirectory(const std::string &path) {
+	AddDirectory(path, 0);
+}
+
+void SymbolCache::AddDirectory(const std::string &path, int depth) {
+	if(depth > 16) { // probably a symlink loop
+		return;
+	}
+	
+	std::vector<std::string> names;
+	try {
+		names = platform::fs::ListDirectory(path.c_str());
+	} catch(platform::NetworkError &e) {
+		LogMessage(Warning, "could not list '%s'", path.c_str());
+		return;
+	}
+	
+	for(const std::string &name : names) {
+		std::string child = path + "/" + name;
+		std::optional<platform::fs::Stat> stat;
+		try {
+			stat = platform::fs::StatFile(child.c_str());
+		} catch(platform::NetworkError &e) {
+			LogMessage(Warning, "could not stat '%s'", child.c_str());
+			continue;
+		}
+		if(!stat) {
+			continue;
+		}
+		if(stat->is_directory) {
+			AddDirectory(child, depth + 1);
+			continue;
+		}
+
+		auto i = files.find(child);
+		if(i == files.end() || i->second.size != stat->size || i->second.mtime != stat->mtime) {
+			Entry entry = {ReadBuildId(child).value_or(""), stat->size, stat->mtime};
+			i = files.insert_or_assign(child, entry).first;
+		}
+		i->second.seen = true;
+		if(!i->second.build_id.empty()) {
+			paths[i->second.build_id] = child;
+		}
+	}
+}
+
+std::optional<std::string> SymbolCache::Find(const uint8_t *build_id, size_t size) const {
+	auto i = paths.find(BuildIdToString(build_id, size));
+	if(i == paths.end()) {
+		return std::nullopt;
+	}
+	return i->second;
+}
+
+bool SymbolCache::Save() const {
+	std::ofstream index(index_path, std::ios::trunc);
+	for(auto &file : files) {
+		const Entry &entry = file.second;
+		if(!entry.seen) { // deleted, or no longer under a directory we index
+			continue;
+		}
+		index << (entry.build_id.empty() ? "-" : entry.build_id) << " " << entry.size << " " << entry.mtime << " " << file.first << "\n";
+	}
+	return (bool) index;
+}
+
+template<typename T>
+static bool ReadAt(std::ifstream &file, uint64_t offset, T &out) {
+	file.seekg(offset);
+	return (bool) file.read((char*) &out, sizeof(out));
+}
+
+std::optional<std::string> SymbolCache::ReadBuildId(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	
+	// 64-bit little-endian ELF only, which is all the Switch uses
+	struct {
+		uint8_t ident[16];
+		uint16_t type, machine;
+		uint32_t version;
+		uint64_t entry, phoff, shoff;
+		uint32_t flags;
+		uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+	} header;
+	if(!ReadAt(file, 0, header) || memcmp(header.ident, "\x7f" "ELF", 4) != 0 || header.ident[4] != 2 || header.ident[5] != 1) {
+		return std::nullopt;
+	}
+
+	// notes can be found through program headers or section headers, and
+	// object files only have the latter
+	std::vector<std::pair<uint64_t, uint64_t>> notes;
+	for(uint16_t i = 0; i < header.phnum && header.phentsize >= 0x38; i++) {
+		struct { uint32_t type, flags; uint64_t offset, vaddr, paddr, filesz, memsz, align; } phdr;
+		if(!ReadAt(file, header.phoff + (uint64_t) i * header.phentsize, phdr)) {
+			return std::nullopt;
+		}
+		if(phdr.type == 4) { // PT_NOTE
+			notes.emplace_back(phdr.offset, phdr.filesz);
+		}
+	}
+	for(uint16_t i = 0; i < header.shnum && header.shentsize >= 0x40; i++) {
+		struct { uint32_t name, type; uint64_t flags, addr, offset, size; uint32_t link, info; uint64_t addralign, entsize; } shdr;
+		if(!ReadAt(file, header.shoff + (uint64_t) i * header.shentsize, shdr)) {
+			return std::nullopt;
+		}
+		if(shdr.type == 7) { // SHT_NOTE
+			notes.emplace_back(shdr.offset, shdr.size);
+		}
+	}
+
+	for(auto &note : notes) {
+		uint64_t offset = note.first;
+		uint64_t end = note.first + note.second;
+		struct { uint32_t namesz, descsz, type; } nhdr;
+		while(offset + sizeof(nhdr) <= end && ReadAt(file, offset, nhdr)) {
+			uint64_t name_offset = offset + sizeof(nhdr);
+			uint64_t desc_offset = name_offset + ((nhdr.namesz + 3) & ~3ull);
+			uint64_t next = desc_offset + ((nhdr.descsz + 3) & ~3ull);
+			if(next > end) {
+				break;
+			}
+			char name[4];
+			if(nhdr.type == 3 && nhdr.namesz == 4 && nhdr.descsz <= 0x20 && // NT_GNU_BUILD_ID
+				 ReadAt(file, name_offset, name) && memcmp(name, "GNU", 4) == 0) {
+				uint8_t desc[0x20];
+				file.seekg(desc_offset);
+				if(!file.read((char*) desc, nhdr.descsz)) {
+					return std::nullopt;
+				}
+				return BuildIdToString(desc, nhdr.descsz);
+			}
+			offset = next;
+		}
+		file.clear();
+	}
+	return std::nullopt;
+}
+
+std::vector<SymbolCache::Symbol> SymbolCache::ReadFunctionSymbols(const std::string &path) {
+	std::ifstream file(path, std::ios::binary);
+	std::vector<Symbol> symbols;
+
+	struct {
+		uint8_t ident[16];
+		uint16_t type, machine;
+		uint32_t version;
+		uint64_t entry, phoff, shoff;
+		uint32_t flags;
+		uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+	} header;
+	if(!ReadAt(file, 0, header) || memcmp(header.ident, "\x7f" "ELF", 4) != 0 || header.ident[4] != 2 || header.ident[5] != 1 ||
+		 header.shentsize < 0x40) {
+		return symbols;
+	}
+
+	struct Section { uint32_t name, type; uint64_t flags, addr, offset, size; uint32_t link, info; uint64_t addralign, entsize; };
+	auto read_section = [&](uint16_t i, Section &shdr) {
+		return i < header.shnum && ReadAt(file, header.shoff + (uint64_t) i * header.shentsize, shdr);
+	};
+	
+	// prefer the full symbol table, but stripped files only have dynsym
+	std::optional<Section> symtab;
+	for(uint16_t i = 0; i < header.shnum; i++) {
+		Section shdr;
+		if(!read_section(i, shdr)) {
+			return symbols;
+		}
+		if(shdr.type == 2 || (shdr.type == 11 && !symtab)) { // SHT_SYMTAB, SHT_DYNSYM
+			symtab = shdr;
+		}
+	}
+	Section strtab;
+	if(!symtab || !read_section(symtab->link, strtab)) {
+		return symbols;
+	}
+
+	std::string strings(strtab.size, '\0');
+	file.seekg(strtab.offset);
+	if(strtab.size == 0 || !file.read(&strings[0], strtab.size)) {
+		return symbols;
+	}
+	strings.back() = 0; // so every name is terminated
+
+	struct { uint32_t name; uint8_t info, other; uint16_t shndx; uint64_t value, size; } sym;
+	for(uint64_t offset = 0; offset + sizeof(sym) <= symtab->size; offset+= sizeof(sym)) {
+		if(!ReadAt(file, symtab->offset + offset, sym)) {
+			break;
+		}
+		if((sym.info & 0xf) != 2 || sym.shndx == 0 || sym.name >= strings.size()) { // STT_FUNC, defined
+			continue;
+		}
+		symbols.push_back({sym.value, sym.size, std::string(strings.c_str() + sym.name)});
+	}
+
+	std::sort(
+		symbols.begin(), symbols.end(),
+		[](const Symbol &a, const Symbol &b) { return a.addr < b.addr; });
+	return symbols;
+}
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,79 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<map>
+#include<optional>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+#include<stdint.h>
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+// Maps build ids to ELF files on the host, so that the GDB stub can name
+// modules by paths GDB can load symbols from. The index is saved between
+// sessions, and files whose size and mtime haven't changed since are not
+// opened again.
+class SymbolCache {
+ public:
+	SymbolCache(std::string index_path);
+
+	// Indexes ELF files under path, recursively.
+	void AddDirectory(const std::string &path);
+	// Takes a build id as the loader reports it, zero-padded to 0x20 bytes.
+	std::optional<std::string> Find(const uint8_t *build_id, size_t size) const;
+	// Only files found by AddDirectory since the index was loaded are
+	// written out, so files that were deleted or moved drop out of it.
+	bool Save() const;
+
+	// Lowercase hex of the GNU build id note, without trailing zero bytes.
+	static std::optional<std::string> ReadBuildId(const std::string &path);
+
+	struct Symbol {
+		uint64_t addr; // relative to where the module is loaded
+		uint64_t size;
+		std::string name; // as mangled in the file
+	};
+	// Defined functions from the ELF's symbol table (or its dynamic symbol
+	// table, if it's been stripped), sorted by address.
+	static std::vector<Symbol> ReadFunctionSymbols(const std::string &path);
+ private:
+	struct Entry {
+		std::string build_id; // empty if the file has none
+		uint64_t size;
+		int64_t mtime;
+		bool seen = false; // by AddDirectory, since the index was loaded
+	};
+	
+	void AddDirectory(const std::string &path, int depth);
+	
+	std::string index_path;
+	std::map<std::string, Entry> files; // by path
+	std::unordered_map<std::string, std::string> paths; // by build id
+};
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
@@ -0,0 +1,98 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "Symbolizer.hpp"
+
+#include<algorithm>
+
+#include<inttypes.h>
+#include<stdio.h>
+#include<stdlib.h>
+
+#if defined(__GNUC__)
+#include<cxxabi.h>
+#endif
+
+#include "common/Logger.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+Symbolizer::Symbolizer(std::vector<Module> modules) : modules(modules) {
+	std::sort(
+		this->modules.begin(), this->modules.end(),
+		[](const Module &a, const Module &b) { return a.base < b.base; });
+	for(const Module &module : this->modules) {
+		symbols.push_back(
+			module.path.empty() ?
+			std::vector<SymbolCache::Symbol>() :
+			SymbolCache::ReadFunctionSymbols(module.path));
+		if(!module.path.empty()) {
+			LogMessage(Debug, "read %zu symbols for %s from '%s'", symbols.back().size(), module.name.c_str(), module.path.c_str());
+		}
+	}
+}
+
+static std::string Demangle(const std::string &name) {
+#if defined(__GNUC__)
+	int status;
+	char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+	if(demangled) {
+		std::string out = demangled;
+		free(demangled);
+		return out;
+	}
+#endif
+	return name;
+}
+
+std::string Symbolizer::Symbolize(uint64_t addr) const {
+	char buffer[64];
+	auto i = std::upper_bound(
+		modules.begin(), modules.end(), addr,
+		[](uint64_t addr, const Module &module) { return addr < module.base; });
+	if(i != modules.begin()) {
+		i--;
+		uint64_t offset = addr - i->base;
+		if(offset < i->size) {
+			const std::vector<SymbolCache::Symbol> &module_symbols = symbols[i - modules.begin()];
+			auto j = std::upper_bound(
+				module_symbols.begin(), module_symbols.end(), offset,
+				[](uint64_t offset, const SymbolCache::Symbol &symbol) { return offset < symbol.addr; });
+			if(j != module_symbols.begin()) {
+				j--;
+				// some hand-written functions don't have a size
+				if(j->size == 0 || offset - j->addr < j->size) {
+					snprintf(buffer, sizeof(buffer), "+0x%" PRIx64, offset - j->addr);
+					return Demangle(j->name) + buffer;
+				}
+			}
+			snprintf(buffer, sizeof(buffer), "+0x%" PRIx64, offset);
+			return i->name + buffer;
+		}
+	}
+	snprintf(buffer, sizeof(buffer), "0x%" PRIx64, addr);
+	return buffer;
+}
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
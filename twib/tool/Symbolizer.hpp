@@ -0,0 +1,57 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include<stdint.h>
+
+#include "SymbolCache.hpp"
+
+namespace twili {
+namespace twib {
+namespace tool {
+
+// Names addresses as function+offset, for tools that print code addresses.
+class Symbolizer {
+ public:
+	struct Module {
+		std::string name;
+		uint64_t base;
+		uint64_t size;
+		std::string path = ""; // ELF on the host to read symbols from, if known
+	};
+
+	Symbolizer(std::vector<Module> modules);
+
+	// Falls back to module+offset where there's no symbol, and to the bare
+	// address outside any module.
+	std::string Symbolize(uint64_t addr) const;
+	inline const std::vector<Module> &GetModules() const { return modules; }
+ private:
+	std::vector<Module> modules; // sorted by base
+	std::vector<std::vector<SymbolCache::Symbol>> symbols; // by module
+};
+
+} // namespace tool
+} // namespace twib
+} // namespace twili
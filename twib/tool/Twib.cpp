@@ -22,7 +22,14 @@
 
 #include<iomanip>
 #include<array>
-
+#include<deque>
+#include<fstream>
+#include<future>
+#include<map>
+#include<optional>
+#include<thread>
+
+#include<ctype.h>
 #include<string.h>
 #include<inttypes.h>
 
@@ -39,6 +46,9 @@
 #include "Protocol.hpp"
 #include "interfaces/ITwibMetaInterface.hpp"
 #include "interfaces/ITwibDeviceInterface.hpp"
+#include "MemoryMap.hpp"
+#include "Profile.hpp"
+#include "SymbolCache.hpp"
 
 #if TWIB_GDB_ENABLED == 1
 #include "GdbStub.hpp"
@@ -53,6 +63,7 @@
 
 #include "util.hpp"
 #include "err.hpp"
+#include "PatternScan.hpp"
 
 namespace twili {
 namespace twib {
@@ -106,6 +117,41 @@ void ListDevices(ITwibMetaInterface &iface) {
 	PrintTable(rows);
 }
 
+void ListMemoryMap(ITwibDebugger &debugger, bool all) {
+	MemoryMap map(debugger);
+	
+	std::vector<std::array<std::string, 5>> rows;
+	rows.push_back({"Start", "End", "Perm", "Type", "Module"});
+	for(const MemoryMap::Region &region : map.regions) {
+		if((region.info.memory_type & 0xff) == 0 && !all) { // unmapped
+			continue;
+		}
+		
+		std::string perm = "---";
+		if(region.info.permission & 1) { perm[0] = 'r'; }
+		if(region.info.permission & 2) { perm[1] = 'w'; }
+		if(region.info.permission & 4) { perm[2] = 'x'; }
+		
+		std::string module;
+		if(region.module) {
+			module = region.module_type;
+			module+= " ";
+			for(size_t i = 0; i < 8; i++) {
+				module+= ToHex((unsigned int) region.module->build_id[i], 2, false);
+			}
+			module+= "+" + ToHex(region.info.base_addr - region.module->base_addr, true);
+		}
+		
+		rows.push_back({
+			ToHex(region.info.base_addr, 16, true),
+			ToHex(region.info.base_addr + region.info.size, 16, true),
+			perm,
+			GetMemoryTypeName(region.info.memory_type),
+			module});
+	}
+	PrintTable(rows);
+}
+
 void ListProcesses(ITwibDeviceInterface &iface) {
 	std::vector<std::array<std::string, 5>> rows;
 	rows.push_back({"Process ID", "Result", "Title ID", "Process Name", "MMU Flags"});
@@ -121,6 +167,133 @@ void ListProcesses(ITwibDeviceInterface &iface) {
 	PrintTable(rows);
 }
 
+// Parses memory type names or numbers into a mask with a bit set for each
+// type, as ITwibDebugger::ScanMemory takes.
+bool ParseMemoryTypes(const std::vector<std::string> &names, uint64_t &mask) {
+	mask = 0;
+	for(const std::string &name : names) {
+		std::optional<uint32_t> named = ParseMemoryTypeName(name);
+		uint32_t type;
+		if(named) {
+			type = *named;
+		} else {
+			char *end;
+			type = strtoul(name.c_str(), &end, 0);
+			if(name.empty() || *end != 0 || type >= 64) {
+				return false;
+			}
+		}
+		mask|= 1ull << type;
+	}
+	return true;
+}
+
+// Attaching to a process stops it. This lets it run again while staying
+// attached.
+void ResumeAttachedProcess(ITwibDebugger &debugger) {
+	std::vector<uint64_t> thread_ids;
+	std::optional<nx::DebugEvent> event;
+	while((event = debugger.GetDebugEvent())) {
+		if(event->event_type == nx::DebugEvent::EventType::AttachThread) {
+			thread_ids.push_back(event->attach_thread.thread_id);
+		}
+	}
+	debugger.ContinueDebugEvent(7, thread_ids);
+}
+
+// Names modules by the first 8 bytes of their build ID, like vmmap does, and
+// points them at ELFs with matching build IDs if symbol_cache knows of any.
+std::vector<Symbolizer::Module> GetModules(ITwibDebugger &debugger, const SymbolCache *symbol_cache = nullptr) {
+	MemoryMap map(debugger);
+	std::vector<Symbolizer::Module> modules;
+	for(auto *list : {&map.nsos, &map.nros}) {
+		for(const nx::LoadedModuleInfo &info : *list) {
+			std::string name;
+			for(size_t i = 0; i < 8; i++) {
+				name+= ToHex((unsigned int) info.build_id[i], 2, false);
+			}
+			std::string path;
+			if(symbol_cache) {
+				path = symbol_cache->Find(info.build_id, sizeof(info.build_id)).value_or("");
+			}
+			modules.push_back({name, info.base_addr, info.size, path});
+		}
+	}
+	return modules;
+}
+
+// Indexes ELFs under dirs, remembering what it found in index (by default
+// ~/.twib-symbols) for next time. Returns null if there are no dirs.
+std::unique_ptr<SymbolCache> OpenSymbolCache(const std::vector<std::string> &dirs, std::string index) {
+	if(dirs.empty()) {
+		return nullptr;
+	}
+	const char *home = getenv("HOME");
+	if(index.empty() && home) {
+		index = std::string(home) + "/.twib-symbols";
+	}
+	std::unique_ptr<SymbolCache> symbol_cache = std::make_unique<SymbolCache>(index);
+	for(const std::string &dir : dirs) {
+		symbol_cache->AddDirectory(dir);
+	}
+	if(!index.empty() && !symbol_cache->Save()) {
+		LogMessage(Warning, "could not save symbol index to '%s'", index.c_str());
+	}
+	return symbol_cache;
+}
+
+void ListBacktraces(ITwibDebugger &debugger, std::vector<uint64_t> thread_ids, uint32_t max_depth, const SymbolCache *symbol_cache) {
+	Symbolizer symbolizer(GetModules(debugger, symbol_cache));
+	for(const ThreadBacktrace &backtrace : debugger.Backtrace(thread_ids, max_depth)) {
+		printf("thread 0x%" PRIx64 ":\n", backtrace.thread_id);
+		std::vector<uint64_t> frames = {backtrace.context.pc};
+		for(const FrameRecord &record : backtrace.records) {
+			if(record.lr == 0) {
+				break;
+			}
+			frames.push_back(record.lr);
+		}
+		for(size_t i = 0; i < frames.size(); i++) {
+			// return addresses are named by their call instruction
+			printf("  #%-3zu 0x%016" PRIx64 " %s\n", i, frames[i], symbolizer.Symbolize(i == 0 ? frames[i] : frames[i] - 4).c_str());
+		}
+		printf("       lr 0x%016" PRIx64 " %s\n", backtrace.context.x[30], symbolizer.Symbolize(backtrace.context.x[30]).c_str());
+	}
+}
+
+// Writes folded stacks to output ("-" for stdout) and a summary to stderr,
+// so the folded stacks can be piped straight into flamegraph.pl.
+int ReportProfile(const Profile &profile, const std::string &output) {
+	FILE *f = stdout;
+	if(output != "-") {
+		f = fopen(output.c_str(), "w");
+		if(!f) {
+			LogMessage(Fatal, "could not open '%s': %s", output.c_str(), strerror(errno));
+			return 1;
+		}
+	}
+	profile.WriteFolded(f);
+	if(f != stdout) {
+		fclose(f);
+	}
+
+	if(profile.samples == 0) {
+		fprintf(stderr, "no samples\n");
+		return 0;
+	}
+	double ticks_per_us = Profile::TICKS_PER_SECOND / 1000000.0;
+	fprintf(
+		stderr, "%" PRIu64 " samples, %" PRIu64 " thread stacks, %zu unique; paused %.1f us on average, %.1f us at most",
+		profile.samples, profile.thread_samples, profile.GetStacks().size(),
+		profile.total_pause_ticks / ticks_per_us / profile.samples,
+		profile.max_pause_ticks / ticks_per_us);
+	if(profile.last_tick > profile.first_tick) {
+		fprintf(stderr, " (%.2f%% of the time)", 100.0 * profile.total_pause_ticks / (profile.last_tick - profile.first_tick));
+	}
+	fprintf(stderr, "\n");
+	return 0;
+}
+
 std::unique_ptr<client::Client> connect_tcp(uint16_t port);
 std::unique_ptr<client::Client> connect_unix(std::string path);
 std::unique_ptr<client::Client> connect_named_pipe(std::string path);
@@ -134,6 +307,58 @@ void show(msgpack11::MsgPack const& blob);
 using namespace twili;
 using namespace twili::twib;
 
+// Objects that stay open for as long as we're connected to twibd, so that
+// commands run in batch mode don't have to open them again.
+class Session {
+ public:
+	Session(tool::client::Client &client, std::string device_id_str) :
+		itmi(tool::RemoteObject(client, 0, 0)),
+		client(client),
+		device_id_str(device_id_str) {
+	}
+
+	// Picks a device the first time this is called. Returns nullptr if no
+	// device could be picked.
+	tool::ITwibDeviceInterface *GetDevice() {
+		if(!itdi) {
+			uint32_t device_id;
+			if(device_id_str.size() > 0) {
+				device_id = std::stoul(device_id_str, NULL, 16);
+			} else {
+				std::vector<msgpack11::MsgPack> devices = itmi.ListDevices();
+				if(devices.size() == 0) {
+					LogMessage(Fatal, "No devices were detected.");
+					return nullptr;
+				}
+				if(devices.size() > 1) {
+					LogMessage(Fatal, "Multiple devices were detected. Please use -d to specify which one you mean.");
+					return nullptr;
+				}
+				device_id = devices[0]["device_id"].uint32_value();
+			}
+			itdi.emplace(std::make_shared<tool::RemoteObject>(client, device_id, 0));
+		}
+		return &*itdi;
+	}
+
+	// Must only be called once GetDevice has succeeded.
+	tool::ITwibFilesystemAccessor &GetFilesystem(const char *name) {
+		auto i = filesystems.find(name);
+		if(i == filesystems.end()) {
+			i = filesystems.emplace(name, GetDevice()->OpenFilesystemAccessor(name)).first;
+		}
+		return i->second;
+	}
+
+	tool::ITwibMetaInterface itmi;
+	
+ private:
+	tool::client::Client &client;
+	std::string device_id_str;
+	std::optional<tool::ITwibDeviceInterface> itdi;
+	std::map<std::string, tool::ITwibFilesystemAccessor> filesystems;
+};
+
 class FSCommands {
  public:
 	FSCommands(CLI::App &app, const char *cmdname, const char *desc, const char *fsname) :
@@ -164,33 +389,43 @@ class FSCommands {
 		mv = subcommand->add_subcommand("mv", "Rename a file or directory");
 		mv->add_option("src", mv_src, "Source path")->required();
 		mv->add_option("dst", mv_dst, "Destination path")->required();
+
+		cp = subcommand->add_subcommand("cp", "Copies a file or directory tree on the device, optionally to another filesystem");
+		cp->add_set("--to", cp_to, {"sd", "nu", "ns"}, "Filesystem to copy to (defaults to this one)");
+		cp->add_flag("--move", cp_move, "Delete the sources once they have been copied");
+		cp->add_option("src", cp_src, "Source path")->required();
+		cp->add_option("dst", cp_dst, "Destination path")->required();
 		
 		subcommand->require_subcommand(1);
 	}
 
-	int Run(tool::ITwibDeviceInterface &itdi) {
+	int Run(Session &session) {
+		tool::ITwibFilesystemAccessor &itfsa = session.GetFilesystem(fsname);
 		if(pull->parsed()) {
-			return DoPull(itdi);
+			return DoPull(itfsa);
 		}
 		if(push->parsed()) {
-			return DoPush(itdi);
+			return DoPush(itfsa);
 		}
 		if(ls->parsed()) {
-			return DoLs(itdi);
+			return DoLs(itfsa);
 		}
 		if(rm->parsed()) {
-			return DoRm(itdi);
+			return DoRm(itfsa);
 		}
 		if(mkdir->parsed()) {
-			return DoMkdir(itdi);
+			return DoMkdir(itfsa);
 		}
 		if(mv->parsed()) {
-			return DoMv(itdi);
+			return DoMv(itfsa);
+		}
+		if(cp->parsed()) {
+			return DoCp(session, itfsa);
 		}
 		return 0;
 	}
 
-	int DoPull(tool::ITwibDeviceInterface &itdi) {
+	int DoPull(tool::ITwibFilesystemAccessor &itfsa) {
 		struct stat target_stat;
 		bool is_target_directory = false;
 
@@ -216,8 +451,6 @@ class FSCommands {
 			}
 		}
 
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
-		
 		for(std::string &src : pull_from) {
 			tool::ITwibFileAccessor itfa = itfsa.OpenFile(1, "/" + src);
 			
@@ -235,11 +468,36 @@ class FSCommands {
 				dst = platform::File::OpenForClobberingWrite(dst_path.c_str());
 			}
 
+			// keep several reads in flight so that we aren't waiting out a
+			// full round trip to the device for every chunk
+			const size_t chunk_size = 0x40000;
+			const size_t max_in_flight = 8;
+			
 			size_t total_size = itfa.GetSize();
+			size_t request_offset = 0;
 			size_t offset = 0;
+			std::deque<std::pair<size_t, std::future<std::vector<uint8_t>>>> in_flight;
 			while(offset < total_size) {
-				std::vector<uint8_t> data = itfa.Read(offset, total_size - offset);
-				if(data.size() == 0 || dst.Write(data.data(), data.size()) < data.size()) {
+				while(in_flight.size() < max_in_flight && request_offset < total_size) {
+					size_t size = std::min(chunk_size, total_size - request_offset);
+					in_flight.emplace_back(size, itfa.ReadAsync(request_offset, size));
+					request_offset+= size;
+				}
+				
+				size_t size = in_flight.front().first;
+				std::vector<uint8_t> data = in_flight.front().second.get();
+				in_flight.pop_front();
+				
+				// fill in anything the device didn't give us in one go
+				while(data.size() < size) {
+					std::vector<uint8_t> rest = itfa.Read(offset + data.size(), size - data.size());
+					if(rest.size() == 0) {
+						break;
+					}
+					data.insert(data.end(), rest.begin(), rest.end());
+				}
+				
+				if(data.size() < size || dst.Write(data.data(), data.size()) < data.size()) {
 					LogMessage(Error, "hit EoF/IO error unexpectedly?");
 					return 1;
 				}
@@ -253,7 +511,7 @@ class FSCommands {
 		return 0;
 	}
 
-	int DoPush(tool::ITwibDeviceInterface &itdi) {
+	int DoPush(tool::ITwibFilesystemAccessor &itfsa) {
 		bool is_target_directory = false;
 
 		// stupid hack for stupid command line parser
@@ -266,8 +524,6 @@ class FSCommands {
 			push_to.insert(push_to.begin(), '/');
 		}
 
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
-
 		LogMessage(Debug, "checking if is file");
 		std::optional<bool> is_file_result = itfsa.IsFile(push_to);
 		LogMessage(Debug, "checked if is file");
@@ -323,8 +579,7 @@ class FSCommands {
 		return 0;
 	}
 
-	int DoLs(tool::ITwibDeviceInterface &itdi) {
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
+	int DoLs(tool::ITwibFilesystemAccessor &itfsa) {
 		tool::ITwibDirectoryAccessor itda = itfsa.OpenDirectory(ls_path);
 
 		uint64_t read = 0;
@@ -354,8 +609,7 @@ class FSCommands {
 		return 0;
 	}
 
-	int DoRm(tool::ITwibDeviceInterface &itdi) {
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
+	int DoRm(tool::ITwibFilesystemAccessor &itfsa) {
 		std::optional<bool> is_file_result = itfsa.IsFile(rm_path);
 		if(!is_file_result) {
 			fprintf(stderr, "'%s': No such file or directory\n", rm_path.c_str());
@@ -374,8 +628,7 @@ class FSCommands {
 		return 0;
 	}
 
-	int DoMkdir(tool::ITwibDeviceInterface &itdi) {
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
+	int DoMkdir(tool::ITwibFilesystemAccessor &itfsa) {
 		if(!itfsa.CreateDirectory(mkdir_path)) {
 			fprintf(stderr, "'%s': File exists\n", mkdir_path.c_str());
 			return 1;
@@ -383,8 +636,7 @@ class FSCommands {
 		return 0;
 	}
 
-	int DoMv(tool::ITwibDeviceInterface &itdi) {
-		tool::ITwibFilesystemAccessor itfsa = itdi.OpenFilesystemAccessor(fsname);
+	int DoMv(tool::ITwibFilesystemAccessor &itfsa) {
 		std::optional<bool> is_src_file = itfsa.IsFile(mv_src);
 		if(!is_src_file) {
 			fprintf(stderr, "'%s': No such file or directory\n", mv_src.c_str());
@@ -408,6 +660,37 @@ class FSCommands {
 		return 0;
 	}
 
+	int DoCp(Session &session, tool::ITwibFilesystemAccessor &itfsa) {
+		const char *dst_fsname = fsname;
+		if(cp_to == "sd") {
+			dst_fsname = "sd";
+		} else if(cp_to == "nu") {
+			dst_fsname = "nand_user";
+		} else if(cp_to == "ns") {
+			dst_fsname = "nand_system";
+		}
+		tool::ITwibFilesystemAccessor &dst_itfsa = session.GetFilesystem(dst_fsname);
+
+		using CopyRecord = tool::ITwibFilesystemAccessor::CopyRecord;
+		bool failed = false;
+		uint32_t r = itfsa.Copy(
+			dst_itfsa, cp_src, cp_dst, cp_move ? protocol::ITwibFilesystemAccessor::COPY_FLAG_MOVE : 0,
+			[&](const CopyRecord &record, const std::string &path) {
+				if(record.type == CopyRecord::Type::PROGRESS) {
+					fprintf(stderr, "\r%s: %3d%%", path.c_str(), (int) (record.bytes * 100 / std::max<uint64_t>(record.size, 1)));
+				} else if(record.result != 0) {
+					fprintf(stderr, "\r%s: failed (0x%x)\n", path.c_str(), record.result);
+					failed = true;
+				} else if(record.entry_type == 1) {
+					fprintf(stderr, "\r%s: 0x%" PRIx64 " bytes\n", path.c_str(), record.size);
+				}
+			});
+		if(r != 0 && !failed) { // didn't get as far as any entries
+			LogMessage(Error, "copy failed: 0x%x", r);
+		}
+		return r == 0 ? 0 : 1;
+	}
+
 	CLI::App &app;
 	CLI::App *subcommand;
 	
@@ -421,11 +704,11 @@ class FSCommands {
 	std::string push_to = "/";
 
 	CLI::App *ls;
-	bool ls_details;
+	bool ls_details = false;
 	std::string ls_path = "/";
 	
 	CLI::App *rm;
-	bool rm_recursive;
+	bool rm_recursive = false;
 	std::string rm_path;
 	
 	CLI::App *mkdir;
@@ -434,11 +717,819 @@ class FSCommands {
 	CLI::App *mv;
 	std::string mv_src;
 	std::string mv_dst;
+
+	CLI::App *cp;
+	std::string cp_to;
+	bool cp_move = false;
+	std::string cp_src;
+	std::string cp_dst;
 	
 	const char *cmdname;
 	const char *fsname;
 };
 
+class Commands {
+ public:
+	Commands(CLI::App &app) {
+		ld = app.add_subcommand("list-devices", "List devices");
+		
+		connect_tcp = app.add_subcommand("connect-tcp", "Connect to a device over TCP");
+		connect_tcp->add_option("hostname", connect_tcp_hostname, "Hostname to connect to")->required();
+		connect_tcp->add_option("port", connect_tcp_port, "Port to connect to");
+
+		dump_trace = app.add_subcommand("dump-trace", "Dump a Chrome trace of recent requests from twibd");
+		dump_trace->add_option("file", dump_trace_file, "File to write trace to")->required();
+		
+		run = app.add_subcommand("run", "Run an executable");
+		run->add_flag("-a,--applet", run_applet, "Run as an applet");
+		run->add_flag("-s,--shell", run_shell, "Run as a shell program");
+		run->add_flag("-d,--debug-suspend", run_suspend, "Suspends for debug");
+		run->add_flag("-q,--quiet", run_quiet, "Suppress any output except from the program being run");
+		run->add_option("file", run_file, "Executable to run")->check(CLI::ExistingFile)->required();
+		
+		reboot = app.add_subcommand("reboot", "Reboot the device");
+		reboot->add_flag("-u,--unsafe", reboot_unsafe, "Reboot quickly but forcefully and unsafely");
+
+		coredump = app.add_subcommand("coredump", "Make a coredump of a crashed process");
+		coredump->add_option("file", core_file, "File to dump core to")->required();
+		coredump->add_option("pid", core_process_id, "Process ID")->required();
+		
+		terminate = app.add_subcommand("terminate", "Terminate a process on the device");
+		terminate->add_option("pid", terminate_process_id, "Process ID")->required();
+		
+		ps = app.add_subcommand("ps", "List processes on the device");
+
+		identify = app.add_subcommand("identify", "Identify the device");
+
+		list_named_pipes = app.add_subcommand("list-named-pipes", "List named pipes on the device");
+
+		open_named_pipe = app.add_subcommand("open-named-pipe", "Open a named pipe on the device");
+		open_named_pipe->add_option("name", open_named_pipe_name, "Name of pipe to open")->required();
+		open_named_pipe->add_option("-o,--output", open_named_pipe_output, "Capture to this file on the device SD card instead of printing");
+
+		get_memory_info = app.add_subcommand("get-memory-info", "Gets memory usage information from the device");
+
+		print_debug_info = app.add_subcommand("debug", "Prints debug info");
+
+#if TWIB_GDB_ENABLED == 1
+		gdb = app.add_subcommand("gdb", "Opens an enhanced GDB stub for the device");
+		gdb->add_option("-s,--symbols", symbol_dirs, "Directories to search for ELFs matching the build ids of loaded modules, so GDB loads them automatically");
+		gdb->add_option("--symbol-index", symbol_index, "File to remember the build ids of files found with --symbols in (default: ~/.twib-symbols)");
+#endif
+
+		launch = app.add_subcommand("launch", "Launches an installed title");
+		launch->add_option("title-id", launch_title_id, "Title ID to launch")->required();
+		launch->add_set_ignore_case("storage", launch_storage, {"none", "host", "gamecard", "gc", "nand-system", "system", "nand-user", "user", "sdcard", "sd"}, "Storage for title")->required();
+		launch->add_option("launch-flags", launch_flags, "Flags for launch");
+
+		sd_commands = std::make_unique<FSCommands>(app, "sd", "Perform operations on target SD card", "sd");
+		nand_user_commands = std::make_unique<FSCommands>(app, "nu", "Perform operations on target NAND user filesystem", "nand_user");
+		nand_system_commands = std::make_unique<FSCommands>(app, "ns", "Perform operations on target NAND system filesystem", "nand_system");
+
+		get_module_info = app.add_subcommand("get-module-info", "Lists loaded module info for a specific process");
+		get_module_info->add_option("pid", get_module_info_process_id, "Process ID")->required();
+
+		scan_memory = app.add_subcommand("scan-memory", "Searches a process's memory on the device for a byte pattern");
+		scan_memory->add_option("pid", scan_memory_process_id, "Process ID")->required();
+		scan_memory->add_option("pattern", scan_memory_pattern, "Bytes to search for in hex, with ? for wildcard nybbles (e.g. \"de ad ?? e?\")")->required();
+		scan_memory->add_option("-s,--start", scan_memory_start, "Address to start scanning at");
+		scan_memory->add_option("-e,--end", scan_memory_end, "Address to stop scanning at");
+		scan_memory->add_option("-t,--type", scan_memory_types, "Only scan these memory types (names as shown by vmmap, e.g. heap, stack, code, or numbers)");
+		scan_memory->add_option("-a,--align", scan_memory_alignment, "Only report matches aligned to this many bytes");
+		scan_memory->add_option("-m,--max-matches", scan_memory_max_matches, "Stop after this many matches");
+
+		vmmap = app.add_subcommand("vmmap", "Prints a process's memory map");
+		vmmap->add_option("pid", vmmap_process_id, "Process ID")->required();
+		vmmap->add_flag("-a,--all", vmmap_all, "Include unmapped regions");
+
+		memory_diff = app.add_subcommand("memory-diff", "Lists pages of a process's writable memory that change while it runs for a while");
+		memory_diff->add_option("pid", memory_diff_process_id, "Process ID")->required();
+		memory_diff->add_option("-s,--start", memory_diff_start, "Address to start at");
+		memory_diff->add_option("-e,--end", memory_diff_end, "Address to stop at");
+		memory_diff->add_option("-w,--wait", memory_diff_wait_ms, "Milliseconds to let the process run between the snapshot and the diff");
+		memory_diff->add_option("-o,--output", memory_diff_output, "Directory to save the contents of changed pages to");
+
+		backtrace = app.add_subcommand("backtrace", "Prints the call stack of each of a process's threads");
+		backtrace->add_option("pid", backtrace_process_id, "Process ID")->required();
+		backtrace->add_option("-t,--thread", backtrace_thread_ids, "Only these threads");
+		backtrace->add_option("--depth", backtrace_depth, "Maximum frames to unwind per thread");
+		backtrace->add_option("-s,--symbols", symbol_dirs, "Directories to search for ELFs matching the build ids of loaded modules, to name functions with");
+		backtrace->add_option("--symbol-index", symbol_index, "File to remember the build ids of files found with --symbols in (default: ~/.twib-symbols)");
+
+		profile = app.add_subcommand("profile", "Samples a process's call stacks and prints them as folded stacks for flame graphs");
+		profile->add_option("pid", profile_process_id, "Process ID")->required();
+		profile->add_option("-d,--duration", profile_duration_ms, "Milliseconds to profile for");
+		profile->add_option("-i,--interval", profile_interval_us, "Microseconds between samples");
+		profile->add_option("--depth", profile_depth, "Maximum frames to unwind per thread");
+		profile->add_flag("--lr", profile_lr, "Use the link register to fill in callers of leaf functions without frame records");
+		profile->add_option("-o,--output", profile_output, "File to write folded stacks to");
+		profile->add_option("-r,--record", profile_record, "File to save the raw samples to, for profile-report");
+		profile->add_option("-s,--symbols", symbol_dirs, "Directories to search for ELFs matching the build ids of loaded modules, to name functions with");
+		profile->add_option("--symbol-index", symbol_index, "File to remember the build ids of files found with --symbols in (default: ~/.twib-symbols)");
+
+		profile_report = app.add_subcommand("profile-report", "Prints folded stacks from a recording made by profile --record");
+		profile_report->add_option("recording", profile_report_file, "Recording file")->required();
+		profile_report->add_flag("--lr", profile_lr, "Use the link register to fill in callers of leaf functions without frame records");
+		profile_report->add_option("-o,--output", profile_output, "File to write folded stacks to");
+	}
+
+	bool IsGdbParsed() {
+#if TWIB_GDB_ENABLED == 1
+		return gdb->parsed();
+#else
+		return false;
+#endif
+	}
+	
+	// commands that don't need to talk to twibd
+	bool IsOfflineParsed() {
+		return profile_report->parsed();
+	}
+
+	int RunOffline() {
+		if(profile_report->parsed()) {
+			FILE *f = fopen(profile_report_file.c_str(), "rb");
+			if(!f) {
+				LogMessage(Fatal, "could not open '%s': %s", profile_report_file.c_str(), strerror(errno));
+				return 1;
+			}
+			std::vector<tool::Profile::Module> modules;
+			std::vector<std::vector<uint64_t>> batches;
+			bool ok = tool::ReadProfileRecording(f, modules, batches);
+			fclose(f);
+			if(!ok) {
+				LogMessage(Fatal, "'%s' is not a valid profile recording", profile_report_file.c_str());
+				return 1;
+			}
+			
+			tool::Profile profile(modules, profile_lr);
+			for(const std::vector<uint64_t> &batch : batches) {
+				if(!profile.AddBatch(batch)) {
+					LogMessage(Fatal, "'%s' has a malformed batch of samples", profile_report_file.c_str());
+					return 1;
+				}
+			}
+			return tool::ReportProfile(profile, profile_output);
+		}
+		return 1;
+	}
+	
+	int Run(Session &session) {
+		tool::ITwibMetaInterface &itmi = session.itmi;
+		
+		if(IsOfflineParsed()) { // from batch or repl
+			return RunOffline();
+		}
+
+		if(ld->parsed()) {
+			ListDevices(itmi);
+			return 0;
+		}
+
+		if(connect_tcp->parsed()) {
+			printf("%s\n", itmi.ConnectTcp(connect_tcp_hostname, connect_tcp_port).c_str());
+			return 0;
+		}
+
+		if(dump_trace->parsed()) {
+			std::string trace = itmi.DumpTrace();
+			FILE *f = fopen(dump_trace_file.c_str(), "w");
+			if(!f) {
+				LogMessage(Fatal, "could not open %s", dump_trace_file.c_str());
+				return 1;
+			}
+			fwrite(trace.data(), 1, trace.size(), f);
+			fclose(f);
+			return 0;
+		}
+
+		tool::ITwibDeviceInterface *itdi_ptr = session.GetDevice();
+		if(!itdi_ptr) {
+			return 1;
+		}
+		tool::ITwibDeviceInterface &itdi = *itdi_ptr;
+	
+		if(run->parsed()) {
+			auto code_opt = util::ReadFile(run_file.c_str());
+			if(!code_opt) {
+				LogMessage(Fatal, "could not read file");
+				return 1;
+			}
+
+			if(!run_applet && !run_shell) {
+				LogMessage(Fatal, "Managed process has been removed.");
+				return 1;
+			}
+		
+			tool::ITwibProcessMonitor mon = itdi.CreateMonitoredProcess(run_shell ? "shell" : (run_applet ? "applet" : "managed"));
+			mon.AppendCode(*code_opt);
+			uint64_t pid = run_suspend ? mon.LaunchSuspended() : mon.Launch();
+			if(!run_quiet) {
+				printf("PID: 0x%" PRIx64"\n", pid);
+			}
+			auto pump_output =
+				[](tool::ITwibPipeReader reader, FILE *stream) {
+					try {
+						while(true) {
+							std::vector<uint8_t> str = reader.ReadSync();
+							size_t r = fwrite(str.data(), sizeof(str[0]), str.size(), stream);
+							if(r < str.size() && str.size() > 0) {
+								throw std::system_error(errno, std::generic_category());
+							}
+							fflush(stream);
+						}
+					} catch(ResultError &e) {
+						LogMessage(Debug, "output pump got 0x%x", e.code);
+						if(e.code == TWILI_ERR_EOF) {
+							LogMessage(Debug, "  EoF");
+							return;
+						} else {
+							return; // there really isn't much we can do with this
+						}
+					}
+				};
+			std::thread stdout_pump(pump_output, mon.OpenStdout(), stdout);
+			std::thread stderr_pump(pump_output, mon.OpenStderr(), stderr);
+
+			class Logic : public platform::EventLoop::Logic {
+			 public:
+				Logic(std::function<void(platform::EventLoop&)> f) : f(f) {
+				}
+				virtual void Prepare(platform::EventLoop &loop) override {
+					f(loop);
+				};
+			 private:
+				std::function<void(platform::EventLoop&)> f;
+			};
+
+			tool::ITwibPipeWriter r = mon.OpenStdin();
+			platform::InputPump input_pump(4096,
+				[&r](std::vector<uint8_t> &data) {
+					r.WriteSync(data);
+				}, [&r]() {
+					r.Close();
+				});
+		
+			Logic logic(
+				[&](platform::EventLoop &l) {
+					l.Clear();
+					l.AddMember(input_pump);
+				});
+			platform::EventLoop stdin_loop(logic);
+			stdin_loop.Begin();
+		
+			stdout_pump.join();
+			stderr_pump.join();
+			LogMessage(Debug, "output pump threads exited");
+			try {
+				uint32_t state;
+				while((state = mon.WaitStateChange()) != 6) {
+					LogMessage(Debug, "  state %d change...", state);
+				}
+			} catch(ResultError &e) {
+				LogMessage(Error, "got 0x%x waiting for process exit", e.code);
+			}
+			LogMessage(Debug, "  process exited");
+			stdin_loop.Destroy();
+			return 0;
+		}
+
+		if(reboot->parsed()) {
+			if(reboot_unsafe) {
+				itdi.RebootUnsafe();
+			} else {
+				itdi.Reboot();
+			}
+			return 0;
+		}
+
+		if(coredump->parsed()) {
+			FILE *f = fopen(core_file.c_str(), "wb");
+			if(!f) {
+				LogMessage(Fatal, "could not open '%s': %s", core_file.c_str(), strerror(errno));
+				return 1;
+			}
+			std::vector<uint8_t> core = itdi.CoreDump(core_process_id);
+			size_t written = 0;
+			while(written < core.size()) {
+				ssize_t r = fwrite(core.data() + written, 1, core.size() - written, f);
+				if(r <= 0 || ferror(f)) {
+					LogMessage(Fatal, "write error on '%s'");
+				} else {
+					written+= r;
+				}
+			}
+			fclose(f);
+		}
+	
+		if(terminate->parsed()) {
+			itdi.Terminate(terminate_process_id);
+			return 0;
+		}
+
+		if(ps->parsed()) {
+			ListProcesses(itdi);
+			return 0;
+		}
+
+		if(identify->parsed()) {
+			show(itdi.Identify());
+			return 0;
+		}
+
+		if(list_named_pipes->parsed()) {
+			for(auto n : itdi.ListNamedPipes()) {
+				printf("%s\n", n.c_str());
+			}
+			return 0;
+		}
+
+		if(open_named_pipe->parsed()) {
+			auto reader = itdi.OpenNamedPipe(open_named_pipe_name);
+			if(!open_named_pipe_output.empty()) {
+				// the device copies straight to the file without sending
+				// anything through us
+				tool::ITwibFilesystemAccessor &sd = session.GetFilesystem("sd");
+				sd.CreateFile(0, 0, open_named_pipe_output);
+				tool::ITwibFileAccessor file = sd.OpenFile(6, open_named_pipe_output);
+				file.SetSize(0);
+				uint64_t size = reader.Splice(file, 0);
+				LogMessage(Info, "captured 0x%" PRIx64 " bytes", size);
+				return 0;
+			}
+			try {
+				while(true) {
+					std::vector<uint8_t> str = reader.ReadSync();
+					std::cout << std::string(str.begin(), str.end());
+				}
+			} catch(ResultError &e) {
+				if(e.code == TWILI_ERR_EOF) {
+					return 0;
+				} else {
+					throw e;
+				}
+			}
+			return 0;
+		}
+
+		if(get_memory_info->parsed()) {
+			msgpack11::MsgPack meminfo = itdi.GetMemoryInfo();
+			uint64_t total_memory_available = meminfo["total_memory_available"].uint64_value();
+			uint64_t total_memory_usage     = meminfo["total_memory_usage"    ].uint64_value();
+			const size_t one_mib = 1024 * 1024;
+			printf(
+				"Twili Memory: %" PRIu64" MiB / %" PRIu64" MiB (%" PRIu64"%%)\n",
+				total_memory_usage / one_mib,
+				total_memory_available / one_mib,
+				total_memory_usage * 100 / total_memory_available);
+
+			std::vector<const char*> category_labels = {"System", "Application", "Applet"};
+			for(auto &cat_info : meminfo["limits"].array_items()) {
+				printf(
+					"%s Category Limit: %" PRIu64" MiB / %" PRIu64" MiB (%" PRIu64"%%)\n",
+					category_labels[cat_info["category"].int_value()],
+					cat_info["current_value"].uint64_value() / one_mib,
+					cat_info["limit_value"].uint64_value() / one_mib,
+					cat_info["current_value"].uint64_value() * 100 / cat_info["limit_value"].uint64_value());
+			}
+			return 0;
+		}
+
+		if(print_debug_info->parsed()) {
+			itdi.PrintDebugInfo();
+			return 0;
+		}
+
+		if(launch->parsed()) {
+			uint64_t storage_id = 0;
+			if(launch_storage == "none") {
+				storage_id = 0;
+			} else if(launch_storage == "host") {
+				storage_id = 1;
+			} else if(launch_storage == "gamecard" || launch_storage == "gc") {
+				storage_id = 2;
+			} else if(launch_storage == "nand-system" || launch_storage == "system") {
+				storage_id = 3;
+			} else if(launch_storage == "nand-user" || launch_storage == "user") {
+				storage_id = 4;
+			} else if(launch_storage == "sdcard" || launch_storage == "sd") {
+				storage_id = 5;
+			} else {
+				LogMessage(Error, "unrecognized storage: %s\n", launch_storage.c_str());
+			}
+
+			uint64_t title_id = std::stoull(launch_title_id, nullptr, 16);
+
+			printf("0x%" PRIx64"\n", itdi.LaunchUnmonitoredProcess(title_id, storage_id, launch_flags));
+		}
+
+#if TWIB_GDB_ENABLED == 1
+		if(gdb->parsed()) {
+			std::unique_ptr<tool::SymbolCache> symbol_cache = tool::OpenSymbolCache(symbol_dirs, symbol_index);
+			
+			tool::gdb::GdbStub stub(itdi);
+			stub.symbol_cache = symbol_cache.get();
+			stub.Run();
+			return 0;
+		}
+#endif
+
+		if(sd_commands->subcommand->parsed()) {
+			return sd_commands->Run(session);
+		}
+
+		if(nand_user_commands->subcommand->parsed()) {
+			return nand_user_commands->Run(session);
+		}
+
+		if(nand_system_commands->subcommand->parsed()) {
+			return nand_system_commands->Run(session);
+		}
+
+		if(get_module_info->parsed()) {
+			auto debugger = itdi.OpenActiveDebugger(get_module_info_process_id);
+			for(auto info : debugger.GetNsoInfos()) {
+				printf("module ");
+				for(int i = 0; i < 0x20; i++) {
+					printf("%02x", info.build_id[i]);
+				}
+				printf(": loaded at 0x%lx,  +0x%lx\n", info.base_addr, info.size);
+			}
+			return 0;
+		}
+
+		if(scan_memory->parsed()) {
+			std::vector<uint8_t> pattern, mask;
+			if(!util::ParsePattern(scan_memory_pattern, pattern, mask)) {
+				LogMessage(Fatal, "invalid pattern: %s", scan_memory_pattern.c_str());
+				return 1;
+			}
+			uint64_t type_mask;
+			if(!tool::ParseMemoryTypes(scan_memory_types, type_mask)) {
+				LogMessage(Fatal, "invalid memory type");
+				return 1;
+			}
+			if(!util::PatternScanner::IsValid(pattern, mask, scan_memory_alignment)) {
+				LogMessage(Fatal, "alignment must be a power of two");
+				return 1;
+			}
+			uint64_t addr = std::stoull(scan_memory_start, nullptr, 0);
+			uint64_t end = std::stoull(scan_memory_end, nullptr, 0);
+			
+			auto debugger = itdi.OpenActiveDebugger(scan_memory_process_id);
+			uint64_t found = 0;
+			while(addr < end && (scan_memory_max_matches == 0 || found < scan_memory_max_matches)) {
+				uint32_t max_matches = 0x1000; // keeps responses small
+				if(scan_memory_max_matches != 0) {
+					max_matches = std::min<uint64_t>(max_matches, scan_memory_max_matches - found);
+				}
+				
+				uint64_t next;
+				std::vector<uint64_t> matches;
+				std::tie(next, matches) = debugger.ScanMemory(addr, end, type_mask, scan_memory_alignment, max_matches, pattern, mask);
+				for(uint64_t match : matches) {
+					printf("0x%016" PRIx64 "\n", match);
+				}
+				fflush(stdout);
+				found+= matches.size();
+				
+				if(next <= addr) {
+					break;
+				}
+				addr = next;
+			}
+			return 0;
+		}
+
+		if(vmmap->parsed()) {
+			auto debugger = itdi.OpenActiveDebugger(vmmap_process_id);
+			tool::ListMemoryMap(debugger, vmmap_all);
+			return 0;
+		}
+
+		if(memory_diff->parsed()) {
+			const uint32_t max_pages = 256; // keeps responses around 1 MiB
+			uint64_t start = std::stoull(memory_diff_start, nullptr, 0);
+			uint64_t end = std::stoull(memory_diff_end, nullptr, 0);
+			bool save = !memory_diff_output.empty();
+			
+			auto debugger = itdi.OpenActiveDebugger(memory_diff_process_id);
+			uint64_t full_size = 0;
+			for(uint64_t addr = start; addr < end; ) {
+				uint64_t next, size;
+				std::tie(next, size) = debugger.SnapshotMemory(addr, end, addr != start);
+				full_size+= size;
+				if(next <= addr) {
+					break;
+				}
+				addr = next;
+			}
+
+			// attaching stopped the process, so let it go until we diff
+			tool::ResumeAttachedProcess(debugger);
+			std::this_thread::sleep_for(std::chrono::milliseconds(memory_diff_wait_ms));
+			debugger.BreakProcess();
+
+			uint64_t addr = start;
+			uint64_t changed = 0;
+			uint64_t transferred = 0;
+			while(addr < end) {
+				uint64_t next;
+				std::vector<uint64_t> pages;
+				std::vector<uint8_t> contents;
+				std::tie(next, pages, contents) = debugger.DiffMemory(addr, max_pages, save);
+				transferred+= sizeof(uint64_t) * (3 + pages.size()) + contents.size();
+				
+				for(size_t i = 0; i < pages.size(); i++) {
+					printf("0x%016" PRIx64 "\n", pages[i]);
+					if(save) {
+						std::string path = memory_diff_output + "/" + tool::ToHex(pages[i], 16, false) + ".bin";
+						FILE *f = fopen(path.c_str(), "wb");
+						if(!f) {
+							LogMessage(Fatal, "could not open '%s': %s", path.c_str(), strerror(errno));
+							return 1;
+						}
+						size_t page_size = contents.size() / pages.size();
+						fwrite(contents.data() + i * page_size, 1, page_size, f);
+						fclose(f);
+					}
+				}
+				changed+= pages.size();
+				
+				if(next <= addr) {
+					break;
+				}
+				addr = next;
+			}
+			
+			LogMessage(Info, "%" PRIu64 " pages changed; transferred 0x%" PRIx64 " bytes, a full dump would have been 0x%" PRIx64 " bytes", changed, transferred, full_size);
+			return 0;
+		}
+
+		if(backtrace->parsed()) {
+			// attaching stops the process, and closing the debugger lets it go
+			auto debugger = itdi.OpenActiveDebugger(backtrace_process_id);
+			std::unique_ptr<tool::SymbolCache> symbol_cache = tool::OpenSymbolCache(symbol_dirs, symbol_index);
+			tool::ListBacktraces(debugger, backtrace_thread_ids, backtrace_depth, symbol_cache.get());
+			return 0;
+		}
+
+		if(profile->parsed()) {
+			if(profile_interval_us == 0 || profile_depth == 0) {
+				LogMessage(Fatal, "interval and depth must be nonzero");
+				return 1;
+			}
+			
+			auto debugger = itdi.OpenActiveDebugger(profile_process_id);
+			std::unique_ptr<tool::SymbolCache> symbol_cache = tool::OpenSymbolCache(symbol_dirs, symbol_index);
+			std::vector<tool::Profile::Module> modules = tool::GetModules(debugger, symbol_cache.get());
+			tool::Profile profile(modules, profile_lr);
+
+			FILE *record = nullptr;
+			if(!profile_record.empty()) {
+				record = fopen(profile_record.c_str(), "wb");
+				if(!record || !tool::WriteProfileHeader(record, modules)) {
+					LogMessage(Fatal, "could not write '%s': %s", profile_record.c_str(), strerror(errno));
+					return 1;
+				}
+			}
+			
+			tool::ResumeAttachedProcess(debugger);
+
+			// the device answers each request once it has taken all the samples,
+			// so ask for about 100ms worth at a time
+			uint64_t remaining = std::max<uint64_t>((uint64_t) profile_duration_ms * 1000 / profile_interval_us, 1);
+			uint32_t per_request = std::min<uint32_t>(std::max<uint32_t>(100000 / profile_interval_us, 1), 1000);
+			while(remaining > 0) {
+				uint32_t count = std::min<uint64_t>(remaining, per_request);
+				std::vector<uint64_t> words = debugger.Sample(count, profile_interval_us, profile_depth);
+				if(!profile.AddBatch(words)) {
+					LogMessage(Fatal, "device sent a malformed batch of samples");
+					return 1;
+				}
+				if(record && !tool::WriteProfileBatch(record, words)) {
+					LogMessage(Fatal, "could not write '%s': %s", profile_record.c_str(), strerror(errno));
+					return 1;
+				}
+				remaining-= count;
+			}
+
+			if(record) {
+				fclose(record);
+			}
+			return tool::ReportProfile(profile, profile_output);
+		}
+	
+		return 0;
+	}
+
+ private:
+	CLI::App *ld;
+	
+	CLI::App *connect_tcp;
+	std::string connect_tcp_hostname;
+	std::string connect_tcp_port = "15152";
+
+	CLI::App *dump_trace;
+	std::string dump_trace_file;
+	
+	CLI::App *run;
+	std::string run_file;
+	bool run_applet = false;
+	bool run_shell = false;
+	bool run_suspend = false;
+	bool run_quiet = false;
+	
+	CLI::App *reboot;
+	bool reboot_unsafe = false;
+
+	CLI::App *coredump;
+	std::string core_file;
+	uint64_t core_process_id;
+	
+	CLI::App *terminate;
+	uint64_t terminate_process_id;
+	
+	CLI::App *ps;
+	CLI::App *identify;
+	CLI::App *list_named_pipes;
+
+	CLI::App *open_named_pipe;
+	std::string open_named_pipe_name;
+	std::string open_named_pipe_output;
+
+	CLI::App *get_memory_info;
+	CLI::App *print_debug_info;
+
+#if TWIB_GDB_ENABLED == 1
+	CLI::App *gdb;
+#endif
+
+	CLI::App *launch;
+	std::string launch_title_id;
+	std::string launch_storage;
+	uint32_t launch_flags = 0;
+
+	std::unique_ptr<FSCommands> sd_commands;
+	std::unique_ptr<FSCommands> nand_user_commands;
+	std::unique_ptr<FSCommands> nand_system_commands;
+
+	CLI::App *get_module_info;
+	uint64_t get_module_info_process_id;
+
+	CLI::App *scan_memory;
+	uint64_t scan_memory_process_id;
+	std::string scan_memory_pattern;
+	std::string scan_memory_start = "0";
+	std::string scan_memory_end = "0xffffffffffffffff";
+	std::vector<std::string> scan_memory_types;
+	uint32_t scan_memory_alignment = 1;
+	uint64_t scan_memory_max_matches = 0;
+
+	CLI::App *vmmap;
+	uint64_t vmmap_process_id;
+	bool vmmap_all = false;
+
+	CLI::App *memory_diff;
+	uint64_t memory_diff_process_id;
+	std::string memory_diff_start = "0";
+	std::string memory_diff_end = "0xffffffffffffffff";
+	uint32_t memory_diff_wait_ms = 1000;
+	std::string memory_diff_output;
+
+	CLI::App *backtrace;
+	uint64_t backtrace_process_id;
+	std::vector<uint64_t> backtrace_thread_ids;
+	uint32_t backtrace_depth = 32;
+
+	CLI::App *profile;
+	uint64_t profile_process_id;
+	uint32_t profile_duration_ms = 5000;
+	uint32_t profile_interval_us = 1000;
+	uint32_t profile_depth = 32;
+	bool profile_lr = false;
+	std::string profile_output = "-";
+	std::string profile_record;
+
+	CLI::App *profile_report;
+	std::string profile_report_file;
+
+	// for gdb, backtrace, and profile
+	std::vector<std::string> symbol_dirs;
+	std::string symbol_index;
+};
+
+// Splits a line into arguments on whitespace, honoring single quotes, double
+// quotes, and backslash escapes. Returns false if a quote is left open.
+static bool SplitCommandLine(const std::string &line, std::vector<std::string> &args) {
+	std::string current;
+	bool in_arg = false;
+	char quote = 0;
+	for(size_t i = 0; i < line.size(); i++) {
+		char c = line[i];
+		if(quote) {
+			if(c == quote) {
+				quote = 0;
+			} else if(c == '\\' && quote == '"' && i + 1 < line.size()) {
+				current.push_back(line[++i]);
+			} else {
+				current.push_back(c);
+			}
+		} else if(c == '\'' || c == '"') {
+			quote = c;
+			in_arg = true;
+		} else if(c == '\\' && i + 1 < line.size()) {
+			current.push_back(line[++i]);
+			in_arg = true;
+		} else if(isspace((unsigned char) c)) {
+			if(in_arg) {
+				args.push_back(current);
+				current.clear();
+				in_arg = false;
+			}
+		} else if(c == '#' && !in_arg) {
+			break; // comment
+		} else {
+			current.push_back(c);
+			in_arg = true;
+		}
+	}
+	if(in_arg) {
+		args.push_back(current);
+	}
+	return quote == 0;
+}
+
+static int RunCommandLine(std::vector<std::string> &args, Session &session) {
+	CLI::App app {"Twili debug monitor client"};
+	Commands commands(app);
+	app.require_subcommand(1);
+
+	std::string name = "twib";
+	std::vector<char*> argv;
+	argv.push_back(name.data());
+	for(std::string &arg : args) {
+		argv.push_back(arg.data());
+	}
+
+	try {
+		app.parse((int) argv.size(), argv.data());
+	} catch(const CLI::ParseError &e) {
+		return app.exit(e);
+	}
+
+	try {
+		return commands.Run(session);
+	} catch(ResultError &e) {
+		LogMessage(Error, "command failed: 0x%x", e.code);
+		return 1;
+	}
+}
+
+// Runs commands one line at a time over the session's connection. In batch
+// mode, stops at the first failing command unless keep_going is set.
+static int RunScript(std::istream &in, Session &session, bool interactive, bool keep_going) {
+	int result = 0;
+	std::string line;
+	while(true) {
+		if(interactive) {
+			printf("twib> ");
+			fflush(stdout);
+		}
+		if(!std::getline(in, line)) {
+			break;
+		}
+		
+		std::vector<std::string> args;
+		if(!SplitCommandLine(line, args)) {
+			LogMessage(Error, "unterminated quote");
+			result = 1;
+			if(!interactive && !keep_going) {
+				return result;
+			}
+			continue;
+		}
+		if(args.empty()) {
+			continue;
+		}
+		if(interactive && (args[0] == "exit" || args[0] == "quit")) {
+			break;
+		}
+		
+		int r = RunCommandLine(args, session);
+		if(r != 0) {
+			result = r;
+			if(!interactive && !keep_going) {
+				return result;
+			}
+		}
+	}
+	if(interactive) {
+		printf("\n");
+	}
+	return result;
+}
+
 int main(int argc, char *argv[]) {
 #ifdef _WIN32
 	WSADATA wsaData;
@@ -506,73 +1597,15 @@ int main(int argc, char *argv[]) {
 		->envname("TWIB_NAMED_PIPE_FRONTEND_NAME");
 #endif
 	
-	CLI::App *ld = app.add_subcommand("list-devices", "List devices");
-	
-	CLI::App *cmd_connect_tcp = app.add_subcommand("connect-tcp", "Connect to a device over TCP");
-	std::string connect_tcp_hostname;
-	std::string connect_tcp_port = "15152";
-	cmd_connect_tcp->add_option("hostname", connect_tcp_hostname, "Hostname to connect to")->required();
-	cmd_connect_tcp->add_option("port", connect_tcp_port, "Port to connect to");
-	
-	CLI::App *run = app.add_subcommand("run", "Run an executable");
-	std::string run_file;
-	bool run_applet = false;
-	bool run_shell = false;
-	bool run_suspend = false;
-	bool run_quiet = false;
-	run->add_flag("-a,--applet", run_applet, "Run as an applet");
-	run->add_flag("-s,--shell", run_shell, "Run as a shell program");
-	run->add_flag("-d,--debug-suspend", run_suspend, "Suspends for debug");
-	run->add_flag("-q,--quiet", run_quiet, "Suppress any output except from the program being run");
-	run->add_option("file", run_file, "Executable to run")->check(CLI::ExistingFile)->required();
-	
-	CLI::App *reboot = app.add_subcommand("reboot", "Reboot the device");
-	bool reboot_unsafe;
-	reboot->add_flag("-u,--unsafe", reboot_unsafe, "Reboot quickly but forcefully and unsafely");
-
-	CLI::App *coredump = app.add_subcommand("coredump", "Make a coredump of a crashed process");
-	std::string core_file;
-	uint64_t core_process_id;
-	coredump->add_option("file", core_file, "File to dump core to")->required();
-	coredump->add_option("pid", core_process_id, "Process ID")->required();
-	
-	CLI::App *terminate = app.add_subcommand("terminate", "Terminate a process on the device");
-	uint64_t terminate_process_id;
-	terminate->add_option("pid", terminate_process_id, "Process ID")->required();
-	
-	CLI::App *ps = app.add_subcommand("ps", "List processes on the device");
-
-	CLI::App *identify = app.add_subcommand("identify", "Identify the device");
-
-	CLI::App *list_named_pipes = app.add_subcommand("list-named-pipes", "List named pipes on the device");
-
-	CLI::App *open_named_pipe = app.add_subcommand("open-named-pipe", "Open a named pipe on the device");
-	std::string open_named_pipe_name;
-	open_named_pipe->add_option("name", open_named_pipe_name, "Name of pipe to open")->required();
-
-	CLI::App *get_memory_info = app.add_subcommand("get-memory-info", "Gets memory usage information from the device");
-
-	CLI::App *print_debug_info = app.add_subcommand("debug", "Prints debug info");
-
-#if TWIB_GDB_ENABLED == 1
-	CLI::App *gdb = app.add_subcommand("gdb", "Opens an enhanced GDB stub for the device");
-#endif
-
-	CLI::App *launch = app.add_subcommand("launch", "Launches an installed title");
-	std::string launch_title_id;
-	std::string launch_storage;
-	uint32_t launch_flags = 0;
-	launch->add_option("title-id", launch_title_id, "Title ID to launch")->required();
-	launch->add_set_ignore_case("storage", launch_storage, {"none", "host", "gamecard", "gc", "nand-system", "system", "nand-user", "user", "sdcard", "sd"}, "Storage for title")->required();
-	launch->add_option("launch-flags", launch_flags, "Flags for launch");
+	Commands commands(app);
 
-	FSCommands sd_commands(app, "sd", "Perform operations on target SD card", "sd");
-	FSCommands nand_user_commands(app, "nu", "Perform operations on target NAND user filesystem", "nand_user");
-	FSCommands nand_system_commands(app, "ns", "Perform operations on target NAND system filesystem", "nand_system");
+	CLI::App *batch = app.add_subcommand("batch", "Run many commands over one connection to twibd");
+	std::string batch_file = "-";
+	bool batch_keep_going = false;
+	batch->add_option("file", batch_file, "File to read commands from, one per line (default: stdin)");
+	batch->add_flag("-k,--keep-going", batch_keep_going, "Keep running commands after one fails");
 
-	CLI::App *get_module_info = app.add_subcommand("get-module-info", "Lists loaded module info for a specific process");
-	uint64_t get_module_info_process_id;
-	get_module_info->add_option("pid", get_module_info_process_id, "Process ID")->required();
+	CLI::App *repl = app.add_subcommand("repl", "Run commands interactively over one connection to twibd");
 	
 	app.require_subcommand(1);
 	
@@ -584,13 +1617,9 @@ int main(int argc, char *argv[]) {
 
 	log::init_color();
 	if(is_verbose) {
-#if TWIB_GDB_ENABLED == 1
-		if(gdb->parsed()) {
+		if(commands.IsGdbParsed()) {
 			// for gdb stub, all logging should go to stderr
 			log::add_log(std::make_shared<log::PrettyFileLogger>(stderr, log::Level::Debug, log::Level::Error));
-#else
-		if(false) {
-#endif
 		} else {
 			log::add_log(std::make_shared<log::PrettyFileLogger>(stdout, log::Level::Debug, log::Level::Error));
 		}
@@ -599,6 +1628,10 @@ int main(int argc, char *argv[]) {
 	
 	LogMessage(Message, "starting twib");
 
+	if(commands.IsOfflineParsed()) {
+		return commands.RunOffline();
+	}
+
 	std::unique_ptr<tool::client::Client> client;
 	if(TWIB_UNIX_FRONTEND_ENABLED && frontend == "unix") {
 		client = tool::connect_unix(unix_frontend_path);
@@ -613,272 +1646,27 @@ int main(int argc, char *argv[]) {
 	if(!client) {
 		return 1;
 	}
-	
-	tool::ITwibMetaInterface itmi(tool::RemoteObject(*client, 0, 0));
-	
-	if(ld->parsed()) {
-		ListDevices(itmi);
-		return 0;
-	}
-
-	if(cmd_connect_tcp->parsed()) {
-		printf("%s\n", itmi.ConnectTcp(connect_tcp_hostname, connect_tcp_port).c_str());
-		return 0;
-	}
-
-	uint32_t device_id;
-	if(device_id_str.size() > 0) {
-		device_id = std::stoul(device_id_str, NULL, 16);
-	} else {
-		std::vector<msgpack11::MsgPack> devices = itmi.ListDevices();
-		if(devices.size() == 0) {
-			LogMessage(Fatal, "No devices were detected.");
-			return 1;
-		}
-		if(devices.size() > 1) {
-			LogMessage(Fatal, "Multiple devices were detected. Please use -d to specify which one you mean.");
-			return 1;
-		}
-		device_id = devices[0]["device_id"].uint32_value();
-	}
-	tool::ITwibDeviceInterface itdi(std::make_shared<tool::RemoteObject>(*client, device_id, 0));
-	
-	if(run->parsed()) {
-		auto code_opt = util::ReadFile(run_file.c_str());
-		if(!code_opt) {
-			LogMessage(Fatal, "could not read file");
-			return 1;
-		}
-
-		if(!run_applet && !run_shell) {
-			LogMessage(Fatal, "Managed process has been removed.");
-			return 1;
-		}
-		
-		tool::ITwibProcessMonitor mon = itdi.CreateMonitoredProcess(run_shell ? "shell" : (run_applet ? "applet" : "managed"));
-		mon.AppendCode(*code_opt);
-		uint64_t pid = run_suspend ? mon.LaunchSuspended() : mon.Launch();
-		if(!run_quiet) {
-			printf("PID: 0x%" PRIx64"\n", pid);
-		}
-		auto pump_output =
-			[](tool::ITwibPipeReader reader, FILE *stream) {
-				try {
-					while(true) {
-						std::vector<uint8_t> str = reader.ReadSync();
-						size_t r = fwrite(str.data(), sizeof(str[0]), str.size(), stream);
-						if(r < str.size() && str.size() > 0) {
-							throw std::system_error(errno, std::generic_category());
-						}
-						fflush(stream);
-					}
-				} catch(ResultError &e) {
-					LogMessage(Debug, "output pump got 0x%x", e.code);
-					if(e.code == TWILI_ERR_EOF) {
-						LogMessage(Debug, "  EoF");
-						return;
-					} else {
-						return; // there really isn't much we can do with this
-					}
-				}
-			};
-		std::thread stdout_pump(pump_output, mon.OpenStdout(), stdout);
-		std::thread stderr_pump(pump_output, mon.OpenStderr(), stderr);
 
-		class Logic : public platform::EventLoop::Logic {
-		 public:
-			Logic(std::function<void(platform::EventLoop&)> f) : f(f) {
-			}
-			virtual void Prepare(platform::EventLoop &loop) override {
-				f(loop);
-			};
-		 private:
-			std::function<void(platform::EventLoop&)> f;
-		};
-
-		tool::ITwibPipeWriter r = mon.OpenStdin();
-		platform::InputPump input_pump(4096,
-			[&r](std::vector<uint8_t> &data) {
-				r.WriteSync(data);
-			}, [&r]() {
-				r.Close();
-			});
-		
-		Logic logic(
-			[&](platform::EventLoop &l) {
-				l.Clear();
-				l.AddMember(input_pump);
-			});
-		platform::EventLoop stdin_loop(logic);
-		stdin_loop.Begin();
-		
-		stdout_pump.join();
-		stderr_pump.join();
-		LogMessage(Debug, "output pump threads exited");
-		try {
-			uint32_t state;
-			while((state = mon.WaitStateChange()) != 6) {
-				LogMessage(Debug, "  state %d change...", state);
-			}
-		} catch(ResultError &e) {
-			LogMessage(Error, "got 0x%x waiting for process exit", e.code);
-		}
-		LogMessage(Debug, "  process exited");
-		stdin_loop.Destroy();
-		return 0;
-	}
+	Session session(*client, device_id_str);
 
-	if(reboot->parsed()) {
-		if(reboot_unsafe) {
-			itdi.RebootUnsafe();
+	if(batch->parsed()) {
+		if(batch_file == "-") {
+			return RunScript(std::cin, session, false, batch_keep_going);
 		} else {
-			itdi.Reboot();
-		}
-		return 0;
-	}
-
-	if(coredump->parsed()) {
-		FILE *f = fopen(core_file.c_str(), "wb");
-		if(!f) {
-			LogMessage(Fatal, "could not open '%s': %s", core_file.c_str(), strerror(errno));
-			return 1;
-		}
-		std::vector<uint8_t> core = itdi.CoreDump(core_process_id);
-		size_t written = 0;
-		while(written < core.size()) {
-			ssize_t r = fwrite(core.data() + written, 1, core.size() - written, f);
-			if(r <= 0 || ferror(f)) {
-				LogMessage(Fatal, "write error on '%s'");
-			} else {
-				written+= r;
+			std::ifstream file(batch_file);
+			if(!file) {
+				LogMessage(Fatal, "could not open %s", batch_file.c_str());
+				return 1;
 			}
+			return RunScript(file, session, false, batch_keep_going);
 		}
-		fclose(f);
-	}
-	
-	if(terminate->parsed()) {
-		itdi.Terminate(terminate_process_id);
-		return 0;
-	}
-
-	if(ps->parsed()) {
-		ListProcesses(itdi);
-		return 0;
-	}
-
-	if(identify->parsed()) {
-		show(itdi.Identify());
-		return 0;
-	}
-
-	if(list_named_pipes->parsed()) {
-		for(auto n : itdi.ListNamedPipes()) {
-			printf("%s\n", n.c_str());
-		}
-		return 0;
 	}
 
-	if(open_named_pipe->parsed()) {
-		auto reader = itdi.OpenNamedPipe(open_named_pipe_name);
-		try {
-			while(true) {
-				std::vector<uint8_t> str = reader.ReadSync();
-				std::cout << std::string(str.begin(), str.end());
-			}
-		} catch(ResultError &e) {
-			if(e.code == TWILI_ERR_EOF) {
-				return 0;
-			} else {
-				throw e;
-			}
-		}
-		return 0;
+	if(repl->parsed()) {
+		return RunScript(std::cin, session, true, false);
 	}
 
-	if(get_memory_info->parsed()) {
-		msgpack11::MsgPack meminfo = itdi.GetMemoryInfo();
-		uint64_t total_memory_available = meminfo["total_memory_available"].uint64_value();
-		uint64_t total_memory_usage     = meminfo["total_memory_usage"    ].uint64_value();
-		const size_t one_mib = 1024 * 1024;
-		printf(
-			"Twili Memory: %" PRIu64" MiB / %" PRIu64" MiB (%" PRIu64"%%)\n",
-			total_memory_usage / one_mib,
-			total_memory_available / one_mib,
-			total_memory_usage * 100 / total_memory_available);
-
-		std::vector<const char*> category_labels = {"System", "Application", "Applet"};
-		for(auto &cat_info : meminfo["limits"].array_items()) {
-			printf(
-				"%s Category Limit: %" PRIu64" MiB / %" PRIu64" MiB (%" PRIu64"%%)\n",
-				category_labels[cat_info["category"].int_value()],
-				cat_info["current_value"].uint64_value() / one_mib,
-				cat_info["limit_value"].uint64_value() / one_mib,
-				cat_info["current_value"].uint64_value() * 100 / cat_info["limit_value"].uint64_value());
-		}
-		return 0;
-	}
-
-	if(print_debug_info->parsed()) {
-		itdi.PrintDebugInfo();
-		return 0;
-	}
-
-	if(launch->parsed()) {
-		uint64_t storage_id = 0;
-		if(launch_storage == "none") {
-			storage_id = 0;
-		} else if(launch_storage == "host") {
-			storage_id = 1;
-		} else if(launch_storage == "gamecard" || launch_storage == "gc") {
-			storage_id = 2;
-		} else if(launch_storage == "nand-system" || launch_storage == "system") {
-			storage_id = 3;
-		} else if(launch_storage == "nand-user" || launch_storage == "user") {
-			storage_id = 4;
-		} else if(launch_storage == "sdcard" || launch_storage == "sd") {
-			storage_id = 5;
-		} else {
-			LogMessage(Error, "unrecognized storage: %s\n", launch_storage.c_str());
-		}
-
-		uint64_t title_id = std::stoull(launch_title_id, nullptr, 16);
-
-		printf("0x%" PRIx64"\n", itdi.LaunchUnmonitoredProcess(title_id, storage_id, launch_flags));
-	}
-
-#if TWIB_GDB_ENABLED == 1
-	if(gdb->parsed()) {
-		tool::gdb::GdbStub stub(itdi);
-		stub.Run();
-		return 0;
-	}
-#endif
-
-	if(sd_commands.subcommand->parsed()) {
-		return sd_commands.Run(itdi);
-	}
-
-	if(nand_user_commands.subcommand->parsed()) {
-		return nand_user_commands.Run(itdi);
-	}
-
-	if(nand_system_commands.subcommand->parsed()) {
-		return nand_system_commands.Run(itdi);
-	}
-
-	if(get_module_info->parsed()) {
-		auto debugger = itdi.OpenActiveDebugger(get_module_info_process_id);
-		for(auto info : debugger.GetNsoInfos()) {
-			printf("module ");
-			for(int i = 0; i < 0x20; i++) {
-				printf("%02x", info.build_id[i]);
-			}
-			printf(": loaded at 0x%lx,  +0x%lx\n", info.base_addr, info.size);
-		}
-		return 0;
-	}
-	
-	return 0;
+	return commands.Run(session);
 }
 
 namespace twili {
@@ -21,6 +21,7 @@
 #include "ITwibDebugger.hpp"
 
 #include "Protocol.hpp"
+#include "err.hpp"
 #include "common/Logger.hpp"
 #include "common/ResultError.hpp"
 
@@ -243,6 +244,171 @@ std::vector<nx::LoadedModuleInfo> ITwibDebugger::GetNroInfos() {
 	return infos;
 }
 
+std::future<std::vector<nx::LoadedModuleInfo>> ITwibDebugger::GetNsoInfosAsync() {
+	LogMessage(Debug, "ITwibDebugger::GetNsoInfosAsync()");
+	return obj->SendSmartAsyncRequest<std::vector<nx::LoadedModuleInfo>>(CommandID::GET_NSO_INFOS);
+}
+
+std::future<std::vector<nx::LoadedModuleInfo>> ITwibDebugger::GetNroInfosAsync() {
+	LogMessage(Debug, "ITwibDebugger::GetNroInfosAsync()");
+	return obj->SendSmartAsyncRequest<std::vector<nx::LoadedModuleInfo>>(CommandID::GET_NRO_INFOS);
+}
+
+std::tuple<uint64_t, std::vector<uint64_t>> ITwibDebugger::ScanMemory(uint64_t start, uint64_t end, uint64_t type_mask, uint32_t alignment, uint32_t max_matches, std::vector<uint8_t> pattern, std::vector<uint8_t> mask) {
+	uint64_t next;
+	std::vector<uint64_t> matches;
+
+	LogMessage(Debug, "ITwibDebugger::ScanMemory(0x%lx, 0x%lx, 0x%lx, %u, %u)", start, end, type_mask, alignment, max_matches);
+	
+	obj->SendSmartSyncRequest(
+		CommandID::SCAN_MEMORY,
+		in<uint64_t>(start),
+		in<uint64_t>(end),
+		in<uint64_t>(type_mask),
+		in<uint32_t>(alignment),
+		in<uint32_t>(max_matches),
+		in<std::vector<uint8_t>>(pattern),
+		in<std::vector<uint8_t>>(mask),
+		out<uint64_t>(next),
+		out<std::vector<uint64_t>>(matches));
+
+	LogMessage(Debug, "  => 0x%lx, %zu matches", next, matches.size());
+	
+	return std::make_tuple(next, matches);
+}
+
+std::tuple<uint64_t, uint64_t> ITwibDebugger::SnapshotMemory(uint64_t start, uint64_t end, bool resume) {
+	uint64_t next;
+	uint64_t size;
+
+	LogMessage(Debug, "ITwibDebugger::SnapshotMemory(0x%lx, 0x%lx, %d)", start, end, resume);
+	
+	obj->SendSmartSyncRequest(
+		CommandID::SNAPSHOT_MEMORY,
+		in<uint64_t>(start),
+		in<uint64_t>(end),
+		in<uint32_t>(resume ? 1 : 0),
+		out<uint64_t>(next),
+		out<uint64_t>(size));
+
+	LogMessage(Debug, "  => 0x%lx, 0x%lx", next, size);
+	
+	return std::make_tuple(next, size);
+}
+
+std::tuple<uint64_t, std::vector<uint64_t>, std::vector<uint8_t>> ITwibDebugger::DiffMemory(uint64_t start, uint32_t max_pages, bool include_contents) {
+	uint64_t next;
+	std::vector<uint64_t> pages;
+	std::vector<uint8_t> contents;
+
+	LogMessage(Debug, "ITwibDebugger::DiffMemory(0x%lx, %u, %d)", start, max_pages, include_contents);
+	
+	obj->SendSmartSyncRequest(
+		CommandID::DIFF_MEMORY,
+		in<uint64_t>(start),
+		in<uint32_t>(max_pages),
+		in<uint32_t>(include_contents ? 1 : 0),
+		out<uint64_t>(next),
+		out<std::vector<uint64_t>>(pages),
+		out<std::vector<uint8_t>>(contents));
+
+	LogMessage(Debug, "  => 0x%lx, %zu pages", next, pages.size());
+	
+	return std::make_tuple(next, pages, contents);
+}
+
+std::vector<nx::MemoryInfo> ITwibDebugger::GetMemoryMap() {
+	std::vector<nx::MemoryInfo> regions;
+
+	LogMessage(Debug, "ITwibDebugger::GetMemoryMap()");
+	
+	obj->SendSmartSyncRequest(
+		CommandID::GET_MEMORY_MAP,
+		out<std::vector<nx::MemoryInfo>>(regions));
+
+	LogMessage(Debug, "  => %zu regions", regions.size());
+	
+	return regions;
+}
+
+std::vector<uint64_t> ITwibDebugger::Sample(uint32_t count, uint32_t interval_us, uint32_t max_depth) {
+	std::vector<uint64_t> words;
+
+	LogMessage(Debug, "ITwibDebugger::Sample(%u, %u, %u)", count, interval_us, max_depth);
+	
+	obj->SendSmartSyncRequest(
+		CommandID::SAMPLE,
+		in<uint32_t>(count),
+		in<uint32_t>(interval_us),
+		in<uint32_t>(max_depth),
+		out<std::vector<uint64_t>>(words));
+
+	LogMessage(Debug, "  => %zu words", words.size());
+	
+	return words;
+}
+
+std::vector<ThreadBacktrace> ITwibDebugger::Backtrace(std::vector<uint64_t> thread_ids, uint32_t max_depth) {
+	std::vector<ThreadContext> contexts;
+	std::vector<uint64_t> words;
+
+	LogMessage(Debug, "ITwibDebugger::Backtrace(%zu threads, %u)", thread_ids.size(), max_depth);
+	
+	obj->SendSmartSyncRequest(
+		CommandID::BACKTRACE,
+		in<std::vector<uint64_t>>(thread_ids),
+		in<uint32_t>(max_depth),
+		out<std::vector<ThreadContext>>(contexts),
+		out<std::vector<uint64_t>>(words));
+
+	std::vector<ThreadBacktrace> backtraces;
+	size_t i = 0;
+	for(ThreadContext &context : contexts) {
+		if(words.size() - i < 2 || (words.size() - i - 2) / 3 < words[i + 1]) {
+			throw ResultError(TWILI_ERR_PROTOCOL_BAD_RESPONSE);
+		}
+		ThreadBacktrace backtrace {words[i], context};
+		uint64_t record_count = words[i + 1];
+		i+= 2;
+		for(uint64_t j = 0; j < record_count; j++, i+= 3) {
+			backtrace.records.push_back({words[i], words[i + 1], words[i + 2]});
+		}
+		backtraces.push_back(std::move(backtrace));
+	}
+	
+	LogMessage(Debug, "  => %zu threads", backtraces.size());
+	
+	return backtraces;
+}
+
+std::vector<std::string> ITwibDebugger::GetThreadNames(std::vector<uint64_t> tls_addrs) {
+	size_t count = tls_addrs.size();
+	return DecodeThreadNames(GetThreadNamesAsync(std::move(tls_addrs)).get(), count);
+}
+
+std::future<std::vector<uint8_t>> ITwibDebugger::GetThreadNamesAsync(std::vector<uint64_t> tls_addrs) {
+	LogMessage(Debug, "ITwibDebugger::GetThreadNames(%zu threads)", tls_addrs.size());
+	
+	return obj->SendSmartAsyncRequest<std::vector<uint8_t>>(
+		CommandID::GET_THREAD_NAMES,
+		in<std::vector<uint64_t>>(tls_addrs));
+}
+
+std::vector<std::string> ITwibDebugger::DecodeThreadNames(const std::vector<uint8_t> &slots, size_t count) {
+	const size_t slot_size = protocol::ITwibDebugger::THREAD_NAME_SIZE;
+	if(slots.size() != count * slot_size) {
+		throw ResultError(TWILI_ERR_PROTOCOL_BAD_RESPONSE);
+	}
+
+	std::vector<std::string> names;
+	for(size_t i = 0; i < count; i++) {
+		const char *slot = (const char*) slots.data() + i * slot_size;
+		names.push_back(std::string(slot, strnlen(slot, slot_size)));
+	}
+	
+	return names;
+}
+
 } // namespace tool
 } // namespace twib
 } // namespace twili
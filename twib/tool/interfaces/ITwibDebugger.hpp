@@ -20,8 +20,10 @@
 
 #pragma once
 
+#include<future>
 #include<vector>
 #include<optional>
+#include<string>
 #include<tuple>
 
 #include "../RemoteObject.hpp"
@@ -42,6 +44,19 @@ struct ThreadContext {
 };
 static_assert(sizeof(ThreadContext) == 800, "sizeof(ThreadContext)");
 
+// An AArch64 frame record, and the address it was read from.
+struct FrameRecord {
+	uint64_t address;
+	uint64_t fp;
+	uint64_t lr;
+};
+
+struct ThreadBacktrace {
+	uint64_t thread_id;
+	ThreadContext context;
+	std::vector<FrameRecord> records; // innermost first
+};
+
 class ITwibDebugger {
  public:
 	ITwibDebugger(std::shared_ptr<RemoteObject> obj);
@@ -61,6 +76,44 @@ class ITwibDebugger {
 	void LaunchDebugProcess();
 	std::vector<nx::LoadedModuleInfo> GetNsoInfos();
 	std::vector<nx::LoadedModuleInfo> GetNroInfos();
+	std::future<std::vector<nx::LoadedModuleInfo>> GetNsoInfosAsync();
+	std::future<std::vector<nx::LoadedModuleInfo>> GetNroInfosAsync();
+	// Scans memory in [start, end) on the device for a masked byte pattern.
+	// type_mask selects memory types by bit (0 for any). The device stops
+	// early after max_matches matches or after scanning for a while, so this
+	// returns the address to continue from along with the matches.
+	std::tuple<uint64_t, std::vector<uint64_t>> ScanMemory(uint64_t start, uint64_t end, uint64_t type_mask, uint32_t alignment, uint32_t max_matches, std::vector<uint8_t> pattern, std::vector<uint8_t> mask);
+	// Records hashes of each page of writable memory in [start, end) on the
+	// device, replacing any earlier snapshot unless resume is set. The device
+	// stops after hashing for a while, so this returns the address to resume
+	// from (end, rounded up to a page, once it's done) along with how many
+	// bytes were hashed, which is what a full dump would have transferred.
+	std::tuple<uint64_t, uint64_t> SnapshotMemory(uint64_t start, uint64_t end, bool resume);
+	// Lists writable pages from start on that changed since SnapshotMemory
+	// finished, up to max_pages (at most 1024) of them, with their contents
+	// back to back if asked for. The device also stops early after hashing
+	// for a while, so this returns the address to continue from along with
+	// them.
+	std::tuple<uint64_t, std::vector<uint64_t>, std::vector<uint8_t>> DiffMemory(uint64_t start, uint32_t max_pages, bool include_contents);
+	// Every region of the address space, in order, in one round trip.
+	std::vector<nx::MemoryInfo> GetMemoryMap();
+	// Breaks the process count times, interval_us apart, to record each
+	// thread's pc, lr, and up to max_depth frames of stack. Resumes the
+	// process after each sample, even if it was stopped before. See
+	// protocol::ITwibDebugger::Command::SAMPLE for the record format.
+	std::vector<uint64_t> Sample(uint32_t count, uint32_t interval_us, uint32_t max_depth);
+	// Contexts and frame pointer chains of up to max_depth records for the
+	// given threads, or all of them if none are given, in one round trip.
+	// The process should be stopped. Threads whose context couldn't be read
+	// are left out.
+	std::vector<ThreadBacktrace> Backtrace(std::vector<uint64_t> thread_ids, uint32_t max_depth);
+	// Names of nn::os threads, given their TLS addresses. Names that couldn't
+	// be found come back empty.
+	std::vector<std::string> GetThreadNames(std::vector<uint64_t> tls_addrs);
+	// Same, but the future holds the raw name slots, to be passed to
+	// DecodeThreadNames along with how many addresses were asked about.
+	std::future<std::vector<uint8_t>> GetThreadNamesAsync(std::vector<uint64_t> tls_addrs);
+	static std::vector<std::string> DecodeThreadNames(const std::vector<uint8_t> &slots, size_t count);
  private:
 	std::shared_ptr<RemoteObject> obj;
 };
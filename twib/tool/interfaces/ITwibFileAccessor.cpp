@@ -42,6 +42,13 @@ std::vector<uint8_t> ITwibFileAccessor::Read(uint64_t offset, uint64_t size) {
 	return vec;
 }
 
+std::future<std::vector<uint8_t>> ITwibFileAccessor::ReadAsync(uint64_t offset, uint64_t size) {
+	return obj->SendSmartAsyncRequest<std::vector<uint8_t>>(
+		CommandID::READ,
+		in<uint64_t>(offset),
+		in<uint64_t>(size));
+}
+
 void ITwibFileAccessor::Write(uint64_t offset, std::vector<uint8_t> &vec) {
 	obj->SendSmartSyncRequest(
 		CommandID::WRITE,
@@ -64,6 +71,10 @@ size_t ITwibFileAccessor::GetSize() {
 }
 
 
+std::shared_ptr<RemoteObject> ITwibFileAccessor::GetObject() {
+	return obj;
+}
+
 } // namespace tool
 } // namespace twib
 } // namespace twili
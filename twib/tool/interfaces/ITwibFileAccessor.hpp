@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include<future>
 #include<vector>
 #include<optional>
 #include<tuple>
@@ -37,11 +38,14 @@ class ITwibFileAccessor {
 	using CommandID = protocol::ITwibFileAccessor::Command;
 
 	std::vector<uint8_t> Read(uint64_t offset, uint64_t size);
+	std::future<std::vector<uint8_t>> ReadAsync(uint64_t offset, uint64_t size);
 	void Write(uint64_t offset, std::vector<uint8_t> &vec);
 	void Flush();
 	void SetSize(size_t size);
 	size_t GetSize();
 
+	std::shared_ptr<RemoteObject> GetObject();
+
  private:
 	std::shared_ptr<RemoteObject> obj;
 };
@@ -21,6 +21,7 @@
 #include "ITwibFilesystemAccessor.hpp"
 
 #include "Protocol.hpp"
+#include "err.hpp"
 
 #include<cstring>
 
@@ -129,6 +130,55 @@ ITwibDirectoryAccessor ITwibFilesystemAccessor::OpenDirectory(std::string path)
 	return *ida;
 }
 
+uint32_t ITwibFilesystemAccessor::Copy(ITwibFilesystemAccessor &destination, std::string src, std::string dst, uint32_t flags, std::function<void(const CopyRecord &record, const std::string &path)> callback) {
+	std::optional<ITwibPipeReader> reader;
+	obj->SendSmartSyncRequest(
+		CommandID::COPY,
+		in_object<ITwibFilesystemAccessor>(destination),
+		in<std::string>(src),
+		in<std::string>(dst),
+		in<uint32_t>(flags),
+		out_object<ITwibPipeReader>(reader));
+
+	// records can be split across pipe reads
+	util::Buffer buffer;
+	while(true) {
+		std::vector<uint8_t> data;
+		try {
+			data = reader->ReadSync();
+		} catch(ResultError &e) {
+			if(e.code == TWILI_ERR_EOF) { // closed without a DONE record
+				throw ResultError(TWILI_ERR_PROTOCOL_BAD_RESPONSE);
+			}
+			throw;
+		}
+		buffer.Write(data);
+
+		CopyRecord record;
+		while(buffer.ReadAvailable() >= sizeof(record)) {
+			std::memcpy(&record, buffer.Read(), sizeof(record));
+			if(record.path_size > 0x300) {
+				throw ResultError(TWILI_ERR_PROTOCOL_BAD_RESPONSE);
+			}
+			if(buffer.ReadAvailable() < sizeof(record) + record.path_size) {
+				break;
+			}
+			buffer.MarkRead(sizeof(record));
+			
+			std::string path;
+			buffer.Read(path, record.path_size);
+			if(record.type == CopyRecord::Type::DONE) {
+				return record.result;
+			}
+			callback(record, path);
+		}
+	}
+}
+
+std::shared_ptr<RemoteObject> ITwibFilesystemAccessor::GetObject() {
+	return obj;
+}
+
 } // namespace tool
 } // namespace twib
 } // namespace twili
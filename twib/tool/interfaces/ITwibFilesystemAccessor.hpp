@@ -23,11 +23,13 @@
 #include<vector>
 #include<optional>
 #include<tuple>
+#include<functional>
 
 #include "../RemoteObject.hpp"
 
 #include "ITwibFileAccessor.hpp"
 #include "ITwibDirectoryAccessor.hpp"
+#include "ITwibPipeReader.hpp"
 
 namespace twili {
 namespace twib {
@@ -38,6 +40,7 @@ class ITwibFilesystemAccessor {
 	ITwibFilesystemAccessor(std::shared_ptr<RemoteObject> obj);
 
 	using CommandID = protocol::ITwibFilesystemAccessor::Command;
+	using CopyRecord = protocol::ITwibFilesystemAccessor::CopyRecord;
 
 	bool CreateFile(uint32_t mode, size_t size, std::string path); // returns false if the file already existed
 	void DeleteFile(std::string path);
@@ -49,6 +52,12 @@ class ITwibFilesystemAccessor {
 	std::optional<bool> IsFile(std::string path);
 	ITwibFileAccessor OpenFile(uint32_t mode, std::string path);
 	ITwibDirectoryAccessor OpenDirectory(std::string path);
+	// Copies src here to dst on the destination filesystem (which may be
+	// this one) without the data leaving the device. Calls back with every
+	// progress and entry record, and returns the first error the device hit.
+	uint32_t Copy(ITwibFilesystemAccessor &destination, std::string src, std::string dst, uint32_t flags, std::function<void(const CopyRecord &record, const std::string &path)> callback);
+
+	std::shared_ptr<RemoteObject> GetObject();
 	
  private:
 	std::shared_ptr<RemoteObject> obj;
@@ -47,6 +47,14 @@ std::string ITwibMetaInterface::ConnectTcp(std::string hostname, std::string por
 	return message;
 }
 
+std::string ITwibMetaInterface::DumpTrace() {
+	std::string trace;
+	obj.SendSmartSyncRequest(
+		CommandID::DUMP_TRACE,
+		out(trace));
+	return trace;
+}
+
 } // namespace tool
 } // namespace twib
 } // namespace twili
@@ -38,6 +38,7 @@ class ITwibMetaInterface {
 	
 	std::vector<msgpack11::MsgPack> ListDevices();
 	std::string ConnectTcp(std::string hostname, std::string port);
+	std::string DumpTrace();
  private:
 	RemoteObject obj;
 };
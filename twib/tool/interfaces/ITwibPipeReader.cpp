@@ -38,6 +38,16 @@ std::vector<uint8_t> ITwibPipeReader::ReadSync() {
 	return data;
 }
 
+uint64_t ITwibPipeReader::Splice(ITwibFileAccessor &file, uint64_t offset) {
+	uint64_t size;
+	obj->SendSmartSyncRequest(
+		CommandID::SPLICE,
+		in_object<ITwibFileAccessor>(file),
+		in<uint64_t>(offset),
+		out<uint64_t>(size));
+	return size;
+}
+
 } // namespace tool
 } // namespace twib
 } // namespace twili
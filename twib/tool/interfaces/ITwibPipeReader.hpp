@@ -23,6 +23,7 @@
 #include<vector>
 
 #include "../RemoteObject.hpp"
+#include "ITwibFileAccessor.hpp"
 
 namespace twili {
 namespace twib {
@@ -35,6 +36,10 @@ class ITwibPipeReader {
 	using CommandID = protocol::ITwibPipeReader::Command;
 	
 	std::vector<uint8_t> ReadSync();
+	// Copies everything written to the pipe into the file, starting at the
+	// given offset, entirely on the device. Returns once the pipe's writer
+	// closes, with the number of bytes copied.
+	uint64_t Splice(ITwibFileAccessor &file, uint64_t offset);
  private:
 	std::shared_ptr<RemoteObject> obj;
 };
@@ -26,6 +26,19 @@ namespace bridge {
 RequestHandler::~RequestHandler() {
 }
 
+void RequestHandler::ReceiveObjects(std::vector<std::shared_ptr<Object>> &&objects) {
+}
+
+std::vector<std::shared_ptr<Object>> ResolveObjects(std::map<uint32_t, std::shared_ptr<Object>> &objects, const std::vector<uint32_t> &object_ids) {
+	std::vector<std::shared_ptr<Object>> resolved;
+	resolved.reserve(object_ids.size());
+	for(uint32_t id : object_ids) {
+		auto i = objects.find(id);
+		resolved.push_back(i == objects.end() ? nullptr : i->second);
+	}
+	return resolved;
+}
+
 DiscardingRequestHandler::DiscardingRequestHandler() {
 }
 
@@ -42,5 +55,33 @@ DiscardingRequestHandler *DiscardingRequestHandler::GetInstance() {
 	return &instance;
 }
 
+CloseObjectsHandler::CloseObjectsHandler(std::map<uint32_t, std::shared_ptr<Object>> &objects) :
+	objects(objects) {
+}
+
+RequestHandler *CloseObjectsHandler::Open(size_t payload_size, ResponseOpener opener) {
+	if(payload_size % sizeof(uint32_t) != 0) {
+		opener.RespondError(TWILI_ERR_PROTOCOL_BAD_REQUEST);
+		return DiscardingRequestHandler::GetInstance();
+	}
+	this->opener.emplace(opener);
+	return this;
+}
+
+void CloseObjectsHandler::FlushReceiveBuffer(util::Buffer &input_buffer) {
+	uint32_t object_id;
+	while(input_buffer.Read(object_id)) {
+		if(object_id != 0) { // object 0 stays open
+			objects.erase(object_id);
+		}
+	}
+}
+
+void CloseObjectsHandler::Finalize(util::Buffer &input_buffer) {
+	FlushReceiveBuffer(input_buffer);
+	opener->RespondOk();
+	opener.reset();
+}
+
 } // namespace bridge
 } // namespace twili
@@ -22,6 +22,11 @@
 
 #include<libtransistor/cpp/nx.hpp>
 
+#include<map>
+#include<memory>
+#include<optional>
+#include<vector>
+
 #include "../twili.hpp"
 
 #include "err.hpp"
@@ -45,10 +50,17 @@ class RequestHandler {
 	// as it wants, as long as it doesn't Read() out-of-bounds.
 	virtual void FlushReceiveBuffer(util::Buffer &input_buffer) = 0;
 
+	// Called with the objects that were sent along with the request, once
+	// they are known, right before Finalize. IDs that didn't refer to any
+	// object come through as null.
+	virtual void ReceiveObjects(std::vector<std::shared_ptr<Object>> &&objects);
+
 	// Called when entire payload has been read.
 	virtual void Finalize(util::Buffer &input_buffer) = 0;
 };
 
+std::vector<std::shared_ptr<Object>> ResolveObjects(std::map<uint32_t, std::shared_ptr<Object>> &objects, const std::vector<uint32_t> &object_ids);
+
 class DiscardingRequestHandler : public RequestHandler {
  public:
 	DiscardingRequestHandler();
@@ -59,6 +71,21 @@ class DiscardingRequestHandler : public RequestHandler {
 	virtual void Finalize(util::Buffer &input_buffer) override;
 };
 
+// Handles protocol::CLOSE_OBJECTS, which is addressed to object 0 but is
+// processed by the bridge itself. The payload is a plain array of object IDs.
+class CloseObjectsHandler : public RequestHandler {
+ public:
+	CloseObjectsHandler(std::map<uint32_t, std::shared_ptr<Object>> &objects);
+
+	RequestHandler *Open(size_t payload_size, ResponseOpener opener);
+	
+	virtual void FlushReceiveBuffer(util::Buffer &input_buffer) override;
+	virtual void Finalize(util::Buffer &input_buffer) override;
+ private:
+	std::map<uint32_t, std::shared_ptr<Object>> &objects;
+	std::optional<ResponseOpener> opener;
+};
+
 template<auto>
 class SmartRequestHandler;
 
@@ -100,9 +127,11 @@ class SmartRequestHandler<Func> : public RequestHandler {
 					}
 				}
 				streaming = true; // sink any further data into stream if we get any
-				
-				// TODO: consider shuffling this into Finalize or streaming start
-				InvocationHelper(object, parameter_holder.GetValues(), std::index_sequence_for<Args...>());
+
+				if constexpr(!has_objects) {
+					// TODO: consider shuffling this into Finalize or streaming start
+					InvocationHelper(object, parameter_holder.GetValues(), std::index_sequence_for<Args...>());
+				}
 			}
 		} else {
 			if(parameter_holder.GetStream()) {
@@ -115,14 +144,38 @@ class SmartRequestHandler<Func> : public RequestHandler {
 		}
 	}
 
+	virtual void ReceiveObjects(std::vector<std::shared_ptr<Object>> &&objects) {
+		this->objects = std::move(objects);
+	}
+
 	virtual void Finalize(util::Buffer &input_buffer) {
 		FlushReceiveBuffer(input_buffer);
-		if(streaming && parameter_holder.GetStream()) {
+		if constexpr(has_objects) {
+			if(has_signaled_bad_request) {
+				return;
+			}
+			if(!streaming) {
+				// host sent too little data
+				SignalBadRequest();
+				return;
+			}
+			// objects only arrive after the payload, so we can't invoke until now
+			trn::ResultCode r = parameter_holder.ResolveObjects(objects);
+			if(r != RESULT_OK) {
+				response_opener.RespondError(r);
+				has_signaled_bad_request = true;
+				return;
+			}
+			InvocationHelper(object, parameter_holder.GetValues(), std::index_sequence_for<Args...>());
+		} else if(streaming && parameter_holder.GetStream()) {
 			parameter_holder.GetStream()->finish(input_buffer);
 		}
 	}
 
  private:
+	static constexpr bool has_objects = detail::UnpackingHolder<detail::ArgPack<Args...>>::HasObjects;
+	static_assert(!has_objects || (!std::is_same<Args, InputStream&>::value && ...), "object arguments can't be combined with streams");
+	
 	T &object;
 	bool has_signaled_bad_request = false;
 
@@ -136,6 +189,7 @@ class SmartRequestHandler<Func> : public RequestHandler {
 	size_t payload_size = 0;
 	bool streaming = false;
 	ResponseOpener response_opener;
+	std::vector<std::shared_ptr<Object>> objects;
 
 	void SignalBadRequest() {
 		twili::Assert<TWILI_ERR_FATAL_BRIDGE_STATE>(!has_signaled_bad_request);
@@ -23,6 +23,7 @@
 #include<type_traits>
 #include<vector>
 #include<tuple>
+#include<memory>
 
 #include "Buffer.hpp"
 #include "err.hpp"
@@ -30,6 +31,7 @@
 #include "Streaming.hpp"
 
 #include "ResponseOpener.hpp"
+#include "Object.hpp"
 
 namespace twili {
 namespace bridge {
@@ -145,6 +147,42 @@ struct UnpackingHelper<T, typename std::enable_if<std::is_pod<T>::value && !std:
 	}
 };
 
+// Object arguments are passed in the payload as an index into the request's
+// object list. That list follows the payload on the wire, so the objects
+// themselves can't be looked up until the request has been fully received.
+template<typename T>
+struct IsObjectArgument : std::false_type {
+};
+
+template<typename T>
+struct IsObjectArgument<std::shared_ptr<T>> : std::is_base_of<Object, T> {
+};
+
+// specialization for objects
+template<typename T>
+struct UnpackingHelper<std::shared_ptr<T>, typename std::enable_if<std::is_base_of<Object, T>::value>::type> {
+	bool Unpack(util::Buffer &buffer, std::shared_ptr<T> &out) {
+		return buffer.Read(index);
+	}
+
+	trn::ResultCode Resolve(std::vector<std::shared_ptr<Object>> &objects, std::shared_ptr<T> &out) {
+		if(index >= objects.size() || !objects[index]) {
+			return TWILI_ERR_PROTOCOL_UNRECOGNIZED_OBJECT;
+		}
+		out = std::dynamic_pointer_cast<T>(objects[index]);
+		if(!out) {
+			return TWILI_ERR_PROTOCOL_BAD_REQUEST;
+		}
+		return RESULT_OK;
+	}
+	
+	static bool IsStream() {
+		return false;
+	}
+ private:
+	uint32_t index = 0;
+};
+
 template<typename... T>
 struct ArgPack;
 
@@ -171,6 +209,10 @@ struct UnpackingHolder<ArgPack<InputStream&, Args...>> {
 	InputStream *GetStream() {
 		return &stream;
 	}
+	trn::ResultCode ResolveObjects(std::vector<std::shared_ptr<Object>> &objects) {
+		return RESULT_OK;
+	}
+	static constexpr bool HasObjects = false;
  private:
 	bool has_value = false;
 	InputStream stream;
@@ -199,6 +241,16 @@ struct UnpackingHolder<ArgPack<T, Args...>> {
 		}
 		return next.GetStream();
 	}
+	trn::ResultCode ResolveObjects(std::vector<std::shared_ptr<Object>> &objects) {
+		if constexpr(IsObjectArgument<T>::value) {
+			trn::ResultCode r = helper.Resolve(objects, value);
+			if(r != RESULT_OK) {
+				return r;
+			}
+		}
+		return next.ResolveObjects(objects);
+	}
+	static constexpr bool HasObjects = IsObjectArgument<T>::value || UnpackingHolder<ArgPack<Args...>>::HasObjects;
  private:
 	bool has_value = false;
 	T value;
@@ -217,6 +269,10 @@ struct UnpackingHolder<ArgPack<>> {
 	InputStream *GetStream() {
 		return nullptr;
 	}
+	trn::ResultCode ResolveObjects(std::vector<std::shared_ptr<Object>> &objects) {
+		return RESULT_OK;
+	}
+	static constexpr bool HasObjects = false;
 };
 
 } // namespace detail
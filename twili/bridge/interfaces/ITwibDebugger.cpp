@@ -22,7 +22,11 @@
 
 #include<libtransistor/cpp/svc.hpp>
 
+#include<algorithm>
+
 #include "err.hpp"
+#include "PatternScan.hpp"
+#include "MemorySnapshot.hpp"
 #include "title_id.hpp"
 #include "../../twili.hpp"
 #include "../../Services.hpp"
@@ -33,6 +37,21 @@ using namespace trn;
 namespace twili {
 namespace bridge {
 
+// ScanMemory, SnapshotMemory, and DiffMemory read debuggee memory this much
+// at a time,
+static const size_t MEMORY_CHUNK_SIZE = 0x40000;
+// and each of them stops to let other requests through after going through
+// this much. The client picks up where it left off with another request.
+static const size_t SCAN_BUDGET = 0x2000000;
+// Limit on DiffMemory, to keep responses bounded.
+static const uint32_t MAX_DIFF_PAGES_PER_REQUEST = 1024;
+
+// Limits on Sample and Backtrace, to keep responses bounded.
+static const uint32_t MAX_SAMPLES_PER_REQUEST = 1000;
+static const uint32_t MAX_UNWIND_DEPTH = 64;
+static const uint32_t MAX_UNWIND_THREADS = 128;
+static const uint64_t TICKS_PER_SECOND = 19200000;
+
 ITwibDebugger::ITwibDebugger(uint32_t object_id, Twili &twili, trn::KDebug &&debug, std::shared_ptr<process::MonitoredProcess> proc) : ObjectDispatcherProxy(*this, object_id), twili(twili), debug(std::move(debug)), proc(proc), dispatcher(*this) {
 	if(proc) {
 		proc->Continue();
@@ -54,6 +73,9 @@ ITwibDebugger::~ITwibDebugger() {
 	if(wait_handle) {
 		wait_handle.reset();
 	}
+	if(sample_deadline) {
+		sample_deadline.reset();
+	}
 	if(title_id != 0) {
 		twili.debugging_titles.erase(title_id);
 	}
@@ -63,6 +85,12 @@ void ITwibDebugger::PumpEvents() {
 	auto r = trn::svc::GetDebugEvent(debug);
 	while(r) {
 		debug_event_info_t e = *r;
+		if(sample_breaks > 0 && e.event_type == DEBUG_EVENT_EXCEPTION && e.exception.exception_type == DEBUG_EXCEPTION_DEBUGGER_BREAK) {
+			// TakeSample's break, not a real stop
+			sample_breaks--;
+			r = trn::svc::GetDebugEvent(debug);
+			continue;
+		}
 		event_queue.push_back(e);
 
 		if(e.event_type == DEBUG_EVENT_ATTACH_PROCESS) {
@@ -263,5 +291,397 @@ void ITwibDebugger::GetNroInfos(bridge::ResponseOpener opener) {
 	opener.RespondOk(std::move(nro_info));
 }
 
+void ITwibDebugger::ScanMemory(bridge::ResponseOpener opener, uint64_t start, uint64_t end, uint64_t type_mask, uint32_t alignment, uint32_t max_matches, std::vector<uint8_t> pattern, std::vector<uint8_t> mask) {
+	TWILI_BRIDGE_CHECK(
+		util::PatternScanner::IsValid(pattern, mask, alignment) && pattern.size() <= MEMORY_CHUNK_SIZE && max_matches > 0 ?
+		RESULT_OK :
+		TWILI_ERR_PROTOCOL_BAD_REQUEST);
+
+	util::PatternScanner scanner(pattern, mask, alignment);
+	// chunks overlap by one byte less than the pattern so that matches
+	// straddling a chunk boundary are still seen whole, and may be preceded
+	// by the tail of the previous region
+	std::vector<uint8_t> buffer(MEMORY_CHUNK_SIZE + (scanner.GetSize() - 1) * 2);
+	std::vector<uint64_t> matches;
+	// last bytes of the region scanned before this one, so that matches
+	// straddling two adjacent regions are seen too
+	std::vector<uint8_t> carry;
+	uint64_t carry_end = 0;
+	
+	uint64_t addr = start;
+	size_t budget = SCAN_BUDGET;
+	// keep going past `end` while carried bytes hold positions before it
+	while((addr < end || (!carry.empty() && carry_end - carry.size() < end)) && budget > 0 && matches.size() < max_matches) {
+		auto r = trn::svc::QueryDebugProcessMemory(debug, addr);
+		if(!r) {
+			TWILI_BRIDGE_CHECK(r.error());
+		}
+		memory_info_t mi = std::get<0>(*r);
+		uint64_t region_end = (uint64_t) mi.base_addr + mi.size;
+		if(region_end <= addr) { // last region wraps around
+			addr = end;
+			carry.clear();
+			break;
+		}
+		
+		uint32_t type = mi.memory_type & 0xff;
+		if(!(mi.permission & 1) || type == 0 || type == 1 || // unreadable, unmapped, io
+			 (type_mask != 0 && (type >= 64 || !(type_mask & (1ull << type))))) {
+			addr = region_end;
+			carry.clear();
+			continue;
+		}
+		if(addr != carry_end) {
+			carry.clear();
+		}
+
+		// matches have to start before `end`, but may extend past it
+		uint64_t scan_end = std::max(std::min(region_end, end), addr);
+		do {
+			size_t limit = std::min<uint64_t>(scan_end - addr, MEMORY_CHUNK_SIZE);
+			size_t read_size = std::min<uint64_t>(region_end - addr, limit + scanner.GetSize() - 1);
+			uint64_t read_end = addr + read_size;
+			if(read_end == region_end) {
+				// take the rest in one go instead of leaving a sliver of the
+				// region for another read; whatever can't be checked yet is
+				// carried into the next region
+				limit = scan_end - addr;
+			}
+			size_t prefix = carry.size();
+			std::copy(carry.begin(), carry.end(), buffer.begin());
+			auto rr = trn::svc::ReadDebugProcessMemory(buffer.data() + prefix, debug, addr, read_size);
+			if(!rr) {
+				printf("ScanMemory: failed to read 0x%lx bytes at 0x%lx (0x%x), skipping region\n", read_size, addr, rr.error().code);
+				addr = region_end;
+				carry.clear();
+				break;
+			}
+
+			// positions in the carried bytes couldn't be checked until now,
+			// but the ones at or past `end` still don't count
+			uint64_t base = addr - prefix;
+			size_t scan_limit = std::min<uint64_t>(prefix + limit, end - base);
+			size_t scanned = scanner.Scan(buffer.data(), prefix + read_size, scan_limit, base, matches, max_matches);
+			carry.clear();
+			if(scanned < scan_limit) { // stopped early at max_matches
+				addr = base + scanned;
+				break;
+			}
+			uint64_t chunk_start = addr;
+			addr+= limit;
+			if(read_end == region_end) {
+				size_t tail = std::min(prefix + read_size, scanner.GetSize() - 1);
+				carry.assign(buffer.begin() + prefix + read_size - tail, buffer.begin() + prefix + read_size);
+				carry_end = region_end;
+				addr = region_end;
+			}
+			// carried bytes were paid for by the region they came from
+			budget-= std::min<uint64_t>(budget, addr - chunk_start);
+			if(matches.size() >= max_matches) {
+				break;
+			}
+		} while(addr < scan_end && budget > 0);
+	}
+
+	uint64_t next = std::min(addr, end);
+	if(!carry.empty() && addr == carry_end) {
+		// carried positions haven't been checked yet; resume from them
+		next = std::min(next, carry_end - carry.size());
+	}
+	opener.RespondOk(std::move(next), std::move(matches));
+}
+
+trn::ResultCode ITwibDebugger::WalkWritableMemory(uint64_t &addr, uint64_t end, std::vector<uint8_t> &buffer, std::function<size_t(uint64_t, uint8_t*, size_t)> visit) {
+	while(addr < end) {
+		auto r = trn::svc::QueryDebugProcessMemory(debug, addr);
+		if(!r) {
+			return r.error();
+		}
+		memory_info_t mi = std::get<0>(*r);
+		uint64_t region_end = (uint64_t) mi.base_addr + mi.size;
+		if(region_end <= addr) { // last region wraps around
+			addr = end;
+			break;
+		}
+		if(!(mi.permission & 2) || (mi.memory_type & 0xff) == 1) { // unwritable, io
+			addr = region_end;
+			continue;
+		}
+
+		uint64_t walk_end = std::min(region_end, end);
+		while(addr < walk_end) {
+			size_t size = std::min<uint64_t>(walk_end - addr, buffer.size());
+			auto rr = trn::svc::ReadDebugProcessMemory(buffer.data(), debug, addr, size);
+			if(!rr) {
+				printf("failed to read 0x%lx bytes at 0x%lx (0x%x), skipping region\n", size, addr, rr.error().code);
+				addr = walk_end;
+				break;
+			}
+			size_t consumed = visit(addr, buffer.data(), size);
+			addr+= consumed;
+			if(consumed < size) {
+				return RESULT_OK;
+			}
+		}
+	}
+	return RESULT_OK;
+}
+
+void ITwibDebugger::SnapshotMemory(bridge::ResponseOpener opener, uint64_t start, uint64_t end, uint32_t resume) {
+	const uint64_t page_mask = util::MemorySnapshot::PAGE_SIZE - 1;
+	start&= ~page_mask;
+	end = end > ~page_mask ? ~page_mask : (end + page_mask) & ~page_mask;
+
+	if(resume) {
+		TWILI_BRIDGE_CHECK(
+			snapshot_next < snapshot_end && start == snapshot_next && end == snapshot_end ?
+			RESULT_OK :
+			TWILI_ERR_INVALID_DEBUGGER_STATE);
+	} else {
+		snapshot.Clear();
+		snapshot_start = start;
+		snapshot_end = end;
+		snapshot_next = start;
+	}
+	
+	std::vector<uint8_t> buffer(MEMORY_CHUNK_SIZE);
+	uint64_t addr = start;
+	size_t budget = SCAN_BUDGET;
+	uint64_t total_size = 0; // what a full dump would have cost
+	trn::ResultCode r = WalkWritableMemory(
+		addr, end, buffer,
+		[this, &total_size, &budget](uint64_t addr, uint8_t *data, size_t size) -> size_t {
+			if(budget == 0) {
+				return 0;
+			}
+			size = std::min(size, budget); // both are page-aligned
+			snapshot.Record(addr, data, size);
+			total_size+= size;
+			budget-= size;
+			return size;
+		});
+	if(r != RESULT_OK) {
+		snapshot.Clear();
+		snapshot_start = 0;
+		snapshot_end = 0;
+		snapshot_next = 0;
+		opener.RespondError(r);
+		return;
+	}
+
+	snapshot_next = std::min(addr, end);
+	if(snapshot_next == snapshot_end) {
+		printf("snapshotted 0x%lx pages\n", snapshot.GetPageCount());
+	}
+	opener.RespondOk(std::move(snapshot_next), std::move(total_size));
+}
+
+void ITwibDebugger::DiffMemory(bridge::ResponseOpener opener, uint64_t start, uint32_t max_pages, uint32_t include_contents) {
+	TWILI_BRIDGE_CHECK(
+		snapshot_end > snapshot_start && snapshot_next == snapshot_end ?
+		RESULT_OK :
+		TWILI_ERR_INVALID_DEBUGGER_STATE);
+	TWILI_BRIDGE_CHECK(
+		max_pages > 0 && max_pages <= MAX_DIFF_PAGES_PER_REQUEST ?
+		RESULT_OK :
+		TWILI_ERR_PROTOCOL_BAD_REQUEST);
+
+	const uint64_t page_mask = util::MemorySnapshot::PAGE_SIZE - 1;
+	std::vector<uint8_t> buffer(MEMORY_CHUNK_SIZE);
+	std::vector<uint64_t> changed;
+	std::vector<uint8_t> contents;
+	size_t budget = SCAN_BUDGET;
+	uint64_t addr = std::max(start & ~page_mask, snapshot_start);
+	TWILI_BRIDGE_CHECK(WalkWritableMemory(
+		addr, snapshot_end, buffer,
+		[&](uint64_t addr, uint8_t *data, size_t size) -> size_t {
+			size_t first = changed.size();
+			size_t consumed = snapshot.Diff(addr, data, std::min(size, budget), changed, max_pages);
+			budget-= consumed;
+			if(include_contents) {
+				for(size_t i = first; i < changed.size(); i++) {
+					uint8_t *page = data + (changed[i] - addr);
+					contents.insert(contents.end(), page, page + util::MemorySnapshot::PAGE_SIZE);
+				}
+			}
+			return consumed;
+		}));
+
+	uint64_t next = std::min(addr, snapshot_end);
+	opener.RespondOk(std::move(next), std::move(changed), std::move(contents));
+}
+
+void ITwibDebugger::GetMemoryMap(bridge::ResponseOpener opener) {
+	std::vector<memory_info_t> regions;
+	uint64_t addr = 0;
+	memory_info_t mi;
+	do {
+		auto r = trn::svc::QueryDebugProcessMemory(debug, addr);
+		if(!r) {
+			TWILI_BRIDGE_CHECK(r.error());
+		}
+		mi = std::get<0>(*r);
+		regions.push_back(mi);
+		addr = (uint64_t) mi.base_addr + mi.size;
+	} while(addr > (uint64_t) mi.base_addr);
+
+	opener.RespondOk(std::move(regions));
+}
+
+void ITwibDebugger::ReadFrameRecords(uint64_t fp, uint32_t max_records, std::vector<uint64_t> &records) {
+	// frame records are {fp, lr} pairs, with callers at higher addresses
+	for(uint32_t i = 0; i < max_records && fp != 0 && (fp & 7) == 0; i++) {
+		uint64_t record[2];
+		if(!trn::svc::ReadDebugProcessMemory(record, debug, fp, sizeof(record))) {
+			break;
+		}
+		records.push_back(fp);
+		records.push_back(record[0]);
+		records.push_back(record[1]);
+		if(record[1] == 0 || record[0] <= fp) {
+			break;
+		}
+		fp = record[0];
+	}
+}
+
+trn::ResultCode ITwibDebugger::TakeSample(std::vector<uint64_t> &words, uint32_t max_depth) {
+	// anything already pending predates our break, so it has to be queued
+	// before we start skipping a break event
+	PumpEvents();
+	
+	uint64_t start = svcGetSystemTick();
+	trn::ResultCode r = twili::Unwrap(trn::svc::BreakDebugProcess(debug));
+	if(r != RESULT_OK) {
+		return r;
+	}
+	sample_breaks++;
+
+	uint64_t thread_ids[MAX_UNWIND_THREADS];
+	uint32_t thread_count = 0;
+	r = svcGetThreadList(&thread_count, thread_ids, MAX_UNWIND_THREADS, debug.handle);
+
+	std::vector<uint64_t> records;
+	size_t sample = words.size();
+	words.push_back(start);
+	words.push_back(0); // pause ticks
+	words.push_back(0); // thread count
+	for(uint32_t i = 0; r == RESULT_OK && i < thread_count; i++) {
+		auto context = trn::svc::GetDebugThreadContext(debug, thread_ids[i], 3); // general, control
+		if(!context) {
+			continue; // thread may be on its way out
+		}
+		
+		size_t thread = words.size();
+		words.push_back(thread_ids[i]);
+		words.push_back(context->regs[30]); // lr
+		words.push_back(1);
+		words.push_back(context->regs[32]); // pc
+
+		records.clear();
+		ReadFrameRecords(context->regs[29], max_depth - 1, records);
+		for(size_t j = 0; j < records.size() && records[j + 2] != 0; j+= 3) {
+			words.push_back(records[j + 2]);
+			words[thread + 2]++;
+		}
+		words[sample + 2]++;
+	}
+
+	// our break shows up as an event, which PumpEvents skips so that it
+	// isn't mistaken for a real stop later
+	PumpEvents();
+	
+	trn::ResultCode cr = twili::Unwrap(trn::svc::ContinueDebugEvent(debug, 7, thread_ids, thread_count));
+	words[sample + 1] = svcGetSystemTick() - start;
+	
+	return r != RESULT_OK ? r : cr;
+}
+
+void ITwibDebugger::Sample(bridge::ResponseOpener opener, uint32_t count, uint32_t interval_us, uint32_t max_depth) {
+	TWILI_BRIDGE_CHECK(sample_deadline ? TWILI_ERR_ALREADY_WAITING : RESULT_OK);
+	TWILI_BRIDGE_CHECK(
+		count > 0 && count <= MAX_SAMPLES_PER_REQUEST && max_depth > 0 && max_depth <= MAX_UNWIND_DEPTH ?
+		RESULT_OK :
+		TWILI_ERR_PROTOCOL_BAD_REQUEST);
+
+	std::shared_ptr<std::vector<uint64_t>> words = std::make_shared<std::vector<uint64_t>>();
+	std::shared_ptr<uint32_t> remaining = std::make_shared<uint32_t>(count);
+	uint64_t interval = (uint64_t) interval_us * TICKS_PER_SECOND / 1000000;
+	
+	sample_deadline = twili.event_waiter.AddDeadline(
+		svcGetSystemTick(),
+		[this, opener, words, remaining, interval, max_depth]() -> uint64_t {
+			trn::ResultCode r = TakeSample(*words, max_depth);
+			if(r != RESULT_OK) {
+				opener.RespondError(r);
+				sample_deadline.reset(); // destroys this lambda
+				return 0;
+			}
+			if(--*remaining == 0) {
+				opener.RespondOk(std::move(*words));
+				sample_deadline.reset(); // destroys this lambda
+				return 0;
+			}
+			return svcGetSystemTick() + interval;
+		});
+}
+
+void ITwibDebugger::Backtrace(bridge::ResponseOpener opener, std::vector<uint64_t> thread_ids, uint32_t max_depth) {
+	TWILI_BRIDGE_CHECK(
+		max_depth <= MAX_UNWIND_DEPTH && thread_ids.size() <= MAX_UNWIND_THREADS ?
+		RESULT_OK :
+		TWILI_ERR_PROTOCOL_BAD_REQUEST);
+
+	if(thread_ids.empty()) {
+		uint32_t thread_count = 0;
+		thread_ids.resize(MAX_UNWIND_THREADS);
+		TWILI_BRIDGE_CHECK(svcGetThreadList(&thread_count, thread_ids.data(), thread_ids.size(), debug.handle));
+		thread_ids.resize(thread_count);
+	}
+
+	std::vector<thread_context_t> contexts;
+	std::vector<uint64_t> words;
+	std::vector<uint64_t> records;
+	for(uint64_t thread_id : thread_ids) {
+		auto context = trn::svc::GetDebugThreadContext(debug, thread_id, 15);
+		if(!context) {
+			continue; // thread may be on its way out
+		}
+		contexts.push_back(*context);
+		
+		records.clear();
+		ReadFrameRecords(context->regs[29], max_depth, records);
+		words.push_back(thread_id);
+		words.push_back(records.size() / 3);
+		words.insert(words.end(), records.begin(), records.end());
+	}
+
+	opener.RespondOk(std::move(contexts), std::move(words));
+}
+
+void ITwibDebugger::GetThreadNames(bridge::ResponseOpener opener, std::vector<uint64_t> tls_addrs) {
+	const size_t slot_size = protocol::ITwibDebugger::THREAD_NAME_SIZE;
+	TWILI_BRIDGE_CHECK(tls_addrs.size() <= MAX_UNWIND_THREADS ? RESULT_OK : TWILI_ERR_PROTOCOL_BAD_REQUEST);
+
+	// nn::os keeps a pointer to the ThreadType in TLS, and the ThreadType
+	// points to the name
+	std::vector<uint8_t> names(tls_addrs.size() * slot_size, 0);
+	for(size_t i = 0; i < tls_addrs.size(); i++) {
+		uint64_t thread_type = 0, name_addr = 0;
+		uint8_t *slot = names.data() + i * slot_size;
+		if(!trn::svc::ReadDebugProcessMemory(&thread_type, debug, tls_addrs[i] + 0x1f8, sizeof(thread_type)) || thread_type == 0) {
+			continue;
+		}
+		if(!trn::svc::ReadDebugProcessMemory(&name_addr, debug, thread_type + 0x1a8, sizeof(name_addr)) || name_addr == 0) {
+			continue;
+		}
+		if(!trn::svc::ReadDebugProcessMemory(slot, debug, name_addr, slot_size - 1)) {
+			std::fill(slot, slot + slot_size, 0);
+		}
+	}
+
+	opener.RespondOk(std::move(names));
+}
+
 } // namespace bridge
 } // namespace twili
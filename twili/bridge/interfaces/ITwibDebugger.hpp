@@ -28,6 +28,9 @@
 #include "../RequestHandler.hpp"
 
 #include<deque>
+#include<functional>
+
+#include "MemorySnapshot.hpp"
 
 namespace twili {
 
@@ -54,9 +57,27 @@ class ITwibDebugger : public ObjectDispatcherProxy<ITwibDebugger> {
 	trn::KDebug debug;
 	std::shared_ptr<process::MonitoredProcess> proc;
 	std::shared_ptr<trn::WaitHandle> wait_handle;
+	std::shared_ptr<trn::WaitHandle> sample_deadline;
 	std::deque<debug_event_info_t> event_queue;
+	// breaks made by TakeSample whose events haven't been skipped yet
+	uint32_t sample_breaks = 0;
+	util::MemorySnapshot snapshot;
+	uint64_t snapshot_start = 0;
+	uint64_t snapshot_end = 0;
+	uint64_t snapshot_next = 0; // where a resumed SnapshotMemory picks up
 
 	void PumpEvents();
+	// Reads writable memory from addr up to end a chunk at a time, skipping
+	// anything else. visit returns how much of the chunk it consumed, and
+	// walking stops if that isn't all of it. Leaves addr where it stopped.
+	trn::ResultCode WalkWritableMemory(uint64_t &addr, uint64_t end, std::vector<uint8_t> &buffer, std::function<size_t(uint64_t, uint8_t*, size_t)> visit);
+	// Follows the frame pointer chain from fp, appending address, fp, and lr
+	// for each frame record read, until a null lr or a chain that doesn't
+	// move up the stack.
+	void ReadFrameRecords(uint64_t fp, uint32_t max_records, std::vector<uint64_t> &records);
+	// Breaks the process, appends a sample record for each of its threads,
+	// and lets it go again.
+	trn::ResultCode TakeSample(std::vector<uint64_t> &words, uint32_t max_depth);
 	
 	void QueryMemory(bridge::ResponseOpener opener, uint64_t address);
 	void ReadMemory(bridge::ResponseOpener opener, uint64_t address, uint64_t size);
@@ -72,6 +93,13 @@ class ITwibDebugger : public ObjectDispatcherProxy<ITwibDebugger> {
 	void GetTargetEntry(bridge::ResponseOpener opener);
 	void LaunchDebugProcess(bridge::ResponseOpener opener);
 	void GetNroInfos(bridge::ResponseOpener opener);
+	void ScanMemory(bridge::ResponseOpener opener, uint64_t start, uint64_t end, uint64_t type_mask, uint32_t alignment, uint32_t max_matches, std::vector<uint8_t> pattern, std::vector<uint8_t> mask);
+	void SnapshotMemory(bridge::ResponseOpener opener, uint64_t start, uint64_t end, uint32_t resume);
+	void DiffMemory(bridge::ResponseOpener opener, uint64_t start, uint32_t max_pages, uint32_t include_contents);
+	void GetMemoryMap(bridge::ResponseOpener opener);
+	void Sample(bridge::ResponseOpener opener, uint32_t count, uint32_t interval_us, uint32_t max_depth);
+	void Backtrace(bridge::ResponseOpener opener, std::vector<uint64_t> thread_ids, uint32_t max_depth);
+	void GetThreadNames(bridge::ResponseOpener opener, std::vector<uint64_t> tls_addrs);
 
  public:
 	SmartRequestDispatcher<
@@ -89,7 +117,14 @@ class ITwibDebugger : public ObjectDispatcherProxy<ITwibDebugger> {
 		SmartCommand<CommandID::WAIT_EVENT, &ITwibDebugger::WaitEvent>,
 		SmartCommand<CommandID::GET_TARGET_ENTRY, &ITwibDebugger::GetTargetEntry>,
 		SmartCommand<CommandID::LAUNCH_DEBUG_PROCESS, &ITwibDebugger::LaunchDebugProcess>,
-		SmartCommand<CommandID::GET_NRO_INFOS, &ITwibDebugger::GetNroInfos>
+		SmartCommand<CommandID::GET_NRO_INFOS, &ITwibDebugger::GetNroInfos>,
+		SmartCommand<CommandID::SCAN_MEMORY, &ITwibDebugger::ScanMemory>,
+		SmartCommand<CommandID::SNAPSHOT_MEMORY, &ITwibDebugger::SnapshotMemory>,
+		SmartCommand<CommandID::DIFF_MEMORY, &ITwibDebugger::DiffMemory>,
+		SmartCommand<CommandID::GET_MEMORY_MAP, &ITwibDebugger::GetMemoryMap>,
+		SmartCommand<CommandID::SAMPLE, &ITwibDebugger::Sample>,
+		SmartCommand<CommandID::BACKTRACE, &ITwibDebugger::Backtrace>,
+		SmartCommand<CommandID::GET_THREAD_NAMES, &ITwibDebugger::GetThreadNames>
 		> dispatcher;
 };
 
@@ -219,7 +219,7 @@ void ITwibDeviceInterface::OpenNamedPipe(bridge::ResponseOpener opener, std::str
 		return;
 	}
 	
-	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(i->second));
+	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(twili, i->second));
 }
 
 void ITwibDeviceInterface::OpenActiveDebugger(bridge::ResponseOpener opener, uint64_t pid) {
@@ -301,7 +301,7 @@ void ITwibDeviceInterface::OpenFilesystemAccessor(bridge::ResponseOpener opener,
 		return;
 	}
 	
-	opener.RespondOk(opener.MakeObject<ITwibFilesystemAccessor>(ifs));
+	opener.RespondOk(opener.MakeObject<ITwibFilesystemAccessor>(twili, ifs));
 }
 
 void ITwibDeviceInterface::WaitToDebugApplication(bridge::ResponseOpener opener) {
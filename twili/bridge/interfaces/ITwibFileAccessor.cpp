@@ -77,6 +77,10 @@ void ITwibFileAccessor::Write(bridge::ResponseOpener opener, uint64_t offset, In
 		};
 }
 
+trn::ResultCode ITwibFileAccessor::WriteAt(uint64_t offset, uint8_t *data, size_t size) {
+	return ifile_write(ifile, 0, offset, size, data, size);
+}
+
 void ITwibFileAccessor::Flush(bridge::ResponseOpener opener) {
 	TWILI_BRIDGE_CHECK(ifile_flush(ifile));
 	opener.RespondOk();
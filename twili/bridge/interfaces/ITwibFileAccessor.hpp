@@ -35,6 +35,9 @@ class ITwibFileAccessor : public ObjectDispatcherProxy<ITwibFileAccessor> {
 	~ITwibFileAccessor();
 	
 	using CommandID = protocol::ITwibFileAccessor::Command;
+
+	// for other objects that want to write here without going through the host
+	trn::ResultCode WriteAt(uint64_t offset, uint8_t *data, size_t size);
 	
  private:
 	ifile_t ifile;
@@ -21,24 +21,398 @@
 #include "ITwibFilesystemAccessor.hpp"
 
 #include<libtransistor/cpp/svc.hpp>
+#include<libtransistor/cpp/waiter.hpp>
+
+#include "../../twili.hpp"
+#include "../../TwibPipe.hpp"
 
 #include "err.hpp"
 
 #include "ITwibFileAccessor.hpp"
 #include "ITwibDirectoryAccessor.hpp"
+#include "ITwibPipeReader.hpp"
 
+#include<algorithm>
 #include<cstring>
+#include<new>
+#include<vector>
 
 using namespace trn;
 
 namespace twili {
 namespace bridge {
 
-ITwibFilesystemAccessor::ITwibFilesystemAccessor(uint32_t object_id, ifilesystem_t ifs) : ObjectDispatcherProxy(*this, object_id), ifs(ifs), dispatcher(*this) {
+using CopyRecord = protocol::ITwibFilesystemAccessor::CopyRecord;
+
+// fs maps page-aligned buffers straight into the server instead of copying
+// the partial pages at either end
+static const size_t COPY_BUFFER_ALIGNMENT = 0x1000;
+
+struct AlignedBufferDeleter {
+	void operator()(uint8_t *buffer) {
+		::operator delete[](buffer, std::align_val_t(COPY_BUFFER_ALIGNMENT));
+	}
+};
+
+// Copies a file or directory tree into another filesystem, a step at a time
+// from the event loop so that other requests still get serviced during big
+// copies. Each step handles one directory or one buffer's worth of a file,
+// and the next one waits until the pipe has taken that step's records.
+class ITwibFilesystemAccessor::Copier : public std::enable_shared_from_this<Copier> {
+ public:
+	Copier(Twili &twili, ITwibFilesystemAccessor &source, std::shared_ptr<ITwibFilesystemAccessor> destination, uint32_t flags, std::shared_ptr<TwibPipe> pipe, std::unique_ptr<uint8_t[], AlignedBufferDeleter> &&buffer, size_t buffer_size) :
+		twili(twili),
+		source(source),
+		destination(destination),
+		flags(flags),
+		pipe(pipe),
+		buffer(std::move(buffer)),
+		buffer_size(buffer_size) {
+	}
+
+	~Copier() {
+		CloseFiles();
+	}
+
+	void Begin(std::string src, std::string dst) {
+		std::shared_ptr<Copier> self = shared_from_this();
+		signal = twili.event_waiter.AddSignal(
+			[self]() {
+				self->signal->ResetSignal();
+				self->Pump();
+				return true;
+			});
+		work.push_back({Work::Type::Root, src, dst, 0});
+		signal->Signal();
+	}
+
+	// The source filesystem is going away, so stop before the next step.
+	void Cancel() {
+		cancelled = true;
+		CloseFiles();
+	}
+	
+ private:
+	struct Work {
+		enum class Type {
+			Root, // don't know what it is yet
+			Directory,
+			File,
+			Leave, // delete the source directory once its contents are moved
+		} type;
+		std::string src;
+		std::string dst;
+		uint64_t size;
+	};
+
+	void Pump() {
+		if(finished) { // our DONE record made it into the pipe
+			pipe->CloseWriter();
+			signal.reset(); // breaks the reference cycle through the signal callback
+			return;
+		}
+
+		if(cancelled) {
+			Finish(TWILI_ERR_INTERRUPTED);
+		} else if(file_open) {
+			CopyChunk();
+		} else if(work.empty()) {
+			Finish(overall_result);
+		} else {
+			Work item = std::move(work.back());
+			work.pop_back();
+			switch(item.type) {
+			case Work::Type::Root:
+				StepRoot(item);
+				break;
+			case Work::Type::Directory:
+				StepDirectory(item);
+				break;
+			case Work::Type::File:
+				StepFile(item);
+				break;
+			case Work::Type::Leave:
+				StepLeave(item);
+				break;
+			}
+		}
+		
+		Flush();
+	}
+
+	void StepRoot(Work &item) {
+		char path[0x301];
+		uint32_t entry_type = 0;
+		ResultCode r = MakePath(path, item.src);
+		if(r == RESULT_OK) {
+			r = ifilesystem_get_entry_type(source.ifs, &entry_type, path);
+		}
+		if(r != RESULT_OK) {
+			Report(CopyRecord::Type::ENTRY, r, 0, 0, 1, item.src);
+			return;
+		}
+
+		if((flags & protocol::ITwibFilesystemAccessor::COPY_FLAG_MOVE) && destination.get() == &source) {
+			// nothing needs to be copied, unless the destination exists and
+			// has to be merged into
+			char dst_path[0x301];
+			uint32_t dst_entry_type;
+			r = MakePath(dst_path, item.dst);
+			if(r == RESULT_OK && ifilesystem_get_entry_type(source.ifs, &dst_entry_type, dst_path) != RESULT_OK) {
+				r = entry_type == 0 ?
+					ifilesystem_rename_directory(source.ifs, path, dst_path) :
+					ifilesystem_rename_file(source.ifs, path, dst_path);
+				Report(CopyRecord::Type::ENTRY, r, 0, 0, entry_type, item.src);
+				return;
+			}
+			if(r != RESULT_OK) {
+				Report(CopyRecord::Type::ENTRY, r, 0, 0, entry_type, item.src);
+				return;
+			}
+		}
+
+		if(entry_type == 0) {
+			work.push_back({Work::Type::Directory, item.src, item.dst, 0});
+		} else {
+			work.push_back({Work::Type::File, item.src, item.dst, 0});
+		}
+	}
+
+	void StepDirectory(Work &item) {
+		char path[0x301];
+		ResultCode r = MakePath(path, item.dst);
+		if(r == RESULT_OK) {
+			r = ifilesystem_create_directory(destination->ifs, path);
+			if(r.code == 0x402) { // already exists, so merge into it
+				r = RESULT_OK;
+			}
+		}
+		if(r == RESULT_OK) {
+			r = MakePath(path, item.src);
+		}
+
+		std::vector<idirectoryentry_t> entries;
+		if(r == RESULT_OK) {
+			idirectory_t idir;
+			r = ifilesystem_open_directory(source.ifs, &idir, 3, path);
+			if(r == RESULT_OK) {
+				uint64_t count;
+				do {
+					size_t old_size = entries.size();
+					entries.resize(old_size + 32);
+					r = idirectory_read(idir, &count, entries.data() + old_size, 32 * sizeof(idirectoryentry_t));
+					entries.resize(old_size + (r == RESULT_OK ? count : 0));
+				} while(r == RESULT_OK && count > 0);
+				ipc_close(idir);
+			}
+		}
+		
+		Report(CopyRecord::Type::ENTRY, r, 0, 0, 0, item.src);
+		if(r != RESULT_OK) {
+			return;
+		}
+
+		if(flags & protocol::ITwibFilesystemAccessor::COPY_FLAG_MOVE) {
+			work.push_back({Work::Type::Leave, item.src, item.dst, 0});
+		}
+		// pushed backwards so that they come off the stack in order
+		for(auto i = entries.rbegin(); i != entries.rend(); i++) {
+			std::string name(i->path, strnlen(i->path, sizeof(i->path)));
+			work.push_back({
+					i->entry_type == 0 ? Work::Type::Directory : Work::Type::File,
+					JoinPath(item.src, name),
+					JoinPath(item.dst, name),
+					i->file_size});
+		}
+	}
+
+	void StepFile(Work &item) {
+		char src_path[0x301];
+		char dst_path[0x301];
+		ResultCode r = MakePath(src_path, item.src);
+		if(r == RESULT_OK) {
+			r = MakePath(dst_path, item.dst);
+		}
+		if(r == RESULT_OK) {
+			r = ifilesystem_open_file(source.ifs, &src_file, 1, src_path);
+		}
+		if(r != RESULT_OK) {
+			Report(CopyRecord::Type::ENTRY, r, 0, 0, 1, item.src);
+			return;
+		}
+		file_open = true;
+		current = std::move(item);
+		offset = 0;
+		
+		r = ifile_get_size(src_file, &current.size);
+		if(r == RESULT_OK) {
+			r = ifilesystem_create_file(destination->ifs, 0, current.size, dst_path);
+			if(r.code == 0x402) { // already exists, so overwrite it
+				r = RESULT_OK;
+			}
+		}
+		if(r == RESULT_OK) {
+			r = ifilesystem_open_file(destination->ifs, &dst_file, 6, dst_path);
+			if(r == RESULT_OK) {
+				dst_file_open = true;
+				r = ifile_set_size(dst_file, current.size);
+			}
+		}
+		if(r != RESULT_OK) {
+			FinishFile(r);
+		}
+	}
+
+	void CopyChunk() {
+		size_t size = std::min<uint64_t>(buffer_size, current.size - offset);
+		if(size == 0) {
+			FinishFile(ifile_flush(dst_file));
+			return;
+		}
+		
+		size_t actual_size = 0;
+		ResultCode r = ifile_read(src_file, &actual_size, buffer.get(), size, 0, offset, size);
+		if(r == RESULT_OK && actual_size != size) {
+			r = TWILI_ERR_EOF; // file shrank out from under us
+		}
+		if(r == RESULT_OK) {
+			r = ifile_write(dst_file, 0, offset, size, buffer.get(), size);
+		}
+		if(r != RESULT_OK) {
+			FinishFile(r);
+			return;
+		}
+		offset+= size;
+		total_size+= size;
+		Report(CopyRecord::Type::PROGRESS, RESULT_OK, offset, current.size, 1, current.src);
+	}
+
+	void FinishFile(ResultCode r) {
+		CloseFiles();
+		if(r == RESULT_OK && (flags & protocol::ITwibFilesystemAccessor::COPY_FLAG_MOVE)) {
+			char path[0x301];
+			r = MakePath(path, current.src);
+			if(r == RESULT_OK) {
+				r = ifilesystem_delete_file(source.ifs, path);
+			}
+		}
+		Report(CopyRecord::Type::ENTRY, r, offset, current.size, 1, current.src);
+	}
+
+	void StepLeave(Work &item) {
+		char path[0x301];
+		ResultCode r = MakePath(path, item.src);
+		if(r == RESULT_OK) {
+			r = ifilesystem_delete_directory(source.ifs, path);
+		}
+		if(r != RESULT_OK) {
+			// the directory itself was already reported when we entered it
+			Report(CopyRecord::Type::ENTRY, r, 0, 0, 0, item.src);
+		}
+	}
+
+	void Finish(ResultCode r) {
+		CloseFiles();
+		work.clear();
+		Report(CopyRecord::Type::DONE, r, total_size, total_size, 0, "");
+		finished = true;
+	}
+
+	void CloseFiles() {
+		if(file_open) {
+			ipc_close(src_file);
+			file_open = false;
+		}
+		if(dst_file_open) {
+			ipc_close(dst_file);
+			dst_file_open = false;
+		}
+	}
+
+	void Report(CopyRecord::Type type, ResultCode r, uint64_t bytes, uint64_t size, uint32_t entry_type, const std::string &path) {
+		if(r != RESULT_OK && overall_result == RESULT_OK) {
+			overall_result = r;
+		}
+		
+		CopyRecord record;
+		record.type = type;
+		record.result = r.code;
+		record.bytes = bytes;
+		record.size = size;
+		record.entry_type = entry_type;
+		record.path_size = path.size();
+		uint8_t *record_bytes = (uint8_t*) &record;
+		records.insert(records.end(), record_bytes, record_bytes + sizeof(record));
+		records.insert(records.end(), path.begin(), path.end());
+	}
+
+	// Sends this step's records, and schedules the next step once the pipe
+	// has taken them.
+	void Flush() {
+		in_flight.swap(records);
+		records.clear();
+		
+		std::shared_ptr<Copier> self = shared_from_this();
+		pipe->Write(
+			in_flight.data(), in_flight.size(),
+			[self](bool eof) {
+				if(eof) { // nobody's listening anymore
+					self->CloseFiles();
+					self->signal.reset();
+					return;
+				}
+				self->signal->Signal();
+			});
+	}
+
+	static ResultCode MakePath(char (&buffer)[0x301], const std::string &path) {
+		if(path.size() >= sizeof(buffer)) {
+			return TWILI_ERR_PROTOCOL_BAD_REQUEST;
+		}
+		std::strncpy(buffer, path.c_str(), sizeof(buffer));
+		return RESULT_OK;
+	}
+
+	static std::string JoinPath(const std::string &directory, const std::string &name) {
+		if(!directory.empty() && directory.back() == '/') {
+			return directory + name;
+		}
+		return directory + "/" + name;
+	}
+
+	Twili &twili;
+	ITwibFilesystemAccessor &source;
+	std::shared_ptr<ITwibFilesystemAccessor> destination;
+	uint32_t flags;
+	std::shared_ptr<TwibPipe> pipe;
+	std::unique_ptr<uint8_t[], AlignedBufferDeleter> buffer;
+	size_t buffer_size;
+	std::shared_ptr<trn::WaitHandle> signal;
+	
+	std::vector<Work> work; // depth-first, so this is a stack
+	Work current; // file being copied
+	ifile_t src_file;
+	ifile_t dst_file;
+	bool file_open = false;
+	bool dst_file_open = false;
+	uint64_t offset = 0;
+	uint64_t total_size = 0;
+	ResultCode overall_result = RESULT_OK; // first error we hit
+	
+	std::vector<uint8_t> records;
+	std::vector<uint8_t> in_flight; // owned by the pipe until it calls back
+	bool cancelled = false;
+	bool finished = false;
+};
+
+ITwibFilesystemAccessor::ITwibFilesystemAccessor(uint32_t object_id, Twili &twili, ifilesystem_t ifs) : ObjectDispatcherProxy(*this, object_id), twili(twili), ifs(ifs), dispatcher(*this) {
 	
 }
 
 ITwibFilesystemAccessor::~ITwibFilesystemAccessor() {
+	if(std::shared_ptr<Copier> c = copier.lock()) {
+		c->Cancel();
+	}
 	ipc_close(ifs);
 }
 
@@ -125,5 +499,64 @@ void ITwibFilesystemAccessor::OpenDirectory(bridge::ResponseOpener opener, std::
 	opener.RespondOk(opener.MakeObject<ITwibDirectoryAccessor>(idir));
 }
 
+// Collapses repeated slashes and resolves "." and ".." components, so that
+// paths can be compared as strings.
+static std::string NormalizePath(const std::string &path) {
+	std::vector<std::string> components;
+	size_t start = 0;
+	while(start <= path.size()) {
+		size_t end = path.find('/', start);
+		if(end == std::string::npos) {
+			end = path.size();
+		}
+		std::string component = path.substr(start, end - start);
+		if(component == "..") {
+			if(!components.empty()) {
+				components.pop_back();
+			}
+		} else if(!component.empty() && component != ".") {
+			components.push_back(component);
+		}
+		start = end + 1;
+	}
+
+	std::string normalized;
+	for(const std::string &component : components) {
+		normalized+= "/" + component;
+	}
+	return normalized.empty() ? "/" : normalized;
+}
+
+void ITwibFilesystemAccessor::Copy(bridge::ResponseOpener opener, std::shared_ptr<ITwibFilesystemAccessor> destination, std::string src, std::string dst, uint32_t flags) {
+	TWILI_BRIDGE_CHECK(copier.expired() ? RESULT_OK : TWILI_ERR_ALREADY_WAITING);
+	TWILI_BRIDGE_CHECK(!src.empty() && !dst.empty() ? RESULT_OK : TWILI_ERR_PROTOCOL_BAD_REQUEST);
+	TWILI_BRIDGE_CHECK(
+		(flags & ~protocol::ITwibFilesystemAccessor::COPY_FLAG_MOVE) == 0 ?
+		RESULT_OK :
+		TWILI_ERR_PROTOCOL_BAD_REQUEST);
+	src = NormalizePath(src);
+	dst = NormalizePath(dst);
+	if(destination.get() == this) {
+		// copying a directory into itself would never finish, and copying
+		// anything onto itself would truncate or delete it
+		std::string prefix = src == "/" ? src : src + "/";
+		TWILI_BRIDGE_CHECK(dst != src && dst.compare(0, prefix.size(), prefix) != 0 ? RESULT_OK : TWILI_ERR_PROTOCOL_BAD_REQUEST);
+	}
+
+	// clamped when the config is loaded
+	size_t buffer_size = twili.config.copy_buffer_size;
+	buffer_size = (buffer_size + COPY_BUFFER_ALIGNMENT - 1) & ~(COPY_BUFFER_ALIGNMENT - 1);
+	std::unique_ptr<uint8_t[], AlignedBufferDeleter> buffer(
+		static_cast<uint8_t*>(::operator new[](buffer_size, std::align_val_t(COPY_BUFFER_ALIGNMENT), std::nothrow)));
+	TWILI_BRIDGE_CHECK(buffer ? RESULT_OK : TWILI_ERR_INTERNAL_ERROR);
+	
+	std::shared_ptr<TwibPipe> pipe = std::make_shared<TwibPipe>(twili.config.pipe_buffer_size_limit);
+	std::shared_ptr<Copier> c = std::make_shared<Copier>(twili, *this, destination, flags, pipe, std::move(buffer), buffer_size);
+	copier = c;
+	c->Begin(src, dst);
+	
+	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(twili, pipe));
+}
+
 } // namespace bridge
 } // namespace twili
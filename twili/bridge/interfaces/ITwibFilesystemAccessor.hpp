@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include<memory>
+
 #include "../Object.hpp"
 #include "../ResponseOpener.hpp"
 #include "../RequestHandler.hpp"
@@ -27,17 +29,24 @@
 #include<libtransistor/ipc/fs/ifilesystem.h>
 
 namespace twili {
+
+class Twili;
+
 namespace bridge {
 
 class ITwibFilesystemAccessor : public ObjectDispatcherProxy<ITwibFilesystemAccessor> {
  public:
-	ITwibFilesystemAccessor(uint32_t object_id, ifilesystem_t ifs);
+	ITwibFilesystemAccessor(uint32_t object_id, Twili &twili, ifilesystem_t ifs);
 	~ITwibFilesystemAccessor();
 	
 	using CommandID = protocol::ITwibFilesystemAccessor::Command;
 	
  private:
+	class Copier;
+	
+	Twili &twili;
 	ifilesystem_t ifs;
+	std::weak_ptr<Copier> copier; // only one copy out of here at a time
 
 	void CreateFile(bridge::ResponseOpener opener, uint32_t mode, uint64_t size, std::string path);
 	void DeleteFile(bridge::ResponseOpener opener, std::string path);
@@ -49,6 +58,7 @@ class ITwibFilesystemAccessor : public ObjectDispatcherProxy<ITwibFilesystemAcce
 	void GetEntryType(bridge::ResponseOpener opener, std::string path);
 	void OpenFile(bridge::ResponseOpener opener, uint32_t mode, std::string path);
 	void OpenDirectory(bridge::ResponseOpener opener, std::string path);
+	void Copy(bridge::ResponseOpener opener, std::shared_ptr<ITwibFilesystemAccessor> destination, std::string src, std::string dst, uint32_t flags);
 
  public:
 	SmartRequestDispatcher<
@@ -62,7 +72,8 @@ class ITwibFilesystemAccessor : public ObjectDispatcherProxy<ITwibFilesystemAcce
 		SmartCommand<CommandID::RENAME_DIRECTORY, &ITwibFilesystemAccessor::RenameDirectory>,
 		SmartCommand<CommandID::GET_ENTRY_TYPE, &ITwibFilesystemAccessor::GetEntryType>,
 		SmartCommand<CommandID::OPEN_FILE, &ITwibFilesystemAccessor::OpenFile>,
-		SmartCommand<CommandID::OPEN_DIRECTORY, &ITwibFilesystemAccessor::OpenDirectory>
+		SmartCommand<CommandID::OPEN_DIRECTORY, &ITwibFilesystemAccessor::OpenDirectory>,
+		SmartCommand<CommandID::COPY, &ITwibFilesystemAccessor::Copy>
 	 > dispatcher;
 };
 
@@ -20,6 +20,8 @@
 
 #include "ITwibPipeReader.hpp"
 
+#include "../../twili.hpp"
+
 #include "err.hpp"
 
 using trn::ResultCode;
@@ -28,7 +30,92 @@ using trn::ResultError;
 namespace twili {
 namespace bridge {
 
-ITwibPipeReader::ITwibPipeReader(uint32_t device_id, std::shared_ptr<TwibPipe> pipe) : ObjectDispatcherProxy(*this, device_id), pipe(pipe), dispatcher(*this) {
+// Copies everything written to a pipe into a file until the writer closes
+// it. A read callback isn't allowed to issue the next read itself, so when
+// data arrives asynchronously (from inside somebody's Write), the next read is
+// kicked off from the event loop instead.
+class ITwibPipeReader::Splicer : public std::enable_shared_from_this<Splicer> {
+ public:
+	Splicer(Twili &twili, std::shared_ptr<TwibPipe> pipe, std::shared_ptr<ITwibFileAccessor> file, uint64_t offset, bridge::ResponseOpener opener) :
+		twili(twili),
+		pipe(pipe),
+		file(file),
+		offset(offset),
+		opener(opener) {
+	}
+
+	void Begin() {
+		std::shared_ptr<Splicer> self = shared_from_this();
+		signal = twili.event_waiter.AddSignal(
+			[self]() {
+				self->signal->ResetSignal();
+				self->Pump();
+				return true;
+			});
+		Pump();
+	}
+	
+ private:
+	void Pump() {
+		std::shared_ptr<Splicer> self = shared_from_this();
+		while(!finished) {
+			read_completed = false;
+			in_pump = true;
+			pipe->Read(
+				[self](uint8_t *data, size_t actual_size) {
+					return self->Consume(data, actual_size);
+				});
+			in_pump = false;
+			if(!read_completed) {
+				return; // Consume will signal us when data shows up
+			}
+		}
+	}
+
+	size_t Consume(uint8_t *data, size_t actual_size) {
+		read_completed = true;
+		if(actual_size == 0) {
+			Finish(RESULT_OK);
+			return 0;
+		}
+
+		ResultCode r = file->WriteAt(offset, data, actual_size);
+		if(r != RESULT_OK) {
+			Finish(r);
+			return actual_size;
+		}
+		offset+= actual_size;
+		total_size+= actual_size;
+		
+		if(!in_pump) {
+			signal->Signal();
+		}
+		return actual_size;
+	}
+
+	void Finish(ResultCode r) {
+		finished = true;
+		if(r == RESULT_OK) {
+			opener.RespondOk(std::move(total_size));
+		} else {
+			opener.RespondError(r);
+		}
+		signal.reset(); // breaks the reference cycle through the signal callback
+	}
+	
+	Twili &twili;
+	std::shared_ptr<TwibPipe> pipe;
+	std::shared_ptr<ITwibFileAccessor> file;
+	uint64_t offset;
+	uint64_t total_size = 0;
+	bridge::ResponseOpener opener;
+	std::shared_ptr<trn::WaitHandle> signal;
+	bool in_pump = false;
+	bool read_completed = false;
+	bool finished = false;
+};
+
+ITwibPipeReader::ITwibPipeReader(uint32_t device_id, Twili &twili, std::shared_ptr<TwibPipe> pipe) : ObjectDispatcherProxy(*this, device_id), twili(twili), pipe(pipe), dispatcher(*this) {
 }
 
 void ITwibPipeReader::Read(bridge::ResponseOpener opener) {
@@ -43,5 +130,9 @@ void ITwibPipeReader::Read(bridge::ResponseOpener opener) {
 		});
 }
 
+void ITwibPipeReader::Splice(bridge::ResponseOpener opener, std::shared_ptr<ITwibFileAccessor> file, uint64_t offset) {
+	std::make_shared<Splicer>(twili, pipe, file, offset, opener)->Begin();
+}
+
 } // namespace bridge
 } // namespace twili
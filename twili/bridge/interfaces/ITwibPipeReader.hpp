@@ -22,29 +22,41 @@
 
 #include<memory>
 
+#include<libtransistor/cpp/waiter.hpp>
+
 #include "../Object.hpp"
 #include "../ResponseOpener.hpp"
 #include "../RequestHandler.hpp"
 #include "../../TwibPipe.hpp"
 
+#include "ITwibFileAccessor.hpp"
+
 namespace twili {
+
+class Twili;
+
 namespace bridge {
 
 class ITwibPipeReader : public ObjectDispatcherProxy<ITwibPipeReader> {
  public:
-	ITwibPipeReader(uint32_t object_id, std::shared_ptr<TwibPipe> pipe);
+	ITwibPipeReader(uint32_t object_id, Twili &twili, std::shared_ptr<TwibPipe> pipe);
 
 	using CommandID = protocol::ITwibPipeReader::Command;
 	
  private:
+	class Splicer;
+	
+	Twili &twili;
 	std::shared_ptr<TwibPipe> pipe;
 
 	void Read(bridge::ResponseOpener opener);
+	void Splice(bridge::ResponseOpener opener, std::shared_ptr<ITwibFileAccessor> file, uint64_t offset);
 
  public:
 	SmartRequestDispatcher<
 		ITwibPipeReader,
-		SmartCommand<CommandID::READ, &ITwibPipeReader::Read>
+		SmartCommand<CommandID::READ, &ITwibPipeReader::Read>,
+		SmartCommand<CommandID::SPLICE, &ITwibPipeReader::Splice>
 		> dispatcher;
 };
 
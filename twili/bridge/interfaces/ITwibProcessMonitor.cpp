@@ -118,11 +118,11 @@ void ITwibProcessMonitor::OpenStdin(bridge::ResponseOpener opener) {
 }
 
 void ITwibProcessMonitor::OpenStdout(bridge::ResponseOpener opener) {
-	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(process->tp_stdout));
+	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(process->twili, process->tp_stdout));
 }
 
 void ITwibProcessMonitor::OpenStderr(bridge::ResponseOpener opener) {
-	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(process->tp_stderr));
+	opener.RespondOk(opener.MakeObject<ITwibPipeReader>(process->twili, process->tp_stderr));
 }
 
 void ITwibProcessMonitor::WaitStateChange(bridge::ResponseOpener opener) {
@@ -22,6 +22,7 @@
 
 #include<libtransistor/ipc/bsd.h>
 
+#include<errno.h>
 #include<mutex>
 
 #include "../../Threading.hpp"
@@ -35,12 +36,46 @@ namespace tcp {
 
 TCPBridge::Connection::Connection(TCPBridge &bridge, util::Socket &&socket) :
 	bridge(bridge),
-	socket(std::move(socket)) {
+	socket(std::move(socket)),
+	close_objects_handler(objects) {
 	objects.insert(std::pair<uint32_t, std::shared_ptr<bridge::Object>>(0, bridge.object_zero));
 }
 
+// how much payload the main thread processes for one connection before
+// moving on to the next one that has work waiting
+static const size_t PROCESSING_QUANTUM = 64 * 1024;
+
+// once a client falls this far behind on reading responses, the main thread
+// stops starting new commands for it until the socket thread catches up.
+static const size_t MAX_BUFFERED_OUTPUT_SIZE = 8 * 1024 * 1024;
+
+// start sending a response before it's finished once this much is buffered
+static const size_t OUTPUT_FLUSH_THRESHOLD = 64 * 1024;
+
+bool TCPBridge::Connection::WantsRead() {
+	{
+		std::unique_lock<thread::Mutex> lock(bridge.request_processing_mutex);
+		if(request_queue.GetQueuedSize() > (size_t) bridge.twili.config.tcp_bridge_input_queue_limit) {
+			return false;
+		}
+	}
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		if(out_buffer.ReadAvailable() > (size_t) bridge.twili.config.tcp_bridge_output_queue_limit) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TCPBridge::Connection::WantsWrite() {
+	std::unique_lock<thread::Mutex> lock(out_mutex);
+	write_armed = out_buffer.ReadAvailable() > 0;
+	return write_armed;
+}
+
 void TCPBridge::Connection::PumpInput() {
-	std::tuple<uint8_t*, size_t> target = in_buffer.Reserve(8192);
+	std::tuple<uint8_t*, size_t> target = in_buffer.Reserve(bridge.twili.config.tcp_bridge_receive_buffer_size);
 	ssize_t r = bsd_recv(socket.fd, (void*) std::get<0>(target), std::get<1>(target), 0);
 	if(r <= 0) {
 		Panic();
@@ -50,86 +85,177 @@ void TCPBridge::Connection::PumpInput() {
 	}
 }
 
-void TCPBridge::Connection::Process() {
-	while(!deletion_flag && in_buffer.ReadAvailable() > 0) {
-		if(!has_current_mh) {
-			if(in_buffer.Read(current_mh)) {
-				has_current_mh = true;
-				payload_size = 0;
-				payload_buffer.Clear();
-				has_current_payload = false;
-				
-				// pick command handler
-				Synchronize(Task::BeginProcessingCommand);
-			} else {
-				in_buffer.Reserve(sizeof(protocol::MessageHeader));
+void TCPBridge::Connection::PumpOutput() {
+	bool failed = false;
+	bool resume = false;
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		while(out_buffer.ReadAvailable() > 0) {
+			util::Span span = out_buffer.GetFrontSpan();
+			ssize_t r = bsd_send(socket.fd, span.data, span.size, MSG_DONTWAIT);
+			if(r < 0 && (bsd_errno == EAGAIN || bsd_errno == EWOULDBLOCK)) {
+				break;
 			}
-		}
-
-		if(!has_current_payload) {
-			size_t payload_avail = in_buffer.ReadAvailable();
-			if(payload_avail > current_mh.payload_size - payload_size) {
-				payload_avail = current_mh.payload_size - payload_size;
+			if(r <= 0) {
+				failed = true;
+				break;
 			}
-			in_buffer.Read(payload_buffer, payload_avail);
-			payload_size+= payload_avail;
-
-			Synchronize(Task::FlushReceiveBuffer);
-			
-			if(payload_size == current_mh.payload_size) {
-				Synchronize(Task::FinalizeCommand);
-				has_current_mh = false;
-				has_current_payload = false;
-			} else {
-				return;
+			out_buffer.MarkRead(r);
+			if((size_t) r < span.size) {
+				break;
 			}
 		}
+		if(output_deferred && out_buffer.ReadAvailable() <= MAX_BUFFERED_OUTPUT_SIZE) {
+			output_deferred = false;
+			resume = true;
+		}
+	}
+
+	if(failed) {
+		Panic();
+	} else if(resume) {
+		// hand our deferred jobs back to the main thread
+		std::unique_lock<thread::Mutex> lock(bridge.request_processing_mutex);
+		bridge.request_processing_connections.push_back(shared_from_this());
+		bridge.request_processing_signal_wh->Signal();
 	}
 }
 
-void TCPBridge::Connection::Synchronize(Task task) {
+void TCPBridge::Connection::Process() {
 	std::unique_lock<thread::Mutex> lock(bridge.request_processing_mutex);
-	
-	this->pending_task = task;
-	// request that the main thread service us
-	bridge.request_processing_connection = shared_from_this();
-	bridge.request_processing_signal_wh->Signal();
-	while(this->pending_task != Task::Idle) {
-		bridge.request_processing_condvar.Wait(bridge.request_processing_mutex, -1);
+
+	if(request_queue.Ingest(in_buffer) && !is_queued_for_processing) {
+		// request that the main thread service us
+		is_queued_for_processing = true;
+		bridge.request_processing_connections.push_back(shared_from_this());
+		bridge.request_processing_signal_wh->Signal();
 	}
 }
 
 void TCPBridge::Connection::Synchronized() {
-	switch(pending_task) {
-	case Task::BeginProcessingCommand:
-		BeginProcessingCommandImpl();
-		break;
-	case Task::FlushReceiveBuffer:
-		try {
-			current_handler->FlushReceiveBuffer(payload_buffer);
-		} catch(trn::ResultError &e) {
-			printf("TCPConnection: Somebody is still throwing exceptions!\n");
-			twili::Abort(e);
+	if(jobs.empty()) {
+		size_t limit = bridge.twili.config.tcp_bridge_input_queue_limit;
+		bool was_throttled;
+		bool is_throttled;
+		{
+			std::unique_lock<thread::Mutex> lock(bridge.request_processing_mutex);
+			was_throttled = request_queue.GetQueuedSize() > limit;
+			request_queue.Take(jobs, PROCESSING_QUANTUM);
+			is_throttled = request_queue.GetQueuedSize() > limit;
 		}
-		break;
-	case Task::FinalizeCommand:
-		try {
-			current_handler->Finalize(payload_buffer);
-			if(current_object) {
-				current_object->FinalizeCommand();
-				current_object.reset();
+
+		if(was_throttled && !is_throttled) {
+			// socket thread stopped polling us for input; let it know it can resume.
+			bridge.WakeSocketThread();
+		}
+	}
+
+	if(!RunJobs()) {
+		// stay queued for processing; PumpOutput puts us back in line
+		return;
+	}
+
+	std::unique_lock<thread::Mutex> lock(bridge.request_processing_mutex);
+	if(request_queue.IsEmpty()) {
+		is_queued_for_processing = false;
+	} else {
+		// go to the back of the line so other connections get a turn
+		bridge.request_processing_connections.push_back(shared_from_this());
+		bridge.request_processing_signal_wh->Signal();
+	}
+}
+
+void TCPBridge::Connection::QueueOutput(const uint8_t *data, size_t size) {
+	bool needs_flush;
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		if(deletion_flag) {
+			return;
+		}
+		out_buffer.Write(data, size);
+		needs_flush = out_buffer.ReadAvailable() >= OUTPUT_FLUSH_THRESHOLD;
+	}
+	
+	if(needs_flush) {
+		FlushOutput();
+	}
+}
+
+void TCPBridge::Connection::FlushOutput() {
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		if(write_armed || out_buffer.ReadAvailable() == 0) {
+			// socket thread is already watching for POLLOUT
+			return;
+		}
+		write_armed = true;
+	}
+	bridge.WakeSocketThread();
+}
+
+bool TCPBridge::Connection::DeferForOutput() {
+	bool wake;
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		if(out_buffer.ReadAvailable() <= MAX_BUFFERED_OUTPUT_SIZE) {
+			return false;
+		}
+		// Rather than have the IPC server wait on a slow client, leave the rest
+		// of its commands for later.
+		output_deferred = true;
+		wake = !write_armed;
+		write_armed = true;
+	}
+	if(wake) {
+		bridge.WakeSocketThread();
+	}
+	return true;
+}
+
+bool TCPBridge::Connection::RunJobs() {
+	for(; !jobs.empty() && !deletion_flag; jobs.pop_front()) {
+		RequestQueue::Job *i = &jobs.front();
+		switch(i->type) {
+		case RequestQueue::Job::Type::BeginProcessingCommand:
+			if(DeferForOutput()) {
+				return false;
+			}
+			current_mh = i->mh;
+			payload_buffer.Clear();
+			current_object_ids.clear();
+			BeginProcessingCommandImpl();
+			break;
+		case RequestQueue::Job::Type::FlushReceiveBuffer:
+			// the socket thread already copied this out of the receive
+			// buffer, so hand it over instead of copying it again
+			payload_buffer.Adopt(std::move(i->data));
+			try {
+				current_handler->FlushReceiveBuffer(payload_buffer);
+			} catch(trn::ResultError &e) {
+				printf("TCPConnection: Somebody is still throwing exceptions!\n");
+				twili::Abort(e);
+			}
+			break;
+		case RequestQueue::Job::Type::FinalizeCommand:
+			current_object_ids = std::move(i->object_ids);
+			try {
+				if(!current_object_ids.empty()) {
+					current_handler->ReceiveObjects(ResolveObjects(objects, current_object_ids));
+				}
+				current_handler->Finalize(payload_buffer);
+				if(current_object) {
+					current_object->FinalizeCommand();
+					current_object.reset();
+				}
+				ResetHandler();
+			} catch(trn::ResultError &e) {
+				printf("TCPConnection: Somebody is still throwing exceptions!\n");
+				twili::Abort(e);
 			}
-			ResetHandler();
-		} catch(trn::ResultError &e) {
-			printf("TCPConnection: Somebody is still throwing exceptions!\n");
-			twili::Abort(e);
+			break;
 		}
-		break;
-	case Task::Idle:
-		printf("TCPConnection: synchronized on idle task?\n");
-		break;
 	}
-	pending_task = Task::Idle;
+	return true;
 }
 
 void TCPBridge::Connection::BeginProcessingCommandImpl() {
@@ -142,7 +268,11 @@ void TCPBridge::Connection::BeginProcessingCommandImpl() {
 	}
 
 	// check for a close object request
-	if(current_mh.command_id == 0xffffffff) {
+	if(current_mh.command_id == protocol::CLOSE_OBJECTS && current_mh.object_id == 0) {
+		current_handler = close_objects_handler.Open(current_mh.payload_size, opener);
+		return;
+	}
+	if(current_mh.command_id == protocol::CLOSE_OBJECT) {
 		printf("got close command for %d\n", current_mh.object_id);
 		if(current_mh.object_id == 0) {
 			// for USBBridge, this is intended to cleanup objects left by another
@@ -169,7 +299,10 @@ void TCPBridge::Connection::ResetHandler() {
 }
 
 void TCPBridge::Connection::Panic() {
-	deletion_flag = true;
+	{
+		std::unique_lock<thread::Mutex> lock(out_mutex);
+		deletion_flag = true;
+	}
 	socket.Close();
 	// this is about the best we can do
 }
@@ -0,0 +1,122 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "RequestQueue.hpp"
+
+#include<algorithm>
+#include<iterator>
+
+namespace twili {
+namespace bridge {
+namespace tcp {
+
+bool RequestQueue::Ingest(util::SegmentedBuffer &input) {
+	bool queued = false;
+	
+	while(true) {
+		if(!has_current_mh) {
+			if(!input.Read(current_mh)) {
+				break;
+			}
+			has_current_mh = true;
+			payload_size = 0;
+
+			Job job;
+			job.type = Job::Type::BeginProcessingCommand;
+			job.mh = current_mh;
+			jobs.push_back(std::move(job));
+			queued = true;
+		}
+
+		if(payload_size < current_mh.payload_size) {
+			// payload may straddle blocks, so copy it out one span at a time
+			util::Span span;
+			while(payload_size < current_mh.payload_size && (span = input.GetFrontSpan()).size > 0) {
+				size_t avail = std::min(span.size, (size_t) (current_mh.payload_size - payload_size));
+				PushData(span.data, avail);
+				input.MarkRead(avail);
+				payload_size+= avail;
+				queued = true;
+			}
+			
+			if(payload_size < current_mh.payload_size) {
+				break;
+			}
+		}
+
+		// object IDs follow the payload
+		if(input.ReadAvailable() < current_mh.object_count * sizeof(uint32_t)) {
+			break;
+		}
+		
+		Job job;
+		job.type = Job::Type::FinalizeCommand;
+		job.object_ids.resize(current_mh.object_count);
+		input.Read(job.object_ids);
+		jobs.push_back(std::move(job));
+		has_current_mh = false;
+		queued = true;
+	}
+
+	return queued;
+}
+
+void RequestQueue::Take(std::deque<Job> &out) {
+	std::move(jobs.begin(), jobs.end(), std::back_inserter(out));
+	jobs.clear();
+	queued_size = 0;
+}
+
+void RequestQueue::Take(std::deque<Job> &out, size_t budget) {
+	size_t taken = 0;
+	while(!jobs.empty() && (taken == 0 || taken < budget)) {
+		Job &job = jobs.front();
+		// count non-payload jobs as a byte so a run of them still makes progress
+		size_t size = std::max(job.data.size(), (size_t) 1);
+		queued_size-= job.data.size();
+		taken+= size;
+		out.push_back(std::move(job));
+		jobs.pop_front();
+	}
+}
+
+size_t RequestQueue::GetQueuedSize() const {
+	return queued_size;
+}
+
+bool RequestQueue::IsEmpty() const {
+	return jobs.empty();
+}
+
+void RequestQueue::PushData(uint8_t *data, size_t size) {
+	// coalesce with the previous chunk if the main thread hasn't taken it yet
+	if(jobs.empty() || jobs.back().type != Job::Type::FlushReceiveBuffer) {
+		Job job;
+		job.type = Job::Type::FlushReceiveBuffer;
+		jobs.push_back(std::move(job));
+	}
+	std::vector<uint8_t> &vec = jobs.back().data;
+	vec.insert(vec.end(), data, data + size);
+	queued_size+= size;
+}
+
+} // namespace tcp
+} // namespace bridge
+} // namespace twili
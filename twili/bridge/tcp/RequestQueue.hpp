@@ -0,0 +1,83 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<deque>
+#include<vector>
+
+#include<stdint.h>
+
+#include "../../../common/Protocol.hpp"
+#include "../../../common/SegmentedBuffer.hpp"
+
+namespace twili {
+namespace bridge {
+namespace tcp {
+
+// Splits the byte stream coming in on a TCP bridge connection into jobs for
+// the main thread to run. The socket thread keeps ingesting while the main
+// thread works through jobs it has already taken, and adjacent payload
+// chunks are coalesced so that one handoff can cover many recv()s.
+//
+// This class does no locking of its own and doesn't depend on libtransistor,
+// so it can be built and exercised on the host.
+class RequestQueue {
+ public:
+	struct Job {
+		enum class Type {
+			BeginProcessingCommand, FlushReceiveBuffer, FinalizeCommand
+		} type;
+		
+		protocol::MessageHeader mh; // BeginProcessingCommand
+		std::vector<uint8_t> data; // FlushReceiveBuffer
+		std::vector<uint32_t> object_ids; // FinalizeCommand
+	};
+
+	// Consumes as much of the input buffer as forms jobs. Returns true if
+	// any jobs were queued.
+	bool Ingest(util::SegmentedBuffer &input);
+
+	// Moves every queued job onto the end of `out`.
+	void Take(std::deque<Job> &out);
+	// Moves queued jobs onto the end of `out` until at least `budget` bytes
+	// of payload have been moved or the queue is empty. Always moves at least
+	// one job if any are queued.
+	void Take(std::deque<Job> &out, size_t budget);
+
+	// Number of payload bytes that are queued but haven't been taken yet.
+	size_t GetQueuedSize() const;
+	bool IsEmpty() const;
+	
+ private:
+	void PushData(uint8_t *data, size_t size);
+	
+	std::deque<Job> jobs;
+	size_t queued_size = 0;
+
+	// parser state
+	bool has_current_mh = false;
+	protocol::MessageHeader current_mh;
+	size_t payload_size = 0;
+};
+
+} // namespace tcp
+} // namespace bridge
+} // namespace twili
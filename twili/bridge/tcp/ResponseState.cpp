@@ -20,8 +20,6 @@
 
 #include "TCPBridge.hpp"
 
-#include<libtransistor/ipc/bsd.h>
-
 #include "../Object.hpp"
 #include "../ResponseOpener.hpp"
 
@@ -40,15 +38,15 @@ TCPBridge::Connection::ResponseState::ResponseState(std::shared_ptr<Connection>
 }
 
 size_t TCPBridge::Connection::ResponseState::GetMaxTransferSize() {
-	return 16384;
+	return 64 * 1024;
 }
 
 void TCPBridge::Connection::ResponseState::SendHeader(protocol::MessageHeader &hdr) {
-	Send((uint8_t*) &hdr, sizeof(hdr));
+	connection->QueueOutput((uint8_t*) &hdr, sizeof(hdr));
 }
 
 void TCPBridge::Connection::ResponseState::SendData(uint8_t *data, size_t size) {
-	Send(data, size);
+	connection->QueueOutput(data, size);
 	transferred_size+= size;
 }
 
@@ -66,8 +64,10 @@ void TCPBridge::Connection::ResponseState::Finalize() {
 		for(auto p : objects) {
 			object_ids.push_back(p->object_id);
 		}
-		Send((uint8_t*) object_ids.data(), object_ids.size() * sizeof(uint32_t));
+		connection->QueueOutput((uint8_t*) object_ids.data(), object_ids.size() * sizeof(uint32_t));
 	}
+
+	connection->FlushOutput();
 }
 
 uint32_t TCPBridge::Connection::ResponseState::ReserveObjectId() {
@@ -78,19 +78,6 @@ void TCPBridge::Connection::ResponseState::InsertObject(std::pair<uint32_t, std:
 	connection->objects.insert(pair);
 }
 
-void TCPBridge::Connection::ResponseState::Send(uint8_t *data, size_t size) {
-	while(!connection->deletion_flag && size > 0) {
-		ssize_t r = bsd_send(connection->socket.fd, data, size, 0);
-		if(r <= 0) {
-			connection->deletion_flag = true;
-			connection->Panic();
-			return;
-		}
-		size-= r;
-		data+= r;
-	}
-}
-
 } // namespace tcp
 } // namespace bridge
 } // namespace twili
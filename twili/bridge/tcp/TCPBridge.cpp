@@ -71,18 +71,23 @@ TCPBridge::TCPBridge(Twili &twili, std::shared_ptr<bridge::Object> object_zero)
 
 	request_processing_signal_wh = twili.event_waiter.AddSignal(
 		[this]() {
-			std::unique_lock<thread::Mutex> lock(request_processing_mutex);
-
-			request_processing_signal_wh->ResetSignal();
-			try {
-				request_processing_connection->Synchronized();
-			} catch(ResultError &e) {
-				printf("caught 0x%x while processing request\n", e.code.code);
-				request_processing_connection->deletion_flag = true;
+			std::list<std::shared_ptr<Connection>> pending;
+			{
+				std::unique_lock<thread::Mutex> lock(request_processing_mutex);
+				request_processing_signal_wh->ResetSignal();
+				pending.swap(request_processing_connections);
 			}
-			request_processing_connection.reset();
 
-			request_processing_condvar.Signal(-1); // resume I/O thread after we unlock
+			// run jobs without holding the lock, so the socket thread can keep
+			// queueing more while we work.
+			for(std::shared_ptr<Connection> &connection : pending) {
+				try {
+					connection->Synchronized();
+				} catch(ResultError &e) {
+					printf("caught 0x%x while processing request\n", e.code.code);
+					connection->deletion_flag = true;
+				}
+			}
 
 			return true;
 		});
@@ -102,6 +107,9 @@ void TCPBridge::SocketThread() {
 			std::unique_lock<thread::Mutex> lock(network_state_mutex);
 			if(network_state != nifm::IRequest::State::Connected) {
 				printf("network is down\n");
+				for(auto &c : connections) {
+					c->Panic(); // release main thread if it's blocked on this connection
+				}
 				connections.clear(); // kill all our connections
 				
 				// wait for network to come back up
@@ -120,9 +128,11 @@ void TCPBridge::SocketThread() {
 		
 		std::vector<pollfd> fds;
 		fds.push_back({server_socket.fd, POLLIN}); // server socket
+		fds.push_back({wake_socket.fd, POLLIN}); // main thread wants our attention
 
 		for(auto &c : connections) {
-			fds.push_back({c->socket.fd, POLLIN});
+			// stop reading from clients that are too far ahead of us
+			fds.push_back({c->socket.fd, (short) ((c->WantsRead() ? POLLIN : 0) | (c->WantsWrite() ? POLLOUT : 0))});
 		}
 
 		if(bsd_poll(fds.data(), fds.size(), -1) < 0) {
@@ -153,6 +163,10 @@ void TCPBridge::SocketThread() {
 			client.fd = bsd_accept(server_socket.fd, NULL, NULL);
 			if(client.fd < 0) {
 				printf("failed to accept incoming connection\n");
+			} else if(connections.size() >= (size_t) twili.config.tcp_bridge_max_connections) {
+				// turn the client away instead of leaving it in the backlog
+				printf("too many connections, dropping %d\n", client.fd);
+				client.Close();
 			} else {
 				printf("accepted %d\n", client.fd);
 				try {
@@ -167,13 +181,23 @@ void TCPBridge::SocketThread() {
 			}
 		}
 
-		size_t fdi = 1;
+		if(fds[1].revents & POLLIN) {
+			// drain wakeup datagrams; we only care that we woke up
+			uint8_t drain[64];
+			while(bsd_recv(wake_socket.fd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+			}
+		}
+
+		size_t fdi = 2;
 		for(auto ci = connections.begin(); ci != connections.end(); fdi++) {
 			if(fds[fdi].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-				(*ci)->deletion_flag = true;
+				(*ci)->Panic();
 				ci = connections.erase(ci);
 				continue;
 			}
+			if(fds[fdi].revents & POLLOUT) {
+				(*ci)->PumpOutput();
+			}
 			if(fds[fdi].revents & POLLIN) {
 				(*ci)->PumpInput();
 			}
@@ -185,10 +209,11 @@ void TCPBridge::SocketThread() {
 				(*i)->Process();
 			} catch(trn::ResultError &e) {
 				printf("error 0x%x\n", e.code.code);
-				(*i)->deletion_flag = true;
+				(*i)->Panic();
 			}
 			
 			if((*i)->deletion_flag) {
+				(*i)->Panic();
 				i = connections.erase(i);
 				continue;
 			}
@@ -224,6 +249,28 @@ void TCPBridge::ResetSockets() {
 		return;
 	}
 
+	// recreate wake socket
+	wake_socket = {bsd_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
+	if(wake_socket.fd == -1) {
+		printf("failed to create wake socket\n");
+		return;
+	}
+
+	memset(&wake_addr, 0, sizeof(wake_addr));
+	wake_addr.sin_family = AF_INET;
+	wake_addr.sin_port = 0;
+	wake_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bsd_bind(wake_socket.fd, (struct sockaddr*) &wake_addr, sizeof(wake_addr)) < 0) {
+		printf("failed to bind wake socket\n");
+		return;
+	}
+
+	socklen_t wake_addr_len = sizeof(wake_addr);
+	if(bsd_getsockname(wake_socket.fd, (struct sockaddr*) &wake_addr, &wake_addr_len) < 0) {
+		printf("failed to get wake socket address\n");
+		return;
+	}
+
 	// recreate announce socket
 	announce_socket = {bsd_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)};
 	if(announce_socket.fd == -1) {
@@ -248,11 +295,21 @@ void TCPBridge::ResetSockets() {
 	printf("  bsd_errno: %d\n", bsd_errno);
 }
 
+void TCPBridge::WakeSocketThread() {
+	std::unique_lock<thread::Mutex> lock(network_state_mutex);
+	if(wake_socket.fd == -1) {
+		return;
+	}
+	uint8_t byte = 0;
+	bsd_sendto(wake_socket.fd, &byte, sizeof(byte), MSG_DONTWAIT, (struct sockaddr*) &wake_addr, sizeof(wake_addr));
+}
+
 TCPBridge::~TCPBridge() {
 	printf("destroying TCPBridge\n");
 	thread_destroy = true;
 	server_socket.Close();
 	network_state_condvar.Signal(-1);
+	WakeSocketThread();
 	printf("waiting for socket thread to die\n");
 	trn_thread_join(&thread, -1);
 	printf("socket thread joined\n");
@@ -22,14 +22,18 @@
 
 #include<libtransistor/cpp/waiter.hpp>
 #include<libtransistor/thread.h>
+#include<libtransistor/ipc/bsd.h>
 
+#include<deque>
 #include<list>
 #include<memory>
 
 #include "../../../common/Protocol.hpp"
 #include "../../../common/Buffer.hpp"
+#include "../../../common/SegmentedBuffer.hpp"
 #include "../ResponseOpener.hpp"
 #include "../RequestHandler.hpp"
+#include "RequestQueue.hpp"
 
 #include "../../nifm.hpp"
 #include "../../Threading.hpp"
@@ -60,6 +64,8 @@ class TCPBridge {
 
 	util::Socket announce_socket;
 	util::Socket server_socket;
+	util::Socket wake_socket; // loopback datagram socket used to interrupt poll
+	struct sockaddr_in wake_addr;
 	std::list<std::shared_ptr<Connection>> connections;
 	std::shared_ptr<bridge::Object> object_zero;
 	
@@ -71,6 +77,7 @@ class TCPBridge {
 	void SocketThread();
 
 	void ResetSockets();
+	void WakeSocketThread(); // thread-agnostic
 	nifm::IRequest::State network_state = nifm::IRequest::State::Error;
 	trn::KEvent network_state_event;
 	thread::Mutex network_state_mutex;
@@ -78,9 +85,9 @@ class TCPBridge {
 	std::shared_ptr<trn::WaitHandle> network_state_wh;
 
 	thread::Mutex request_processing_mutex;
-	thread::Condvar request_processing_condvar;
 	std::shared_ptr<trn::WaitHandle> request_processing_signal_wh;
-	std::shared_ptr<Connection> request_processing_connection;
+	// connections that have jobs waiting for the main thread
+	std::list<std::shared_ptr<Connection>> request_processing_connections;
 };
 
 class TCPBridge::Connection : public std::enable_shared_from_this<TCPBridge::Connection> {
@@ -89,20 +96,22 @@ class TCPBridge::Connection : public std::enable_shared_from_this<TCPBridge::Con
 	
 	Connection(TCPBridge &bridge, util::Socket &&socket);
 
+	// called on socket thread
+	bool WantsRead();
+	bool WantsWrite();
 	void PumpInput();
+	void PumpOutput();
 	void Process();
 
+	// called on main thread
+	void QueueOutput(const uint8_t *data, size_t size);
+	void FlushOutput();
+
 	// called when command processing has ended and further input should be discarded
 	void ResetHandler();
 	
 	bool deletion_flag = false;
 
-	enum class Task {
-		Idle, BeginProcessingCommand, FlushReceiveBuffer, FinalizeCommand
-	};
-	
-	volatile Task pending_task = Task::Idle;
-
 	void Synchronized(); // called on main thread
 	
 	util::Socket socket;
@@ -110,29 +119,43 @@ class TCPBridge::Connection : public std::enable_shared_from_this<TCPBridge::Con
 	void Panic(); // unrecoverable protocol error- abort!
 	
 	TCPBridge &bridge;
-	
+
 	/*
-	 * Requests that the main thread process something,
-	 * and then blocks until the main thread finishes. I know that this
-	 * isn't very parallel, but I'm only using threads here to work around
-	 * bad socket synchronization primitives so I don't really care.
-	 * The faster we can block this (the I/O) thread and keep it from breaking
-	 * things, the better.
+	 * The socket thread splits incoming data into jobs and hands them to the
+	 * main thread without waiting for them to run, so it can go on reading
+	 * the next request while the main thread handles the current one. It
+	 * stops reading if too much payload data is waiting for the main thread.
 	 */
-	// TODO: use a mutex here and run things on this thread to simplify
-	//       control flow.
-	void Synchronize(Task task);
-	
+	// Returns false if it stopped early because the client is too far behind
+	// on reading responses. The remaining jobs are kept until the socket
+	// thread has drained enough output and puts us back in line.
+	bool RunJobs(); // should run on main thread
+	bool DeferForOutput(); // should run on main thread
 	void BeginProcessingCommandImpl(); // should run on main thread
 	
-	util::Buffer in_buffer;
+	util::SegmentedBuffer in_buffer;
+	
+	// guarded by bridge.request_processing_mutex
+	RequestQueue request_queue;
+	bool is_queued_for_processing = false;
+
+	/*
+	 * Responses are appended to out_buffer by the main thread and sent by
+	 * the socket thread with non-blocking writes when poll says the socket
+	 * is writable, so a slow client can't stall the main thread. Header,
+	 * payload, and object IDs all land in the same buffer, so they usually
+	 * go out in a single send.
+	 */
+	thread::Mutex out_mutex;
+	util::SegmentedBuffer out_buffer; // guarded by out_mutex
+	bool write_armed = false; // guarded by out_mutex, set if socket thread will poll for POLLOUT
+	bool output_deferred = false; // guarded by out_mutex, set if jobs are waiting on output to drain
 
-	bool has_current_mh = false;
-	bool has_current_payload = false;
+	// main thread state
+	std::deque<RequestQueue::Job> jobs;
 	protocol::MessageHeader current_mh;
-	size_t payload_size;
 	util::Buffer payload_buffer;
-	util::Buffer current_object_ids;
+	std::vector<uint32_t> current_object_ids;
 
 	std::shared_ptr<detail::ResponseState> current_state;
 	std::shared_ptr<Object> current_object;
@@ -140,6 +163,7 @@ class TCPBridge::Connection : public std::enable_shared_from_this<TCPBridge::Con
 	
 	uint32_t next_object_id = 1;
 	std::map<uint32_t, std::shared_ptr<bridge::Object>> objects;
+	CloseObjectsHandler close_objects_handler;
 };
 
 class TCPBridge::Connection::ResponseState : public bridge::detail::ResponseState {
@@ -154,7 +178,6 @@ class TCPBridge::Connection::ResponseState : public bridge::detail::ResponseStat
 	virtual void InsertObject(std::pair<uint32_t, std::shared_ptr<Object>> &&pair) override;
 	
  private:
-	void Send(uint8_t *data, size_t size);
 	std::shared_ptr<Connection> connection;
 };
 
@@ -42,7 +42,9 @@ namespace usb {
 using trn::ResultCode;
 using trn::ResultError;
 
-USBBridge::RequestReader::RequestReader(USBBridge *bridge) : bridge(bridge) {
+USBBridge::RequestReader::RequestReader(USBBridge *bridge) :
+	bridge(bridge),
+	close_objects_handler(bridge->objects) {
 }
 
 USBBridge::RequestReader::~RequestReader() {
@@ -54,7 +56,6 @@ void USBBridge::RequestReader::Begin() {
 			bridge->endpoint_request_meta->completion_event, [this]() {
 				try {
 					this->MetadataTransactionCompleted();
-					this->PostMetaBuffer();
 					return true;
 				} catch(ResultError &e) {
 					bridge->ResetInterface();
@@ -95,11 +96,7 @@ void USBBridge::RequestReader::PostMetaBuffer() {
 }
 
 void USBBridge::RequestReader::PostDataBuffer() {
-	size_t size = bridge->request_data_buffer.size;
-	if(current_header.payload_size - payload_size < size) {
-		size = current_header.payload_size - payload_size;
-	}
-
+	size_t size = bridge->sequencer.GetPayloadTransferSize(bridge->request_data_buffer.size);
 	auto r = bridge->endpoint_request_data->PostBufferAsync(bridge->request_data_buffer.data, size);
 	if(r) {
 		data_urb_id = *r;
@@ -133,6 +130,7 @@ void USBBridge::RequestReader::MetadataTransactionCompleted() {
 		return;
 	}
 	if(entry->transferred_size == 0) {
+		PostMetaBuffer();
 		return;
 	}
 	if(entry->transferred_size != sizeof(protocol::MessageHeader)) {
@@ -144,28 +142,20 @@ void USBBridge::RequestReader::MetadataTransactionCompleted() {
 		printf("got header, object 0x%x, command %u, payload size 0x%lx\n", current_header.object_id, current_header.command_id, current_header.payload_size);
 	}
 
-	payload_size = 0;
 	object_ids.clear();
 	payload_buffer.Clear();
 	ResetHandler();
 	
 	// pick command handler
 	BeginProcessingCommand();
-	
-	if(current_header.payload_size > 0) {
-		PostDataBuffer();
-	} else if(current_header.object_count > 0) {
-		PostObjectBuffer();
-	} else {
-		FinalizeCommand();
-	}
+	Advance();
 }
 
 void USBBridge::RequestReader::DataTransactionCompleted() {
 	usb_ds_report_t report;
 
 	// we've finished receiving the payload, so this must be object IDs
-	if(payload_size == current_header.payload_size) {
+	if(bridge->sequencer.GetNextStep() == RequestSequencer::Step::ReceiveObjects) {
 		auto entry = USBBridge::FindReport(bridge->endpoint_request_data, report, object_urb_id);
 		if(entry->urb_status != 3) {
 			printf("Object URB status (%d) != 3\n", entry->urb_status);
@@ -182,6 +172,7 @@ void USBBridge::RequestReader::DataTransactionCompleted() {
 			((uint32_t*) bridge->request_data_buffer.data),
 			((uint32_t*) bridge->request_data_buffer.data) + current_header.object_count,
 			object_ids.insert(object_ids.end(), current_header.object_count, 0));
+		bridge->sequencer.ObjectsReceived();
 		FinalizeCommand();
 
 		return;
@@ -193,13 +184,11 @@ void USBBridge::RequestReader::DataTransactionCompleted() {
 		bridge->ResetInterface();
 		return;
 	}
-	if(payload_size + entry->transferred_size > current_header.payload_size) {
+	if(!bridge->sequencer.PayloadReceived(entry->transferred_size)) {
 		printf("Overshot payload size\n");
 		bridge->ResetInterface();
 		return;
 	}
-
-	payload_size+= entry->transferred_size;
 	
 	try {
 		// fill input buffer with data from USB
@@ -211,7 +200,7 @@ void USBBridge::RequestReader::DataTransactionCompleted() {
 		printf("USBRequestReader: Somebody is still throwing exceptions!\n");
 		twili::Abort(e);
 	} catch(std::bad_alloc &e) {
-		if(!current_state->has_begun) {
+		if(bridge->sequencer.IsHandlingInput()) {
 			printf("USBRequestReader: ran out of memory. trying to signal this to user...\n");
 			ResponseOpener opener(current_state);
 			opener.RespondError(LIBTRANSISTOR_ERR_OUT_OF_MEMORY);
@@ -222,18 +211,14 @@ void USBBridge::RequestReader::DataTransactionCompleted() {
 		}
 		CleanupCommand();
 	}
-	
-	if(payload_size < current_header.payload_size) {
-		PostDataBuffer();
-	} else if(current_header.object_count > 0) {
-		PostObjectBuffer();
-	} else {
-		FinalizeCommand();
-	}
+
+	Advance();
 }
 
 void USBBridge::RequestReader::BeginProcessingCommand() {
 	current_state = std::make_shared<USBBridge::ResponseState>(*bridge, current_header.client_id, current_header.tag);
+	// before anything can respond, so that an early response is recognized
+	bridge->sequencer.BeginRequest(current_header, current_state.get());
 	ResponseOpener opener(current_state);
 	auto i = bridge->objects.find(current_header.object_id);
 	if(i == bridge->objects.end()) {
@@ -242,7 +227,11 @@ void USBBridge::RequestReader::BeginProcessingCommand() {
 	}
 	
 	// check for a close object request
-	if(current_header.command_id == 0xffffffff) {
+	if(current_header.command_id == protocol::CLOSE_OBJECTS && current_header.object_id == 0) {
+		current_handler = close_objects_handler.Open(current_header.payload_size, opener);
+		return;
+	}
+	if(current_header.command_id == protocol::CLOSE_OBJECT) {
 		printf("got close command for %d\n", current_header.object_id);
 		if(current_header.object_id == 0) {
 			// closing object 0 closes everything except object 0
@@ -276,12 +265,22 @@ void USBBridge::RequestReader::BeginProcessingCommand() {
 
 void USBBridge::RequestReader::FinalizeCommand() {
 	try {
+		if(!object_ids.empty()) {
+			current_handler->ReceiveObjects(ResolveObjects(bridge->objects, object_ids));
+		}
 		current_handler->Finalize(payload_buffer);
 		CleanupCommand();
 	} catch(ResultError &e) {
 		printf("USBRequestReader: Somebody is still throwing exceptions!\n");
 		twili::Abort(e);
 	}
+
+	// The request has been fully received. Its response may still be pending
+	// (pipe reads, state change waits, etc.), but that doesn't need to hold up
+	// the next request. We wait until now to post the meta buffer so that the
+	// next header can't be processed before this request's data.
+	bridge->sequencer.EndRequest();
+	PostMetaBuffer();
 }
 
 void USBBridge::RequestReader::CleanupCommand() {
@@ -297,6 +296,23 @@ void USBBridge::RequestReader::ResetHandler() {
 	current_handler = DiscardingRequestHandler::GetInstance();
 }
 
+void USBBridge::RequestReader::Advance() {
+	switch(bridge->sequencer.GetNextStep()) {
+	case RequestSequencer::Step::ReceiveHeader:
+		PostMetaBuffer();
+		break;
+	case RequestSequencer::Step::ReceivePayload:
+		PostDataBuffer();
+		break;
+	case RequestSequencer::Step::ReceiveObjects:
+		PostObjectBuffer();
+		break;
+	case RequestSequencer::Step::Finalize:
+		FinalizeCommand();
+		break;
+	}
+}
+
 } // namespace usb
 } // namespace bridge
 } // namespace twili
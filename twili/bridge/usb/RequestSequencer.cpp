@@ -0,0 +1,102 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "RequestSequencer.hpp"
+
+namespace twili {
+namespace bridge {
+namespace usb {
+
+void RequestSequencer::BeginRequest(const protocol::MessageHeader &mh, const void *response) {
+	in_request = true;
+	header = mh;
+	payload_received = 0;
+	objects_received = false;
+	receiving = response;
+}
+
+bool RequestSequencer::PayloadReceived(size_t size) {
+	if(payload_received + size > header.payload_size) {
+		return false;
+	}
+	payload_received+= size;
+	return true;
+}
+
+void RequestSequencer::ObjectsReceived() {
+	objects_received = true;
+}
+
+void RequestSequencer::EndRequest() {
+	in_request = false;
+	receiving = nullptr;
+}
+
+RequestSequencer::Step RequestSequencer::GetNextStep() const {
+	if(!in_request) {
+		return Step::ReceiveHeader;
+	}
+	if(payload_received < header.payload_size) {
+		return Step::ReceivePayload;
+	}
+	if(header.object_count > 0 && !objects_received) {
+		return Step::ReceiveObjects;
+	}
+	return Step::Finalize;
+}
+
+size_t RequestSequencer::GetPayloadTransferSize(size_t buffer_size) const {
+	if(header.payload_size - payload_received < buffer_size) {
+		return header.payload_size - payload_received;
+	}
+	return buffer_size;
+}
+
+bool RequestSequencer::IsHandlingInput() const {
+	return receiving != nullptr;
+}
+
+RequestSequencer::ResponseStart RequestSequencer::BeginResponse(const void *response) {
+	// responses share the response buffers, so only one may be in flight.
+	if(transmitting != nullptr) {
+		return ResponseStart::Busy;
+	}
+	transmitting = response;
+	if(response == receiving) {
+		// responding before we've received the entire request
+		receiving = nullptr;
+		return ResponseStart::Early;
+	}
+	return ResponseStart::Ok;
+}
+
+void RequestSequencer::EndResponse(const void *response) {
+	if(transmitting == response) {
+		transmitting = nullptr;
+	}
+}
+
+const void *RequestSequencer::GetTransmittingResponse() const {
+	return transmitting;
+}
+
+} // namespace usb
+} // namespace bridge
+} // namespace twili
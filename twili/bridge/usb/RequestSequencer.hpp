@@ -0,0 +1,92 @@
+//
+// Twili - Homebrew debug monitor for the Nintendo Switch
+// Copyright (C) 2018 misson20000 <xenotoad@xenotoad.net>
+//
+// This file is part of Twili.
+//
+// Twili is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Twili is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Twili.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include<stdint.h>
+#include<stddef.h>
+
+#include "../../../common/Protocol.hpp"
+
+namespace twili {
+namespace bridge {
+namespace usb {
+
+// The request/response state machine behind USBBridge. Requests are received
+// one at a time, but any number of them may be waiting on asynchronous
+// responses, and those responses may begin whenever their handlers get to
+// them. This decides what the request reader should wait for next, whether
+// the request being received still wants its input, and which response
+// owns the shared response buffers.
+//
+// Responses are only compared by address. This class doesn't depend on
+// libtransistor, so it can be built and exercised on the host.
+class RequestSequencer {
+ public:
+	enum class Step {
+		ReceiveHeader, // post the meta buffer for the next request header
+		ReceivePayload, // post the data buffer for more payload
+		ReceiveObjects, // post the data buffer for the object ID tail
+		Finalize, // the request has been fully received
+	};
+
+	enum class ResponseStart {
+		Ok,
+		// the response is for the request that is still being received, so
+		// the rest of that request's input should be discarded
+		Early,
+		// another response still holds the response buffers
+		Busy,
+	};
+
+	// A header came in for a request whose response will be sent through
+	// `response`.
+	void BeginRequest(const protocol::MessageHeader &mh, const void *response);
+	// Returns false if this overshot the payload size.
+	bool PayloadReceived(size_t size);
+	void ObjectsReceived();
+	// The request has been finalized or abandoned.
+	void EndRequest();
+	
+	Step GetNextStep() const;
+	// How much the next payload transfer should ask for.
+	size_t GetPayloadTransferSize(size_t buffer_size) const;
+	// False once the response for the request being received has begun.
+	bool IsHandlingInput() const;
+
+	ResponseStart BeginResponse(const void *response);
+	// The response has been finalized, or destroyed partway through. Does
+	// nothing if it wasn't the one transmitting.
+	void EndResponse(const void *response);
+	const void *GetTransmittingResponse() const;
+	
+ private:
+	bool in_request = false;
+	protocol::MessageHeader header;
+	size_t payload_received = 0;
+	bool objects_received = false;
+
+	const void *receiving = nullptr;
+	const void *transmitting = nullptr;
+};
+
+} // namespace usb
+} // namespace bridge
+} // namespace twili
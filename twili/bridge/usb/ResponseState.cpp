@@ -36,12 +36,27 @@ USBBridge::ResponseState::ResponseState(USBBridge &bridge, uint32_t client_id, u
 	
 }
 
+USBBridge::ResponseState::~ResponseState() {
+	bridge.sequencer.EndResponse(this);
+}
+
 size_t USBBridge::ResponseState::GetMaxTransferSize() {
 	return bridge.response_data_buffer.size;
 }
 
 void USBBridge::ResponseState::SendHeader(protocol::MessageHeader &hdr) {
-	bridge.request_reader.ResetHandler();
+	switch(bridge.sequencer.BeginResponse(this)) {
+	case RequestSequencer::ResponseStart::Ok:
+		break;
+	case RequestSequencer::ResponseStart::Early:
+		// responding before we've received the entire request,
+		// so discard whatever is left of it.
+		bridge.request_reader.ResetHandler();
+		break;
+	case RequestSequencer::ResponseStart::Busy:
+		// responses share the response buffers, so only one may be in flight.
+		twili::Abort(TWILI_ERR_FATAL_BRIDGE_STATE);
+	}
 	
 	memcpy(
 		bridge.response_meta_buffer.data,
@@ -86,6 +101,8 @@ void USBBridge::ResponseState::Finalize() {
 		}
 		USBBridge::PostBufferSync(bridge.endpoint_response_data, bridge.response_data_buffer.data, object_count * sizeof(uint32_t));
 	}
+
+	bridge.sequencer.EndResponse(this);
 }
 
 uint32_t USBBridge::ResponseState::ReserveObjectId() {
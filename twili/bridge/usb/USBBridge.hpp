@@ -31,6 +31,7 @@
 #include "../../../common/Protocol.hpp"
 #include "../ResponseOpener.hpp"
 #include "../RequestHandler.hpp"
+#include "RequestSequencer.hpp"
 
 namespace twili {
 
@@ -65,7 +66,8 @@ class USBBridge {
 		void PostObjectBuffer();
 
 		// called when command processing has ended (normally or fatally)
-		// and any further input for this request should be discarded.
+		// and any further input for this request should be discarded,
+		// including when its response begins early.
 		void ResetHandler();
 		
 	 private:
@@ -81,15 +83,17 @@ class USBBridge {
 		void BeginProcessingCommand();
 		void FinalizeCommand();
 		void CleanupCommand();
+		// posts whichever buffer the sequencer says comes next
+		void Advance();
 		
 		protocol::MessageHeader current_header;
-		size_t payload_size;
 		util::Buffer payload_buffer;
 		std::vector<uint32_t> object_ids;
 
 		std::shared_ptr<detail::ResponseState> current_state;
 		std::shared_ptr<Object> current_object;
 		RequestHandler *current_handler = DiscardingRequestHandler::GetInstance();
+		CloseObjectsHandler close_objects_handler;
 	};
 
 	class ResponseState;
@@ -116,7 +120,8 @@ class USBBridge {
 
 	uint32_t object_id = 1;
 	std::map<uint32_t, std::shared_ptr<bridge::Object>> objects;
-	
+
+	RequestSequencer sequencer;
 	RequestReader request_reader;
 	USBBuffer request_meta_buffer;
 	USBBuffer response_meta_buffer;
@@ -132,6 +137,7 @@ class USBBridge {
 class USBBridge::ResponseState : public bridge::detail::ResponseState {
  public:
 	ResponseState(USBBridge &bridge, uint32_t client_id, uint32_t tag);
+	~ResponseState();
 
 	virtual size_t GetMaxTransferSize() override;
 	virtual void SendHeader(protocol::MessageHeader &hdr) override;
@@ -19,6 +19,7 @@
 //
 
 typedef bool _Bool;
+#include<algorithm>
 #include<iostream>
 
 #include<libtransistor/cpp/types.hpp>
@@ -230,6 +231,10 @@ Twili::Config::Config() {
 		fprintf(f, "; 0 forces pipes to be synchronous\n");
 		fprintf(f, "pipe_buffer_size_limit = 0x%lx\n", pipe_buffer_size_limit);
 		fprintf(f, "\n");
+		fprintf(f, "[filesystem]\n");
+		fprintf(f, "; buffer for copies between filesystems on the device, rounded up to a page\n");
+		fprintf(f, "copy_buffer_size = 0x%lx\n", copy_buffer_size);
+		fprintf(f, "\n");
 		fprintf(f, "[logging]\n");
 		fprintf(f, "verbosity = %d\n", logging_verbosity);
 		fprintf(f, "enable_usb = %s\n", enable_usb_log ? "true" : "false");
@@ -240,6 +245,12 @@ Twili::Config::Config() {
 		fprintf(f, "[tcp_bridge]\n");
 		fprintf(f, "enabled = %s\n", enable_tcp_bridge ? "true" : "false");
 		fprintf(f, "port = %d\n", tcp_bridge_port);
+		fprintf(f, "max_connections = %d\n", tcp_bridge_max_connections);
+		fprintf(f, "receive_buffer_size = 0x%lx\n", tcp_bridge_receive_buffer_size);
+		fprintf(f, "; stop reading requests from a client once this many bytes of them are waiting to be processed\n");
+		fprintf(f, "input_queue_limit = 0x%lx\n", tcp_bridge_input_queue_limit);
+		fprintf(f, "; stop reading requests from a client once this many bytes of responses are waiting to be sent to it\n");
+		fprintf(f, "output_queue_limit = 0x%lx\n", tcp_bridge_output_queue_limit);
 		fclose(f);
 	} else {
 		// load config
@@ -256,6 +267,7 @@ Twili::Config::Config() {
 		temp_directory = reader.Get("twili", "temp_directory", temp_directory);
 
 		pipe_buffer_size_limit = reader.GetInteger("pipes", "pipe_buffer_size_limit", pipe_buffer_size_limit);
+		copy_buffer_size = reader.GetInteger("filesystem", "copy_buffer_size", copy_buffer_size);
 		
 		logging_verbosity = reader.GetInteger("logging", "verbosity", logging_verbosity);
 		enable_usb_log = reader.GetBoolean("logging", "enable_usb", enable_usb_log);
@@ -264,6 +276,19 @@ Twili::Config::Config() {
 		
 		enable_tcp_bridge = reader.GetBoolean("tcp_bridge", "enabled", true);
 		tcp_bridge_port = reader.GetInteger("tcp_bridge", "port", tcp_bridge_port);
+		tcp_bridge_max_connections = reader.GetInteger("tcp_bridge", "max_connections", tcp_bridge_max_connections);
+		tcp_bridge_receive_buffer_size = reader.GetInteger("tcp_bridge", "receive_buffer_size", tcp_bridge_receive_buffer_size);
+		tcp_bridge_input_queue_limit = reader.GetInteger("tcp_bridge", "input_queue_limit", tcp_bridge_input_queue_limit);
+		tcp_bridge_output_queue_limit = reader.GetInteger("tcp_bridge", "output_queue_limit", tcp_bridge_output_queue_limit);
+
+		// a zero receive buffer would fail every recv(), and the limits are
+		// compared as size_t, where a negative value would mean no limit at all
+		tcp_bridge_max_connections = std::max(tcp_bridge_max_connections, 1);
+		tcp_bridge_receive_buffer_size = std::max(tcp_bridge_receive_buffer_size, 0x1000l);
+		tcp_bridge_input_queue_limit = std::max(tcp_bridge_input_queue_limit, 0l);
+		tcp_bridge_output_queue_limit = std::max(tcp_bridge_output_queue_limit, 0l);
+		// the copy buffer is allocated in one piece for every copy
+		copy_buffer_size = std::min(std::max(copy_buffer_size, 0x1000l), 0x1000000l);
 
 		state = State::Loaded;
 		fclose(f);
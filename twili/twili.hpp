@@ -96,6 +96,9 @@ class Twili {
 
 		// [pipes]
 		long pipe_buffer_size_limit = 512 * 1024;
+
+		// [filesystem]
+		long copy_buffer_size = 1024 * 1024;
 		
 		// [logging]
 		int logging_verbosity = 0;
@@ -107,6 +110,10 @@ class Twili {
 		// [tcp_bridge]
 		bool enable_tcp_bridge = true;
 		int tcp_bridge_port = 15152;
+		int tcp_bridge_max_connections = 8;
+		long tcp_bridge_receive_buffer_size = 64 * 1024;
+		long tcp_bridge_input_queue_limit = 512 * 1024; // per connection
+		long tcp_bridge_output_queue_limit = 1024 * 1024; // per connection
 
 		enum class State {
 			Fresh, Loaded, Error